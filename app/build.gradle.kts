@@ -42,6 +42,10 @@ android {
     buildFeatures {
         viewBinding = true
     }
+    androidResources {
+        // The native asset bundle is mmapped through its file descriptor, so it must be stored uncompressed.
+        noCompress += "pak"
+    }
     sourceSets {
         getByName("main") {
             jniLibs.srcDirs("libs")
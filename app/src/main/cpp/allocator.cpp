@@ -0,0 +1,161 @@
+#include "allocator.h"
+
+#include <cstdlib>
+#include <mutex>
+
+#include "common.h"
+
+namespace {
+
+struct TagCounters {
+    std::atomic<uint64_t> liveBytes{0};
+    std::atomic<uint64_t> peakBytes{0};
+    std::atomic<uint64_t> capBytes{0};
+    std::atomic<uint64_t> allocs{0};
+    std::atomic<uint64_t> frees{0};
+    std::atomic<uint64_t> failures{0};
+    std::atomic<uint64_t> capBreaches{0};
+};
+
+TagCounters gCounters[MEM_TAG_COUNT];
+
+// Prefix in front of every block so Mem_Free needs neither size nor tag.
+// 16 bytes keeps the payload at malloc's alignment.
+struct alignas(16) BlockHeader {
+    uint64_t bytes;
+    MemTag tag;
+};
+static_assert(sizeof(BlockHeader) == 16, "header must preserve malloc alignment");
+
+struct SampleState {
+    std::mutex mutex;
+    int64_t lastNs = 0;
+    uint64_t lastAllocs[MEM_TAG_COUNT] = {};
+};
+
+SampleState& Sampler() {
+    static SampleState state;
+    return state;
+}
+
+void* AllocBlock(size_t bytes, MemTag tag, bool capped) {
+    TagCounters& c = gCounters[tag];
+    const uint64_t cap = c.capBytes.load(std::memory_order_relaxed);
+    const uint64_t live = c.liveBytes.load(std::memory_order_relaxed);
+    if (cap != 0 && live + bytes > cap) {
+        if (capped) {
+            if (c.failures.fetch_add(1, std::memory_order_relaxed) == 0) {
+                ALOGW("Memory cap for %s reached (%.1f MB), refusing allocations", Mem_TagName(tag), cap / 1048576.0);
+            }
+            return nullptr;
+        }
+        if (c.capBreaches.fetch_add(1, std::memory_order_relaxed) == 0) {
+            ALOGW("Memory cap for %s exceeded by a container (%.1f MB)", Mem_TagName(tag), cap / 1048576.0);
+        }
+    }
+    auto* header = static_cast<BlockHeader*>(malloc(sizeof(BlockHeader) + bytes));
+    if (header == nullptr) {
+        c.failures.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    header->bytes = bytes;
+    header->tag = tag;
+    const uint64_t now = c.liveBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    uint64_t peak = c.peakBytes.load(std::memory_order_relaxed);
+    while (now > peak && !c.peakBytes.compare_exchange_weak(peak, now, std::memory_order_relaxed)) {}
+    c.allocs.fetch_add(1, std::memory_order_relaxed);
+    return header + 1;
+}
+
+} // namespace
+
+void* Mem_Alloc(size_t bytes, MemTag tag) { return AllocBlock(bytes, tag, true); }
+
+void* Mem_AllocUncapped(size_t bytes, MemTag tag) {
+    void* p = AllocBlock(bytes, tag, false);
+    if (p == nullptr) throw std::bad_alloc();
+    return p;
+}
+
+void Mem_Free(void* ptr) {
+    if (ptr == nullptr) return;
+    BlockHeader* header = static_cast<BlockHeader*>(ptr) - 1;
+    TagCounters& c = gCounters[header->tag];
+    c.liveBytes.fetch_sub(header->bytes, std::memory_order_relaxed);
+    c.frees.fetch_add(1, std::memory_order_relaxed);
+    free(header);
+}
+
+void Mem_NoteAlloc(MemTag tag) { gCounters[tag].allocs.fetch_add(1, std::memory_order_relaxed); }
+
+void Mem_SetCap(MemTag tag, uint64_t bytes) {
+    gCounters[tag].capBytes.store(bytes, std::memory_order_relaxed);
+    gCounters[tag].failures.store(0, std::memory_order_relaxed);
+    gCounters[tag].capBreaches.store(0, std::memory_order_relaxed);
+    ALOGI("Memory cap for %s: %.1f MB", Mem_TagName(tag), bytes / 1048576.0);
+}
+
+void Mem_Sample(MemTagStats (&out)[MEM_TAG_COUNT]) {
+    SampleState& s = Sampler();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    const int64_t now = NowNs();
+    const double seconds = s.lastNs != 0 ? (now - s.lastNs) / 1e9 : 0.0;
+    for (int t = 0; t < MEM_TAG_COUNT; ++t) {
+        const TagCounters& c = gCounters[t];
+        MemTagStats& o = out[t];
+        o.liveBytes = c.liveBytes.load(std::memory_order_relaxed);
+        o.peakBytes = c.peakBytes.load(std::memory_order_relaxed);
+        o.capBytes = c.capBytes.load(std::memory_order_relaxed);
+        o.allocs = c.allocs.load(std::memory_order_relaxed);
+        o.frees = c.frees.load(std::memory_order_relaxed);
+        o.failures = c.failures.load(std::memory_order_relaxed);
+        o.capBreaches = c.capBreaches.load(std::memory_order_relaxed);
+        o.allocsPerSec = seconds > 0.0 ? (o.allocs - s.lastAllocs[t]) / seconds : 0.0;
+        s.lastAllocs[t] = o.allocs;
+    }
+    s.lastNs = now;
+}
+
+void Mem_LogReport() {
+    MemTagStats stats[MEM_TAG_COUNT];
+    Mem_Sample(stats);
+    for (int t = 0; t < MEM_TAG_COUNT; ++t) {
+        const MemTagStats& s = stats[t];
+        if (s.allocs == 0) continue;
+        ALOGI("Memory %-8s live %8.1f KB  peak %8.1f KB  %6.1f allocs/s  %llu failed",
+              Mem_TagName(static_cast<MemTag>(t)), s.liveBytes / 1024.0, s.peakBytes / 1024.0, s.allocsPerSec,
+              (unsigned long long)s.failures);
+    }
+}
+
+const char* Mem_TagName(MemTag tag) {
+    switch (tag) {
+        case MEM_TAG_FRAME: return "frame";
+        case MEM_TAG_SCENE: return "scene";
+        case MEM_TAG_TEXT: return "text";
+        case MEM_TAG_VISION: return "vision";
+        case MEM_TAG_NETWORK: return "network";
+        case MEM_TAG_AUDIO: return "audio";
+        case MEM_TAG_CAPTURE: return "capture";
+        default: return "general";
+    }
+}
+
+// -----------------------------------------------------------------------------
+// LinearArena
+// -----------------------------------------------------------------------------
+void* LinearArena::Alloc(size_t bytes, size_t align) {
+    if (base_ == nullptr) {
+        base_ = static_cast<uint8_t*>(Mem_Alloc(capacity_, tag_));
+        if (base_ == nullptr) { overflows_++; return nullptr; }
+    }
+    const size_t offset = (used_ + align - 1) & ~(align - 1);
+    if (offset + bytes > capacity_) {
+        if (overflows_++ == 0) ALOGW("%s arena exhausted (%zu bytes)", Mem_TagName(tag_), capacity_);
+        return nullptr;
+    }
+    used_ = offset + bytes;
+    if (used_ > highWater_) highWater_ = used_;
+    Mem_NoteAlloc(tag_);
+    return base_ + offset;
+}
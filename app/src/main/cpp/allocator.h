@@ -0,0 +1,169 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <vector>
+
+// =============================================================================
+// Tracked Native Allocations
+// =============================================================================
+// Long-lived native allocations are tagged with the subsystem that owns them so
+// heap growth during long assistant sessions can be attributed and capped.
+//
+//   Mem_Alloc / Mem_Free      raw tagged blocks, refused once the tag's cap is hit
+//   TrackingAllocator<T, Tag> STL allocator for tagged containers
+//   LinearArena               bump allocator reset every frame
+//   ObjectPool<T>             free-list pool for fixed-size objects
+//
+// Counters are relaxed atomics; any thread may allocate.
+
+enum MemTag : uint8_t {
+    MEM_TAG_FRAME = 0,
+    MEM_TAG_SCENE,
+    MEM_TAG_TEXT,
+    MEM_TAG_VISION,
+    MEM_TAG_NETWORK,
+    MEM_TAG_AUDIO,
+    MEM_TAG_CAPTURE,
+    MEM_TAG_GENERAL,
+    MEM_TAG_COUNT
+};
+
+struct MemTagStats {
+    uint64_t liveBytes = 0;
+    uint64_t peakBytes = 0;
+    uint64_t capBytes = 0;        // 0: uncapped
+    uint64_t allocs = 0;          // lifetime, including arena and pool allocations
+    uint64_t frees = 0;
+    uint64_t failures = 0;        // refused by the cap
+    uint64_t capBreaches = 0;     // container growth past the cap (containers cannot be refused)
+    double allocsPerSec = 0.0;    // since the previous Mem_Sample
+};
+
+void* Mem_Alloc(size_t bytes, MemTag tag);
+void Mem_Free(void* ptr);
+// Allocation that always succeeds (or throws); growth past the cap is only counted.
+void* Mem_AllocUncapped(size_t bytes, MemTag tag);
+// Counts an allocation served from memory the tag already owns (arena, pool).
+void Mem_NoteAlloc(MemTag tag);
+
+void Mem_SetCap(MemTag tag, uint64_t bytes);
+// Snapshot of every tag; allocation rates are measured against the previous call.
+void Mem_Sample(MemTagStats (&out)[MEM_TAG_COUNT]);
+void Mem_LogReport();
+const char* Mem_TagName(MemTag tag);
+
+// -----------------------------------------------------------------------------
+// STL allocator charging a tag.
+// -----------------------------------------------------------------------------
+template <typename T, MemTag Tag>
+struct TrackingAllocator {
+    using value_type = T;
+    template <typename U> struct rebind { using other = TrackingAllocator<U, Tag>; };
+
+    TrackingAllocator() = default;
+    template <typename U> TrackingAllocator(const TrackingAllocator<U, Tag>&) {}
+
+    T* allocate(size_t n) { return static_cast<T*>(Mem_AllocUncapped(n * sizeof(T), Tag)); }
+    void deallocate(T* p, size_t) { Mem_Free(p); }
+
+    template <typename U> bool operator==(const TrackingAllocator<U, Tag>&) const { return true; }
+    template <typename U> bool operator!=(const TrackingAllocator<U, Tag>&) const { return false; }
+};
+
+template <typename T, MemTag Tag>
+using TrackedVector = std::vector<T, TrackingAllocator<T, Tag>>;
+
+// -----------------------------------------------------------------------------
+// Bump allocator over one tagged block. Nothing is freed individually; Reset()
+// releases everything at once. Single-threaded.
+// -----------------------------------------------------------------------------
+class LinearArena {
+public:
+    LinearArena(MemTag tag, size_t capacity) : tag_(tag), capacity_(capacity) {}
+    ~LinearArena() { Mem_Free(base_); }
+    LinearArena(const LinearArena&) = delete;
+    LinearArena& operator=(const LinearArena&) = delete;
+
+    void* Alloc(size_t bytes, size_t align = alignof(std::max_align_t));
+    // Value-initialized array; nullptr when the arena is exhausted.
+    template <typename T> T* AllocArray(size_t count, const T& init = T()) {
+        T* p = static_cast<T*>(Alloc(count * sizeof(T), alignof(T)));
+        if (p != nullptr) for (size_t i = 0; i < count; ++i) new (p + i) T(init);
+        return p;
+    }
+    void Reset() { used_ = 0; }
+
+    size_t Used() const { return used_; }
+    size_t HighWater() const { return highWater_; }
+    uint64_t Overflows() const { return overflows_; }
+
+private:
+    MemTag tag_;
+    size_t capacity_;
+    uint8_t* base_ = nullptr;
+    size_t used_ = 0;
+    size_t highWater_ = 0;
+    uint64_t overflows_ = 0;
+};
+
+// -----------------------------------------------------------------------------
+// Pool of fixed-size objects carved from tagged chunks. Slots are recycled
+// through a free list and chunks are only returned when the pool is destroyed.
+// Single-threaded.
+// -----------------------------------------------------------------------------
+template <typename T>
+class ObjectPool {
+public:
+    explicit ObjectPool(MemTag tag, size_t objectsPerChunk = 16) : tag_(tag), perChunk_(objectsPerChunk) {}
+    ~ObjectPool() { for (void* chunk : chunks_) Mem_Free(chunk); }
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+
+    template <typename... Args> T* Create(Args&&... args) {
+        if (freeList_ == nullptr && !Grow()) return nullptr;
+        Slot* slot = freeList_;
+        freeList_ = slot->next;
+        inUse_++;
+        Mem_NoteAlloc(tag_);
+        return new (slot) T(std::forward<Args>(args)...);
+    }
+
+    void Destroy(T* object) {
+        if (object == nullptr) return;
+        object->~T();
+        Slot* slot = reinterpret_cast<Slot*>(object);
+        slot->next = freeList_;
+        freeList_ = slot;
+        inUse_--;
+    }
+
+    size_t InUse() const { return inUse_; }
+    size_t Capacity() const { return chunks_.size() * perChunk_; }
+
+private:
+    union Slot {
+        Slot* next;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    bool Grow() {
+        Slot* chunk = static_cast<Slot*>(Mem_Alloc(perChunk_ * sizeof(Slot), tag_));
+        if (chunk == nullptr) return false;
+        chunks_.push_back(chunk);
+        for (size_t i = 0; i < perChunk_; ++i) {
+            chunk[i].next = freeList_;
+            freeList_ = &chunk[i];
+        }
+        return true;
+    }
+
+    MemTag tag_;
+    size_t perChunk_;
+    Slot* freeList_ = nullptr;
+    size_t inUse_ = 0;
+    std::vector<void*> chunks_;
+};
@@ -0,0 +1,295 @@
+#include "asset_bundle.h"
+
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <GLES3/gl3.h>
+
+#include "common.h"
+
+namespace {
+
+size_t PageSize() {
+    static const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return pageSize;
+}
+
+uint64_t AlignUp(uint64_t value, uint64_t alignment) { return (value + alignment - 1) / alignment * alignment; }
+
+float FloatFromBits(uint32_t bits) {
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+uint32_t FloatBits(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+uint64_t TextureBytes(uint32_t width, uint32_t height, uint32_t levels, uint32_t bytesPerTexel) {
+    uint64_t bytes = 0;
+    for (uint32_t level = 0; level < levels; ++level) {
+        bytes += static_cast<uint64_t>(width) * height * bytesPerTexel;
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+    return bytes;
+}
+
+} // namespace
+
+uint32_t AssetTexture_TexelBytes(uint32_t format, uint32_t type) {
+    if (type != GL_UNSIGNED_BYTE) return 0;
+    switch (format) {
+        case GL_RED: return 1;
+        case GL_RG: return 2;
+        case GL_RGB: return 3;
+        case GL_RGBA: return 4;
+        default: return 0;
+    }
+}
+
+// =============================================================================
+// Reader
+// =============================================================================
+bool AssetBundle::Open(const std::string& path) {
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) { ALOGE("Asset bundle: cannot open %s", path.c_str()); return false; }
+    struct stat st;
+    const bool ok = fstat(fd, &st) == 0 && OpenFd(fd, 0, st.st_size, path.c_str());
+    close(fd);
+    return ok;
+}
+
+bool AssetBundle::OpenFd(int fd, int64_t offset, int64_t length, const char* label) {
+    Close();
+    if (offset < 0 || length < static_cast<int64_t>(sizeof(AssetBundleHeader)) || length > UINT32_MAX) {
+        ALOGE("Asset bundle %s: %lld bytes is not a valid size", label, (long long)length);
+        return false;
+    }
+    // mmap wants a page-aligned file offset; an APK entry usually is not one.
+    const size_t lead = static_cast<size_t>(offset) % PageSize();
+    mappingSize_ = lead + static_cast<size_t>(length);
+    mapping_ = mmap(nullptr, mappingSize_, PROT_READ, MAP_PRIVATE, fd, offset - static_cast<int64_t>(lead));
+    if (mapping_ == MAP_FAILED) {
+        ALOGE("Asset bundle %s: mmap failed", label);
+        mapping_ = nullptr;
+        mappingSize_ = 0;
+        return false;
+    }
+    base_ = static_cast<const uint8_t*>(mapping_) + lead;
+    size_ = static_cast<size_t>(length);
+    if (!Validate(label)) { Close(); return false; }
+    ALOGI("Asset bundle %s: %u assets, %zu bytes mapped.", label, entryCount_, size_);
+    return true;
+}
+
+#if defined(__ANDROID__)
+bool AssetBundle::OpenAsset(AAssetManager* manager, const char* name) {
+    AAsset* asset = manager != nullptr ? AAssetManager_open(manager, name, AASSET_MODE_UNKNOWN) : nullptr;
+    if (asset == nullptr) { ALOGI("Asset bundle %s not packaged; using built-in assets.", name); return false; }
+    off64_t start = 0, length = 0;
+    const int fd = AAsset_openFileDescriptor64(asset, &start, &length);
+    AAsset_close(asset);
+    if (fd < 0) {
+        // A compressed entry would have to be inflated into the heap first.
+        ALOGW("Asset bundle %s is compressed in the APK; add it to noCompress.", name);
+        return false;
+    }
+    const bool ok = OpenFd(fd, start, length, name);
+    close(fd);
+    return ok;
+}
+#endif
+
+void AssetBundle::Close() {
+    if (mapping_ != nullptr) munmap(mapping_, mappingSize_);
+    mapping_ = nullptr;
+    mappingSize_ = 0;
+    base_ = nullptr;
+    size_ = 0;
+    entries_ = nullptr;
+    entryCount_ = 0;
+}
+
+bool AssetBundle::Validate(const char* label) {
+    AssetBundleHeader header;
+    memcpy(&header, base_, sizeof(header));
+    if (header.magic != kAssetBundleMagic || header.version != kAssetBundleVersion) {
+        ALOGE("Asset bundle %s: not a version %u bundle", label, kAssetBundleVersion);
+        return false;
+    }
+    const uint64_t tocEnd = header.tocOffset + static_cast<uint64_t>(header.entryCount) * sizeof(AssetBundleEntry);
+    const bool aligned = (reinterpret_cast<uintptr_t>(base_) + header.tocOffset) % alignof(AssetBundleEntry) == 0;
+    if (header.fileSize != size_ || tocEnd > size_ || !aligned) {
+        ALOGE("Asset bundle %s: truncated or corrupt table of contents", label);
+        return false;
+    }
+    entries_ = reinterpret_cast<const AssetBundleEntry*>(base_ + header.tocOffset);
+    entryCount_ = header.entryCount;
+    for (uint32_t i = 0; i < entryCount_; ++i) {
+        const AssetBundleEntry& e = entries_[i];
+        const bool named = memchr(e.name, '\0', kAssetNameLength) != nullptr;
+        const bool inside = e.offset >= tocEnd && e.offset <= size_ && e.size <= size_ - e.offset;
+        if (!named || !inside || e.offset % kAssetBundleAlignment != 0) {
+            ALOGE("Asset bundle %s: entry %u is out of bounds", label, i);
+            return false;
+        }
+    }
+    return true;
+}
+
+const AssetBundleEntry* AssetBundle::Find(const char* name) const {
+    // A handful of entries; a linear scan over the mapped table is cheaper than building an index.
+    for (uint32_t i = 0; i < entryCount_; ++i) {
+        if (strncmp(entries_[i].name, name, kAssetNameLength) == 0) return &entries_[i];
+    }
+    return nullptr;
+}
+
+bool AssetBundle::GetMesh(const char* name, AssetMesh& mesh) const {
+    const AssetBundleEntry* e = Find(name);
+    if (e == nullptr || e->type != ASSET_TYPE_MESH) return false;
+    const uint32_t* p = e->params;
+    const uint32_t indexBytes = p[MESH_INDEX_TYPE] == GL_UNSIGNED_SHORT ? 2 : 4;
+    const uint64_t vertexBytes = static_cast<uint64_t>(p[MESH_VERTEX_COUNT]) * p[MESH_VERTEX_STRIDE];
+    if (vertexBytes > p[MESH_INDEX_OFFSET] ||
+        p[MESH_INDEX_OFFSET] + static_cast<uint64_t>(p[MESH_INDEX_COUNT]) * indexBytes > e->size) {
+        ALOGE("Asset bundle: mesh %s does not fit its payload", name);
+        return false;
+    }
+    const uint8_t* data = static_cast<const uint8_t*>(Data(*e));
+    mesh.vertices = data;
+    mesh.indices = data + p[MESH_INDEX_OFFSET];
+    mesh.vertexCount = p[MESH_VERTEX_COUNT];
+    mesh.indexCount = p[MESH_INDEX_COUNT];
+    mesh.vertexStride = p[MESH_VERTEX_STRIDE];
+    mesh.vertexFormat = p[MESH_VERTEX_FORMAT];
+    mesh.indexType = p[MESH_INDEX_TYPE];
+    mesh.boundingRadius = FloatFromBits(p[MESH_BOUNDING_RADIUS]);
+    mesh.lodError = FloatFromBits(p[MESH_LOD_ERROR]);
+    return true;
+}
+
+bool AssetBundle::GetTexture(const char* name, AssetTexture& texture) const {
+    const AssetBundleEntry* e = Find(name);
+    if (e == nullptr || e->type != ASSET_TYPE_TEXTURE) return false;
+    const uint32_t* p = e->params;
+    const uint32_t bytesPerTexel = AssetTexture_TexelBytes(p[TEXTURE_FORMAT], p[TEXTURE_TYPE]);
+    if (bytesPerTexel == 0 || p[TEXTURE_LEVELS] == 0 ||
+        TextureBytes(p[TEXTURE_WIDTH], p[TEXTURE_HEIGHT], p[TEXTURE_LEVELS], bytesPerTexel) > e->size) {
+        ALOGE("Asset bundle: texture %s has an unsupported format or does not fit its payload", name);
+        return false;
+    }
+    texture.pixels = Data(*e);
+    texture.width = p[TEXTURE_WIDTH];
+    texture.height = p[TEXTURE_HEIGHT];
+    texture.levels = p[TEXTURE_LEVELS];
+    texture.internalFormat = p[TEXTURE_INTERNAL_FORMAT];
+    texture.format = p[TEXTURE_FORMAT];
+    texture.type = p[TEXTURE_TYPE];
+    texture.bytesPerTexel = bytesPerTexel;
+    return true;
+}
+
+void AssetBundle::Prefetch(const AssetBundleEntry& entry) const {
+    const uintptr_t page = PageSize();
+    const uintptr_t begin = reinterpret_cast<uintptr_t>(Data(entry)) / page * page;
+    const uintptr_t end = reinterpret_cast<uintptr_t>(Data(entry)) + entry.size;
+    if (entry.size != 0) madvise(reinterpret_cast<void*>(begin), end - begin, MADV_WILLNEED);
+}
+
+// =============================================================================
+// Writer
+// =============================================================================
+AssetBundleWriter::PendingAsset& AssetBundleWriter::Add(const char* name, AssetType type) {
+    assets_.emplace_back();
+    PendingAsset& asset = assets_.back();
+    memset(&asset.entry, 0, sizeof(asset.entry));
+    strncpy(asset.entry.name, name, kAssetNameLength - 1);
+    if (strlen(name) >= kAssetNameLength) ALOGW("Asset name %s truncated to %zu characters", name, kAssetNameLength - 1);
+    asset.entry.type = type;
+    return asset;
+}
+
+void AssetBundleWriter::AddBlob(const char* name, const void* data, size_t size) {
+    PendingAsset& asset = Add(name, ASSET_TYPE_BLOB);
+    asset.payload.assign(static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + size);
+}
+
+void AssetBundleWriter::AddMesh(const char* name, const void* vertices, uint32_t vertexCount, uint32_t vertexStride,
+                                uint32_t vertexFormat, const uint32_t* indices, uint32_t indexCount, float boundingRadius,
+                                float lodError) {
+    PendingAsset& asset = Add(name, ASSET_TYPE_MESH);
+    // 16-bit indices whenever they fit: half the index bandwidth.
+    const bool shortIndices = vertexCount <= 0x10000;
+    const size_t vertexBytes = static_cast<size_t>(vertexCount) * vertexStride;
+    const size_t indexOffset = AlignUp(vertexBytes, 4);
+    asset.payload.assign(indexOffset + static_cast<size_t>(indexCount) * (shortIndices ? 2 : 4), 0);
+    memcpy(asset.payload.data(), vertices, vertexBytes);
+    for (uint32_t i = 0; i < indexCount; ++i) {
+        if (shortIndices) {
+            const uint16_t index = static_cast<uint16_t>(indices[i]);
+            memcpy(asset.payload.data() + indexOffset + i * 2, &index, 2);
+        } else {
+            memcpy(asset.payload.data() + indexOffset + i * 4, &indices[i], 4);
+        }
+    }
+    uint32_t* p = asset.entry.params;
+    p[MESH_VERTEX_COUNT] = vertexCount;
+    p[MESH_INDEX_COUNT] = indexCount;
+    p[MESH_VERTEX_STRIDE] = vertexStride;
+    p[MESH_VERTEX_FORMAT] = vertexFormat;
+    p[MESH_INDEX_TYPE] = shortIndices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    p[MESH_INDEX_OFFSET] = static_cast<uint32_t>(indexOffset);
+    p[MESH_BOUNDING_RADIUS] = FloatBits(boundingRadius);
+    p[MESH_LOD_ERROR] = FloatBits(lodError);
+}
+
+void AssetBundleWriter::AddTexture(const char* name, const void* pixels, uint32_t width, uint32_t height, uint32_t levels,
+                                   uint32_t internalFormat, uint32_t format, uint32_t type) {
+    PendingAsset& asset = Add(name, ASSET_TYPE_TEXTURE);
+    const size_t bytes = TextureBytes(width, height, levels, AssetTexture_TexelBytes(format, type));
+    asset.payload.assign(static_cast<const uint8_t*>(pixels), static_cast<const uint8_t*>(pixels) + bytes);
+    uint32_t* p = asset.entry.params;
+    p[TEXTURE_WIDTH] = width;
+    p[TEXTURE_HEIGHT] = height;
+    p[TEXTURE_LEVELS] = levels;
+    p[TEXTURE_INTERNAL_FORMAT] = internalFormat;
+    p[TEXTURE_FORMAT] = format;
+    p[TEXTURE_TYPE] = type;
+}
+
+bool AssetBundleWriter::Write(const std::string& path) const {
+    AssetBundleHeader header = {kAssetBundleMagic, kAssetBundleVersion, static_cast<uint32_t>(assets_.size()),
+                                static_cast<uint32_t>(sizeof(AssetBundleHeader)), 0};
+    std::vector<AssetBundleEntry> toc;
+    uint64_t offset = AlignUp(header.tocOffset + assets_.size() * sizeof(AssetBundleEntry), kAssetBundleAlignment);
+    for (const PendingAsset& asset : assets_) {
+        toc.push_back(asset.entry);
+        toc.back().offset = static_cast<uint32_t>(offset);
+        toc.back().size = static_cast<uint32_t>(asset.payload.size());
+        offset = AlignUp(offset + asset.payload.size(), kAssetBundleAlignment);
+    }
+    if (offset > UINT32_MAX) { ALOGE("Asset bundle: %s would exceed 4 GB", path.c_str()); return false; }
+    header.fileSize = static_cast<uint32_t>(offset);
+
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file == nullptr) { ALOGE("Asset bundle: cannot write %s", path.c_str()); return false; }
+    std::vector<uint8_t> image(static_cast<size_t>(header.fileSize), 0);
+    memcpy(image.data(), &header, sizeof(header));
+    if (!toc.empty()) memcpy(image.data() + header.tocOffset, toc.data(), toc.size() * sizeof(AssetBundleEntry));
+    for (size_t i = 0; i < assets_.size(); ++i) {
+        if (!assets_[i].payload.empty()) memcpy(image.data() + toc[i].offset, assets_[i].payload.data(), assets_[i].payload.size());
+    }
+    const bool ok = fwrite(image.data(), 1, image.size(), file) == image.size();
+    if (fclose(file) != 0 || !ok) { ALOGE("Asset bundle: short write to %s", path.c_str()); return false; }
+    return true;
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#if defined(__ANDROID__)
+#include <android/asset_manager.h>
+#endif
+
+// =============================================================================
+// Asset Bundle
+// =============================================================================
+// Every mesh and texture the app loads, packed into one file by the host
+// asset_packer tool. The file is mapped read-only and never parsed into heap
+// copies: the table of contents is read in place and each payload is handed to
+// glBufferData / glTexSubImage2D straight from the mapped pages, so the only
+// copy is the driver's own. On device the bundle ships uncompressed inside the
+// APK (noCompress "pak") and is mapped through the asset's file descriptor.
+//
+//   header:  "IRAB" | version u32 | entryCount u32 | tocOffset u32 | fileSize u32
+//   toc:     AssetBundleEntry * entryCount, right after the header
+//   payload: each entry's data on a kAssetBundleAlignment boundary
+//
+// All values are little-endian u32, so the table can be read in place at the
+// 4-byte alignment zipalign gives uncompressed APK entries. Meshes hold their
+// vertices, then their indices at params[MESH_INDEX_OFFSET] from the start of
+// the payload. Textures hold their mip chain largest first, rows tightly packed.
+
+constexpr uint32_t kAssetBundleMagic = 0x42415249;   // "IRAB"
+constexpr uint32_t kAssetBundleVersion = 1;
+constexpr uint32_t kAssetBundleAlignment = 64;
+constexpr size_t kAssetNameLength = 32;
+
+enum AssetType : uint32_t {
+    ASSET_TYPE_BLOB = 0,
+    ASSET_TYPE_MESH = 1,
+    ASSET_TYPE_TEXTURE = 2,
+};
+
+// Vertex attributes of a mesh, interleaved in this order. A mesh has one
+// position and one color encoding.
+enum AssetVertexFormat : uint32_t {
+    ASSET_VERTEX_POSITION = 1u << 0,        // 3 x float
+    ASSET_VERTEX_COLOR = 1u << 1,           // 3 x float
+    ASSET_VERTEX_POSITION_HALF = 1u << 2,   // 3 x half float + 2 bytes padding
+    ASSET_VERTEX_COLOR_UNORM8 = 1u << 3,    // 4 x normalized unsigned byte
+};
+
+enum AssetMeshParam {
+    MESH_VERTEX_COUNT, MESH_INDEX_COUNT, MESH_VERTEX_STRIDE, MESH_VERTEX_FORMAT,
+    MESH_INDEX_TYPE,      // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    MESH_INDEX_OFFSET,    // bytes from the start of the payload
+    MESH_BOUNDING_RADIUS, // float bits; sphere around the origin
+    MESH_LOD_ERROR,       // float bits; how far the mesh deviates from LOD 0, in mesh units
+};
+
+// LOD n > 0 of mesh "name" is the entry "name#n", coarsest last.
+constexpr char kAssetLodSeparator = '#';
+
+enum AssetTextureParam {
+    TEXTURE_WIDTH, TEXTURE_HEIGHT, TEXTURE_LEVELS,
+    TEXTURE_INTERNAL_FORMAT, TEXTURE_FORMAT, TEXTURE_TYPE,   // GL enums; uncompressed only
+};
+
+struct AssetBundleHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t tocOffset;
+    uint32_t fileSize;
+};
+
+struct AssetBundleEntry {
+    char name[kAssetNameLength];   // NUL-terminated
+    uint32_t type;
+    uint32_t flags;
+    uint32_t offset;               // from the start of the bundle
+    uint32_t size;
+    uint32_t params[8];
+};
+
+static_assert(sizeof(AssetBundleHeader) == 20, "bundle header layout");
+static_assert(sizeof(AssetBundleEntry) == 80, "bundle entry layout");
+
+// Views into the mapping; valid until the bundle is closed.
+struct AssetMesh {
+    const void* vertices = nullptr;
+    const void* indices = nullptr;
+    uint32_t vertexCount = 0;
+    uint32_t indexCount = 0;
+    uint32_t vertexStride = 0;
+    uint32_t vertexFormat = 0;
+    uint32_t indexType = 0;
+    float boundingRadius = 0.0f;
+    float lodError = 0.0f;
+};
+
+struct AssetTexture {
+    const void* pixels = nullptr;   // level 0, followed by the smaller levels
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t levels = 0;
+    uint32_t internalFormat = 0;
+    uint32_t format = 0;
+    uint32_t type = 0;
+    uint32_t bytesPerTexel = 0;
+};
+
+class AssetBundle {
+public:
+    ~AssetBundle() { Close(); }
+
+    bool Open(const std::string& path);
+    // Maps [offset, offset + length) of an open file; the descriptor can be
+    // closed afterwards. Used for bundles stored inside the APK.
+    bool OpenFd(int fd, int64_t offset, int64_t length, const char* label);
+#if defined(__ANDROID__)
+    bool OpenAsset(AAssetManager* manager, const char* name);
+#endif
+    void Close();
+    bool IsOpen() const { return base_ != nullptr; }
+
+    uint32_t EntryCount() const { return entryCount_; }
+    const AssetBundleEntry& Entry(uint32_t index) const { return entries_[index]; }
+    const AssetBundleEntry* Find(const char* name) const;
+    const void* Data(const AssetBundleEntry& entry) const { return base_ + entry.offset; }
+    size_t Size() const { return size_; }
+
+    // False when the entry is missing or is not of that type.
+    bool GetMesh(const char* name, AssetMesh& mesh) const;
+    bool GetTexture(const char* name, AssetTexture& texture) const;
+
+    // Asks the kernel to start reading an entry's pages ahead of the upload.
+    void Prefetch(const AssetBundleEntry& entry) const;
+
+private:
+    bool Validate(const char* label);
+
+    void* mapping_ = nullptr;
+    size_t mappingSize_ = 0;
+    const uint8_t* base_ = nullptr;   // the bundle's first byte inside the mapping
+    size_t size_ = 0;
+    const AssetBundleEntry* entries_ = nullptr;
+    uint32_t entryCount_ = 0;
+};
+
+// Bytes per texel of an uncompressed GL format/type pair, 0 if unsupported.
+uint32_t AssetTexture_TexelBytes(uint32_t format, uint32_t type);
+
+// Builds a bundle in memory; used by the host packer.
+class AssetBundleWriter {
+public:
+    void AddBlob(const char* name, const void* data, size_t size);
+    void AddMesh(const char* name, const void* vertices, uint32_t vertexCount, uint32_t vertexStride, uint32_t vertexFormat,
+                 const uint32_t* indices, uint32_t indexCount, float boundingRadius, float lodError = 0.0f);
+    // levels are consecutive in `pixels`, each half the size of the previous one.
+    void AddTexture(const char* name, const void* pixels, uint32_t width, uint32_t height, uint32_t levels,
+                    uint32_t internalFormat, uint32_t format, uint32_t type);
+    bool Write(const std::string& path) const;
+    size_t AssetCount() const { return assets_.size(); }
+
+private:
+    struct PendingAsset {
+        AssetBundleEntry entry;
+        std::vector<uint8_t> payload;
+    };
+    PendingAsset& Add(const char* name, AssetType type);
+
+    std::vector<PendingAsset> assets_;
+};
@@ -0,0 +1,455 @@
+// =============================================================================
+// Asset Packer (host only)
+// =============================================================================
+// Builds the asset bundle the app maps at load time (asset_bundle.h), lists a
+// bundle's table of contents, and benchmarks loading it against reading the
+// same assets as loose files into heap buffers. Meshes go through the
+// optimizer (mesh_optimizer.h) on the way in, with a before/after report of
+// vertex cache and vertex fetch efficiency.
+//
+//   asset_packer <out.pak> [--panel] [--mesh name file.obj] [--sphere name segments]
+//                [--texture name file.ppm|pgm] [--blob name file]
+//                [--no-mips] [--no-optimize] [--no-quantize] [--lods N] [--lod-ratio R]
+//   asset_packer --list <bundle.pak>
+//   asset_packer --bench <bundle.pak> [--repeat N] [--cold]
+//
+// The device bundle is app/src/main/assets/iris.pak; without it the renderer
+// falls back to its built-in quad.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <GLES3/gl3.h>
+
+#include "asset_bundle.h"
+#include "common.h"
+#include "mesh_optimizer.h"
+
+namespace {
+
+// =============================================================================
+// Sources
+// =============================================================================
+// The quad the renderer falls back to without a bundle.
+MeshData PanelMesh() {
+    MeshData mesh;
+    mesh.vertices = {-0.5f, -0.5f, 0.0f, 1.0f, 0.0f, 0.0f,   0.5f, -0.5f, 0.0f, 0.0f, 1.0f, 0.0f,
+                     0.5f, 0.5f, 0.0f, 0.0f, 0.0f, 1.0f,     -0.5f, 0.5f, 0.0f, 1.0f, 1.0f, 0.0f};
+    mesh.indices = {0, 1, 2, 2, 3, 0};
+    return mesh;
+}
+
+// A 1 m UV sphere in ring order, colored by its normal; a stand-in for
+// exported models when trying the optimizer.
+MeshData SphereMesh(int segments) {
+    MeshData mesh;
+    const int rings = std::max(2, segments / 2);
+    segments = std::max(3, segments);
+    for (int r = 0; r <= rings; ++r) {
+        const float theta = 3.14159265f * r / rings;
+        for (int s = 0; s <= segments; ++s) {
+            const float phi = 6.2831853f * s / segments;
+            const float n[3] = {sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi)};
+            mesh.vertices.insert(mesh.vertices.end(), {0.5f * n[0], 0.5f * n[1], 0.5f * n[2],
+                                                       0.5f + 0.5f * n[0], 0.5f + 0.5f * n[1], 0.5f + 0.5f * n[2]});
+        }
+    }
+    for (int r = 0; r < rings; ++r) {
+        for (int s = 0; s < segments; ++s) {
+            const uint32_t a = r * (segments + 1) + s, b = a + segments + 1;
+            mesh.indices.insert(mesh.indices.end(), {a, b, a + 1, a + 1, b, b + 1});
+        }
+    }
+    return mesh;
+}
+
+// Positions with optional per-vertex color ("v x y z r g b"); faces are fanned
+// into triangles. Texture coordinates and normals are not used by the panel
+// shaders and are skipped.
+bool LoadObj(const char* path, MeshData& mesh) {
+    FILE* file = fopen(path, "r");
+    if (file == nullptr) { ALOGE("Cannot open %s", path); return false; }
+    std::vector<float> positions;   // x y z r g b
+    char line[512];
+    size_t lineNumber = 0;
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), file) != nullptr) {
+        lineNumber++;
+        if (line[0] == 'v' && line[1] == ' ') {
+            float v[6] = {0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f};
+            const int n = sscanf(line + 2, "%f %f %f %f %f %f", &v[0], &v[1], &v[2], &v[3], &v[4], &v[5]);
+            if (n != 3 && n != 6) { ALOGE("%s:%zu: malformed vertex", path, lineNumber); ok = false; }
+            positions.insert(positions.end(), v, v + 6);
+        } else if (line[0] == 'f' && line[1] == ' ') {
+            std::vector<uint32_t> face;
+            const long count = static_cast<long>(positions.size() / 6);
+            for (char* token = strtok(line + 2, " \t\r\n"); token != nullptr; token = strtok(nullptr, " \t\r\n")) {
+                long index = strtol(token, nullptr, 10);   // stops at the first '/'
+                if (index < 0) index += count + 1;
+                if (index < 1 || index > count) { ALOGE("%s:%zu: face index out of range", path, lineNumber); ok = false; break; }
+                face.push_back(static_cast<uint32_t>(index - 1));
+            }
+            for (size_t i = 2; ok && i < face.size(); ++i) mesh.indices.insert(mesh.indices.end(), {face[0], face[i - 1], face[i]});
+        }
+    }
+    fclose(file);
+    if (!ok) return false;
+    if (mesh.indices.empty()) { ALOGE("%s has no faces", path); return false; }
+    mesh.vertices = positions;
+    return true;
+}
+
+struct TextureSource {
+    std::vector<uint8_t> pixels;   // all levels
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t levels = 0;
+    uint32_t channels = 0;
+};
+
+// Binary PPM (P6, RGB) or PGM (P5, single channel), 8 bits per channel.
+bool LoadNetpbm(const char* path, TextureSource& texture) {
+    FILE* file = fopen(path, "rb");
+    if (file == nullptr) { ALOGE("Cannot open %s", path); return false; }
+    char magic[3] = {};
+    unsigned width = 0, height = 0, maxValue = 0;
+    const bool header = fscanf(file, "%2s %u %u %u", magic, &width, &height, &maxValue) == 4 && fgetc(file) != EOF;
+    texture.channels = strcmp(magic, "P6") == 0 ? 3 : (strcmp(magic, "P5") == 0 ? 1 : 0);
+    if (!header || texture.channels == 0 || maxValue != 255 || width == 0 || height == 0) {
+        ALOGE("%s: only 8-bit binary PPM (P6) and PGM (P5) are supported", path);
+        fclose(file);
+        return false;
+    }
+    texture.width = width;
+    texture.height = height;
+    texture.levels = 1;
+    texture.pixels.resize(static_cast<size_t>(width) * height * texture.channels);
+    const bool ok = fread(texture.pixels.data(), 1, texture.pixels.size(), file) == texture.pixels.size();
+    fclose(file);
+    if (!ok) ALOGE("%s: truncated pixel data", path);
+    return ok;
+}
+
+// Appends box-filtered levels down to 1x1.
+void GenerateMips(TextureSource& texture) {
+    uint32_t width = texture.width, height = texture.height;
+    size_t level = 0;
+    const uint32_t c = texture.channels;
+    while (width > 1 || height > 1) {
+        const uint32_t w = width > 1 ? width / 2 : 1, h = height > 1 ? height / 2 : 1;
+        const size_t next = texture.pixels.size();
+        texture.pixels.resize(next + static_cast<size_t>(w) * h * c);
+        const uint8_t* src = texture.pixels.data() + level;
+        uint8_t* dst = texture.pixels.data() + next;
+        for (uint32_t y = 0; y < h; ++y) {
+            const uint32_t y0 = std::min(2 * y, height - 1), y1 = std::min(2 * y + 1, height - 1);
+            for (uint32_t x = 0; x < w; ++x) {
+                const uint32_t x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+                for (uint32_t k = 0; k < c; ++k) {
+                    const uint32_t sum = src[(y0 * width + x0) * c + k] + src[(y0 * width + x1) * c + k] +
+                                         src[(y1 * width + x0) * c + k] + src[(y1 * width + x1) * c + k];
+                    dst[(y * w + x) * c + k] = static_cast<uint8_t>((sum + 2) / 4);
+                }
+            }
+        }
+        level = next;
+        width = w;
+        height = h;
+        texture.levels++;
+    }
+}
+
+bool ReadFile(const char* path, std::vector<uint8_t>& bytes) {
+    FILE* file = fopen(path, "rb");
+    if (file == nullptr) { ALOGE("Cannot open %s", path); return false; }
+    fseek(file, 0, SEEK_END);
+    bytes.resize(static_cast<size_t>(ftell(file)));
+    fseek(file, 0, SEEK_SET);
+    const bool ok = fread(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    fclose(file);
+    return ok;
+}
+
+// =============================================================================
+// Mesh Pipeline
+// =============================================================================
+struct MeshOptions {
+    bool optimize = true;
+    bool quantize = true;
+    int lods = 0;             // extra levels below LOD 0
+    float lodRatio = 0.5f;    // triangles kept per level
+};
+
+struct MeshReport {
+    VertexCacheStats cache16, cache32;
+    VertexFetchStats fetch;
+    size_t bytes = 0;
+};
+
+MeshReport Analyze(const MeshData& mesh, uint32_t stride) {
+    MeshReport report;
+    report.cache16 = MeshOpt_AnalyzeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.VertexCount(), 16);
+    report.cache32 = MeshOpt_AnalyzeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.VertexCount(), 32);
+    report.fetch = MeshOpt_AnalyzeVertexFetch(mesh.indices.data(), mesh.indices.size(), mesh.VertexCount(), stride);
+    report.bytes = mesh.VertexCount() * stride;
+    return report;
+}
+
+// Optimizes, quantizes and writes one level; returns the stride written.
+uint32_t WriteLevel(AssetBundleWriter& writer, const std::string& name, MeshData& mesh, const MeshOptions& options,
+                    float radius, float error) {
+    if (options.optimize) {
+        MeshOpt_OptimizeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.VertexCount());
+        MeshOpt_OptimizeVertexFetch(mesh);
+    }
+    const uint32_t vertexCount = static_cast<uint32_t>(mesh.VertexCount());
+    const uint32_t indexCount = static_cast<uint32_t>(mesh.indices.size());
+    if (options.quantize) {
+        std::vector<uint8_t> packed;
+        const uint32_t stride = MeshOpt_Quantize(mesh, packed);
+        writer.AddMesh(name.c_str(), packed.data(), vertexCount, stride, ASSET_VERTEX_POSITION_HALF | ASSET_VERTEX_COLOR_UNORM8,
+                       mesh.indices.data(), indexCount, radius, error);
+        return stride;
+    }
+    const uint32_t stride = kMeshFloatsPerVertex * sizeof(float);
+    writer.AddMesh(name.c_str(), mesh.vertices.data(), vertexCount, stride, ASSET_VERTEX_POSITION | ASSET_VERTEX_COLOR,
+                   mesh.indices.data(), indexCount, radius, error);
+    return stride;
+}
+
+bool AddMesh(AssetBundleWriter& writer, const char* name, const MeshData& source, const MeshOptions& options) {
+    if (strlen(name) + 3 >= kAssetNameLength) { ALOGE("Mesh name %s is too long for its LOD entries", name); return false; }
+    const float radius = MeshOpt_BoundingRadius(source);
+    const MeshReport before = Analyze(source, kMeshFloatsPerVertex * sizeof(float));
+    MeshData mesh = source;
+    const uint32_t stride = WriteLevel(writer, name, mesh, options, radius, 0.0f);
+    const MeshReport after = Analyze(mesh, stride);
+    printf("%s: %zu triangles, %zu vertices\n", name, mesh.TriangleCount(), mesh.VertexCount());
+    printf("  ACMR fifo16 %.3f -> %.3f  fifo32 %.3f -> %.3f  ATVR %.3f -> %.3f\n", before.cache16.acmr, after.cache16.acmr,
+           before.cache32.acmr, after.cache32.acmr, before.cache32.atvr, after.cache32.atvr);
+    printf("  vertex fetch overfetch %.3f -> %.3f, %llu -> %llu bytes fetched, buffer %zu -> %zu bytes\n",
+           before.fetch.overfetch, after.fetch.overfetch, (unsigned long long)before.fetch.bytesFetched,
+           (unsigned long long)after.fetch.bytesFetched, before.bytes, after.bytes);
+
+    // Every level is simplified from LOD 0 so errors do not compound.
+    size_t previous = source.TriangleCount();
+    for (int level = 1; level <= options.lods; ++level) {
+        const size_t target = static_cast<size_t>(source.TriangleCount() * powf(options.lodRatio, static_cast<float>(level)));
+        MeshData lod;
+        float error = 0.0f;
+        if (!MeshOpt_Simplify(source, std::max<size_t>(target, 1), lod, error) || lod.TriangleCount() >= previous) {
+            printf("  lod%d: no further reduction, chain stops at %d levels\n", level, level);
+            break;
+        }
+        previous = lod.TriangleCount();
+        const uint32_t lodStride = WriteLevel(writer, std::string(name) + kAssetLodSeparator + std::to_string(level), lod,
+                                              options, radius, error);
+        const MeshReport lodReport = Analyze(lod, lodStride);
+        printf("  lod%d: %zu triangles, %zu vertices, error %.4f, ACMR fifo32 %.3f, overfetch %.3f\n", level,
+               lod.TriangleCount(), lod.VertexCount(), error, lodReport.cache32.acmr, lodReport.fetch.overfetch);
+    }
+    return true;
+}
+
+// =============================================================================
+// Modes
+// =============================================================================
+int Pack(int argc, char** argv) {
+    AssetBundleWriter writer;
+    bool mips = true;
+    MeshOptions meshOptions;
+    for (int i = 2; i < argc; ++i) {
+        if (strcmp(argv[i], "--no-mips") == 0) mips = false;
+        else if (strcmp(argv[i], "--no-optimize") == 0) meshOptions.optimize = false;
+        else if (strcmp(argv[i], "--no-quantize") == 0) meshOptions.quantize = false;
+        else if (strcmp(argv[i], "--lods") == 0 && i + 1 < argc) meshOptions.lods = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--lod-ratio") == 0 && i + 1 < argc) meshOptions.lodRatio = static_cast<float>(atof(argv[i + 1]));
+    }
+    if (meshOptions.lodRatio <= 0.0f || meshOptions.lodRatio >= 1.0f) { ALOGE("--lod-ratio must be between 0 and 1"); return 1; }
+    for (int i = 2; i < argc; ++i) {
+        if (strcmp(argv[i], "--panel") == 0) {
+            if (!AddMesh(writer, "panel", PanelMesh(), meshOptions)) return 1;
+        } else if (strcmp(argv[i], "--mesh") == 0 && i + 2 < argc) {
+            MeshData mesh;
+            if (!LoadObj(argv[i + 2], mesh) || !AddMesh(writer, argv[i + 1], mesh, meshOptions)) return 1;
+            i += 2;
+        } else if (strcmp(argv[i], "--sphere") == 0 && i + 2 < argc) {
+            if (!AddMesh(writer, argv[i + 1], SphereMesh(atoi(argv[i + 2])), meshOptions)) return 1;
+            i += 2;
+        } else if (strcmp(argv[i], "--texture") == 0 && i + 2 < argc) {
+            TextureSource texture;
+            if (!LoadNetpbm(argv[i + 2], texture)) return 1;
+            if (mips) GenerateMips(texture);
+            const bool rgb = texture.channels == 3;
+            writer.AddTexture(argv[i + 1], texture.pixels.data(), texture.width, texture.height, texture.levels,
+                              rgb ? GL_RGB8 : GL_R8, rgb ? GL_RGB : GL_RED, GL_UNSIGNED_BYTE);
+            i += 2;
+        } else if (strcmp(argv[i], "--blob") == 0 && i + 2 < argc) {
+            std::vector<uint8_t> bytes;
+            if (!ReadFile(argv[i + 2], bytes)) return 1;
+            writer.AddBlob(argv[i + 1], bytes.data(), bytes.size());
+            i += 2;
+        } else if (strcmp(argv[i], "--lods") == 0 || strcmp(argv[i], "--lod-ratio") == 0) {
+            i++;   // read above
+        } else if (strcmp(argv[i], "--no-mips") != 0 && strcmp(argv[i], "--no-optimize") != 0 &&
+                   strcmp(argv[i], "--no-quantize") != 0) {
+            ALOGE("Unknown or incomplete option %s", argv[i]);
+            return 1;
+        }
+    }
+    if (writer.AssetCount() == 0) { ALOGE("Nothing to pack"); return 1; }
+    if (!writer.Write(argv[1])) return 1;
+    printf("Wrote %zu assets to %s\n", writer.AssetCount(), argv[1]);
+    return 0;
+}
+
+const char* TypeName(uint32_t type) {
+    switch (type) {
+        case ASSET_TYPE_MESH: return "mesh";
+        case ASSET_TYPE_TEXTURE: return "texture";
+        default: return "blob";
+    }
+}
+
+int List(const char* path) {
+    AssetBundle bundle;
+    if (!bundle.Open(path)) return 1;
+    printf("%s: %u assets, %zu bytes\n", path, bundle.EntryCount(), bundle.Size());
+    for (uint32_t i = 0; i < bundle.EntryCount(); ++i) {
+        const AssetBundleEntry& e = bundle.Entry(i);
+        printf("  %-24s %-7s offset %8u  size %8u", e.name, TypeName(e.type), e.offset, e.size);
+        AssetMesh mesh;
+        AssetTexture texture;
+        if (bundle.GetMesh(e.name, mesh)) {
+            printf("  %u vertices, %u indices (%s), %s, radius %.3f", mesh.vertexCount, mesh.indexCount,
+                   mesh.indexType == GL_UNSIGNED_SHORT ? "u16" : "u32",
+                   mesh.vertexFormat & ASSET_VERTEX_POSITION_HALF ? "quantized" : "float", mesh.boundingRadius);
+            if (mesh.lodError > 0.0f) printf(", lod error %.4f", mesh.lodError);
+        } else if (bundle.GetTexture(e.name, texture)) {
+            printf("  %ux%u, %u levels, %u bytes/texel", texture.width, texture.height, texture.levels, texture.bytesPerTexel);
+        }
+        printf("\n");
+    }
+    return 0;
+}
+
+// Reads every byte the way a GL upload would, so both loaders pay for the same work.
+uint64_t Consume(const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    uint64_t sum = 0;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, bytes + i, sizeof(word));
+        sum += word;
+    }
+    for (; i < size; ++i) sum += bytes[i];
+    return sum;
+}
+
+// Drops a file's clean pages from the page cache so the next read goes to storage.
+void Evict(const char* path) {
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+}
+
+void Report(const char* label, std::vector<int64_t> ns) {
+    std::sort(ns.begin(), ns.end());
+    double sum = 0.0;
+    for (int64_t v : ns) sum += static_cast<double>(v);
+    printf("%-22s mean %9.1f us  p50 %9.1f  max %9.1f\n", label, sum / ns.size() / 1e3, ns[ns.size() / 2] / 1e3,
+           ns.back() / 1e3);
+}
+
+int Bench(const char* path, int repeat, bool cold) {
+    AssetBundle bundle;
+    if (!bundle.Open(path)) return 1;
+    // The same payloads as loose files, the layout the bundle replaces.
+    char directory[] = "/tmp/asset_packer.XXXXXX";
+    if (mkdtemp(directory) == nullptr) { ALOGE("Cannot create a scratch directory"); return 1; }
+    std::vector<std::string> files;
+    uint64_t payloadBytes = 0;
+    for (uint32_t i = 0; i < bundle.EntryCount(); ++i) {
+        const AssetBundleEntry& e = bundle.Entry(i);
+        files.push_back(std::string(directory) + "/" + std::to_string(i) + ".bin");
+        FILE* file = fopen(files.back().c_str(), "wb");
+        if (file == nullptr) { ALOGE("Cannot write %s", files.back().c_str()); return 1; }
+        fwrite(bundle.Data(e), 1, e.size, file);
+        fclose(file);
+        payloadBytes += e.size;
+    }
+    bundle.Close();
+
+    std::vector<int64_t> mapped, loose;
+    uint64_t mappedSum = 0, looseSum = 0;
+    for (int pass = 0; pass < repeat; ++pass) {
+        if (cold) Evict(path);
+        int64_t start = NowNs();
+        bundle.Open(path);
+        for (uint32_t i = 0; i < bundle.EntryCount(); ++i) bundle.Prefetch(bundle.Entry(i));
+        for (uint32_t i = 0; i < bundle.EntryCount(); ++i) mappedSum += Consume(bundle.Data(bundle.Entry(i)), bundle.Entry(i).size);
+        bundle.Close();
+        mapped.push_back(NowNs() - start);
+
+        if (cold) for (const std::string& f : files) Evict(f.c_str());
+        start = NowNs();
+        for (const std::string& f : files) {
+            const int fd = open(f.c_str(), O_RDONLY | O_CLOEXEC);
+            struct stat st;
+            if (fd < 0 || fstat(fd, &st) != 0) { ALOGE("Cannot read %s", f.c_str()); return 1; }
+            std::vector<uint8_t> bytes(static_cast<size_t>(st.st_size));
+            const bool ok = read(fd, bytes.data(), bytes.size()) == static_cast<ssize_t>(bytes.size());
+            close(fd);
+            if (!ok) { ALOGE("Short read from %s", f.c_str()); return 1; }
+            looseSum += Consume(bytes.data(), bytes.size());
+        }
+        loose.push_back(NowNs() - start);
+    }
+    for (const std::string& f : files) unlink(f.c_str());
+    rmdir(directory);
+    if (mappedSum != looseSum) { ALOGE("Loaders disagree on the payload checksum"); return 1; }
+
+    printf("%zu assets, %llu payload bytes, %d passes%s\n", files.size(), (unsigned long long)payloadBytes, repeat,
+           cold ? " (page cache dropped before each)" : "");
+    Report("mapped bundle", mapped);
+    Report("loose files + heap", loose);
+    printf("heap bytes copied: mapped 0, loose %llu per pass\n", (unsigned long long)payloadBytes);
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc >= 3 && strcmp(argv[1], "--list") == 0) return List(argv[2]);
+    if (argc >= 3 && strcmp(argv[1], "--bench") == 0) {
+        int repeat = 20;
+        bool cold = false;
+        for (int i = 3; i < argc; ++i) {
+            if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) repeat = std::max(1, atoi(argv[++i]));
+            else if (strcmp(argv[i], "--cold") == 0) cold = true;
+        }
+        return Bench(argv[2], repeat, cold);
+    }
+    if (argc < 3 || argv[1][0] == '-') {
+        fprintf(stderr, "usage: %s <out.pak> [--panel] [--mesh name file.obj] [--sphere name segments]\n"
+                        "       %*s [--texture name file.ppm|pgm] [--blob name file]\n"
+                        "       %*s [--no-mips] [--no-optimize] [--no-quantize] [--lods N] [--lod-ratio R]\n"
+                        "       %s --list <bundle.pak>\n"
+                        "       %s --bench <bundle.pak> [--repeat N] [--cold]\n",
+                argv[0], (int)strlen(argv[0]), "", (int)strlen(argv[0]), "", argv[0], argv[0]);
+        return 1;
+    }
+    return Pack(argc, argv);
+}
@@ -0,0 +1,293 @@
+#include "audio_capture.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#if defined(__ANDROID__)
+#include <aaudio/AAudio.h>
+#endif
+
+#include "common.h"
+#include "thread_roles.h"
+
+namespace {
+
+int64_t ThreadCpuNs() {
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+void NoteWrite(AudioSource& source, AudioRing& ring, const float* samples, size_t count) {
+    const size_t written = ring.Write(samples, count);
+    if (written < count) source.overruns++;
+    source.samplesWritten += static_cast<int64_t>(written);
+    source.lastWriteNs = NowNs();
+}
+
+// =============================================================================
+// File / Null Source (Linux stand-in, also usable on device for replaying clips)
+// =============================================================================
+class FileAudioSource : public AudioSource {
+public:
+    FileAudioSource(const std::string& path, int sampleRate, bool realtime)
+        : path_(path), sampleRate_(sampleRate), realtime_(realtime) {}
+    ~FileAudioSource() override { Stop(); }
+
+    bool Start(AudioRing* ring) override {
+        if (!path_.empty() && !Load()) return false;
+        ring_ = ring;
+        running_ = true;
+        thread_ = std::thread(&FileAudioSource::Run, this);
+        return true;
+    }
+
+    void Stop() override {
+        running_ = false;
+        if (thread_.joinable()) thread_.join();
+    }
+
+    int SampleRate() const override { return sampleRate_; }
+    const char* Name() const override { return path_.empty() ? "null" : "file"; }
+
+private:
+    bool Load() {
+        FILE* f = fopen(path_.c_str(), "rb");
+        if (f == nullptr) { ALOGE("Audio file %s could not be opened", path_.c_str()); return false; }
+        std::vector<int16_t> pcm;
+        char riff[44];
+        size_t skip = 0;
+        if (fread(riff, 1, sizeof(riff), f) == sizeof(riff) && memcmp(riff, "RIFF", 4) == 0) {
+            // Canonical 44-byte header: mono s16le is assumed, the rate is taken from it.
+            int32_t rate;
+            memcpy(&rate, riff + 24, sizeof(rate));
+            sampleRate_ = rate;
+            skip = sizeof(riff);
+        }
+        fseek(f, static_cast<long>(skip), SEEK_SET);
+        int16_t block[4096];
+        size_t n;
+        while ((n = fread(block, sizeof(int16_t), 4096, f)) > 0) pcm.insert(pcm.end(), block, block + n);
+        fclose(f);
+        samples_.resize(pcm.size());
+        for (size_t i = 0; i < pcm.size(); ++i) samples_[i] = pcm[i] / 32768.0f;
+        ALOGI("Audio file %s loaded: %zu samples at %d Hz", path_.c_str(), samples_.size(), sampleRate_);
+        return true;
+    }
+
+    void Run() {
+        ThreadRoleScope role(THREAD_ROLE_AUDIO, "iris-mic-file");
+        const size_t block = static_cast<size_t>(sampleRate_ / 100);
+        std::vector<float> silence(block, 0.0f);
+        // A second of trailing silence lets the detector close a final utterance.
+        const size_t total = samples_.empty() ? 0 : samples_.size() + static_cast<size_t>(sampleRate_);
+        size_t position = 0;
+        int64_t next = NowNs();
+        while (running_ && (samples_.empty() || position < total)) {
+            const float* data = silence.data();
+            size_t count = block;
+            if (position < samples_.size()) {
+                data = samples_.data() + position;
+                count = std::min(block, samples_.size() - position);
+            }
+            if (!realtime_) {
+                while (running_ && AudioRing::kCapacity - ring_->Size() < count) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            NoteWrite(*this, *ring_, data, count);
+            position += count;
+            if (realtime_) {
+                next += 10000000;
+                ThreadRoles_SleepUntil(next);
+            }
+        }
+    }
+
+    std::string path_;
+    int sampleRate_;
+    bool realtime_;
+    std::vector<float> samples_;
+    AudioRing* ring_ = nullptr;
+    std::thread thread_;
+    std::atomic<bool> running_{false};
+};
+
+#if defined(__ANDROID__)
+// =============================================================================
+// AAudio Source
+// =============================================================================
+class AAudioSource : public AudioSource {
+public:
+    explicit AAudioSource(int sampleRate) : sampleRate_(sampleRate) {}
+    ~AAudioSource() override { Stop(); }
+
+    bool Start(AudioRing* ring) override {
+        ring_ = ring;
+        AAudioStreamBuilder* builder = nullptr;
+        if (AAudio_createStreamBuilder(&builder) != AAUDIO_OK) return false;
+        AAudioStreamBuilder_setDirection(builder, AAUDIO_DIRECTION_INPUT);
+        AAudioStreamBuilder_setSampleRate(builder, sampleRate_);
+        AAudioStreamBuilder_setChannelCount(builder, 1);
+        AAudioStreamBuilder_setFormat(builder, AAUDIO_FORMAT_PCM_FLOAT);
+        AAudioStreamBuilder_setPerformanceMode(builder, AAUDIO_PERFORMANCE_MODE_LOW_LATENCY);
+        AAudioStreamBuilder_setSharingMode(builder, AAUDIO_SHARING_MODE_EXCLUSIVE);
+        AAudioStreamBuilder_setDataCallback(builder, DataCallback, this);
+        AAudioStreamBuilder_setErrorCallback(builder, ErrorCallback, this);
+        aaudio_result_t result = AAudioStreamBuilder_openStream(builder, &stream_);
+        AAudioStreamBuilder_delete(builder);
+        if (result != AAUDIO_OK) {
+            ALOGE("AAudio input stream open failed: %s", AAudio_convertResultToText(result));
+            return false;
+        }
+        sampleRate_ = AAudioStream_getSampleRate(stream_);
+        result = AAudioStream_requestStart(stream_);
+        if (result != AAUDIO_OK) {
+            ALOGE("AAudio input stream start failed: %s", AAudio_convertResultToText(result));
+            AAudioStream_close(stream_);
+            stream_ = nullptr;
+            return false;
+        }
+        ALOGI("AAudio capture started: %d Hz, burst %d frames, %s sharing", sampleRate_,
+              AAudioStream_getFramesPerBurst(stream_),
+              AAudioStream_getSharingMode(stream_) == AAUDIO_SHARING_MODE_EXCLUSIVE ? "exclusive" : "shared");
+        return true;
+    }
+
+    void Stop() override {
+        if (stream_ == nullptr) return;
+        AAudioStream_requestStop(stream_);
+        AAudioStream_close(stream_);
+        stream_ = nullptr;
+    }
+
+    int SampleRate() const override { return sampleRate_; }
+    const char* Name() const override { return "aaudio"; }
+
+private:
+    // Runs on the AAudio real-time thread: no locks, no allocation, just a ring write.
+    static aaudio_data_callback_result_t DataCallback(AAudioStream*, void* user, void* audioData, int32_t numFrames) {
+        auto* self = static_cast<AAudioSource*>(user);
+        NoteWrite(*self, *self->ring_, static_cast<const float*>(audioData), static_cast<size_t>(numFrames));
+        return AAUDIO_CALLBACK_RESULT_CONTINUE;
+    }
+
+    static void ErrorCallback(AAudioStream*, void*, aaudio_result_t error) {
+        ALOGE("AAudio capture error: %s", AAudio_convertResultToText(error));
+    }
+
+    int sampleRate_;
+    AudioRing* ring_ = nullptr;
+    AAudioStream* stream_ = nullptr;
+};
+#endif
+
+} // namespace
+
+AudioSource* CreateAudioSource(const AudioCaptureConfig& config) {
+#if defined(__ANDROID__)
+    if (config.filePath.empty()) return new AAudioSource(config.sampleRate);
+#endif
+    return new FileAudioSource(config.filePath, config.sampleRate, config.realtime);
+}
+
+// =============================================================================
+// Capture Pipeline
+// =============================================================================
+bool AudioCapture::Start(const AudioCaptureConfig& config, VoiceSegmentCallback consumer, void* user) {
+    if (running_) return true;
+    consumer_ = consumer;
+    consumerUser_ = user;
+    processedSamples_ = 0;
+    {
+        std::lock_guard<std::mutex> lock(metricsMutex_);
+        metrics_ = {};
+    }
+
+    source_ = CreateAudioSource(config);
+    if (!source_->Start(&ring_)) {
+        delete source_;
+        source_ = nullptr;
+        return false;
+    }
+    if (!vad_.Init(source_->SampleRate(), config.vad, &AudioCapture::OnSegment, this)) {
+        Stop();
+        return false;
+    }
+    running_ = true;
+    worker_ = std::thread(&AudioCapture::Worker, this);
+    ALOGI("Audio capture running from %s source.", source_->Name());
+    return true;
+}
+
+void AudioCapture::Stop() {
+    running_ = false;
+    if (worker_.joinable()) worker_.join();
+    if (source_ != nullptr) {
+        source_->Stop();
+        {
+            std::lock_guard<std::mutex> lock(metricsMutex_);
+            metrics_.overruns = source_->overruns;
+        }
+        delete source_;
+        source_ = nullptr;
+    }
+    float discard[256];
+    while (ring_.Read(discard, 256) > 0) {}
+}
+
+AudioCaptureMetrics AudioCapture::GetMetrics() {
+    // source_ belongs to Start/Stop; its overrun count reaches metrics_ through the worker.
+    std::lock_guard<std::mutex> lock(metricsMutex_);
+    return metrics_;
+}
+
+void AudioCapture::Worker() {
+    ThreadRoleScope role(THREAD_ROLE_AUDIO, "iris-vad");
+    const size_t frameSize = vad_.FrameSize();
+    std::vector<float> frame(frameSize);
+    uint64_t frames = 0, voiced = 0;
+    int64_t cpuNs = 0;
+
+    while (running_) {
+        if (ring_.Size() < frameSize) {
+            ThreadRoles_SleepUntil(NowNs() + 2000000);
+            continue;
+        }
+        const int64_t cpuStart = ThreadCpuNs();
+        while (ring_.Size() >= frameSize) {
+            ring_.Read(frame.data(), frameSize);
+            if (vad_.Process(frame.data())) voiced++;
+            processedSamples_ += static_cast<int64_t>(frameSize);
+            frames++;
+        }
+        cpuNs += ThreadCpuNs() - cpuStart;
+
+        std::lock_guard<std::mutex> lock(metricsMutex_);
+        metrics_.framesProcessed = frames;
+        metrics_.voicedFrames = voiced;
+        metrics_.audioSeconds = static_cast<double>(processedSamples_) / source_->SampleRate();
+        metrics_.cpuNsPerAudioSecond = metrics_.audioSeconds > 0 ? cpuNs / metrics_.audioSeconds : 0.0;
+        metrics_.noiseFloorDb = vad_.NoiseFloorDb();
+        metrics_.overruns = source_->overruns;
+    }
+    vad_.Flush();
+}
+
+void AudioCapture::OnSegment(const VoiceSegment& segment, void* user) {
+    auto* self = static_cast<AudioCapture*>(user);
+    // Estimate when the last voiced sample left the microphone from the producer's latest write.
+    const int64_t written = self->source_->samplesWritten;
+    const int64_t lastWrite = self->source_->lastWriteNs;
+    const int64_t capturedNs = lastWrite - (written - segment.lastVoicedSample) * 1000000000LL / segment.sampleRate;
+    const int64_t latencyNs = NowNs() - capturedNs;
+    {
+        std::lock_guard<std::mutex> lock(self->metricsMutex_);
+        self->metrics_.segments++;
+        self->metrics_.lastEndOfSpeechLatencyNs = latencyNs;
+        self->metrics_.lastSegmentSamples = static_cast<int64_t>(segment.count);
+    }
+    ALOGI("Utterance: %.2f s, end-of-speech detected %.1f ms after last voiced sample",
+          static_cast<double>(segment.count) / segment.sampleRate, latencyNs / 1e6);
+    if (self->consumer_ != nullptr) self->consumer_(segment, self->consumerUser_);
+}
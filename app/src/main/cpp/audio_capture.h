@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "spsc_ring.h"
+#include "voice_activity.h"
+
+// =============================================================================
+// Audio Capture Pipeline
+// =============================================================================
+// A capture source (AAudio on device, a paced file/null source elsewhere) writes
+// mono float samples into a lock-free SPSC ring from its own callback thread. A
+// worker thread drains the ring in 10 ms frames, runs voice activity detection
+// and hands finished utterances to the registered consumer.
+
+typedef SpscRing<float, 1 << 16> AudioRing;   // ~4 s at 16 kHz
+
+class AudioSource {
+public:
+    virtual ~AudioSource() = default;
+    virtual bool Start(AudioRing* ring) = 0;
+    virtual void Stop() = 0;
+    virtual int SampleRate() const = 0;
+    virtual const char* Name() const = 0;
+
+    // Producer-side bookkeeping used to timestamp samples for latency metrics.
+    std::atomic<int64_t> samplesWritten{0};
+    std::atomic<int64_t> lastWriteNs{0};
+    std::atomic<uint64_t> overruns{0};
+};
+
+struct AudioCaptureConfig {
+    int sampleRate = 16000;
+    std::string filePath;       // raw s16le mono or WAV; empty selects the device (or silence off-device)
+    bool realtime = true;       // file source paces itself like a microphone when true
+    VoiceActivityConfig vad;
+};
+
+struct AudioCaptureMetrics {
+    uint64_t framesProcessed = 0;
+    uint64_t voicedFrames = 0;
+    uint64_t segments = 0;
+    uint64_t overruns = 0;
+    double audioSeconds = 0.0;
+    double cpuNsPerAudioSecond = 0.0;       // VAD worker CPU per second of audio
+    int64_t lastEndOfSpeechLatencyNs = 0;   // last voiced sample captured -> segment handed off
+    int64_t lastSegmentSamples = 0;
+    float noiseFloorDb = 0.0f;
+};
+
+class AudioCapture {
+public:
+    ~AudioCapture() { Stop(); }
+
+    bool Start(const AudioCaptureConfig& config, VoiceSegmentCallback consumer, void* user);
+    void Stop();
+    bool Running() const { return running_; }
+
+    AudioCaptureMetrics GetMetrics();
+
+private:
+    void Worker();
+    static void OnSegment(const VoiceSegment& segment, void* self);
+
+    AudioSource* source_ = nullptr;
+    AudioRing ring_;
+    VoiceActivityDetector vad_;
+    VoiceSegmentCallback consumer_ = nullptr;
+    void* consumerUser_ = nullptr;
+    int64_t processedSamples_ = 0;
+
+    std::thread worker_;
+    std::atomic<bool> running_{false};
+
+    std::mutex metricsMutex_;
+    AudioCaptureMetrics metrics_;
+};
+
+AudioSource* CreateAudioSource(const AudioCaptureConfig& config);
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+
+// =============================================================================
+// Logging & Timing shared by all native modules
+// =============================================================================
+#define LOG_TAG "IrisAgent_Native"
+
+#if defined(__ANDROID__)
+#include <android/log.h>
+#define ALOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define ALOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
+#define ALOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+#else
+// Linux stand-in builds log to stderr so the same modules can run off-device.
+#include <cstdio>
+#define ALOGI(...) (fprintf(stderr, "I/" LOG_TAG ": " __VA_ARGS__), fputc('\n', stderr))
+#define ALOGW(...) (fprintf(stderr, "W/" LOG_TAG ": " __VA_ARGS__), fputc('\n', stderr))
+#define ALOGE(...) (fprintf(stderr, "E/" LOG_TAG ": " __VA_ARGS__), fputc('\n', stderr))
+#endif
+
+// Monotonic clock in nanoseconds. On Android this is the same time base as XrTime.
+inline int64_t NowNs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
@@ -0,0 +1,184 @@
+#include "frame_capture.h"
+
+#include <cstring>
+
+#include "common.h"
+
+namespace {
+
+// Fields are packed explicitly (little-endian host order, no padding) so the
+// format does not depend on struct layout.
+struct Packer {
+    uint8_t bytes[512];
+    uint16_t size = 0;
+    template <typename T> void Put(const T& value) {
+        memcpy(bytes + size, &value, sizeof(T));
+        size += sizeof(T);
+    }
+};
+
+struct Unpacker {
+    const uint8_t* bytes;
+    uint16_t size;
+    uint16_t offset = 0;
+    template <typename T> T Get() {
+        T value = {};
+        if (offset + sizeof(T) <= size) memcpy(&value, bytes + offset, sizeof(T));
+        offset += sizeof(T);
+        return value;
+    }
+};
+
+void PackPose(Packer& p, const XrPosef& pose) {
+    p.Put(pose.orientation.x); p.Put(pose.orientation.y); p.Put(pose.orientation.z); p.Put(pose.orientation.w);
+    p.Put(pose.position.x); p.Put(pose.position.y); p.Put(pose.position.z);
+}
+
+XrPosef UnpackPose(Unpacker& u) {
+    XrPosef pose;
+    pose.orientation.x = u.Get<float>(); pose.orientation.y = u.Get<float>();
+    pose.orientation.z = u.Get<float>(); pose.orientation.w = u.Get<float>();
+    pose.position.x = u.Get<float>(); pose.position.y = u.Get<float>(); pose.position.z = u.Get<float>();
+    return pose;
+}
+
+} // namespace
+
+// =============================================================================
+// Writer
+// =============================================================================
+bool FrameCaptureWriter::Open(const std::string& path, const std::vector<FrameCaptureTarget>& targets) {
+    Close();
+    file_ = fopen(path.c_str(), "wb");
+    if (file_ == nullptr) { ALOGE("Frame capture: cannot open %s", path.c_str()); return false; }
+    buffer_.resize(256 * 1024);
+    setvbuf(file_, buffer_.data(), _IOFBF, buffer_.size());
+    const uint32_t header[3] = {kFrameCaptureMagic, kFrameCaptureVersion, static_cast<uint32_t>(targets.size())};
+    fwrite(header, sizeof(header), 1, file_);
+    for (const auto& t : targets) {
+        fwrite(&t.width, sizeof(t.width), 1, file_);
+        fwrite(&t.height, sizeof(t.height), 1, file_);
+    }
+    records_ = 0;
+    ALOGI("Frame capture recording to %s", path.c_str());
+    return true;
+}
+
+void FrameCaptureWriter::Close() {
+    if (file_ == nullptr) return;
+    fclose(file_);
+    file_ = nullptr;
+    buffer_.clear();
+    buffer_.shrink_to_fit();
+    ALOGI("Frame capture closed after %llu records", (unsigned long long)records_);
+}
+
+void FrameCaptureWriter::WriteRecord(FrameCaptureTag tag, const void* payload, uint16_t size) {
+    if (file_ == nullptr) return;
+    fwrite(&tag, sizeof(tag), 1, file_);
+    fwrite(&size, sizeof(size), 1, file_);
+    fwrite(payload, size, 1, file_);
+    records_++;
+}
+
+void FrameCaptureWriter::WriteFrame(const CapturedFrame& frame) {
+    Packer p;
+    p.Put(frame.frameStartNs);
+    p.Put(frame.predictedDisplayTime);
+    p.Put(frame.predictedDisplayPeriod);
+    p.Put(frame.shouldRender);
+    p.Put(frame.viewStateFlags);
+    const uint8_t viewCount = static_cast<uint8_t>(frame.viewCount < kFrameCaptureMaxViews ? frame.viewCount : kFrameCaptureMaxViews);
+    p.Put(viewCount);
+    for (uint32_t i = 0; i < viewCount; ++i) {
+        PackPose(p, frame.views[i].pose);
+        p.Put(frame.views[i].fov.angleLeft); p.Put(frame.views[i].fov.angleRight);
+        p.Put(frame.views[i].fov.angleUp); p.Put(frame.views[i].fov.angleDown);
+    }
+    WriteRecord(FRAME_CAPTURE_FRAME, p.bytes, p.size);
+}
+
+void FrameCaptureWriter::WriteSessionState(const CapturedSessionState& event) {
+    Packer p;
+    p.Put(event.time);
+    p.Put(event.state);
+    WriteRecord(FRAME_CAPTURE_SESSION_STATE, p.bytes, p.size);
+}
+
+void FrameCaptureWriter::WriteInput(const CapturedInput& input) {
+    Packer p;
+    p.Put(input.resumed);
+    p.Put(input.sessionReady);
+    WriteRecord(FRAME_CAPTURE_INPUT, p.bytes, p.size);
+}
+
+// =============================================================================
+// Reader
+// =============================================================================
+bool FrameCaptureReader::Open(const std::string& path) {
+    Close();
+    file_ = fopen(path.c_str(), "rb");
+    if (file_ == nullptr) { ALOGE("Frame capture: cannot open %s", path.c_str()); return false; }
+    uint32_t header[3];
+    if (fread(header, sizeof(header), 1, file_) != 1 || header[0] != kFrameCaptureMagic || header[1] > kFrameCaptureVersion ||
+        header[2] > kFrameCaptureMaxViews) {
+        ALOGE("Frame capture: %s is not a supported capture", path.c_str());
+        Close();
+        return false;
+    }
+    targets_.resize(header[2]);
+    payload_.resize(UINT16_MAX);
+    for (auto& t : targets_) {
+        if (fread(&t.width, sizeof(t.width), 1, file_) != 1 || fread(&t.height, sizeof(t.height), 1, file_) != 1) {
+            Close();
+            return false;
+        }
+    }
+    return true;
+}
+
+void FrameCaptureReader::Close() {
+    if (file_ != nullptr) fclose(file_);
+    file_ = nullptr;
+}
+
+bool FrameCaptureReader::Next(FrameCaptureTag& tag, CapturedFrame& frame, CapturedSessionState& event, CapturedInput& input) {
+    for (;;) {
+        uint8_t rawTag;
+        uint16_t size;
+        if (file_ == nullptr || fread(&rawTag, 1, 1, file_) != 1 || fread(&size, sizeof(size), 1, file_) != 1 ||
+            fread(payload_.data(), 1, size, file_) != size) {
+            return false;
+        }
+        Unpacker u = {payload_.data(), size};
+        switch (rawTag) {
+            case FRAME_CAPTURE_FRAME: {
+                frame.frameStartNs = u.Get<int64_t>();
+                frame.predictedDisplayTime = u.Get<XrTime>();
+                frame.predictedDisplayPeriod = u.Get<XrDuration>();
+                frame.shouldRender = u.Get<uint8_t>();
+                frame.viewStateFlags = u.Get<uint32_t>();
+                frame.viewCount = u.Get<uint8_t>();
+                if (frame.viewCount > kFrameCaptureMaxViews) frame.viewCount = kFrameCaptureMaxViews;
+                for (uint32_t i = 0; i < frame.viewCount; ++i) {
+                    frame.views[i].pose = UnpackPose(u);
+                    frame.views[i].fov.angleLeft = u.Get<float>(); frame.views[i].fov.angleRight = u.Get<float>();
+                    frame.views[i].fov.angleUp = u.Get<float>(); frame.views[i].fov.angleDown = u.Get<float>();
+                }
+                break;
+            }
+            case FRAME_CAPTURE_SESSION_STATE:
+                event.time = u.Get<XrTime>();
+                event.state = u.Get<int32_t>();
+                break;
+            case FRAME_CAPTURE_INPUT:
+                input.resumed = u.Get<uint8_t>();
+                input.sessionReady = u.Get<uint8_t>();
+                break;
+            default:
+                continue;   // newer record type, skip
+        }
+        tag = static_cast<FrameCaptureTag>(rawTag);
+        return true;
+    }
+}
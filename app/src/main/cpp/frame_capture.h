@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <openxr/openxr.h>
+
+// =============================================================================
+// Frame Capture & Replay
+// =============================================================================
+// Records every per-frame input the frame loop consumes so a headset session can
+// be fed back through the renderer off-device. The file is a small header
+// followed by tagged records (tag, payload size, payload); readers skip tags
+// they do not know, so new inputs can be added without breaking old captures.
+//
+//   header:  "IRFC" | version u32 | viewCount u32 | {width i32, height i32} * viewCount
+//   record:  tag u8 | size u16 | payload
+
+constexpr uint32_t kFrameCaptureMagic = 0x43465249;   // "IRFC"
+constexpr uint32_t kFrameCaptureVersion = 1;
+constexpr uint32_t kFrameCaptureMaxViews = 4;
+
+enum FrameCaptureTag : uint8_t {
+    FRAME_CAPTURE_FRAME = 1,          // xrWaitFrame + xrLocateViews results
+    FRAME_CAPTURE_SESSION_STATE = 2,  // XrEventDataSessionStateChanged
+    FRAME_CAPTURE_INPUT = 3,          // app-level input state sampled this frame
+};
+
+struct CapturedView {
+    XrPosef pose;
+    XrFovf fov;
+};
+
+struct CapturedFrame {
+    int64_t frameStartNs = 0;         // monotonic clock when the loop iteration began
+    XrTime predictedDisplayTime = 0;
+    XrDuration predictedDisplayPeriod = 0;
+    uint8_t shouldRender = 0;
+    uint32_t viewStateFlags = 0;
+    uint32_t viewCount = 0;
+    CapturedView views[kFrameCaptureMaxViews];
+};
+
+struct CapturedSessionState {
+    XrTime time = 0;
+    int32_t state = 0;
+};
+
+struct CapturedInput {
+    uint8_t resumed = 0;
+    uint8_t sessionReady = 0;
+};
+
+struct FrameCaptureTarget {
+    int32_t width;
+    int32_t height;
+};
+
+class FrameCaptureWriter {
+public:
+    ~FrameCaptureWriter() { Close(); }
+
+    bool Open(const std::string& path, const std::vector<FrameCaptureTarget>& targets);
+    void Close();
+    bool IsOpen() const { return file_ != nullptr; }
+
+    void WriteFrame(const CapturedFrame& frame);
+    void WriteSessionState(const CapturedSessionState& event);
+    void WriteInput(const CapturedInput& input);
+
+    uint64_t RecordsWritten() const { return records_; }
+
+private:
+    void WriteRecord(FrameCaptureTag tag, const void* payload, uint16_t size);
+
+    FILE* file_ = nullptr;
+    std::vector<char> buffer_;   // stdio buffer, sized so the frame loop rarely hits write()
+    uint64_t records_ = 0;
+};
+
+class FrameCaptureReader {
+public:
+    ~FrameCaptureReader() { Close(); }
+
+    bool Open(const std::string& path);
+    void Close();
+    const std::vector<FrameCaptureTarget>& Targets() const { return targets_; }
+
+    // Returns false at end of file. Only the member matching `tag` is filled.
+    bool Next(FrameCaptureTag& tag, CapturedFrame& frame, CapturedSessionState& event, CapturedInput& input);
+
+private:
+    FILE* file_ = nullptr;
+    std::vector<FrameCaptureTarget> targets_;
+    std::vector<uint8_t> payload_;
+};
@@ -0,0 +1,191 @@
+#include "frame_pacing.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "common.h"
+
+namespace {
+
+// At most one jank line per second in the log; the rest are only counted.
+constexpr int64_t kJankLogIntervalNs = 1000000000LL;
+
+// "gpu 3.20 ms", or "gpu n/a" when the timer result never arrived.
+void FormatGpu(char (&out)[32], int64_t gpuNs) {
+    if (gpuNs < 0) snprintf(out, sizeof(out), "gpu n/a");
+    else snprintf(out, sizeof(out), "gpu %.2f ms", gpuNs / 1e6);
+}
+
+} // namespace
+
+const char* FramePacingMonitor::PhaseName(FramePhase phase) {
+    switch (phase) {
+        case FRAME_PHASE_UPDATE: return "update";
+        case FRAME_PHASE_WAIT: return "wait";
+        case FRAME_PHASE_BEGIN: return "begin";
+        case FRAME_PHASE_CULL: return "cull";
+        case FRAME_PHASE_ACQUIRE: return "acquire";
+        case FRAME_PHASE_RENDER: return "render";
+        case FRAME_PHASE_SUBMIT: return "submit";
+        case FRAME_PHASE_GPU: return "gpu";
+        default: return "unknown";
+    }
+}
+
+void FramePacingMonitor::BeginFrame(uint64_t frameIndex) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    frameIndex_ = frameIndex;
+    FrameRecord& record = Record(frameIndex);
+    record = {};
+    record.index = frameIndex;
+    phase_ = FRAME_PHASE_UPDATE;
+    phaseStartNs_ = NowNs();
+}
+
+void FramePacingMonitor::MarkPhase(FramePhase phase) {
+    const int64_t now = NowNs();
+    std::lock_guard<std::mutex> lock(mutex_);
+    Record(frameIndex_).phaseNs[phase_] += now - phaseStartNs_;
+    phase_ = phase;
+    phaseStartNs_ = now;
+}
+
+void FramePacingMonitor::EndFrame(int64_t predictedDisplayTime, int64_t predictedDisplayPeriod) {
+    const int64_t now = NowNs();
+    std::lock_guard<std::mutex> lock(mutex_);
+    FrameRecord& record = Record(frameIndex_);
+    record.phaseNs[phase_] += now - phaseStartNs_;
+    record.periodNs = predictedDisplayPeriod;
+    stats_.frames++;
+    stats_.displayPeriodNs = predictedDisplayPeriod;
+
+    if (lastDisplayTime_ != 0 && predictedDisplayPeriod > 0) {
+        const int64_t steps = (predictedDisplayTime - lastDisplayTime_ + predictedDisplayPeriod / 2) / predictedDisplayPeriod;
+        if (steps <= 0) {
+            stats_.duplicatedFrames++;
+        } else if (steps >= 2) {
+            // This frame's wait was pushed out because the previous one was late.
+            const uint64_t lateFrame = frameIndex_ > 0 && Record(frameIndex_ - 1).index == frameIndex_ - 1 ? frameIndex_ - 1 : frameIndex_;
+            JankEvent& event = janks_[jankCount_++ % kJankHistory];
+            event = {};
+            event.frameIndex = lateFrame;
+            event.missed = static_cast<uint32_t>(steps - 1);
+            event.periodNs = predictedDisplayPeriod;
+            stats_.missedFrames += static_cast<uint64_t>(steps - 1);
+            stats_.jankEvents++;
+        }
+    }
+    lastDisplayTime_ = predictedDisplayTime;
+
+    const uint64_t pending = std::min<uint64_t>(jankCount_, kJankHistory);
+    for (uint64_t i = 0; i < pending; ++i) {
+        JankEvent& event = janks_[(jankCount_ - 1 - i) % kJankHistory];
+        if (event.resolved) continue;
+        const FrameRecord& late = Record(event.frameIndex);
+        const bool gpuKnown = late.index == event.frameIndex && late.gpuKnown;
+        if (gpuKnown || frameIndex_ >= event.frameIndex + kGpuLatencyFrames) Resolve(event, !gpuKnown);
+    }
+}
+
+void FramePacingMonitor::SetGpuTime(uint64_t frameIndex, int64_t ns) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    FrameRecord& record = Record(frameIndex);
+    if (record.index != frameIndex) return;
+    record.phaseNs[FRAME_PHASE_GPU] = ns;
+    record.gpuKnown = true;
+}
+
+void FramePacingMonitor::NoteSwapchainStall() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    FrameRecord& record = Record(frameIndex_);
+    if (!record.swapchainStall) stats_.swapchainStalls++;
+    record.swapchainStall = true;
+}
+
+void FramePacingMonitor::Reset() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    lastDisplayTime_ = 0;
+}
+
+// Blames the longest phase of the late frame; waiting is never the cause.
+void FramePacingMonitor::Resolve(JankEvent& event, bool force) {
+    event.resolved = true;
+    const FrameRecord& late = Record(event.frameIndex);
+    if (late.index != event.frameIndex) return;
+    for (int p = 0; p < FRAME_PHASE_COUNT; ++p) {
+        if (p == FRAME_PHASE_WAIT || (p == FRAME_PHASE_GPU && force)) continue;
+        if (p != FRAME_PHASE_GPU) event.cpuNs += late.phaseNs[p];
+        if (late.phaseNs[p] > event.phaseNs) {
+            event.phase = static_cast<FramePhase>(p);
+            event.phaseNs = late.phaseNs[p];
+        }
+    }
+    event.gpuNs = force ? -1 : late.phaseNs[FRAME_PHASE_GPU];
+    event.swapchainStall = late.swapchainStall;
+    stats_.blamed[event.phase]++;
+
+    const int64_t now = NowNs();
+    if (now - lastLogNs_ < kJankLogIntervalNs) { suppressedLogs_++; return; }
+    char gpu[32];
+    FormatGpu(gpu, event.gpuNs);
+    ALOGW("Frame %llu missed %u vsync(s): %s %.2f ms (cpu %.2f ms, %s, period %.2f ms%s), %llu more since last report",
+          (unsigned long long)event.frameIndex, event.missed, PhaseName(event.phase), event.phaseNs / 1e6,
+          event.cpuNs / 1e6, gpu, event.periodNs / 1e6, event.swapchainStall ? ", swapchain stall" : "",
+          (unsigned long long)suppressedLogs_);
+    lastLogNs_ = now;
+    suppressedLogs_ = 0;
+}
+
+FramePacingStats FramePacingMonitor::Stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    FramePacingStats s = stats_;
+    uint64_t counted[FRAME_PHASE_COUNT] = {};
+    int64_t sums[FRAME_PHASE_COUNT] = {};
+    for (const FrameRecord& record : frames_) {
+        // Only finished frames; the one in flight has no period yet.
+        if (record.periodNs == 0) continue;
+        for (int p = 0; p < FRAME_PHASE_COUNT; ++p) {
+            if (p == FRAME_PHASE_GPU && !record.gpuKnown) continue;
+            counted[p]++;
+            sums[p] += record.phaseNs[p];
+            s.maxPhaseNs[p] = std::max(s.maxPhaseNs[p], record.phaseNs[p]);
+        }
+    }
+    for (int p = 0; p < FRAME_PHASE_COUNT; ++p) {
+        s.meanPhaseNs[p] = counted[p] != 0 ? sums[p] / static_cast<int64_t>(counted[p]) : 0;
+    }
+    return s;
+}
+
+std::string FramePacingMonitor::JankReport() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string report;
+    const uint64_t count = std::min<uint64_t>(jankCount_, kJankHistory);
+    for (uint64_t i = jankCount_ - count; i < jankCount_; ++i) {
+        const JankEvent& e = janks_[i % kJankHistory];
+        char line[224];
+        if (!e.resolved) {
+            snprintf(line, sizeof(line), "frame %llu: missed %u, pending GPU time\n", (unsigned long long)e.frameIndex, e.missed);
+        } else {
+            char gpu[32];
+            FormatGpu(gpu, e.gpuNs);
+            snprintf(line, sizeof(line), "frame %llu: missed %u, %s %.2f ms (cpu %.2f ms, %s, period %.2f ms%s)\n",
+                     (unsigned long long)e.frameIndex, e.missed, PhaseName(e.phase), e.phaseNs / 1e6, e.cpuNs / 1e6,
+                     gpu, e.periodNs / 1e6, e.swapchainStall ? ", swapchain stall" : "");
+        }
+        report += line;
+    }
+    return report;
+}
+
+void FramePacingMonitor::LogReport() const {
+    const FramePacingStats s = Stats();
+    if (s.frames == 0) return;
+    ALOGI("Frame pacing: %llu frames, %llu missed vsyncs in %llu janks, %llu duplicated, %llu swapchain stalls, period %.2f ms",
+          (unsigned long long)s.frames, (unsigned long long)s.missedFrames, (unsigned long long)s.jankEvents,
+          (unsigned long long)s.duplicatedFrames, (unsigned long long)s.swapchainStalls, s.displayPeriodNs / 1e6);
+    for (int p = 0; p < FRAME_PHASE_COUNT; ++p) {
+        ALOGI("  %-7s mean %6.2f ms  max %6.2f ms  blamed %llu", PhaseName(static_cast<FramePhase>(p)),
+              s.meanPhaseNs[p] / 1e6, s.maxPhaseNs[p] / 1e6, (unsigned long long)s.blamed[p]);
+    }
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+// =============================================================================
+// Frame Pacing Monitor
+// =============================================================================
+// Follows XrFrameState::predictedDisplayTime from frame to frame. A step of two
+// or more display periods means vsyncs went by without a new frame (missed); a
+// step of zero means the same vsync was targeted twice (duplicated). Each miss is
+// blamed on the phase of the late frame that took longest, CPU phases and GPU
+// time alike, once that frame's GPU time has come back.
+
+enum FramePhase : uint8_t {
+    FRAME_PHASE_UPDATE = 0,   // events, stream tokens, capture bookkeeping
+    FRAME_PHASE_WAIT,         // xrWaitFrame
+    FRAME_PHASE_BEGIN,        // xrBeginFrame, xrLocateViews
+    FRAME_PHASE_CULL,
+    FRAME_PHASE_ACQUIRE,      // swapchain image acquire and wait, all eyes
+    FRAME_PHASE_RENDER,       // per-eye GL submission
+    FRAME_PHASE_SUBMIT,       // xrEndFrame
+    FRAME_PHASE_GPU,          // GPU time of the frame's GL work
+    FRAME_PHASE_COUNT
+};
+
+struct FramePacingStats {
+    uint64_t frames = 0;
+    uint64_t missedFrames = 0;       // vsyncs skipped
+    uint64_t duplicatedFrames = 0;
+    uint64_t jankEvents = 0;         // frames followed by at least one skipped vsync
+    uint64_t swapchainStalls = 0;    // frames whose swapchain wait timed out at least once
+    int64_t displayPeriodNs = 0;
+    // Over the last kFramePacingWindow frames.
+    int64_t meanPhaseNs[FRAME_PHASE_COUNT] = {};
+    int64_t maxPhaseNs[FRAME_PHASE_COUNT] = {};
+    // Lifetime count of jank events blamed on each phase.
+    uint64_t blamed[FRAME_PHASE_COUNT] = {};
+};
+
+constexpr uint32_t kFramePacingWindow = 128;
+
+class FramePacingMonitor {
+public:
+    // Top of the loop; starts timing FRAME_PHASE_UPDATE.
+    void BeginFrame(uint64_t frameIndex);
+    // Closes the running phase and starts `phase`.
+    void MarkPhase(FramePhase phase);
+    // After xrEndFrame, with the frame state xrWaitFrame returned.
+    void EndFrame(int64_t predictedDisplayTime, int64_t predictedDisplayPeriod);
+    // GPU time arrives a few frames late; misses wait for it before being blamed.
+    void SetGpuTime(uint64_t frameIndex, int64_t ns);
+    // The running frame's swapchain wait timed out; shown with any miss it causes.
+    void NoteSwapchainStall();
+    // Forget the previous display time, e.g. while the session is not running.
+    void Reset();
+
+    FramePacingStats Stats() const;
+    // The most recent jank events, newest last, one per line.
+    std::string JankReport() const;
+    void LogReport() const;
+
+    static const char* PhaseName(FramePhase phase);
+
+private:
+    struct FrameRecord {
+        uint64_t index = 0;
+        int64_t periodNs = 0;
+        int64_t phaseNs[FRAME_PHASE_COUNT] = {};
+        bool gpuKnown = false;
+        bool swapchainStall = false;
+    };
+    struct JankEvent {
+        uint64_t frameIndex = 0;
+        uint32_t missed = 0;
+        FramePhase phase = FRAME_PHASE_UPDATE;
+        int64_t phaseNs = 0;
+        int64_t cpuNs = 0;
+        int64_t gpuNs = 0;
+        int64_t periodNs = 0;
+        bool swapchainStall = false;
+        bool resolved = false;
+    };
+    static constexpr uint32_t kJankHistory = 32;
+    // GPU results later than this are given up on and the miss is blamed on the CPU.
+    static constexpr uint64_t kGpuLatencyFrames = 4;
+
+    FrameRecord& Record(uint64_t frameIndex) { return frames_[frameIndex % kFramePacingWindow]; }
+    void Resolve(JankEvent& event, bool force);
+
+    mutable std::mutex mutex_;
+    FrameRecord frames_[kFramePacingWindow];
+    JankEvent janks_[kJankHistory];
+    uint64_t jankCount_ = 0;
+    uint64_t frameIndex_ = 0;
+    FramePhase phase_ = FRAME_PHASE_UPDATE;
+    int64_t phaseStartNs_ = 0;
+    int64_t lastDisplayTime_ = 0;
+    int64_t lastLogNs_ = 0;
+    uint64_t suppressedLogs_ = 0;
+    FramePacingStats stats_;
+};
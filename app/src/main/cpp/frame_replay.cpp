@@ -0,0 +1,1096 @@
+// =============================================================================
+// Frame Replay Driver (host only)
+// =============================================================================
+// Feeds a frame capture recorded on the headset back through the renderer on a
+// surfaceless EGL context (Mesa llvmpipe on a Linux box), and reports per-frame
+// CPU cost so two builds can be compared on an identical workload.
+//
+//   frame_replay <capture.bin> [--repeat N] [--no-finish] [--msaa N] [--objects N] [--cpu-cull]
+//                [--hint-log out.csv] [--hidden-area] [--bundle assets.pak] [--lod-error px]
+//                [--reversed-z] [--depth-bits 16|24|32] [--screenshot out.png]
+//                [--record out.y4m] [--record-fps N] [--mirror fps] [--mirror-width px]
+//                [--mirror-client-delay ms] [--mirror-save last.png] [--dedup hz]
+//                [--dedup-latency ms] [--roi hz] [--roi-lag ms] [--roi-field deg] [--roi-max px]
+//                [--roi-save crop.png] [--record-restart frame out2.y4m] [--gpu-budget KB]
+//                [--idle-at frame N]
+//   frame_replay --synthesize <out.bin> <frames> [size]
+//   frame_replay --depth-check
+//   frame_replay --hash-bench
+//   frame_replay --stream-bench [tokens] [token delay ms] [tokens taken per frame]
+//   frame_replay --audio-bench [clip.wav] [--fast]
+//   frame_replay --mixer-bench [sources]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include "asset_bundle.h"
+#include "audio_capture.h"
+#include "common.h"
+#include "frame_capture.h"
+#include "gl_trace.h"
+#include "gpu_resources.h"
+#include "image_capture.h"
+#include "mirror_stream.h"
+#include "perf_hint.h"
+#include "renderer.h"
+#include "spatial_mixer.h"
+#include "stream_client.h"
+#include "thread_roles.h"
+#include "vision_roi.h"
+#include "visual_dedup.h"
+#include "xr_math.h"
+
+namespace {
+
+struct ReplayTarget {
+    GLuint framebuffer = 0;
+    GLuint color = 0;
+    GLuint depth = 0;
+    int32_t width = 0;
+    int32_t height = 0;
+};
+
+int64_t CpuNs(clockid_t clock) {
+    timespec ts;
+    clock_gettime(clock, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+bool InitializeSurfacelessGl(EGLDisplay& display, EGLContext& context) {
+    auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    display = getPlatformDisplay != nullptr ? getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr)
+                                            : eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    EGLint major, minor;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) { ALOGE("eglInitialize failed"); return false; }
+    eglBindAPI(EGL_OPENGL_ES_API);
+    const EGLint contextAttribs[] = {EGL_CONTEXT_MAJOR_VERSION, 3, EGL_CONTEXT_MINOR_VERSION, 2, EGL_NONE};
+    context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, contextAttribs);
+    if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+        ALOGE("Surfaceless GLES 3.2 context unavailable");
+        return false;
+    }
+    ALOGI("Replay GL: %s, %s", glGetString(GL_RENDERER), glGetString(GL_VERSION));
+    return true;
+}
+
+ReplayTarget CreateTarget(const MsaaConfig& msaa, GLenum depthFormat, int32_t width, int32_t height) {
+    ReplayTarget t;
+    t.width = width;
+    t.height = height;
+    glGenTextures(1, &t.color);
+    glBindTexture(GL_TEXTURE_2D, t.color);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, width, height);
+    glGenTextures(1, &t.depth);
+    glBindTexture(GL_TEXTURE_2D, t.depth);
+    glTexStorage2D(GL_TEXTURE_2D, 1, depthFormat, width, height);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glGenFramebuffers(1, &t.framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, t.framebuffer);
+    AttachViewTargets(msaa, t.color, t.depth);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    GpuResources_Register(GPU_KIND_TEXTURE, t.color, GPU_CATEGORY_RENDER_TARGET, GL_RGBA8,
+                          GpuResources_ImageBytes(GL_RGBA8, width, height), "replay");
+    GpuResources_Register(GPU_KIND_TEXTURE, t.depth, GPU_CATEGORY_DEPTH, depthFormat,
+                          GpuResources_ImageBytes(depthFormat, width, height), "replay");
+    return t;
+}
+
+double Percentile(std::vector<int64_t> values, double p) {
+    if (values.empty()) return 0.0;
+    std::sort(values.begin(), values.end());
+    return static_cast<double>(values[static_cast<size_t>(p * (values.size() - 1))]);
+}
+
+void Report(const char* label, const std::vector<int64_t>& ns) {
+    if (ns.empty()) return;
+    double sum = 0.0;
+    for (int64_t v : ns) sum += static_cast<double>(v);
+    printf("%-22s mean %8.1f us  p50 %8.1f  p95 %8.1f  p99 %8.1f  max %8.1f\n", label, sum / ns.size() / 1e3,
+           Percentile(ns, 0.5) / 1e3, Percentile(ns, 0.95) / 1e3, Percentile(ns, 0.99) / 1e3,
+           Percentile(ns, 1.0) / 1e3);
+}
+
+// The device's single panel by default; otherwise a grid of panels filling a
+// 20 x 4 x 20 m volume around the viewer, most of it outside the frusta.
+std::vector<SceneObject> MakeSceneObjects(int count) {
+    if (count <= 0) return {{{0.0f, 0.0f, -1.0f}, 1.0f}};
+    std::vector<SceneObject> objects;
+    const int side = std::max(1, static_cast<int>(ceilf(cbrtf(count / 0.2f))));
+    for (int i = 0; static_cast<int>(objects.size()) < count; ++i) {
+        const int x = i % side, z = (i / side) % side, y = i / (side * side);
+        objects.push_back({{-10.0f + 20.0f * x / side, 0.2f + 0.8f * y, -10.0f + 20.0f * z / side}, 0.3f});
+    }
+    return objects;
+}
+
+// Stand-in for the runtime's hidden-area mesh: the ring between an ellipse
+// inscribed in the view's tangent rectangle and one well outside it. Vertices
+// are on the z = -1 plane like XR_KHR_visibility_mask's.
+void MakeHiddenAreaMesh(const XrFovf& fov, std::vector<XrVector2f>& vertices, std::vector<uint32_t>& indices) {
+    constexpr uint32_t kSegments = 64;
+    const float cx = 0.5f * (tanf(fov.angleRight) + tanf(fov.angleLeft));
+    const float cy = 0.5f * (tanf(fov.angleUp) + tanf(fov.angleDown));
+    const float rx = 0.5f * (tanf(fov.angleRight) - tanf(fov.angleLeft));
+    const float ry = 0.5f * (tanf(fov.angleUp) - tanf(fov.angleDown));
+    vertices.clear();
+    indices.clear();
+    for (uint32_t k = 0; k < kSegments; ++k) {
+        const float a = 6.2831853f * k / kSegments;
+        vertices.push_back({cx + 0.98f * rx * cosf(a), cy + 0.98f * ry * sinf(a)});
+        vertices.push_back({cx + 1.6f * rx * cosf(a), cy + 1.6f * ry * sinf(a)});
+        const uint32_t inner = 2 * k, outer = inner + 1;
+        const uint32_t nextInner = 2 * ((k + 1) % kSegments), nextOuter = nextInner + 1;
+        indices.insert(indices.end(), {inner, outer, nextOuter, inner, nextOuter, nextInner});
+    }
+}
+
+// Writes a 72 Hz stereo capture of a slowly swaying head, for trying the driver without a headset.
+int Synthesize(const char* path, int frames, int size) {
+    FrameCaptureWriter writer;
+    if (!writer.Open(path, {{size, size}, {size, size}})) return 1;
+    writer.WriteSessionState({0, XR_SESSION_STATE_READY});
+    writer.WriteInput({1, 1});
+    const XrDuration period = 1000000000LL / 72;
+    for (int f = 0; f < frames; ++f) {
+        CapturedFrame frame;
+        frame.frameStartNs = f * period;
+        frame.predictedDisplayTime = (f + 2) * period;
+        frame.predictedDisplayPeriod = period;
+        frame.shouldRender = 1;
+        frame.viewStateFlags = XR_VIEW_STATE_ORIENTATION_VALID_BIT | XR_VIEW_STATE_POSITION_VALID_BIT;
+        frame.viewCount = 2;
+        const float yaw = 0.3f * sinf(f * 0.02f);
+        for (uint32_t v = 0; v < 2; ++v) {
+            frame.views[v].pose.orientation = {0.0f, sinf(yaw * 0.5f), 0.0f, cosf(yaw * 0.5f)};
+            frame.views[v].pose.position = {v == 0 ? -0.032f : 0.032f, 1.6f, 0.0f};
+            frame.views[v].fov = {-0.9f, 0.9f, 0.9f, -0.9f};
+        }
+        writer.WriteFrame(frame);
+    }
+    writer.WriteSessionState({(frames + 2) * period, XR_SESSION_STATE_STOPPING});
+    printf("Wrote %d frames to %s\n", frames, path);
+    return 0;
+}
+
+// Depth mapping self-check, no GL needed. Points straight ahead are taken
+// through each projection in float as the GPU would (clip z / w, then the
+// viewport remap) and quantized to the depth format. Fails when a mapping
+// misses its near or far value or puts a farther point in front of a nearer
+// one; prints the smallest separation each mapping resolves.
+struct DepthMapping {
+    const char* name;
+    bool reversed;
+    bool zeroToOne;
+    int bits;   // 32 is float
+};
+
+float WindowDepth(const Matrix4f& projection, bool zeroToOne, float distance) {
+    const float z = projection.M[10] * -distance + projection.M[14];
+    const float w = projection.M[11] * -distance + projection.M[15];
+    return zeroToOne ? z / w : z / w * 0.5f + 0.5f;
+}
+
+double StoredDepth(float depth, int bits) {
+    if (bits >= 32) return depth;
+    return std::nearbyint(std::min(std::max(depth, 0.0f), 1.0f) * static_cast<double>((1u << bits) - 1));
+}
+
+int DepthCheck() {
+    constexpr float kNear = 0.1f, kFar = 100.0f;
+    const XrFovf fov = {-0.9f, 0.9f, 0.9f, -0.9f};
+    const DepthMapping mappings[] = {
+            {"conventional, 16-bit", false, false, 16},
+            {"conventional, 24-bit", false, false, 24},
+            {"conventional, 32-bit float", false, false, 32},
+            {"reversed-Z [0, 1], 16-bit", true, true, 16},
+            {"reversed-Z [0, 1], 24-bit", true, true, 24},
+            {"reversed-Z [0, 1], 32-bit float", true, true, 32},
+            {"reversed-Z [-1, 1], 32-bit float", true, false, 32},
+    };
+    const float probes[] = {0.5f, 1.0f, 2.0f, 5.0f, 10.0f, 50.0f};
+    int failures = 0;
+
+    // Only depth may differ from the conventional matrix, or culling and x/y would change.
+    const Matrix4f conventional = Matrix4f_CreateProjectionFov(fov, kNear, kFar);
+    for (bool zeroToOne : {false, true}) {
+        const Matrix4f reversed = Matrix4f_CreateProjectionFovReversedInfinite(fov, kNear, zeroToOne);
+        for (int i : {0, 5, 8, 9, 11}) {
+            if (reversed.M[i] != conventional.M[i]) {
+                printf("FAIL: reversed matrix element %d is %g, conventional %g\n", i, reversed.M[i], conventional.M[i]);
+                failures++;
+            }
+        }
+    }
+
+    printf("%-34s", "smallest resolved separation, mm");
+    for (float d : probes) printf("%9.1f m", d);
+    printf("\n");
+    for (const DepthMapping& m : mappings) {
+        const Matrix4f projection = m.reversed ? Matrix4f_CreateProjectionFovReversedInfinite(fov, kNear, m.zeroToOne)
+                                               : Matrix4f_CreateProjectionFov(fov, kNear, kFar);
+        const float nearDepth = WindowDepth(projection, m.zeroToOne, kNear);
+        const float farDepth = WindowDepth(projection, m.zeroToOne, m.reversed ? 1e6f : kFar);
+        if (fabsf(nearDepth - (m.reversed ? 1.0f : 0.0f)) > 1e-5f || fabsf(farDepth - (m.reversed ? 0.0f : 1.0f)) > 1e-5f) {
+            printf("FAIL: %s maps near to %g and far to %g\n", m.name, nearDepth, farDepth);
+            failures++;
+        }
+        // A farther point may tie with a nearer one (z-fighting) but never win the depth test.
+        const float last = m.reversed ? 1e4f : kFar;
+        double previous = StoredDepth(nearDepth, m.bits);
+        for (float d = kNear * 1.001f; d <= last; d *= 1.001f) {
+            const double stored = StoredDepth(WindowDepth(projection, m.zeroToOne, d), m.bits);
+            if (m.reversed ? stored > previous : stored < previous) {
+                printf("FAIL: %s orders %.4f m in front of a nearer point\n", m.name, d);
+                failures++;
+                break;
+            }
+            previous = stored;
+        }
+        printf("%-34s", m.name);
+        for (float d : probes) {
+            const double at = StoredDepth(WindowDepth(projection, m.zeroToOne, d), m.bits);
+            // Width of the run of distances around d that store the same value.
+            float up = 1e-6f, down = 1e-6f;
+            while (up < d && StoredDepth(WindowDepth(projection, m.zeroToOne, d + up), m.bits) == at) up *= 1.02f;
+            while (down < 0.5f * d && StoredDepth(WindowDepth(projection, m.zeroToOne, d - down), m.bits) == at) down *= 1.02f;
+            if (up < d && down < 0.5f * d) printf("%11.3f", (up + down) * 1000.0f);
+            else printf("%11s", "-");
+        }
+        printf("\n");
+    }
+    printf("Depth check: %s\n", failures == 0 ? "OK" : "FAILED");
+    return failures == 0 ? 0 : 1;
+}
+
+// Head pose as the device loop publishes it: mean eye position, first eye's orientation.
+HeadPose MakeHeadPose(const CapturedView* views, uint32_t count) {
+    HeadPose pose = {};
+    for (uint32_t v = 0; v < count; ++v) {
+        pose.position[0] += views[v].pose.position.x / count;
+        pose.position[1] += views[v].pose.position.y / count;
+        pose.position[2] += views[v].pose.position.z / count;
+    }
+    const XrQuaternionf& o = views[0].pose.orientation;
+    pose.orientation[0] = o.x; pose.orientation[1] = o.y; pose.orientation[2] = o.z; pose.orientation[3] = o.w;
+    return pose;
+}
+
+// Replay stand-in for the vision sender: left-eye readbacks go through the
+// query gate, and a sent query is answered latencyNs of display time later.
+struct DedupReplay {
+    struct Sample {
+        int64_t timeNs;
+        HeadPose pose;
+    };
+    ReadbackRing readback;
+    VisualQueryDedup gate;
+    std::vector<Sample> poses;   // one per readback in flight, in issue order
+    int64_t latencyNs = 0;
+    int64_t nextSampleNs = 0;
+    int64_t answerAtNs = -1;     // -1 while no query is in flight
+    uint64_t dropped = 0;
+
+    static void OnReadback(const uint8_t* rgba, int32_t width, int32_t height, int64_t timeNs, void* user) {
+        DedupReplay& self = *static_cast<DedupReplay*>(user);
+        HeadPose pose = {};
+        bool havePose = false;
+        if (!self.poses.empty() && self.poses.front().timeNs == timeNs) {
+            pose = self.poses.front().pose;
+            havePose = true;
+        }
+        if (!self.poses.empty()) self.poses.erase(self.poses.begin());
+        if (rgba == nullptr) return;
+        if (self.answerAtNs >= 0 && timeNs >= self.answerAtNs) {
+            self.gate.Complete();
+            self.answerAtNs = -1;
+        }
+        const VisualQueryDecision decision = self.gate.Submit(rgba, width, height, static_cast<size_t>(width) * 4,
+                                                              havePose ? &pose : nullptr, timeNs);
+        if (decision == VISUAL_QUERY_SEND) self.answerAtNs = timeNs + self.latencyNs;
+    }
+};
+
+// Replay stand-in for the vision uploader. Readbacks wait lagNs, as a camera
+// frame would wait for its crop, and are then cropped around where the head
+// points by that time. Each crop is compared with the whole frame it came from
+// and with the crop the capture-time pose alone would have given.
+struct RoiReplay {
+    struct Sample {
+        int64_t timeNs;
+        HeadPose pose;
+    };
+    struct Frame {
+        int64_t timeNs;
+        HeadPose pose;
+        int32_t width, height;
+        std::vector<uint8_t> rgba;   // top row first
+    };
+    ReadbackRing readback;
+    VisionCamera camera;
+    VisionRoiConfig config;
+    int64_t lagNs = 0;
+    int64_t nextSampleNs = 0;
+    std::vector<Sample> poses;   // one per readback in flight
+    std::vector<Frame> frames;   // read back, waiting for the lag to pass
+    HeadPose lastViewPose = {};
+    uint64_t dropped = 0, crops = 0, fallbacks = 0, mismatches = 0;
+    uint64_t roiBytes = 0, fullBytes = 0;
+    int64_t extractNs = 0, scalarNs = 0, encodeNs = 0, fullEncodeNs = 0;
+    double shiftPx = 0.0, maxShiftPx = 0.0;
+    int32_t lastWidth = 0, lastHeight = 0, frameWidth = 0, frameHeight = 0;
+    TrackedVector<uint8_t, MEM_TAG_CAPTURE> lastPng;
+
+    static void OnReadback(const uint8_t* rgba, int32_t width, int32_t height, int64_t timeNs, void* user) {
+        RoiReplay& self = *static_cast<RoiReplay*>(user);
+        HeadPose pose = {};
+        if (!self.poses.empty()) {
+            pose = self.poses.front().pose;
+            self.poses.erase(self.poses.begin());
+        }
+        if (rgba == nullptr) return;
+        Frame frame = {timeNs, pose, width, height, std::vector<uint8_t>(static_cast<size_t>(width) * height * 4)};
+        for (int32_t y = 0; y < height; ++y) {
+            memcpy(frame.rgba.data() + static_cast<size_t>(y) * width * 4,
+                   rgba + static_cast<size_t>(height - 1 - y) * width * 4, static_cast<size_t>(width) * 4);
+        }
+        self.frames.push_back(std::move(frame));
+    }
+
+    // Crops every frame whose lag has passed by nowNs, or all of them when `flush`.
+    void Process(int64_t nowNs, const HeadPose& viewPose, bool flush) {
+        lastViewPose = viewPose;
+        TrackedVector<uint8_t, MEM_TAG_VISION> scalar, vector;
+        TrackedVector<uint8_t, MEM_TAG_CAPTURE> full;
+        while (!frames.empty() && (flush || nowNs - frames.front().timeNs >= lagNs)) {
+            const Frame& f = frames.front();
+            const size_t stride = static_cast<size_t>(f.width) * 4;
+            const VisionRoi r = SelectVisionRoi(camera, f.width, f.height, f.pose, viewPose, nullptr, config);
+            const VisionRoi uncompensated = SelectVisionRoi(camera, f.width, f.height, viewPose, viewPose, nullptr, config);
+            int32_t w = 0, h = 0, sw = 0, sh = 0;
+            int64_t t0 = NowNs();
+            VisionRoi_Extract(f.rgba.data(), stride, r, config.maxSide, vector, w, h, true);
+            int64_t t1 = NowNs();
+            VisionRoi_Extract(f.rgba.data(), stride, r, config.maxSide, scalar, sw, sh, false);
+            int64_t t2 = NowNs();
+            if (w != sw || h != sh || vector != scalar) mismatches++;
+            EncodePng(vector.data(), w, h, lastPng);
+            int64_t t3 = NowNs();
+            EncodePng(f.rgba.data(), f.width, f.height, full);
+            int64_t t4 = NowNs();
+            extractNs += t1 - t0;
+            scalarNs += t2 - t1;
+            encodeNs += t3 - t2;
+            fullEncodeNs += t4 - t3;
+            roiBytes += lastPng.size();
+            fullBytes += full.size();
+            const double shift = hypot(r.gazeX - uncompensated.gazeX, r.gazeY - uncompensated.gazeY);
+            shiftPx += shift;
+            maxShiftPx = std::max(maxShiftPx, shift);
+            crops++;
+            if (r.fallback) fallbacks++;
+            lastWidth = w;
+            lastHeight = h;
+            frameWidth = f.width;
+            frameHeight = f.height;
+            frames.erase(frames.begin());
+        }
+    }
+};
+
+// A few soft blobs on a gradient; `scene` picks their layout. The rest are the
+// changes a camera sees between two looks at the same thing.
+void MakeHashScene(std::vector<uint8_t>& rgba, int32_t width, int32_t height, int scene, int shift, int brightness,
+                   int noise) {
+    rgba.resize(static_cast<size_t>(width) * height * 4);
+    uint32_t seed = 777;
+    for (int32_t y = 0; y < height; ++y) {
+        for (int32_t x = 0; x < width; ++x) {
+            float value = 60.0f + 80.0f * x / width;
+            for (int b = 0; b < 5; ++b) {
+                const float cx = width * (0.15f + 0.7f * fmodf(0.37f * (b + 1) * (scene + 1), 1.0f)) + shift;
+                const float cy = height * (0.15f + 0.7f * fmodf(0.61f * (b + 2) * (scene + 1), 1.0f));
+                const float r = 0.12f * width;
+                const float d2 = ((x - cx) * (x - cx) + (y - cy) * (y - cy)) / (r * r);
+                value += (b % 2 ? 90.0f : -50.0f) * expf(-d2);
+            }
+            seed = seed * 1664525u + 1013904223u;
+            const int jitter = noise > 0 ? static_cast<int>(seed >> 24) % (2 * noise + 1) - noise : 0;
+            const int v = std::max(0, std::min(255, static_cast<int>(value) + brightness + jitter));
+            uint8_t* p = rgba.data() + (static_cast<size_t>(y) * width + x) * 4;
+            p[0] = static_cast<uint8_t>(v);
+            p[1] = static_cast<uint8_t>(v * 3 / 4);
+            p[2] = static_cast<uint8_t>(255 - v);
+            p[3] = 255;
+        }
+    }
+}
+
+// Hash cost per frame with and without the vector kernel, then the hash
+// distance of typical near-duplicates and of a different scene from a
+// reference frame. Fails when the kernels disagree or the default threshold
+// would misjudge one of the pairs.
+int HashBench() {
+    int failures = 0;
+    const int32_t sizes[][2] = {{320, 240}, {640, 480}, {1280, 960}, {1920, 1920}};
+    printf("%-12s %12s %12s %8s %10s\n", "frame", "scalar us", "vector us", "speedup", "GB/s");
+    for (const auto& size : sizes) {
+        const int32_t w = size[0], h = size[1];
+        const int iterations = std::max(5, 50000000 / (w * h));
+        uint64_t scalarHash = 0, vectorHash = 0;
+        const double scalar = VisualHash_Benchmark(w, h, iterations, false, &scalarHash);
+        const double vector = VisualHash_Benchmark(w, h, iterations, true, &vectorHash);
+        if (scalarHash != vectorHash) {
+            printf("FAIL: %dx%d hashes differ, scalar %016llx, vector %016llx\n", w, h, (unsigned long long)scalarHash,
+                   (unsigned long long)vectorHash);
+            failures++;
+        }
+        printf("%5dx%-6d %12.1f %12.1f %7.2fx %10.2f\n", w, h, scalar / 1e3, vector / 1e3, scalar / vector,
+               static_cast<double>(w) * h * 4 / vector);
+    }
+
+    const int32_t w = 640, h = 480;
+    const int threshold = VisualDedupConfig().maxHammingBits;
+    std::vector<uint8_t> image;
+    MakeHashScene(image, w, h, 0, 0, 0, 0);
+    const uint64_t reference = VisualHash_Compute(image.data(), w, h, static_cast<size_t>(w) * 4);
+    struct Variant {
+        const char* name;
+        int scene, shift, brightness, noise;
+        bool duplicate;
+    };
+    const Variant variants[] = {
+            {"shifted 8 px", 0, 8, 0, 0, true},
+            {"brighter by 25", 0, 0, 25, 0, true},
+            {"noise +-16", 0, 0, 0, 16, true},
+            {"all three", 0, 8, 25, 16, true},
+            {"different scene", 1, 0, 0, 0, false},
+            {"another scene", 2, 0, 0, 0, false},
+    };
+    printf("hash distance from a %dx%d reference (same view at <= %d bits):\n", w, h, threshold);
+    for (const Variant& v : variants) {
+        MakeHashScene(image, w, h, v.scene, v.shift, v.brightness, v.noise);
+        const int distance = VisualHash_Distance(reference, VisualHash_Compute(image.data(), w, h, static_cast<size_t>(w) * 4));
+        const bool ok = (distance <= threshold) == v.duplicate;
+        printf("  %-18s %2d bits%s\n", v.name, distance, ok ? "" : "  FAIL");
+        if (!ok) failures++;
+    }
+
+    // A head that stays still must not hide a new object: the gate still hashes and sends it.
+    VisualQueryDedup gate;
+    const HeadPose pose = {{0.0f, 1.6f, 0.0f}, {0.0f, 0.0f, 0.0f, 1.0f}};
+    const size_t stride = static_cast<size_t>(w) * 4;
+    MakeHashScene(image, w, h, 0, 0, 0, 0);
+    const VisualQueryDecision first = gate.Submit(image.data(), w, h, stride, &pose, 0);
+    gate.Complete();
+    MakeHashScene(image, w, h, 0, 8, 25, 16);
+    const VisualQueryDecision same = gate.Submit(image.data(), w, h, stride, &pose, 100000000LL);
+    MakeHashScene(image, w, h, 1, 0, 0, 0);
+    const VisualQueryDecision changed = gate.Submit(image.data(), w, h, stride, &pose, 200000000LL);
+    const bool gateOk = first == VISUAL_QUERY_SEND && same == VISUAL_QUERY_REUSE && changed == VISUAL_QUERY_SEND;
+    printf("  still head: first %d, same view %d, new object %d%s\n", first, same, changed, gateOk ? "" : "  FAIL");
+    if (!gateOk) failures++;
+    printf("Hash check: %s\n", failures == 0 ? "OK" : "FAILED");
+    return failures == 0 ? 0 : 1;
+}
+
+// One request against the loopback stand-in backend, drained the way the
+// device loop drains it: at most `perFrame` tokens every 72 Hz frame (0 takes
+// everything). A small per-frame budget fills the render queue and exercises
+// the read pause. The text received must match what the stand-in sent.
+int StreamBench(int tokenCount, int tokenDelayMs, int perFrame) {
+    StreamStandInServer server;
+    StreamClient client;
+    if (!server.Start(tokenCount, tokenDelayMs) || !client.Start()) return 1;
+    StreamRequest request;
+    request.port = server.Port();
+    request.path = "/v1/chat/completions";
+    request.body = "{\"stream\":true}";
+    const uint32_t id = client.Submit(request);
+
+    std::string expected, received;
+    char piece[64];
+    for (int i = 0; i < tokenCount; ++i) {
+        snprintf(piece, sizeof(piece), (i % 8 == 7) ? "caf\xc3\xa9 \"%d\"\n" : "token%d ", i);
+        expected += piece;
+    }
+    StreamTokenKind end = STREAM_TOKEN_TEXT;
+    uint64_t frames = 0, tokens = 0;
+    const int64_t deadline = NowNs() + 60000000000LL;
+    while (end == STREAM_TOKEN_TEXT && NowNs() < deadline) {
+        StreamToken token;
+        for (int taken = 0; (perFrame <= 0 || taken < perFrame) && client.PopToken(token); ++taken) {
+            if (token.requestId != id) continue;
+            if (token.kind != STREAM_TOKEN_TEXT) { end = static_cast<StreamTokenKind>(token.kind); break; }
+            received.append(token.text, token.length);
+            tokens++;
+        }
+        frames++;
+        std::this_thread::sleep_for(std::chrono::microseconds(13889));
+    }
+    client.Stop();
+    server.Stop();
+
+    const StreamMetrics m = client.GetMetrics();
+    printf("Stream (%d tokens, %d ms apart, %d per frame): %llu slots over %llu frames, %llu bytes, ended with %s\n",
+           tokenCount, tokenDelayMs, perFrame, (unsigned long long)tokens, (unsigned long long)frames,
+           (unsigned long long)m.bytesReceived,
+           end == STREAM_TOKEN_DONE ? "DONE" : end == STREAM_TOKEN_ERROR ? "ERROR" : "nothing");
+    printf("  first token %.2f ms, stream %.2f ms, %.0f tokens/s, %.1f KB/s, reads paused %llu times for %.2f ms\n",
+           m.lastFirstTokenNs / 1e6, m.lastStreamNs / 1e6, m.lastTokensPerSec, m.lastBytesPerSec / 1024.0,
+           (unsigned long long)m.readPauses, m.readPausedNs / 1e6);
+    const bool ok = end == STREAM_TOKEN_DONE && received == expected;
+    if (received != expected) {
+        printf("FAIL: received %zu bytes of text, expected %zu\n", received.size(), expected.size());
+    }
+    printf("Stream check: %s\n", ok ? "OK" : "FAILED");
+    return ok ? 0 : 1;
+}
+
+// Three voiced bursts (a 140 Hz harmonic series, like a vowel) in faint white
+// noise, as a 16 kHz mono WAV.
+bool WriteSyntheticSpeech(const char* path, int& utterances) {
+    const int rate = 16000;
+    const float bursts[][2] = {{0.5f, 0.8f}, {2.0f, 1.2f}, {3.9f, 0.6f}};   // start, length in seconds
+    utterances = 3;
+    std::vector<int16_t> pcm(static_cast<size_t>(rate * 5));
+    uint32_t seed = 99;
+    for (size_t i = 0; i < pcm.size(); ++i) {
+        const float t = static_cast<float>(i) / rate;
+        seed = seed * 1664525u + 1013904223u;
+        float v = 0.003f * ((seed >> 8) / 8388608.0f - 1.0f);
+        for (const auto& b : bursts) {
+            if (t < b[0] || t >= b[0] + b[1]) continue;
+            const float edge = std::min(t - b[0], b[0] + b[1] - t);
+            const float envelope = edge < 0.03f ? 0.5f - 0.5f * cosf(static_cast<float>(M_PI) * edge / 0.03f) : 1.0f;
+            for (int k = 1; k <= 8; ++k) v += 0.3f * envelope / k * sinf(2.0f * static_cast<float>(M_PI) * 140.0f * k * t);
+        }
+        pcm[i] = static_cast<int16_t>(std::max(-1.0f, std::min(1.0f, v)) * 32767.0f);
+    }
+    FILE* f = fopen(path, "wb");
+    if (f == nullptr) return false;
+    const uint32_t dataBytes = static_cast<uint32_t>(pcm.size() * 2), riffBytes = 36 + dataBytes, fmtBytes = 16;
+    const uint32_t byteRate = rate * 2;
+    const uint16_t pcmFormat = 1, channels = 1, blockAlign = 2, bits = 16;
+    const int32_t sampleRate = rate;
+    fwrite("RIFF", 1, 4, f); fwrite(&riffBytes, 4, 1, f); fwrite("WAVEfmt ", 1, 8, f); fwrite(&fmtBytes, 4, 1, f);
+    fwrite(&pcmFormat, 2, 1, f); fwrite(&channels, 2, 1, f); fwrite(&sampleRate, 4, 1, f); fwrite(&byteRate, 4, 1, f);
+    fwrite(&blockAlign, 2, 1, f); fwrite(&bits, 2, 1, f); fwrite("data", 1, 4, f); fwrite(&dataBytes, 4, 1, f);
+    fwrite(pcm.data(), 2, pcm.size(), f);
+    return fclose(f) == 0;
+}
+
+// The capture pipeline end to end on the file stand-in source: ring, VAD
+// worker and segment hand-off. Paced like a microphone unless `fast`, since
+// end-of-speech latency only means something in real time. Without a clip a
+// synthetic one is used, and the number of utterances found is checked.
+int AudioBench(const char* clip, bool fast) {
+    char temp[] = "/tmp/iris-speech-XXXXXX";
+    int expected = -1;
+    std::string path = clip != nullptr ? clip : "";
+    if (path.empty()) {
+        const int fd = mkstemp(temp);
+        if (fd < 0) return 1;
+        close(fd);
+        path = temp;
+        if (!WriteSyntheticSpeech(temp, expected)) return 1;
+    }
+    struct Segments {
+        uint64_t count = 0;
+        double seconds = 0.0;
+    } segments;
+    AudioCaptureConfig config;
+    config.filePath = path;
+    config.realtime = !fast;
+    AudioCapture capture;
+    const bool started = capture.Start(config, [](const VoiceSegment& segment, void* user) {
+        auto* s = static_cast<Segments*>(user);
+        s->count++;
+        s->seconds += static_cast<double>(segment.count) / segment.sampleRate;
+    }, &segments);
+    if (clip == nullptr) unlink(temp);
+    if (!started) return 1;
+
+    // The source stops after the clip and a second of silence; wait until the worker has caught up.
+    double lastSeconds = -1.0;
+    for (int still = 0; still < 3;) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        const double seconds = capture.GetMetrics().audioSeconds;
+        still = seconds == lastSeconds ? still + 1 : 0;
+        lastSeconds = seconds;
+    }
+    capture.Stop();
+    const AudioCaptureMetrics m = capture.GetMetrics();
+    printf("Audio (%s): %.2f s in %llu frames, %llu voiced, %llu utterances (%.2f s of speech), %llu overruns\n",
+           fast ? "unpaced" : "real time", m.audioSeconds, (unsigned long long)m.framesProcessed,
+           (unsigned long long)m.voicedFrames, (unsigned long long)segments.count, segments.seconds,
+           (unsigned long long)m.overruns);
+    printf("  VAD %.1f us CPU per second of audio (%.4f%% of a core), noise floor %.1f dB\n",
+           m.cpuNsPerAudioSecond / 1e3, m.cpuNsPerAudioSecond / 1e7, m.noiseFloorDb);
+    if (!fast) printf("  end of speech detected %.1f ms after the last voiced sample\n", m.lastEndOfSpeechLatencyNs / 1e6);
+    const bool ok = expected < 0 || static_cast<int>(segments.count) == expected;
+    if (expected >= 0) printf("Audio check: %s (%d utterances expected)\n", ok ? "OK" : "FAILED", expected);
+    return ok ? 0 : 1;
+}
+
+// The spatial mixer's cost per 10 ms buffer at a range of source counts (or
+// just `sources`), against the 10 ms it has to fit in. Then, on the paced
+// null sink, checks that a voice handle kept past its earcon's end no longer
+// reaches the voice that reused the slot.
+int MixerBench(int sources) {
+    const int counts[] = {1, 4, 8, 16, 32, kMixerMaxSources};
+    for (int count : counts) {
+        if (sources > 0 && count != counts[0]) break;
+        const int n = sources > 0 ? sources : count;
+        SpatialMixer mixer;
+        const double ns = mixer.Benchmark(n, 1000);
+        printf("Mixer: %2d sources, %7.1f us per 10 ms buffer (%.2f%% of the budget)\n",
+               std::min(n, kMixerMaxSources), ns / 1e3, ns / 1e5);
+    }
+
+    SpatialMixer mixer;
+    if (!mixer.Start(48000)) return 1;
+    std::vector<float> earcon(static_cast<size_t>(mixer.SampleRate()) / 20);
+    SpatialMixer_SynthesizeEarcon(earcon.data(), earcon.size(), mixer.SampleRate(), 660.0f);
+    const float position[3] = {0.5f, 0.0f, -1.0f};
+    const int stale = mixer.Play({earcon.data(), earcon.size()}, position, 1.0f, false);
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));   // the earcon ends and frees its slot
+    const int current = mixer.Play({earcon.data(), earcon.size()}, position, 1.0f, true);
+    mixer.StopVoice(stale);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    const int survived = mixer.GetMetrics().activeSources;
+    mixer.StopVoice(current);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    const SpatialMixerMetrics m = mixer.GetMetrics();
+    mixer.Stop();
+    const bool ok = stale >= 0 && current >= 0 && stale != current && survived == 1 && m.activeSources == 0;
+    printf("Mixer handles: %s (handles %d then %d, %d active after the stale stop, %d after the real one)\n",
+           ok ? "OK" : "FAILED", stale, current, survived, m.activeSources);
+    printf("  null sink: %llu callbacks, mean %.1f us per 10 ms, max %.1f us\n", (unsigned long long)m.callbacks,
+           m.avgCallbackNsPer10ms / 1e3, m.maxCallbackNs / 1e3);
+    return ok ? 0 : 1;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc >= 2 && strcmp(argv[1], "--depth-check") == 0) return DepthCheck();
+    if (argc >= 2 && strcmp(argv[1], "--hash-bench") == 0) return HashBench();
+    if (argc >= 2 && strcmp(argv[1], "--audio-bench") == 0) {
+        const bool fast = strcmp(argv[argc - 1], "--fast") == 0;
+        return AudioBench(argc >= 3 && strcmp(argv[2], "--fast") != 0 ? argv[2] : nullptr, fast);
+    }
+    if (argc >= 2 && strcmp(argv[1], "--mixer-bench") == 0) return MixerBench(argc >= 3 ? atoi(argv[2]) : 0);
+    if (argc >= 2 && strcmp(argv[1], "--stream-bench") == 0) {
+        return StreamBench(argc >= 3 ? atoi(argv[2]) : 2000, argc >= 4 ? atoi(argv[3]) : 0, argc >= 5 ? atoi(argv[4]) : 0);
+    }
+    if (argc >= 4 && strcmp(argv[1], "--synthesize") == 0) {
+        return Synthesize(argv[2], atoi(argv[3]), argc >= 5 ? atoi(argv[4]) : 1024);
+    }
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <capture.bin> [--repeat N] [--no-finish] [--msaa N] [--objects N] [--cpu-cull]\n"
+                        "       %*s [--hint-log out.csv] [--hidden-area] [--bundle assets.pak] [--lod-error px]\n"
+                        "       %*s [--reversed-z] [--depth-bits 16|24|32] [--screenshot out.png]\n"
+                        "       %*s [--record out.y4m] [--record-fps N] [--mirror fps] [--mirror-width px]\n"
+                        "       %*s [--mirror-client-delay ms] [--mirror-save last.png] [--dedup hz]\n"
+                        "       %*s [--dedup-latency ms] [--roi hz] [--roi-lag ms] [--roi-field deg] [--roi-max px]\n"
+                        "       %*s [--roi-save crop.png] [--record-restart frame out2.y4m] [--gpu-budget KB]\n"
+                        "       %*s [--idle-at frame N]\n"
+                        "       %s --synthesize <out.bin> <frames> [size]\n"
+                        "       %s --depth-check\n"
+                        "       %s --hash-bench\n"
+                        "       %s --stream-bench [tokens] [token delay ms] [tokens taken per frame]\n"
+                        "       %s --audio-bench [clip.wav] [--fast]\n"
+                        "       %s --mixer-bench [sources]\n", argv[0], (int)strlen(argv[0]), "", (int)strlen(argv[0]), "",
+                (int)strlen(argv[0]), "", (int)strlen(argv[0]), "", (int)strlen(argv[0]), "", (int)strlen(argv[0]), "", (int)strlen(argv[0]), "", argv[0], argv[0], argv[0], argv[0], argv[0], argv[0]);
+        return 1;
+    }
+    int repeat = 1;
+    bool finish = true;
+    int32_t msaaSamples = 1;
+    int objectCount = 0;
+    bool gpuCulling = true;
+    const char* hintLog = nullptr;
+    bool hiddenArea = false;
+    const char* bundlePath = nullptr;
+    float lodPixelError = 1.0f;
+    bool reversedZ = false;
+    int32_t depthBits = 24;
+    const char* screenshotPath = nullptr;
+    const char* recordPath = nullptr;
+    int32_t recordFps = 30;
+    const char* restartPath = nullptr;   // recording restarted into this file with readbacks still in flight
+    size_t restartFrame = 0;
+    int64_t gpuBudgetKb = 0;
+    size_t idleAt = 0;    // before this rendered frame, run idleFrames frames that draw nothing
+    int idleFrames = 0;
+    MirrorConfig mirrorConfig;
+    bool mirror = false;
+    int mirrorClientDelayMs = 0;
+    const char* mirrorSave = nullptr;
+    int dedupHz = 0;
+    int dedupLatencyMs = 1500;
+    int roiHz = 0;
+    int roiLagMs = 50;
+    VisionRoiConfig roiConfig;
+    const char* roiSave = nullptr;
+    for (int i = 2; i < argc; ++i) {
+        if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) repeat = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--no-finish") == 0) finish = false;
+        else if (strcmp(argv[i], "--msaa") == 0 && i + 1 < argc) msaaSamples = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--objects") == 0 && i + 1 < argc) objectCount = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--cpu-cull") == 0) gpuCulling = false;
+        else if (strcmp(argv[i], "--hint-log") == 0 && i + 1 < argc) hintLog = argv[++i];
+        else if (strcmp(argv[i], "--hidden-area") == 0) hiddenArea = true;
+        else if (strcmp(argv[i], "--bundle") == 0 && i + 1 < argc) bundlePath = argv[++i];
+        else if (strcmp(argv[i], "--lod-error") == 0 && i + 1 < argc) lodPixelError = static_cast<float>(atof(argv[++i]));
+        else if (strcmp(argv[i], "--reversed-z") == 0) reversedZ = true;
+        else if (strcmp(argv[i], "--depth-bits") == 0 && i + 1 < argc) depthBits = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--screenshot") == 0 && i + 1 < argc) screenshotPath = argv[++i];
+        else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) recordPath = argv[++i];
+        else if (strcmp(argv[i], "--record-fps") == 0 && i + 1 < argc) recordFps = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--gpu-budget") == 0 && i + 1 < argc) gpuBudgetKb = atoll(argv[++i]);
+        else if (strcmp(argv[i], "--idle-at") == 0 && i + 2 < argc) {
+            idleAt = static_cast<size_t>(atoi(argv[++i]));
+            idleFrames = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--record-restart") == 0 && i + 2 < argc) {
+            restartFrame = static_cast<size_t>(atoi(argv[++i]));
+            restartPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--mirror") == 0 && i + 1 < argc) { mirror = true; mirrorConfig.fps = atoi(argv[++i]); }
+        else if (strcmp(argv[i], "--mirror-width") == 0 && i + 1 < argc) mirrorConfig.width = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--mirror-client-delay") == 0 && i + 1 < argc) mirrorClientDelayMs = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--mirror-save") == 0 && i + 1 < argc) mirrorSave = argv[++i];
+        else if (strcmp(argv[i], "--dedup") == 0 && i + 1 < argc) dedupHz = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--dedup-latency") == 0 && i + 1 < argc) dedupLatencyMs = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--roi") == 0 && i + 1 < argc) roiHz = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--roi-lag") == 0 && i + 1 < argc) roiLagMs = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--roi-field") == 0 && i + 1 < argc) roiConfig.fieldDegrees = static_cast<float>(atof(argv[++i]));
+        else if (strcmp(argv[i], "--roi-max") == 0 && i + 1 < argc) roiConfig.maxSide = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--roi-save") == 0 && i + 1 < argc) roiSave = argv[++i];
+    }
+
+    EGLDisplay display;
+    EGLContext context;
+    if (!InitializeSurfacelessGl(display, context)) return 1;
+
+    FrameCaptureReader reader;
+    if (!reader.Open(argv[1])) return 1;
+    const MsaaConfig msaa = InitializeMsaa(msaaSamples);
+    const DepthConfig depth = InitializeDepth(reversedZ, depthBits);
+    std::vector<ReplayTarget> targets;
+    for (const auto& t : reader.Targets()) targets.push_back(CreateTarget(msaa, depth.format, t.width, t.height));
+    GraphicsPipeline pipeline;
+    AssetBundle bundle;   // kept mapped, as on device, for reloads after an eviction
+    {
+        // Load time as the device sees it: map, validate, upload.
+        const int64_t loadStart = NowNs();
+        if (bundlePath != nullptr && !bundle.Open(bundlePath)) return 1;
+        CreateGraphicsPipeline(pipeline, bundle.IsOpen() ? &bundle : nullptr);
+        printf("Pipeline loaded in %.2f ms (%s mesh, %d indices, %u LODs)\n", (NowNs() - loadStart) / 1e6,
+               bundlePath != nullptr ? "bundled" : "built-in", pipeline.lods[0].indexCount, pipeline.lodCount);
+    }
+    Scene scene;
+    const std::vector<SceneObject> objects = MakeSceneObjects(objectCount);
+    CreateScene(scene, pipeline, objects.data(), objects.size(), gpuCulling);
+    scene.lodPixelError = lodPixelError;
+
+    // Perf hint reports go to the recording stand-in, exactly as the device loop would send them.
+    ThreadRoles_RegisterCurrent(THREAD_ROLE_RENDER, "frame_replay", false);
+    PerfHintSession perfHint;
+    RecordingPerfHintBackend* hintRecorder = nullptr;   // owned by perfHint
+
+    std::vector<VisibilityMask> masks(targets.size());
+    bool masksBuilt = !hiddenArea;
+
+    // Captures the first view, as the device loop captures the left eye.
+    ImageCapture capture;
+    if (screenshotPath != nullptr) capture.RequestStill(screenshotPath);
+    if (recordPath != nullptr) capture.StartRecording(recordPath, recordFps);
+    int64_t passTimeNs = 0;   // keeps display times increasing across --repeat passes
+
+    // The mirror streams to a client in this process over the loopback interface.
+    MirrorStream mirrorStream;
+    MirrorLoopbackClient mirrorClient;
+    if (mirror) {
+        if (!mirrorStream.Start(mirrorConfig) ||
+            !mirrorClient.Start(mirrorStream.Port(), mirrorClientDelayMs, mirrorSave != nullptr ? mirrorSave : "")) {
+            return 1;
+        }
+        // Capture starts once the stream has accepted the client.
+        while (!mirrorStream.Stats().clientConnected) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    // The left eye stands in for the camera: sampled at dedupHz, read back and
+    // put through the query gate with the head pose of its frame. Each query
+    // sent is answered dedupLatencyMs of display time later.
+    DedupReplay dedup;
+    dedup.latencyNs = static_cast<int64_t>(dedupLatencyMs) * 1000000;
+
+    // The left eye also stands in for the vision camera: sampled at roiHz and
+    // cropped roiLagMs later, around where the head then points.
+    RoiReplay roi;
+    roi.config = roiConfig;
+    roi.lagNs = static_cast<int64_t>(roiLagMs) * 1000000;
+
+    std::vector<int64_t> submitCpu, frameCpu, frameWall;
+    uint64_t glCalls = 0, glRedundant = 0, glUploadBytes = 0;
+    uint64_t sessionEvents = 0, skipped = 0;
+    uint64_t lodObjects[kMaxMeshLods] = {}, lodTriangles = 0;
+    if (gpuBudgetKb > 0) GpuResources_SetBudget(static_cast<uint64_t>(gpuBudgetKb) * 1024);
+    uint64_t frameIndex = 0;   // every loop iteration, drawn or not, as on device
+    for (int pass = 0; pass < repeat; ++pass) {
+        if (pass > 0 && !reader.Open(argv[1])) return 1;
+        const int64_t passStartNs = passTimeNs;
+        CapturedInput input = {1, 1};
+        FrameCaptureTag tag;
+        CapturedFrame frame;
+        CapturedSessionState event;
+        while (reader.Next(tag, frame, event, input)) {
+            if (tag == FRAME_CAPTURE_SESSION_STATE) { sessionEvents++; continue; }
+            if (tag != FRAME_CAPTURE_FRAME) continue;
+            if (idleFrames > 0 && submitCpu.size() == idleAt) {
+                // The app paused: the loop keeps turning without drawing, and the budget may take the mesh back.
+                for (int i = 0; i < idleFrames; ++i) {
+                    GpuResources_SetFrame(frameIndex++);
+                    GpuResources_EndFrame();
+                }
+                skipped += idleFrames;
+                idleFrames = 0;
+            }
+            GpuResources_SetFrame(frameIndex++);
+            // Same gating as the device loop: nothing is drawn unless the session runs and the app is resumed.
+            if (!input.resumed || !input.sessionReady || !frame.shouldRender) { skipped++; continue; }
+
+            const int64_t wall0 = NowNs();
+            const int64_t thread0 = CpuNs(CLOCK_THREAD_CPUTIME_ID);
+            const int64_t process0 = CpuNs(CLOCK_PROCESS_CPUTIME_ID);
+            const uint32_t views = std::min<uint32_t>(frame.viewCount, static_cast<uint32_t>(targets.size()));
+            XrView xrViews[kFrameCaptureMaxViews];
+            for (uint32_t v = 0; v < views; ++v) {
+                xrViews[v] = {XR_TYPE_VIEW};
+                xrViews[v].pose = frame.views[v].pose;
+                xrViews[v].fov = frame.views[v].fov;
+            }
+            if (!masksBuilt) {
+                // Built from the first frame's fields of view, as the runtime would.
+                masksBuilt = true;
+                std::vector<XrVector2f> vertices;
+                std::vector<uint32_t> indices;
+                for (uint32_t v = 0; v < views; ++v) {
+                    MakeHiddenAreaMesh(xrViews[v].fov, vertices, indices);
+                    UpdateVisibilityMask(masks[v], vertices.data(), vertices.size(), indices.data(), indices.size());
+                }
+            }
+            capture.Poll();
+            mirrorStream.Poll();
+            if (dedupHz > 0) dedup.readback.Collect(DedupReplay::OnReadback, &dedup);
+            if (roiHz > 0) {
+                roi.readback.Collect(RoiReplay::OnReadback, &roi);
+                roi.Process(passStartNs + frame.predictedDisplayTime, MakeHeadPose(frame.views, views), false);
+            }
+            if (!EnsureMeshResident(pipeline, scene)) return 1;
+            CullScene(scene, xrViews, views, targets.empty() ? 0 : targets[0].height);
+            for (uint32_t l = 0; l < pipeline.lodCount; ++l) {
+                lodObjects[l] += scene.lodStats.objects[l];
+                lodTriangles += static_cast<uint64_t>(scene.lodStats.objects[l]) * pipeline.lods[l].indexCount / 3;
+            }
+            for (uint32_t v = 0; v < views; ++v) {
+                glBindFramebuffer(GL_FRAMEBUFFER, targets[v].framebuffer);
+                RenderView(pipeline, scene, xrViews[v], targets[v].width, targets[v].height, &masks[v]);
+                DiscardViewDepth();
+                if (v == 0) {
+                    passTimeNs = passStartNs + frame.predictedDisplayTime;
+                    capture.CaptureView(targets[v].width, targets[v].height, passTimeNs);
+                    if (restartPath != nullptr && recordPath != nullptr && submitCpu.size() == restartFrame) {
+                        capture.StartRecording(restartPath, recordFps);
+                    }
+                    mirrorStream.CaptureView(targets[v].framebuffer, targets[v].width, targets[v].height, passTimeNs);
+                    if (dedupHz > 0 && passTimeNs >= dedup.nextSampleNs) {
+                        dedup.nextSampleNs = passTimeNs + 1000000000LL / dedupHz;
+                        if (dedup.readback.Issue(targets[v].width, targets[v].height, passTimeNs, "visual dedup")) {
+                            dedup.poses.push_back({passTimeNs, MakeHeadPose(frame.views, views)});
+                        } else {
+                            dedup.dropped++;
+                        }
+                    }
+                    if (roiHz > 0 && passTimeNs >= roi.nextSampleNs) {
+                        roi.nextSampleNs = passTimeNs + 1000000000LL / roiHz;
+                        if (roi.readback.Issue(targets[v].width, targets[v].height, passTimeNs, "vision roi")) {
+                            roi.poses.push_back({passTimeNs, MakeHeadPose(frame.views, views)});
+                            roi.camera.angleLeft = frame.views[0].fov.angleLeft;
+                            roi.camera.angleRight = frame.views[0].fov.angleRight;
+                            roi.camera.angleUp = frame.views[0].fov.angleUp;
+                            roi.camera.angleDown = frame.views[0].fov.angleDown;
+                        } else {
+                            roi.dropped++;
+                        }
+                    }
+                }
+                glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            }
+            submitCpu.push_back(CpuNs(CLOCK_THREAD_CPUTIME_ID) - thread0);
+            if (finish) glFinish();
+            frameCpu.push_back(CpuNs(CLOCK_PROCESS_CPUTIME_ID) - process0);
+            frameWall.push_back(NowNs() - wall0);
+            if (hintRecorder == nullptr) {
+                hintRecorder = new RecordingPerfHintBackend();
+                perfHint.Open(hintRecorder, ThreadRoles_Threads(THREAD_ROLE_RENDER), frame.predictedDisplayPeriod);
+            }
+            perfHint.ReportFrame(frameWall.back(), frame.predictedDisplayPeriod);
+            GpuResources_EndFrame();
+            GlTrace_EndFrame();
+            const GlTraceFrameStats gl = GlTrace_LastFrame();
+            glCalls += gl.calls;
+            glRedundant += gl.redundantStateSets;
+            glUploadBytes += gl.uploadBytes;
+        }
+    }
+
+    printf("Replayed %zu frames (%llu skipped, %llu session events), %zu views, %dx MSAA\n", submitCpu.size(),
+           (unsigned long long)skipped, (unsigned long long)sessionEvents, targets.size(), msaa.samples);
+    Report("submit CPU (thread)", submitCpu);
+    Report(finish ? "frame CPU (process)" : "frame CPU (no finish)", frameCpu);
+    Report("frame wall", frameWall);
+    if (IRIS_GL_TRACE && !submitCpu.empty()) {
+        printf("GL per frame: %.1f calls, %.1f redundant state sets, %.0f upload bytes\n", (double)glCalls / submitCpu.size(),
+               (double)glRedundant / submitCpu.size(), (double)glUploadBytes / submitCpu.size());
+    }
+
+    if (!scene.gpuCulling && !submitCpu.empty()) {
+        // Before frustum culling, so comparable across runs with different thresholds.
+        printf("LOD (%.2f px):", lodPixelError);
+        for (uint32_t l = 0; l < pipeline.lodCount; ++l) printf(" %.1f", (double)lodObjects[l] / submitCpu.size());
+        printf(" objects per level, %llu switches, %.0f triangles per frame (%.0f at LOD 0)\n",
+               (unsigned long long)scene.lodStats.switches, (double)lodTriangles / submitCpu.size(),
+               (double)scene.objects.size() * pipeline.lods[0].indexCount / 3);
+    }
+
+    if (screenshotPath != nullptr || recordPath != nullptr) {
+        capture.StopRecording();
+        // Every fence has passed after a finish, so one poll collects the rest.
+        glFinish();
+        capture.Poll();
+        capture.Poll();   // books the last frame's render-thread cost
+        capture.ReleaseGl();
+        capture.Shutdown();
+        const ImageCaptureStats c = capture.Stats();
+        const size_t images = c.stills + c.frames;
+        printf("Image capture: %llu stills, %llu frames, %llu dropped, %llu bytes written\n",
+               (unsigned long long)c.stills, (unsigned long long)c.frames, (unsigned long long)c.dropped,
+               (unsigned long long)c.bytesWritten);
+        if (!submitCpu.empty() && images > 0) {
+            printf("  render thread %.1f us per frame (max %.1f us), encoder %.2f ms CPU per image, latency %.2f ms\n",
+                   c.renderCpuNs / 1e3 / submitCpu.size(), c.maxRenderCpuNs / 1e3, c.encodeCpuNs / 1e6 / images,
+                   c.lastLatencyNs / 1e6);
+        }
+    }
+
+    if (mirror) {
+        glFinish();
+        mirrorStream.Poll();
+        mirrorStream.Poll();
+        // Give the mirror thread time to send what it holds before the client goes.
+        std::this_thread::sleep_for(std::chrono::milliseconds(200 + mirrorClientDelayMs));
+        mirrorClient.Stop();
+        mirrorStream.Stop();
+        mirrorStream.ReleaseGl();
+        const MirrorStats m = mirrorStream.Stats();
+        const MirrorClientStats c = mirrorClient.Stats();
+        printf("Mirror (%d fps): %llu frames sent, %llu dropped, %.1f KB per frame, client got %llu (%ux%u, %llu gaps, "
+               "%llu malformed)\n", mirrorConfig.fps, (unsigned long long)m.framesSent, (unsigned long long)m.dropped,
+               m.framesSent > 0 ? m.bytesSent / 1024.0 / m.framesSent : 0.0, (unsigned long long)c.frames,
+               c.lastWidth, c.lastHeight, (unsigned long long)c.sequenceGaps, (unsigned long long)c.malformed);
+        if (!submitCpu.empty() && m.framesSent > 0) {
+            printf("  render thread %.1f us per frame (max %.1f us), encoder %.2f ms CPU per frame, latency %.2f ms\n",
+                   m.renderCpuNs / 1e3 / submitCpu.size(), m.maxRenderCpuNs / 1e3, m.encodeCpuNs / 1e6 / m.framesSent,
+                   m.lastLatencyNs / 1e6);
+        }
+    }
+
+    if (dedupHz > 0) {
+        glFinish();
+        dedup.readback.Collect(DedupReplay::OnReadback, &dedup);
+        dedup.readback.Release();
+        const VisualDedupStats d = dedup.gate.Stats();
+        printf("Visual dedup (%d Hz, %d ms answers): %llu frames, %llu sent, %llu reused, %llu coalesced, "
+               "%.1f%% not sent, %llu readbacks dropped\n", dedupHz, dedupLatencyMs, (unsigned long long)d.frames,
+               (unsigned long long)d.sent, (unsigned long long)d.reused, (unsigned long long)d.coalesced,
+               d.frames > 0 ? 100.0 * (d.frames - d.sent) / d.frames : 0.0, (unsigned long long)dedup.dropped);
+        printf("  %llu matched only within the still-head distance, %llu hashed at %.1f us each\n",
+               (unsigned long long)d.stillMatches,
+               (unsigned long long)d.hashes, d.hashes > 0 ? d.hashNs / 1e3 / d.hashes : 0.0);
+    }
+
+    if (roiHz > 0) {
+        glFinish();
+        roi.readback.Collect(RoiReplay::OnReadback, &roi);
+        roi.readback.Release();
+        roi.Process(passTimeNs, roi.lastViewPose, true);
+        const double n = static_cast<double>(std::max<uint64_t>(1, roi.crops));
+        printf("Vision ROI (%d Hz, %.0f deg, %d px max, %d ms lag): %llu crops, %llu whole-frame fallbacks, "
+               "%llu readbacks dropped\n", roiHz, roiConfig.fieldDegrees, roiConfig.maxSide, roiLagMs,
+               (unsigned long long)roi.crops, (unsigned long long)roi.fallbacks, (unsigned long long)roi.dropped);
+        if (roi.crops > 0) {
+            printf("  upload %.1f KB per frame vs %.1f KB whole (%.1f%% of it), %dx%d from %dx%d\n",
+                   roi.roiBytes / 1024.0 / n, roi.fullBytes / 1024.0 / n, 100.0 * roi.roiBytes / std::max<uint64_t>(1, roi.fullBytes),
+                   roi.lastWidth, roi.lastHeight, roi.frameWidth, roi.frameHeight);
+            printf("  crop+scale %.1f us (scalar %.1f us, %s), encode %.2f ms vs %.2f ms whole\n",
+                   roi.extractNs / 1e3 / n, roi.scalarNs / 1e3 / n, roi.mismatches == 0 ? "identical" : "MISMATCH",
+                   roi.encodeNs / 1e6 / n, roi.fullEncodeNs / 1e6 / n);
+            printf("  pose compensation moved the crop %.1f px on average, %.1f px at most\n", roi.shiftPx / n,
+                   roi.maxShiftPx);
+        }
+        if (roiSave != nullptr && !roi.lastPng.empty()) {
+            if (FILE* f = fopen(roiSave, "wb")) {
+                fwrite(roi.lastPng.data(), 1, roi.lastPng.size(), f);
+                fclose(f);
+                printf("  last crop written to %s\n", roiSave);
+            }
+        }
+        if (roi.mismatches > 0) return 1;
+    }
+
+    if (perfHint.IsOpen()) {
+        const PerfHintStats hint = perfHint.Stats();
+        printf("Perf hint: %llu reports, %llu over the %.2f ms target, %llu target updates\n",
+               (unsigned long long)hint.reports, (unsigned long long)hint.overTarget, hint.targetNs / 1e6,
+               (unsigned long long)hint.targetUpdates);
+        if (hintLog != nullptr && hintRecorder->WriteCsv(hintLog)) printf("Perf hint log written to %s\n", hintLog);
+        perfHint.Close();
+    }
+
+    if (gpuBudgetKb > 0) {
+        const GpuMemoryReport r = GpuResources_Report();
+        printf("GPU budget %lld KB: %llu evictions, %u mesh reloads, %llu times over budget, %.1f KB now\n",
+               (long long)gpuBudgetKb, (unsigned long long)r.evictions, pipeline.meshReloads,
+               (unsigned long long)r.overBudgetEvents, r.totalBytes / 1024.0);
+    }
+    GpuResources_LogReport();
+    for (auto& mask : masks) DestroyVisibilityMask(mask);
+    DestroyScene(scene);
+    DestroyGraphicsPipeline(pipeline);
+    for (auto& t : targets) {
+        GpuResources_DeferDelete(GPU_KIND_FRAMEBUFFER, t.framebuffer);
+        GpuResources_DeferDelete(GPU_KIND_TEXTURE, t.color);
+        GpuResources_DeferDelete(GPU_KIND_TEXTURE, t.depth);
+    }
+    GpuResources_FlushDeletes();
+    GpuResources_ReportLeaks();
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(display, context);
+    eglTerminate(display);
+    return 0;
+}
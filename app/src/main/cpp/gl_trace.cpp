@@ -0,0 +1,148 @@
+#include "gl_trace.h"
+
+#if IRIS_GL_TRACE
+
+#include <atomic>
+#include <mutex>
+
+#include "common.h"
+
+namespace {
+
+const char* const kEntryNames[] = {
+#define GL_TRACE_NAME(name) #name,
+    GL_TRACE_ENTRY_POINTS(GL_TRACE_NAME)
+#undef GL_TRACE_NAME
+};
+
+struct CallLogEntry {
+    GlTraceEntry entry;
+    const char* marker;   // set for GlTrace_Marker entries instead of a GL call
+    uint64_t a;
+    uint64_t b;
+};
+
+constexpr size_t kCallLogCapacity = 4096;
+
+// All of this is touched only by the GL thread, except the summary under summaryMutex.
+struct TraceState {
+    uint32_t counts[GL_TRACE_ENTRY_COUNT] = {};
+    uint64_t shadow[GL_STATE_COUNT] = {};
+    bool shadowValid[GL_STATE_COUNT] = {};
+    GlTraceFrameStats current;
+    CallLogEntry log[kCallLogCapacity];
+    size_t logSize = 0;
+    bool logging = false;
+
+    std::mutex summaryMutex;
+    GlTraceFrameStats last;
+    std::atomic<bool> dumpRequested{false};
+};
+
+TraceState& State() {
+    static TraceState state;
+    return state;
+}
+
+} // namespace
+
+void GlTrace_Record(GlTraceEntry entry, uint64_t a, uint64_t b) {
+    TraceState& s = State();
+    s.counts[entry]++;
+    s.current.calls++;
+    if (s.logging && s.logSize < kCallLogCapacity) s.log[s.logSize++] = {entry, nullptr, a, b};
+}
+
+void GlTrace_Marker(const char* label, uint64_t a, uint64_t b) {
+    TraceState& s = State();
+    if (s.logging && s.logSize < kCallLogCapacity) s.log[s.logSize++] = {GL_TRACE_ENTRY_COUNT, label, a, b};
+}
+
+bool GlTrace_SetState(GlTraceState slot, uint64_t value) {
+    TraceState& s = State();
+    s.current.stateSets++;
+    const bool redundant = s.shadowValid[slot] && s.shadow[slot] == value;
+    if (redundant) s.current.redundantStateSets++;
+    s.shadow[slot] = value;
+    s.shadowValid[slot] = true;
+    return redundant;
+}
+
+void GlTrace_ForgetState(GlTraceState slot) { State().shadowValid[slot] = false; }
+
+GlTraceState GlTrace_TextureSlot() {
+    const TraceState& s = State();
+    if (!s.shadowValid[GL_STATE_ACTIVE_TEXTURE]) return GL_STATE_TEXTURE_2D_UNKNOWN_UNIT;
+    const uint64_t unit = s.shadow[GL_STATE_ACTIVE_TEXTURE] - GL_TEXTURE0;
+    if (unit >= kGlTraceTextureUnits) return GL_STATE_COUNT;
+    return static_cast<GlTraceState>(GL_STATE_TEXTURE_2D + unit);
+}
+
+void GlTrace_Upload(uint64_t bytes) { State().current.uploadBytes += bytes; }
+
+void GlTrace_Draw() { State().current.drawCalls++; }
+
+void GlTrace_Invalidate() {
+    TraceState& s = State();
+    for (bool& valid : s.shadowValid) valid = false;
+}
+
+size_t GlTrace_TexelBytes(GLenum format, GLenum type) {
+    size_t components = 4;
+    switch (format) {
+        case GL_RED: case GL_RED_INTEGER: case GL_DEPTH_COMPONENT: case GL_ALPHA: case GL_LUMINANCE: components = 1; break;
+        case GL_RG: case GL_RG_INTEGER: case GL_DEPTH_STENCIL: case GL_LUMINANCE_ALPHA: components = 2; break;
+        case GL_RGB: case GL_RGB_INTEGER: components = 3; break;
+        default: break;
+    }
+    switch (type) {
+        case GL_UNSIGNED_BYTE: case GL_BYTE: return components;
+        case GL_UNSIGNED_SHORT: case GL_SHORT: case GL_HALF_FLOAT: return components * 2;
+        case GL_UNSIGNED_SHORT_5_6_5: case GL_UNSIGNED_SHORT_4_4_4_4: case GL_UNSIGNED_SHORT_5_5_5_1: return 2;
+        case GL_UNSIGNED_INT_24_8: case GL_UNSIGNED_INT_2_10_10_10_REV: case GL_UNSIGNED_INT_10F_11F_11F_REV: return 4;
+        default: return components * 4;   // GL_UNSIGNED_INT, GL_INT, GL_FLOAT
+    }
+}
+
+void GlTrace_EndFrame() {
+    TraceState& s = State();
+    if (s.logging) {
+        ALOGI("GL trace frame %llu: %u calls, %u draws, %u/%u redundant state sets, %llu upload bytes",
+              (unsigned long long)s.current.frame, s.current.calls, s.current.drawCalls, s.current.redundantStateSets,
+              s.current.stateSets, (unsigned long long)s.current.uploadBytes);
+        for (size_t i = 0; i < s.logSize; ++i) {
+            const CallLogEntry& e = s.log[i];
+            if (e.marker != nullptr) {
+                ALOGI("  %4zu -- %-23s %llu %llu", i, e.marker, (unsigned long long)e.a, (unsigned long long)e.b);
+                continue;
+            }
+            ALOGI("  %4zu %-26s 0x%llx 0x%llx", i, kEntryNames[e.entry], (unsigned long long)e.a, (unsigned long long)e.b);
+        }
+        if (s.logSize == kCallLogCapacity) ALOGW("  call log truncated at %zu entries", kCallLogCapacity);
+        for (int e = 0; e < GL_TRACE_ENTRY_COUNT; ++e) {
+            if (s.counts[e] != 0) ALOGI("  count %-26s %u", kEntryNames[e], s.counts[e]);
+        }
+        s.logging = false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(s.summaryMutex);
+        s.last = s.current;
+    }
+    const uint64_t nextFrame = s.current.frame + 1;
+    s.current = {};
+    s.current.frame = nextFrame;
+    for (uint32_t& c : s.counts) c = 0;
+    s.logSize = 0;
+    // A dump covers one whole frame, so logging starts at the boundary after the request.
+    if (s.dumpRequested.exchange(false)) s.logging = true;
+}
+
+void GlTrace_RequestDump() { State().dumpRequested = true; }
+
+GlTraceFrameStats GlTrace_LastFrame() {
+    TraceState& s = State();
+    std::lock_guard<std::mutex> lock(s.summaryMutex);
+    return s.last;
+}
+
+#endif
@@ -0,0 +1,363 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <GLES3/gl32.h>
+
+// =============================================================================
+// GL Call Tracing
+// =============================================================================
+// Compile-time switchable layer over the GL entry points the renderer uses.
+// With IRIS_GL_TRACE=1 every traced call is counted per entry point, state
+// setters are checked against a shadow copy to find redundant sets, upload bytes
+// are summed and a per-frame call log can be dumped. With it off this header only
+// declares empty inline hooks, so traced builds and release builds share sources.
+//
+// Include this after any other GL header in a translation unit.
+
+#ifndef IRIS_GL_TRACE
+#define IRIS_GL_TRACE 0
+#endif
+
+struct GlTraceFrameStats {
+    uint64_t frame = 0;
+    uint32_t calls = 0;
+    uint32_t drawCalls = 0;
+    uint32_t stateSets = 0;
+    uint32_t redundantStateSets = 0;
+    uint64_t uploadBytes = 0;
+};
+
+#if IRIS_GL_TRACE
+
+#define GL_TRACE_ENTRY_POINTS(X) \
+    X(glActiveTexture) X(glAttachShader) X(glBeginQuery) X(glBindBuffer) X(glBindBufferBase) \
+    X(glBindFramebuffer) X(glBindTexture) X(glBindVertexArray) X(glBlitFramebuffer) \
+    X(glBufferData) X(glBufferSubData) X(glClear) X(glClearColor) X(glClearDepthf) \
+    X(glClientWaitSync) X(glColorMask) X(glCompileShader) X(glCreateProgram) X(glCreateShader) \
+    X(glDeleteBuffers) X(glDeleteFramebuffers) X(glDeleteProgram) X(glDeleteQueries) \
+    X(glDeleteRenderbuffers) X(glDeleteShader) X(glDeleteSync) X(glDeleteTextures) \
+    X(glDeleteVertexArrays) X(glDepthFunc) X(glDisable) X(glDispatchCompute) X(glDrawElements) \
+    X(glDrawElementsBaseVertex) X(glDrawElementsIndirect) X(glEnable) X(glEnableVertexAttribArray) \
+    X(glEndQuery) X(glFenceSync) X(glFinish) X(glFramebufferTexture2D) X(glGenBuffers) \
+    X(glGenFramebuffers) X(glGenQueries) X(glGenTextures) X(glGenVertexArrays) \
+    X(glGetQueryObjectuiv) X(glGetUniformLocation) X(glInvalidateFramebuffer) X(glLinkProgram) \
+    X(glMapBufferRange) X(glMemoryBarrier) X(glPixelStorei) X(glReadPixels) X(glShaderSource) \
+    X(glTexImage2D) X(glTexParameteri) X(glTexStorage2D) X(glTexSubImage2D) X(glUniform1f) \
+    X(glUniform1i) X(glUniform1ui) X(glUniform4fv) X(glUniformMatrix4fv) X(glUnmapBuffer) \
+    X(glUseProgram) X(glVertexAttribDivisor) X(glVertexAttribPointer) X(glViewport)
+
+enum GlTraceEntry : uint16_t {
+#define GL_TRACE_ENUM(name) GL_TRACE_##name,
+    GL_TRACE_ENTRY_POINTS(GL_TRACE_ENUM)
+#undef GL_TRACE_ENUM
+    GL_TRACE_ENTRY_COUNT
+};
+
+// Texture bindings are shadowed per unit for the first few units, plus one
+// slot for whichever unit is active while that is unknown (after an
+// invalidate, until the next glActiveTexture). Binds on higher units are
+// counted but never reported as redundant.
+constexpr uint16_t kGlTraceTextureUnits = 16;
+
+// The element buffer slot belongs to the bound vertex array and is forgotten
+// whenever a different one is bound.
+enum GlTraceState : uint16_t {
+    GL_STATE_PROGRAM, GL_STATE_VERTEX_ARRAY, GL_STATE_FRAMEBUFFER, GL_STATE_ARRAY_BUFFER,
+    GL_STATE_ELEMENT_BUFFER, GL_STATE_ACTIVE_TEXTURE, GL_STATE_VIEWPORT_XY,
+    GL_STATE_VIEWPORT_WH, GL_STATE_CLEAR_COLOR_RG, GL_STATE_CLEAR_COLOR_BA, GL_STATE_CLEAR_DEPTH,
+    GL_STATE_DEPTH_FUNC, GL_STATE_DEPTH_TEST, GL_STATE_BLEND, GL_STATE_CULL_FACE, GL_STATE_SCISSOR_TEST,
+    GL_STATE_STENCIL_TEST, GL_STATE_TEXTURE_2D,
+    GL_STATE_TEXTURE_2D_UNKNOWN_UNIT = GL_STATE_TEXTURE_2D + kGlTraceTextureUnits,
+    GL_STATE_COUNT
+};
+
+void GlTrace_Record(GlTraceEntry entry, uint64_t a = 0, uint64_t b = 0);
+// Returns true when the set was redundant.
+bool GlTrace_SetState(GlTraceState slot, uint64_t value);
+void GlTrace_ForgetState(GlTraceState slot);
+// The texture binding slot for the active unit; GL_STATE_COUNT when it is
+// beyond the shadowed ones.
+GlTraceState GlTrace_TextureSlot();
+void GlTrace_Upload(uint64_t bytes);
+void GlTrace_Draw();
+void GlTrace_Invalidate();   // after foreign code (e.g. the runtime) touched GL state
+size_t GlTrace_TexelBytes(GLenum format, GLenum type);
+
+inline uint64_t GlTrace_Pack(uint32_t hi, uint32_t lo) { return (static_cast<uint64_t>(hi) << 32) | lo; }
+inline uint32_t GlTrace_FloatBits(float f) { uint32_t u; __builtin_memcpy(&u, &f, sizeof(u)); return u; }
+
+inline GlTraceState GlTrace_CapSlot(GLenum cap) {
+    switch (cap) {
+        case GL_DEPTH_TEST: return GL_STATE_DEPTH_TEST;
+        case GL_BLEND: return GL_STATE_BLEND;
+        case GL_CULL_FACE: return GL_STATE_CULL_FACE;
+        case GL_SCISSOR_TEST: return GL_STATE_SCISSOR_TEST;
+        case GL_STENCIL_TEST: return GL_STATE_STENCIL_TEST;
+        default: return GL_STATE_COUNT;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Wrappers. Each records the call and forwards to the real entry point; the
+// redirecting macros are only defined after all of them.
+// -----------------------------------------------------------------------------
+inline void GlTrace_glActiveTexture(GLenum t) {
+    GlTrace_Record(GL_TRACE_glActiveTexture, t);
+    GlTrace_SetState(GL_STATE_ACTIVE_TEXTURE, t);
+    GlTrace_ForgetState(GL_STATE_TEXTURE_2D_UNKNOWN_UNIT);
+    glActiveTexture(t);
+}
+inline void GlTrace_glAttachShader(GLuint p, GLuint s) { GlTrace_Record(GL_TRACE_glAttachShader, p, s); glAttachShader(p, s); }
+inline void GlTrace_glBeginQuery(GLenum target, GLuint q) { GlTrace_Record(GL_TRACE_glBeginQuery, target, q); glBeginQuery(target, q); }
+inline void GlTrace_glBindBuffer(GLenum target, GLuint b) {
+    GlTrace_Record(GL_TRACE_glBindBuffer, target, b);
+    if (target == GL_ARRAY_BUFFER) GlTrace_SetState(GL_STATE_ARRAY_BUFFER, b);
+    else if (target == GL_ELEMENT_ARRAY_BUFFER) GlTrace_SetState(GL_STATE_ELEMENT_BUFFER, b);
+    glBindBuffer(target, b);
+}
+inline void GlTrace_glBindBufferBase(GLenum target, GLuint index, GLuint b) { GlTrace_Record(GL_TRACE_glBindBufferBase, GlTrace_Pack(target, index), b); glBindBufferBase(target, index, b); }
+inline void GlTrace_glBindFramebuffer(GLenum target, GLuint f) {
+    GlTrace_Record(GL_TRACE_glBindFramebuffer, target, f);
+    // Read- or draw-only binds shadow as a different value, so rebinding both afterwards is not redundant.
+    GlTrace_SetState(GL_STATE_FRAMEBUFFER, target == GL_FRAMEBUFFER ? f : GlTrace_Pack(target, f));
+    glBindFramebuffer(target, f);
+}
+inline void GlTrace_glBindTexture(GLenum target, GLuint t) {
+    GlTrace_Record(GL_TRACE_glBindTexture, target, t);
+    if (target == GL_TEXTURE_2D && GlTrace_TextureSlot() != GL_STATE_COUNT) GlTrace_SetState(GlTrace_TextureSlot(), t);
+    glBindTexture(target, t);
+}
+inline void GlTrace_glBindVertexArray(GLuint v) {
+    GlTrace_Record(GL_TRACE_glBindVertexArray, v);
+    if (!GlTrace_SetState(GL_STATE_VERTEX_ARRAY, v)) GlTrace_ForgetState(GL_STATE_ELEMENT_BUFFER);
+    glBindVertexArray(v);
+}
+inline void GlTrace_glBlitFramebuffer(GLint sx0, GLint sy0, GLint sx1, GLint sy1, GLint dx0, GLint dy0, GLint dx1, GLint dy1, GLbitfield mask, GLenum filter) {
+    GlTrace_Record(GL_TRACE_glBlitFramebuffer, GlTrace_Pack(dx1 - dx0, dy1 - dy0), mask);
+    glBlitFramebuffer(sx0, sy0, sx1, sy1, dx0, dy0, dx1, dy1, mask, filter);
+}
+inline void GlTrace_glBufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage) {
+    GlTrace_Record(GL_TRACE_glBufferData, target, static_cast<uint64_t>(size));
+    if (data != nullptr) GlTrace_Upload(static_cast<uint64_t>(size));
+    glBufferData(target, size, data, usage);
+}
+inline void GlTrace_glBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data) {
+    GlTrace_Record(GL_TRACE_glBufferSubData, target, static_cast<uint64_t>(size));
+    GlTrace_Upload(static_cast<uint64_t>(size));
+    glBufferSubData(target, offset, size, data);
+}
+inline void GlTrace_glClear(GLbitfield mask) { GlTrace_Record(GL_TRACE_glClear, mask); glClear(mask); }
+inline void GlTrace_glClearColor(GLfloat r, GLfloat g, GLfloat b, GLfloat a) {
+    GlTrace_Record(GL_TRACE_glClearColor);
+    GlTrace_SetState(GL_STATE_CLEAR_COLOR_RG, GlTrace_Pack(GlTrace_FloatBits(r), GlTrace_FloatBits(g)));
+    GlTrace_SetState(GL_STATE_CLEAR_COLOR_BA, GlTrace_Pack(GlTrace_FloatBits(b), GlTrace_FloatBits(a)));
+    glClearColor(r, g, b, a);
+}
+inline void GlTrace_glClearDepthf(GLfloat d) { GlTrace_Record(GL_TRACE_glClearDepthf); GlTrace_SetState(GL_STATE_CLEAR_DEPTH, GlTrace_FloatBits(d)); glClearDepthf(d); }
+inline GLenum GlTrace_glClientWaitSync(GLsync sync, GLbitfield flags, GLuint64 timeout) { GlTrace_Record(GL_TRACE_glClientWaitSync, flags, timeout); return glClientWaitSync(sync, flags, timeout); }
+inline void GlTrace_glColorMask(GLboolean r, GLboolean g, GLboolean b, GLboolean a) {
+    GlTrace_Record(GL_TRACE_glColorMask, (r << 3) | (g << 2) | (b << 1) | a);
+    glColorMask(r, g, b, a);
+}
+inline void GlTrace_glCompileShader(GLuint s) { GlTrace_Record(GL_TRACE_glCompileShader, s); glCompileShader(s); }
+inline GLuint GlTrace_glCreateProgram() { GlTrace_Record(GL_TRACE_glCreateProgram); return glCreateProgram(); }
+inline GLuint GlTrace_glCreateShader(GLenum type) { GlTrace_Record(GL_TRACE_glCreateShader, type); return glCreateShader(type); }
+inline void GlTrace_glDeleteBuffers(GLsizei n, const GLuint* b) { GlTrace_Record(GL_TRACE_glDeleteBuffers, n); glDeleteBuffers(n, b); }
+inline void GlTrace_glDeleteFramebuffers(GLsizei n, const GLuint* f) { GlTrace_Record(GL_TRACE_glDeleteFramebuffers, n); glDeleteFramebuffers(n, f); }
+inline void GlTrace_glDeleteProgram(GLuint p) { GlTrace_Record(GL_TRACE_glDeleteProgram, p); glDeleteProgram(p); }
+inline void GlTrace_glDeleteQueries(GLsizei n, const GLuint* q) { GlTrace_Record(GL_TRACE_glDeleteQueries, n); glDeleteQueries(n, q); }
+inline void GlTrace_glDeleteRenderbuffers(GLsizei n, const GLuint* r) { GlTrace_Record(GL_TRACE_glDeleteRenderbuffers, n); glDeleteRenderbuffers(n, r); }
+inline void GlTrace_glDeleteShader(GLuint s) { GlTrace_Record(GL_TRACE_glDeleteShader, s); glDeleteShader(s); }
+inline void GlTrace_glDeleteSync(GLsync sync) { GlTrace_Record(GL_TRACE_glDeleteSync); glDeleteSync(sync); }
+inline void GlTrace_glDeleteTextures(GLsizei n, const GLuint* t) { GlTrace_Record(GL_TRACE_glDeleteTextures, n); glDeleteTextures(n, t); }
+inline void GlTrace_glDeleteVertexArrays(GLsizei n, const GLuint* v) { GlTrace_Record(GL_TRACE_glDeleteVertexArrays, n); glDeleteVertexArrays(n, v); }
+inline void GlTrace_glDepthFunc(GLenum f) { GlTrace_Record(GL_TRACE_glDepthFunc, f); GlTrace_SetState(GL_STATE_DEPTH_FUNC, f); glDepthFunc(f); }
+inline void GlTrace_glDisable(GLenum cap) {
+    GlTrace_Record(GL_TRACE_glDisable, cap);
+    if (GlTrace_CapSlot(cap) != GL_STATE_COUNT) GlTrace_SetState(GlTrace_CapSlot(cap), 0);
+    glDisable(cap);
+}
+inline void GlTrace_glDrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices) {
+    GlTrace_Record(GL_TRACE_glDrawElements, mode, static_cast<uint64_t>(count));
+    GlTrace_Draw();
+    glDrawElements(mode, count, type, indices);
+}
+inline void GlTrace_glDrawElementsBaseVertex(GLenum mode, GLsizei count, GLenum type, const void* indices, GLint baseVertex) {
+    GlTrace_Record(GL_TRACE_glDrawElementsBaseVertex, mode, static_cast<uint64_t>(count));
+    GlTrace_Draw();
+    glDrawElementsBaseVertex(mode, count, type, indices, baseVertex);
+}
+inline void GlTrace_glDispatchCompute(GLuint x, GLuint y, GLuint z) { GlTrace_Record(GL_TRACE_glDispatchCompute, x, GlTrace_Pack(y, z)); glDispatchCompute(x, y, z); }
+inline void GlTrace_glDrawElementsIndirect(GLenum mode, GLenum type, const void* indirect) {
+    GlTrace_Record(GL_TRACE_glDrawElementsIndirect, mode, reinterpret_cast<uintptr_t>(indirect));
+    GlTrace_Draw();
+    glDrawElementsIndirect(mode, type, indirect);
+}
+inline void GlTrace_glEnable(GLenum cap) {
+    GlTrace_Record(GL_TRACE_glEnable, cap);
+    if (GlTrace_CapSlot(cap) != GL_STATE_COUNT) GlTrace_SetState(GlTrace_CapSlot(cap), 1);
+    glEnable(cap);
+}
+inline void GlTrace_glEnableVertexAttribArray(GLuint i) { GlTrace_Record(GL_TRACE_glEnableVertexAttribArray, i); glEnableVertexAttribArray(i); }
+inline void GlTrace_glEndQuery(GLenum target) { GlTrace_Record(GL_TRACE_glEndQuery, target); glEndQuery(target); }
+inline GLsync GlTrace_glFenceSync(GLenum condition, GLbitfield flags) { GlTrace_Record(GL_TRACE_glFenceSync, condition); return glFenceSync(condition, flags); }
+inline void GlTrace_glFinish() { GlTrace_Record(GL_TRACE_glFinish); glFinish(); }
+inline void GlTrace_glFramebufferTexture2D(GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level) {
+    GlTrace_Record(GL_TRACE_glFramebufferTexture2D, attachment, texture);
+    glFramebufferTexture2D(target, attachment, textarget, texture, level);
+}
+inline void GlTrace_glGenBuffers(GLsizei n, GLuint* b) { GlTrace_Record(GL_TRACE_glGenBuffers, n); glGenBuffers(n, b); }
+inline void GlTrace_glGenFramebuffers(GLsizei n, GLuint* f) { GlTrace_Record(GL_TRACE_glGenFramebuffers, n); glGenFramebuffers(n, f); }
+inline void GlTrace_glGenQueries(GLsizei n, GLuint* q) { GlTrace_Record(GL_TRACE_glGenQueries, n); glGenQueries(n, q); }
+inline void GlTrace_glGenTextures(GLsizei n, GLuint* t) { GlTrace_Record(GL_TRACE_glGenTextures, n); glGenTextures(n, t); }
+inline void GlTrace_glGenVertexArrays(GLsizei n, GLuint* v) { GlTrace_Record(GL_TRACE_glGenVertexArrays, n); glGenVertexArrays(n, v); }
+inline void GlTrace_glGetQueryObjectuiv(GLuint q, GLenum pname, GLuint* v) { GlTrace_Record(GL_TRACE_glGetQueryObjectuiv, q, pname); glGetQueryObjectuiv(q, pname, v); }
+inline GLint GlTrace_glGetUniformLocation(GLuint p, const GLchar* name) { GlTrace_Record(GL_TRACE_glGetUniformLocation, p); return glGetUniformLocation(p, name); }
+inline void GlTrace_glInvalidateFramebuffer(GLenum target, GLsizei n, const GLenum* attachments) {
+    GlTrace_Record(GL_TRACE_glInvalidateFramebuffer, target, static_cast<uint64_t>(n));
+    glInvalidateFramebuffer(target, n, attachments);
+}
+inline void GlTrace_glLinkProgram(GLuint p) { GlTrace_Record(GL_TRACE_glLinkProgram, p); glLinkProgram(p); }
+inline void* GlTrace_glMapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access) {
+    GlTrace_Record(GL_TRACE_glMapBufferRange, target, static_cast<uint64_t>(length));
+    return glMapBufferRange(target, offset, length, access);
+}
+inline void GlTrace_glMemoryBarrier(GLbitfield barriers) { GlTrace_Record(GL_TRACE_glMemoryBarrier, barriers); glMemoryBarrier(barriers); }
+inline void GlTrace_glPixelStorei(GLenum pname, GLint v) { GlTrace_Record(GL_TRACE_glPixelStorei, pname, static_cast<uint32_t>(v)); glPixelStorei(pname, v); }
+inline void GlTrace_glReadPixels(GLint x, GLint y, GLsizei w, GLsizei h, GLenum format, GLenum type, void* pixels) {
+    GlTrace_Record(GL_TRACE_glReadPixels, GlTrace_Pack(w, h), reinterpret_cast<uintptr_t>(pixels));
+    glReadPixels(x, y, w, h, format, type, pixels);
+}
+inline void GlTrace_glShaderSource(GLuint s, GLsizei count, const GLchar* const* src, const GLint* len) { GlTrace_Record(GL_TRACE_glShaderSource, s); glShaderSource(s, count, src, len); }
+inline void GlTrace_glTexImage2D(GLenum target, GLint level, GLint internalformat, GLsizei w, GLsizei h, GLint border, GLenum format, GLenum type, const void* pixels) {
+    GlTrace_Record(GL_TRACE_glTexImage2D, GlTrace_Pack(w, h), internalformat);
+    if (pixels != nullptr) GlTrace_Upload(static_cast<uint64_t>(w) * h * GlTrace_TexelBytes(format, type));
+    glTexImage2D(target, level, internalformat, w, h, border, format, type, pixels);
+}
+inline void GlTrace_glTexParameteri(GLenum target, GLenum pname, GLint v) { GlTrace_Record(GL_TRACE_glTexParameteri, GlTrace_Pack(target, pname), static_cast<uint32_t>(v)); glTexParameteri(target, pname, v); }
+inline void GlTrace_glTexStorage2D(GLenum target, GLsizei levels, GLenum internalformat, GLsizei w, GLsizei h) {
+    GlTrace_Record(GL_TRACE_glTexStorage2D, GlTrace_Pack(w, h), internalformat);
+    glTexStorage2D(target, levels, internalformat, w, h);
+}
+inline void GlTrace_glTexSubImage2D(GLenum target, GLint level, GLint x, GLint y, GLsizei w, GLsizei h, GLenum format, GLenum type, const void* pixels) {
+    GlTrace_Record(GL_TRACE_glTexSubImage2D, GlTrace_Pack(w, h));
+    GlTrace_Upload(static_cast<uint64_t>(w) * h * GlTrace_TexelBytes(format, type));
+    glTexSubImage2D(target, level, x, y, w, h, format, type, pixels);
+}
+inline void GlTrace_glUniform1f(GLint loc, GLfloat v) { GlTrace_Record(GL_TRACE_glUniform1f, static_cast<uint64_t>(loc), GlTrace_FloatBits(v)); glUniform1f(loc, v); }
+inline void GlTrace_glUniform1i(GLint loc, GLint v) { GlTrace_Record(GL_TRACE_glUniform1i, static_cast<uint64_t>(loc), static_cast<uint32_t>(v)); glUniform1i(loc, v); }
+inline void GlTrace_glUniform1ui(GLint loc, GLuint v) { GlTrace_Record(GL_TRACE_glUniform1ui, static_cast<uint64_t>(loc), v); glUniform1ui(loc, v); }
+inline void GlTrace_glUniform4fv(GLint loc, GLsizei count, const GLfloat* v) {
+    GlTrace_Record(GL_TRACE_glUniform4fv, static_cast<uint64_t>(loc), count);
+    GlTrace_Upload(static_cast<uint64_t>(count) * 4 * sizeof(GLfloat));
+    glUniform4fv(loc, count, v);
+}
+inline void GlTrace_glUniformMatrix4fv(GLint loc, GLsizei count, GLboolean transpose, const GLfloat* v) {
+    GlTrace_Record(GL_TRACE_glUniformMatrix4fv, static_cast<uint64_t>(loc), count);
+    GlTrace_Upload(static_cast<uint64_t>(count) * 16 * sizeof(GLfloat));
+    glUniformMatrix4fv(loc, count, transpose, v);
+}
+inline GLboolean GlTrace_glUnmapBuffer(GLenum target) { GlTrace_Record(GL_TRACE_glUnmapBuffer, target); return glUnmapBuffer(target); }
+inline void GlTrace_glUseProgram(GLuint p) { GlTrace_Record(GL_TRACE_glUseProgram, p); GlTrace_SetState(GL_STATE_PROGRAM, p); glUseProgram(p); }
+inline void GlTrace_glVertexAttribPointer(GLuint i, GLint size, GLenum type, GLboolean norm, GLsizei stride, const void* ptr) {
+    GlTrace_Record(GL_TRACE_glVertexAttribPointer, i, static_cast<uint64_t>(stride));
+    glVertexAttribPointer(i, size, type, norm, stride, ptr);
+}
+inline void GlTrace_glVertexAttribDivisor(GLuint i, GLuint d) { GlTrace_Record(GL_TRACE_glVertexAttribDivisor, i, d); glVertexAttribDivisor(i, d); }
+inline void GlTrace_glViewport(GLint x, GLint y, GLsizei w, GLsizei h) {
+    GlTrace_Record(GL_TRACE_glViewport, GlTrace_Pack(x, y), GlTrace_Pack(w, h));
+    GlTrace_SetState(GL_STATE_VIEWPORT_XY, GlTrace_Pack(x, y));
+    GlTrace_SetState(GL_STATE_VIEWPORT_WH, GlTrace_Pack(w, h));
+    glViewport(x, y, w, h);
+}
+
+#define GL_TRACE_REDIRECT(name) GlTrace_##name
+#define glActiveTexture GL_TRACE_REDIRECT(glActiveTexture)
+#define glAttachShader GL_TRACE_REDIRECT(glAttachShader)
+#define glBeginQuery GL_TRACE_REDIRECT(glBeginQuery)
+#define glBindBuffer GL_TRACE_REDIRECT(glBindBuffer)
+#define glBindBufferBase GL_TRACE_REDIRECT(glBindBufferBase)
+#define glBindFramebuffer GL_TRACE_REDIRECT(glBindFramebuffer)
+#define glBindTexture GL_TRACE_REDIRECT(glBindTexture)
+#define glBindVertexArray GL_TRACE_REDIRECT(glBindVertexArray)
+#define glBlitFramebuffer GL_TRACE_REDIRECT(glBlitFramebuffer)
+#define glBufferData GL_TRACE_REDIRECT(glBufferData)
+#define glBufferSubData GL_TRACE_REDIRECT(glBufferSubData)
+#define glClear GL_TRACE_REDIRECT(glClear)
+#define glClearColor GL_TRACE_REDIRECT(glClearColor)
+#define glClearDepthf GL_TRACE_REDIRECT(glClearDepthf)
+#define glClientWaitSync GL_TRACE_REDIRECT(glClientWaitSync)
+#define glColorMask GL_TRACE_REDIRECT(glColorMask)
+#define glCompileShader GL_TRACE_REDIRECT(glCompileShader)
+#define glCreateProgram GL_TRACE_REDIRECT(glCreateProgram)
+#define glCreateShader GL_TRACE_REDIRECT(glCreateShader)
+#define glDeleteBuffers GL_TRACE_REDIRECT(glDeleteBuffers)
+#define glDeleteFramebuffers GL_TRACE_REDIRECT(glDeleteFramebuffers)
+#define glDeleteProgram GL_TRACE_REDIRECT(glDeleteProgram)
+#define glDeleteQueries GL_TRACE_REDIRECT(glDeleteQueries)
+#define glDeleteRenderbuffers GL_TRACE_REDIRECT(glDeleteRenderbuffers)
+#define glDeleteShader GL_TRACE_REDIRECT(glDeleteShader)
+#define glDeleteSync GL_TRACE_REDIRECT(glDeleteSync)
+#define glDeleteTextures GL_TRACE_REDIRECT(glDeleteTextures)
+#define glDeleteVertexArrays GL_TRACE_REDIRECT(glDeleteVertexArrays)
+#define glDepthFunc GL_TRACE_REDIRECT(glDepthFunc)
+#define glDisable GL_TRACE_REDIRECT(glDisable)
+#define glDispatchCompute GL_TRACE_REDIRECT(glDispatchCompute)
+#define glDrawElements GL_TRACE_REDIRECT(glDrawElements)
+#define glDrawElementsBaseVertex GL_TRACE_REDIRECT(glDrawElementsBaseVertex)
+#define glDrawElementsIndirect GL_TRACE_REDIRECT(glDrawElementsIndirect)
+#define glEnable GL_TRACE_REDIRECT(glEnable)
+#define glEnableVertexAttribArray GL_TRACE_REDIRECT(glEnableVertexAttribArray)
+#define glEndQuery GL_TRACE_REDIRECT(glEndQuery)
+#define glFenceSync GL_TRACE_REDIRECT(glFenceSync)
+#define glFinish GL_TRACE_REDIRECT(glFinish)
+#define glFramebufferTexture2D GL_TRACE_REDIRECT(glFramebufferTexture2D)
+#define glGenBuffers GL_TRACE_REDIRECT(glGenBuffers)
+#define glGenFramebuffers GL_TRACE_REDIRECT(glGenFramebuffers)
+#define glGenQueries GL_TRACE_REDIRECT(glGenQueries)
+#define glGenTextures GL_TRACE_REDIRECT(glGenTextures)
+#define glGenVertexArrays GL_TRACE_REDIRECT(glGenVertexArrays)
+#define glGetQueryObjectuiv GL_TRACE_REDIRECT(glGetQueryObjectuiv)
+#define glGetUniformLocation GL_TRACE_REDIRECT(glGetUniformLocation)
+#define glInvalidateFramebuffer GL_TRACE_REDIRECT(glInvalidateFramebuffer)
+#define glLinkProgram GL_TRACE_REDIRECT(glLinkProgram)
+#define glMapBufferRange GL_TRACE_REDIRECT(glMapBufferRange)
+#define glMemoryBarrier GL_TRACE_REDIRECT(glMemoryBarrier)
+#define glPixelStorei GL_TRACE_REDIRECT(glPixelStorei)
+#define glReadPixels GL_TRACE_REDIRECT(glReadPixels)
+#define glShaderSource GL_TRACE_REDIRECT(glShaderSource)
+#define glTexImage2D GL_TRACE_REDIRECT(glTexImage2D)
+#define glTexParameteri GL_TRACE_REDIRECT(glTexParameteri)
+#define glTexStorage2D GL_TRACE_REDIRECT(glTexStorage2D)
+#define glTexSubImage2D GL_TRACE_REDIRECT(glTexSubImage2D)
+#define glUniform1f GL_TRACE_REDIRECT(glUniform1f)
+#define glUniform1i GL_TRACE_REDIRECT(glUniform1i)
+#define glUniform1ui GL_TRACE_REDIRECT(glUniform1ui)
+#define glUniform4fv GL_TRACE_REDIRECT(glUniform4fv)
+#define glUniformMatrix4fv GL_TRACE_REDIRECT(glUniformMatrix4fv)
+#define glUnmapBuffer GL_TRACE_REDIRECT(glUnmapBuffer)
+#define glUseProgram GL_TRACE_REDIRECT(glUseProgram)
+#define glVertexAttribPointer GL_TRACE_REDIRECT(glVertexAttribPointer)
+#define glVertexAttribDivisor GL_TRACE_REDIRECT(glVertexAttribDivisor)
+#define glViewport GL_TRACE_REDIRECT(glViewport)
+
+// Frame boundary: rolls the current counters into the last-frame summary and
+// emits the call log if a dump was requested.
+void GlTrace_EndFrame();
+void GlTrace_RequestDump();
+GlTraceFrameStats GlTrace_LastFrame();
+// Non-GL event (e.g. a swapchain stall) placed in the call log between the GL
+// calls around it. `label` must outlive the frame; a string literal.
+void GlTrace_Marker(const char* label, uint64_t a = 0, uint64_t b = 0);
+
+#else
+
+inline void GlTrace_Invalidate() {}
+inline void GlTrace_Marker(const char*, uint64_t = 0, uint64_t = 0) {}
+inline void GlTrace_EndFrame() {}
+inline void GlTrace_RequestDump() {}
+inline GlTraceFrameStats GlTrace_LastFrame() { return {}; }
+
+#endif
@@ -0,0 +1,320 @@
+#include "gpu_resources.h"
+
+#include <algorithm>
+
+#include "common.h"
+#include "gl_trace.h"
+
+namespace {
+
+struct PendingDelete {
+    GpuResourceKind kind;
+    GLuint name;
+    uint64_t bytes;
+    uint64_t fence;   // serial of the fence guarding it, 0 until the next frame end
+};
+
+struct FrameFence {
+    uint64_t serial;
+    GLsync sync;
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<GpuResourceInfo> resources;
+    GpuMemoryReport report;
+    uint64_t frame = 0;
+    bool overBudget = false;   // since the last time the total fit
+    std::vector<PendingDelete> pending;
+    std::vector<FrameFence> fences;   // oldest first
+    uint64_t fenceSerial = 0;
+};
+
+Registry& GetRegistry() {
+    static Registry registry;
+    return registry;
+}
+
+// Picks cacheable victims (least recently used first) until the total fits the
+// budget again. Runs under the registry lock; callbacks are invoked after it is released.
+std::vector<GpuResourceInfo> CollectVictims(Registry& r) {
+    std::vector<GpuResourceInfo> victims;
+    if (r.report.budgetBytes == 0 || r.report.totalBytes <= r.report.budgetBytes) {
+        r.overBudget = false;
+        return victims;
+    }
+    // Checked every frame while over, so only going over counts (and logs).
+    const bool wentOver = !r.overBudget;
+    r.overBudget = true;
+    if (wentOver) r.report.overBudgetEvents++;
+
+    std::vector<const GpuResourceInfo*> candidates;
+    for (const auto& res : r.resources) {
+        if (res.cacheable && res.evict != nullptr) candidates.push_back(&res);
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const GpuResourceInfo* a, const GpuResourceInfo* b) {
+        return a->lastUsedFrame < b->lastUsedFrame;
+    });
+    uint64_t projected = r.report.totalBytes;
+    for (const GpuResourceInfo* c : candidates) {
+        if (projected <= r.report.budgetBytes) break;
+        // Never evict what this frame or the last one used: that is the working
+        // set, and evicting it would only have it uploaded again straight away.
+        if (c->lastUsedFrame + 1 >= r.frame) break;
+        victims.push_back(*c);
+        projected -= c->bytes;
+    }
+    if (projected > r.report.budgetBytes && wentOver) {
+        ALOGW("GPU budget exceeded: %.1f MB used, %.1f MB budget, nothing left to evict",
+              r.report.totalBytes / 1048576.0, r.report.budgetBytes / 1048576.0);
+    }
+    return victims;
+}
+
+void Evict(const std::vector<GpuResourceInfo>& victims) {
+    for (const auto& v : victims) {
+        ALOGI("GPU budget: evicting %s %u (%s, %.1f KB)", GpuResources_CategoryName(v.category), v.name, v.owner, v.bytes / 1024.0);
+        v.evict(v.kind, v.name, v.evictUser);
+        std::lock_guard<std::mutex> lock(GetRegistry().mutex);
+        GetRegistry().report.evictions++;
+    }
+}
+
+void Add(const GpuResourceInfo& info) {
+    Registry& r = GetRegistry();
+    std::vector<GpuResourceInfo> victims;
+    {
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.resources.push_back(info);
+        r.resources.back().lastUsedFrame = r.frame;
+        r.report.bytes[info.category] += info.bytes;
+        r.report.counts[info.category]++;
+        r.report.totalBytes += info.bytes;
+        r.report.peakBytes = std::max(r.report.peakBytes, r.report.totalBytes);
+        victims = CollectVictims(r);
+    }
+    Evict(victims);
+}
+
+// Drops a registered resource from the totals; returns its size, 0 if unknown.
+uint64_t RemoveLocked(Registry& r, GpuResourceKind kind, GLuint name) {
+    for (size_t i = 0; i < r.resources.size(); ++i) {
+        const GpuResourceInfo& res = r.resources[i];
+        if (res.kind != kind || res.name != name) continue;
+        const uint64_t bytes = res.bytes;
+        r.report.bytes[res.category] -= bytes;
+        r.report.counts[res.category]--;
+        r.report.totalBytes -= bytes;
+        r.resources[i] = r.resources.back();
+        r.resources.pop_back();
+        return bytes;
+    }
+    return 0;
+}
+
+void DeleteObject(GpuResourceKind kind, GLuint name) {
+    switch (kind) {
+        case GPU_KIND_TEXTURE: glDeleteTextures(1, &name); break;
+        case GPU_KIND_BUFFER: glDeleteBuffers(1, &name); break;
+        case GPU_KIND_RENDERBUFFER: glDeleteRenderbuffers(1, &name); break;
+        case GPU_KIND_FRAMEBUFFER: glDeleteFramebuffers(1, &name); break;
+        case GPU_KIND_VERTEX_ARRAY: glDeleteVertexArrays(1, &name); break;
+        case GPU_KIND_PROGRAM: glDeleteProgram(name); break;
+    }
+}
+
+// Deletes outside the registry lock and updates the queue counters.
+void DeleteRetired(const std::vector<PendingDelete>& retired) {
+    if (retired.empty()) return;
+    uint64_t bytes = 0;
+    for (const PendingDelete& d : retired) {
+        DeleteObject(d.kind, d.name);
+        bytes += d.bytes;
+    }
+    Registry& r = GetRegistry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.report.pendingDeletes -= static_cast<uint32_t>(retired.size());
+    r.report.pendingBytes -= bytes;
+    r.report.deferredDeletes += retired.size();
+}
+
+} // namespace
+
+void GpuResources_Register(GpuResourceKind kind, GLuint name, GpuResourceCategory category, GLenum format,
+                           uint64_t bytes, const char* owner) {
+    Add({kind, name, category, format, bytes, owner, false, nullptr, nullptr, 0});
+}
+
+void GpuResources_RegisterCacheable(GpuResourceKind kind, GLuint name, GpuResourceCategory category, GLenum format,
+                                    uint64_t bytes, const char* owner, GpuEvictCallback evict, void* user) {
+    Add({kind, name, category, format, bytes, owner, true, evict, user, 0});
+}
+
+void GpuResources_Unregister(GpuResourceKind kind, GLuint name) {
+    Registry& r = GetRegistry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    RemoveLocked(r, kind, name);
+}
+
+void GpuResources_Touch(GpuResourceKind kind, GLuint name) {
+    Registry& r = GetRegistry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (auto& res : r.resources) {
+        if (res.kind == kind && res.name == name) { res.lastUsedFrame = r.frame; return; }
+    }
+}
+
+void GpuResources_SetFrame(uint64_t frame) {
+    Registry& r = GetRegistry();
+    std::vector<GpuResourceInfo> victims;
+    {
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.frame = frame;
+        victims = CollectVictims(r);
+    }
+    Evict(victims);
+}
+
+// =============================================================================
+// Deferred deletion
+// =============================================================================
+void GpuResources_DeferDelete(GpuResourceKind kind, GLuint name) {
+    if (name == 0) return;
+    Registry& r = GetRegistry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    const uint64_t bytes = RemoveLocked(r, kind, name);
+    r.pending.push_back({kind, name, bytes, 0});
+    r.report.pendingDeletes++;
+    r.report.pendingBytes += bytes;
+    r.report.peakPendingDeletes = std::max(r.report.peakPendingDeletes, r.report.pendingDeletes);
+}
+
+void GpuResources_EndFrame() {
+    Registry& r = GetRegistry();
+    std::vector<PendingDelete> retired;
+    {
+        std::lock_guard<std::mutex> lock(r.mutex);
+        // One fence covers everything queued since the last one; idle frames add none.
+        bool unfenced = false;
+        for (const PendingDelete& d : r.pending) unfenced |= d.fence == 0;
+        if (unfenced) {
+            GLsync sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            if (sync != nullptr) {
+                r.fences.push_back({++r.fenceSerial, sync});
+                for (PendingDelete& d : r.pending) {
+                    if (d.fence == 0) d.fence = r.fenceSerial;
+                }
+            }
+        }
+
+        // Fences signal in submission order, so polling stops at the first busy one.
+        uint64_t completed = 0;
+        size_t signaled = 0;
+        for (; signaled < r.fences.size(); ++signaled) {
+            const GLenum status = glClientWaitSync(r.fences[signaled].sync, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+            if (status == GL_TIMEOUT_EXPIRED) break;
+            if (status == GL_WAIT_FAILED) ALOGW("Deferred deletion fence %llu failed, treating it as signaled", (unsigned long long)r.fences[signaled].serial);
+            completed = r.fences[signaled].serial;
+            glDeleteSync(r.fences[signaled].sync);
+        }
+        r.fences.erase(r.fences.begin(), r.fences.begin() + signaled);
+        r.report.fencesInFlight = static_cast<uint32_t>(r.fences.size());
+
+        if (completed != 0) {
+            auto firstKept = std::stable_partition(r.pending.begin(), r.pending.end(), [completed](const PendingDelete& d) {
+                return d.fence != 0 && d.fence <= completed;
+            });
+            retired.assign(r.pending.begin(), firstKept);
+            r.pending.erase(r.pending.begin(), firstKept);
+        }
+    }
+    DeleteRetired(retired);
+}
+
+void GpuResources_FlushDeletes() {
+    Registry& r = GetRegistry();
+    std::vector<PendingDelete> retired;
+    {
+        std::lock_guard<std::mutex> lock(r.mutex);
+        if (r.pending.empty() && r.fences.empty()) return;
+        glFinish();
+        for (const FrameFence& f : r.fences) glDeleteSync(f.sync);
+        r.fences.clear();
+        r.report.fencesInFlight = 0;
+        retired.swap(r.pending);
+    }
+    DeleteRetired(retired);
+}
+
+void GpuResources_SetBudget(uint64_t bytes) {
+    Registry& r = GetRegistry();
+    {
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.report.budgetBytes = bytes;
+        r.overBudget = false;
+    }
+    ALOGI("GPU budget set to %.1f MB", bytes / 1048576.0);
+}
+
+GpuMemoryReport GpuResources_Report() {
+    std::lock_guard<std::mutex> lock(GetRegistry().mutex);
+    return GetRegistry().report;
+}
+
+void GpuResources_LogReport() {
+    const GpuMemoryReport report = GpuResources_Report();
+    ALOGI("GPU memory: %.2f MB total (peak %.2f MB, budget %s)", report.totalBytes / 1048576.0, report.peakBytes / 1048576.0,
+          report.budgetBytes ? "set" : "none");
+    for (int c = 0; c < GPU_CATEGORY_COUNT; ++c) {
+        if (report.counts[c] == 0) continue;
+        ALOGI("  %-14s %4u objects %9.2f MB", GpuResources_CategoryName(static_cast<GpuResourceCategory>(c)),
+              report.counts[c], report.bytes[c] / 1048576.0);
+    }
+    if (report.deferredDeletes != 0 || report.pendingDeletes != 0) {
+        ALOGI("  deferred deletes: %u pending (%.2f MB, %u fences), %llu done, peak queue %u", report.pendingDeletes,
+              report.pendingBytes / 1048576.0, report.fencesInFlight, (unsigned long long)report.deferredDeletes,
+              report.peakPendingDeletes);
+    }
+}
+
+size_t GpuResources_ReportLeaks() {
+    Registry& r = GetRegistry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (const auto& res : r.resources) {
+        ALOGE("GPU leak: %s %u from %s, %.1f KB (format 0x%x)", GpuResources_CategoryName(res.category), res.name, res.owner,
+              res.bytes / 1024.0, res.format);
+    }
+    if (r.resources.empty()) ALOGI("GPU resources: no leaks.");
+    return r.resources.size();
+}
+
+const char* GpuResources_CategoryName(GpuResourceCategory category) {
+    switch (category) {
+        case GPU_CATEGORY_SWAPCHAIN: return "swapchain";
+        case GPU_CATEGORY_DEPTH: return "depth";
+        case GPU_CATEGORY_VERTEX_BUFFER: return "vertex-buffer";
+        case GPU_CATEGORY_INDEX_BUFFER: return "index-buffer";
+        case GPU_CATEGORY_TEXTURE: return "texture";
+        case GPU_CATEGORY_RENDER_TARGET: return "render-target";
+        default: return "other";
+    }
+}
+
+uint64_t GpuResources_ImageBytes(GLenum internalFormat, int32_t width, int32_t height, int32_t levels, int32_t samples) {
+    uint64_t texel;
+    switch (internalFormat) {
+        case GL_R8: case GL_ALPHA: case GL_LUMINANCE: case GL_STENCIL_INDEX8: texel = 1; break;
+        case GL_RG8: case GL_R16F: case GL_RGB565: case GL_RGBA4: case GL_RGB5_A1: case GL_DEPTH_COMPONENT16: texel = 2; break;
+        case GL_RGB8: case GL_SRGB8: texel = 3; break;
+        case GL_RGBA16F: case GL_RG32F: texel = 8; break;
+        case GL_RGBA32F: texel = 16; break;
+        // 24-bit depth is stored padded to 32 bits on the GPUs we target.
+        default: texel = 4; break;   // RGBA8, SRGB8_ALPHA8, R32F, RG16F, DEPTH24, DEPTH24_STENCIL8, DEPTH32F, ...
+    }
+    uint64_t total = 0;
+    for (int32_t level = 0; level < std::max(levels, 1); ++level) {
+        const uint64_t w = std::max(width >> level, 1), h = std::max(height >> level, 1);
+        total += w * h * texel;
+    }
+    return total * static_cast<uint64_t>(std::max(samples, 1));
+}
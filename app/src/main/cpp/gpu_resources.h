@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include <GLES3/gl32.h>
+
+// =============================================================================
+// GPU Resource Registry
+// =============================================================================
+// Every GPU allocation the app makes (or that the runtime makes on its behalf,
+// like swapchain images) is registered here with its size, format and an owner
+// tag. The registry keeps per-category totals for reporting, enforces an
+// optional budget by evicting resources marked cacheable (least recently used
+// first) through their owner's callback, and lists whatever is still registered
+// at shutdown as a leak. Resources used in the current or the previous frame
+// are never evicted, so the budget only ever takes back what is idle.
+//
+// Objects released while frames may still be in flight go through a deferred
+// deletion queue: each frame ends with a fence, and a queued object is deleted
+// only once the fence of the frame it was released in has signaled.
+
+enum GpuResourceCategory : uint8_t {
+    GPU_CATEGORY_SWAPCHAIN = 0,
+    GPU_CATEGORY_DEPTH,
+    GPU_CATEGORY_VERTEX_BUFFER,
+    GPU_CATEGORY_INDEX_BUFFER,
+    GPU_CATEGORY_TEXTURE,
+    GPU_CATEGORY_RENDER_TARGET,
+    GPU_CATEGORY_OTHER,
+    GPU_CATEGORY_COUNT
+};
+
+enum GpuResourceKind : uint8_t {
+    GPU_KIND_TEXTURE,
+    GPU_KIND_BUFFER,
+    GPU_KIND_RENDERBUFFER,
+    GPU_KIND_FRAMEBUFFER,     // the kinds below are only ever queued for deletion, not registered
+    GPU_KIND_VERTEX_ARRAY,
+    GPU_KIND_PROGRAM,
+};
+
+// Called on the GL thread when the budget needs the resource back. The owner must
+// release it, normally with GpuResources_DeferDelete.
+typedef void (*GpuEvictCallback)(GpuResourceKind kind, GLuint name, void* user);
+
+struct GpuResourceInfo {
+    GpuResourceKind kind;
+    GLuint name;
+    GpuResourceCategory category;
+    GLenum format;
+    uint64_t bytes;
+    const char* owner;          // static string
+    bool cacheable;
+    GpuEvictCallback evict;
+    void* evictUser;
+    uint64_t lastUsedFrame;
+};
+
+struct GpuMemoryReport {
+    uint64_t bytes[GPU_CATEGORY_COUNT] = {};
+    uint32_t counts[GPU_CATEGORY_COUNT] = {};
+    uint64_t totalBytes = 0;
+    uint64_t peakBytes = 0;
+    uint64_t budgetBytes = 0;   // 0: unlimited
+    uint64_t evictions = 0;
+    uint64_t overBudgetEvents = 0;
+    // Deferred deletion queue. Pending bytes are no longer in totalBytes.
+    uint32_t pendingDeletes = 0;
+    uint64_t pendingBytes = 0;
+    uint32_t peakPendingDeletes = 0;
+    uint64_t deferredDeletes = 0;   // lifetime objects deleted through the queue
+    uint32_t fencesInFlight = 0;
+};
+
+void GpuResources_Register(GpuResourceKind kind, GLuint name, GpuResourceCategory category, GLenum format,
+                           uint64_t bytes, const char* owner);
+void GpuResources_RegisterCacheable(GpuResourceKind kind, GLuint name, GpuResourceCategory category, GLenum format,
+                                    uint64_t bytes, const char* owner, GpuEvictCallback evict, void* user);
+void GpuResources_Unregister(GpuResourceKind kind, GLuint name);
+// Marks a cacheable resource as used this frame so it is evicted last.
+void GpuResources_Touch(GpuResourceKind kind, GLuint name);
+// GL thread, at the start of each frame, rendered or not: evicts while over budget.
+void GpuResources_SetFrame(uint64_t frame);
+
+// Unregisters the object (if registered) and queues its deletion behind the
+// current frame's fence. Any thread; names of 0 are ignored.
+void GpuResources_DeferDelete(GpuResourceKind kind, GLuint name);
+// GL thread, after the frame's GL work is submitted: fences the frame and
+// deletes everything whose fence has signaled. Never waits.
+void GpuResources_EndFrame();
+// Waits for the GPU and deletes the whole queue; before the context goes away.
+void GpuResources_FlushDeletes();
+
+// Any thread; evictions it calls for happen at the next GpuResources_SetFrame.
+void GpuResources_SetBudget(uint64_t bytes);
+GpuMemoryReport GpuResources_Report();
+void GpuResources_LogReport();
+// Logs every resource still registered; returns how many there were.
+size_t GpuResources_ReportLeaks();
+
+const char* GpuResources_CategoryName(GpuResourceCategory category);
+// Bytes for a 2D image of the given sized internal format (all mip levels, all samples).
+uint64_t GpuResources_ImageBytes(GLenum internalFormat, int32_t width, int32_t height, int32_t levels = 1, int32_t samples = 1);
@@ -0,0 +1,11 @@
+#pragma once
+
+// =============================================================================
+// Head Pose
+// =============================================================================
+// The wearer's head in stage space, as the frame loop hands it to the audio
+// mixer and the vision pipeline.
+struct HeadPose {
+    float position[3];
+    float orientation[4];   // x, y, z, w
+};
@@ -0,0 +1,674 @@
+#include "image_capture.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include <zlib.h>
+
+#if defined(__ANDROID__)
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <media/NdkMediaCodec.h>
+#include <media/NdkMediaFormat.h>
+#include <media/NdkMediaMuxer.h>
+#endif
+
+#include "common.h"
+#include "gl_trace.h"
+#include "gpu_resources.h"
+#include "thread_roles.h"
+
+namespace {
+
+int64_t ThreadCpuNs() {
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+void PutBigEndian32(uint8_t* out, uint32_t value) {
+    out[0] = static_cast<uint8_t>(value >> 24);
+    out[1] = static_cast<uint8_t>(value >> 16);
+    out[2] = static_cast<uint8_t>(value >> 8);
+    out[3] = static_cast<uint8_t>(value);
+}
+
+void AppendPngChunk(TrackedVector<uint8_t, MEM_TAG_CAPTURE>& png, const char* type, const uint8_t* data,
+                    uint32_t length) {
+    const size_t start = png.size();
+    png.resize(start + 12 + length);
+    uint8_t* out = png.data() + start;
+    PutBigEndian32(out, length);
+    memcpy(out + 4, type, 4);
+    if (length > 0) memcpy(out + 8, data, length);
+    PutBigEndian32(out + 8 + length, static_cast<uint32_t>(crc32(0, out + 4, 4 + length)));
+}
+
+// =============================================================================
+// YUV4MPEG2 Writer
+// =============================================================================
+// Uncompressed, so the encoder-thread cost it reports is only the colour
+// conversion and the write; it is there to exercise the pipeline, not to
+// predict MediaCodec's numbers.
+class Y4mEncoder : public VideoEncoder {
+public:
+    ~Y4mEncoder() override { Close(); }
+
+    bool Open(const std::string& path, int32_t width, int32_t height, int32_t fps) override {
+        file_ = fopen(path.c_str(), "wb");
+        if (file_ == nullptr) return false;
+        width_ = width;
+        height_ = height;
+        frame_.resize(static_cast<size_t>(width) * height * 3 / 2);
+        const int length = fprintf(file_, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg XCOLORRANGE=LIMITED\n", width,
+                                   height, fps);
+        bytes_ = length > 0 ? static_cast<uint64_t>(length) : 0;
+        return length > 0;
+    }
+
+    bool Encode(const uint8_t* rgba, int64_t) override {
+        if (file_ == nullptr) return false;
+        const size_t lumaSize = static_cast<size_t>(width_) * height_;
+        uint8_t* y = frame_.data();
+        ConvertRgbaToYuv420(rgba, width_, height_, y, y + lumaSize, y + lumaSize + lumaSize / 4, 1);
+        if (fwrite("FRAME\n", 1, 6, file_) != 6 || fwrite(frame_.data(), 1, frame_.size(), file_) != frame_.size()) {
+            return false;
+        }
+        bytes_ += 6 + frame_.size();
+        return true;
+    }
+
+    void Close() override {
+        if (file_ == nullptr) return;
+        fclose(file_);
+        file_ = nullptr;
+    }
+
+    uint64_t BytesWritten() const override { return bytes_; }
+    const char* Name() const override { return "y4m"; }
+
+private:
+    FILE* file_ = nullptr;
+    int32_t width_ = 0;
+    int32_t height_ = 0;
+    TrackedVector<uint8_t, MEM_TAG_CAPTURE> frame_;
+    uint64_t bytes_ = 0;
+};
+
+#if defined(__ANDROID__)
+// =============================================================================
+// MediaCodec Encoder
+// =============================================================================
+// H.264 from the hardware encoder, muxed into MP4. Input is NV12 written
+// straight into the codec's buffers; output is drained after every frame
+// without waiting, so a frame costs one conversion plus whatever the codec
+// has finished by then.
+class MediaCodecEncoder : public VideoEncoder {
+public:
+    ~MediaCodecEncoder() override { Close(); }
+
+    bool Open(const std::string& path, int32_t width, int32_t height, int32_t fps) override {
+        fd_ = open(path.c_str(), O_CREAT | O_TRUNC | O_RDWR, 0644);
+        if (fd_ < 0) return false;
+        muxer_ = AMediaMuxer_new(fd_, AMEDIAMUXER_OUTPUT_FORMAT_MPEG_4);
+        codec_ = AMediaCodec_createEncoderByType("video/avc");
+        if (muxer_ == nullptr || codec_ == nullptr) {
+            Close();
+            return false;
+        }
+        AMediaFormat* format = AMediaFormat_new();
+        AMediaFormat_setString(format, AMEDIAFORMAT_KEY_MIME, "video/avc");
+        AMediaFormat_setInt32(format, AMEDIAFORMAT_KEY_WIDTH, width);
+        AMediaFormat_setInt32(format, AMEDIAFORMAT_KEY_HEIGHT, height);
+        AMediaFormat_setInt32(format, AMEDIAFORMAT_KEY_COLOR_FORMAT, kColorFormatYuv420SemiPlanar);
+        AMediaFormat_setInt32(format, AMEDIAFORMAT_KEY_FRAME_RATE, fps);
+        AMediaFormat_setInt32(format, AMEDIAFORMAT_KEY_I_FRAME_INTERVAL, 1);
+        // About 0.1 bit per pixel, which keeps text on the panels legible.
+        const int64_t bitRate = std::min<int64_t>(static_cast<int64_t>(width) * height * fps / 10, 40000000);
+        AMediaFormat_setInt32(format, AMEDIAFORMAT_KEY_BIT_RATE, static_cast<int32_t>(bitRate));
+        media_status_t status = AMediaCodec_configure(codec_, format, nullptr, nullptr, AMEDIACODEC_CONFIGURE_FLAG_ENCODE);
+        AMediaFormat_delete(format);
+        if (status != AMEDIA_OK || AMediaCodec_start(codec_) != AMEDIA_OK) {
+            ALOGE("MediaCodec H.264 encoder rejected %dx%d at %d fps (%d)", width, height, fps, status);
+            AMediaCodec_delete(codec_);
+            codec_ = nullptr;
+            Close();
+            return false;
+        }
+        started_ = true;
+        width_ = width;
+        height_ = height;
+        stride_ = width;
+        sliceHeight_ = height;
+        AMediaFormat* input = AMediaCodec_getInputFormat(codec_);
+        if (input != nullptr) {
+            int32_t value = 0;
+            if (AMediaFormat_getInt32(input, "stride", &value) && value >= width) stride_ = value;
+            if (AMediaFormat_getInt32(input, "slice-height", &value) && value >= height) sliceHeight_ = value;
+            AMediaFormat_delete(input);
+        }
+        frame_.resize(static_cast<size_t>(width) * height * 3 / 2);
+        return true;
+    }
+
+    bool Encode(const uint8_t* rgba, int64_t ptsNs) override {
+        if (!started_) return false;
+        const ssize_t index = AMediaCodec_dequeueInputBuffer(codec_, 0);
+        if (index < 0) {
+            Drain(false);
+            return false;
+        }
+        size_t capacity = 0;
+        uint8_t* input = AMediaCodec_getInputBuffer(codec_, static_cast<size_t>(index), &capacity);
+        const size_t lumaSize = static_cast<size_t>(width_) * height_;
+        const size_t needed = static_cast<size_t>(stride_) * sliceHeight_ + static_cast<size_t>(stride_) * height_ / 2;
+        if (input == nullptr || capacity < needed) {
+            AMediaCodec_queueInputBuffer(codec_, static_cast<size_t>(index), 0, 0, ptsNs / 1000, 0);
+            return false;
+        }
+        uint8_t* y = frame_.data();
+        ConvertRgbaToYuv420(rgba, width_, height_, y, y + lumaSize, y + lumaSize + 1, 2);
+        // Copied row by row because the codec may pad its planes.
+        for (int32_t row = 0; row < height_; row++) {
+            memcpy(input + static_cast<size_t>(row) * stride_, y + static_cast<size_t>(row) * width_, width_);
+        }
+        uint8_t* chroma = input + static_cast<size_t>(stride_) * sliceHeight_;
+        for (int32_t row = 0; row < height_ / 2; row++) {
+            memcpy(chroma + static_cast<size_t>(row) * stride_, y + lumaSize + static_cast<size_t>(row) * width_,
+                   width_);
+        }
+        AMediaCodec_queueInputBuffer(codec_, static_cast<size_t>(index), 0, needed, ptsNs / 1000, 0);
+        Drain(false);
+        return true;
+    }
+
+    void Close() override {
+        if (started_) {
+            const ssize_t index = AMediaCodec_dequeueInputBuffer(codec_, 100000);
+            if (index >= 0) {
+                AMediaCodec_queueInputBuffer(codec_, static_cast<size_t>(index), 0, 0, 0,
+                                             AMEDIACODEC_BUFFER_FLAG_END_OF_STREAM);
+                Drain(true);
+            }
+            AMediaCodec_stop(codec_);
+            started_ = false;
+        }
+        if (codec_ != nullptr) AMediaCodec_delete(codec_);
+        codec_ = nullptr;
+        if (muxer_ != nullptr) {
+            if (track_ >= 0) AMediaMuxer_stop(muxer_);
+            AMediaMuxer_delete(muxer_);
+        }
+        muxer_ = nullptr;
+        track_ = -1;
+        if (fd_ >= 0) {
+            struct stat st;
+            if (fstat(fd_, &st) == 0) bytes_ = static_cast<uint64_t>(st.st_size);
+            close(fd_);
+        }
+        fd_ = -1;
+    }
+
+    uint64_t BytesWritten() const override { return bytes_; }
+    const char* Name() const override { return "mediacodec h264"; }
+
+private:
+    static constexpr int32_t kColorFormatYuv420SemiPlanar = 21;   // MediaCodecInfo.CodecCapabilities
+
+    // Writes out whatever the codec has produced; until end of stream when `final`.
+    void Drain(bool final) {
+        for (;;) {
+            AMediaCodecBufferInfo info;
+            const ssize_t index = AMediaCodec_dequeueOutputBuffer(codec_, &info, final ? 100000 : 0);
+            if (index == AMEDIACODEC_INFO_OUTPUT_FORMAT_CHANGED) {
+                AMediaFormat* format = AMediaCodec_getOutputFormat(codec_);
+                track_ = static_cast<int32_t>(AMediaMuxer_addTrack(muxer_, format));
+                AMediaFormat_delete(format);
+                AMediaMuxer_start(muxer_);
+                continue;
+            }
+            if (index == AMEDIACODEC_INFO_OUTPUT_BUFFERS_CHANGED) continue;
+            if (index < 0) return;   // nothing ready (or, when final, the codec stopped answering)
+            size_t capacity = 0;
+            uint8_t* output = AMediaCodec_getOutputBuffer(codec_, static_cast<size_t>(index), &capacity);
+            // Codec config (SPS/PPS) reaches the muxer through the output format instead.
+            if (output != nullptr && track_ >= 0 && info.size > 0 && !(info.flags & AMEDIACODEC_BUFFER_FLAG_CODEC_CONFIG)) {
+                AMediaMuxer_writeSampleData(muxer_, static_cast<size_t>(track_), output, &info);
+            }
+            AMediaCodec_releaseOutputBuffer(codec_, static_cast<size_t>(index), false);
+            if (info.flags & AMEDIACODEC_BUFFER_FLAG_END_OF_STREAM) return;
+        }
+    }
+
+    int fd_ = -1;
+    AMediaMuxer* muxer_ = nullptr;
+    AMediaCodec* codec_ = nullptr;
+    bool started_ = false;
+    int32_t track_ = -1;
+    int32_t width_ = 0;
+    int32_t height_ = 0;
+    int32_t stride_ = 0;
+    int32_t sliceHeight_ = 0;
+    TrackedVector<uint8_t, MEM_TAG_CAPTURE> frame_;
+    uint64_t bytes_ = 0;
+};
+#endif
+
+} // namespace
+
+// =============================================================================
+// Readback Ring
+// =============================================================================
+bool ReadbackRing::Issue(int32_t width, int32_t height, int64_t timeNs, const char* owner) {
+    if (count_ == kReadbackSlots) return false;
+    Slot& slot = slots_[(head_ + count_) % kReadbackSlots];
+    const GLsizeiptr bytes = static_cast<GLsizeiptr>(width) * height * 4;
+    if (slot.pbo == 0 || slot.bytes != bytes) {
+        GpuResources_DeferDelete(GPU_KIND_BUFFER, slot.pbo);
+        glGenBuffers(1, &slot.pbo);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr, GL_STREAM_READ);
+        GpuResources_Register(GPU_KIND_BUFFER, slot.pbo, GPU_CATEGORY_OTHER, GL_RGBA8, static_cast<uint64_t>(bytes),
+                              owner);
+        slot.bytes = bytes;
+    } else {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    }
+    // RGBA8 rows are always 4-byte aligned, so the default pack alignment packs them tightly.
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.width = width;
+    slot.height = height;
+    slot.timeNs = timeNs;
+    count_++;
+    return true;
+}
+
+void ReadbackRing::Collect(ReadbackCallback callback, void* user) {
+    while (count_ > 0) {
+        Slot& slot = slots_[head_];
+        // Zero timeout: only poll. The flush bit makes sure a fence still sitting
+        // in the command buffer gets submitted, or it would never signal.
+        if (glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0) == GL_TIMEOUT_EXPIRED) break;
+        glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+        const void* pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, slot.bytes, GL_MAP_READ_BIT);
+        callback(static_cast<const uint8_t*>(pixels), slot.width, slot.height, slot.timeNs, user);
+        if (pixels != nullptr) glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        head_ = (head_ + 1) % kReadbackSlots;
+        count_--;
+    }
+}
+
+void ReadbackRing::Release() {
+    for (Slot& slot : slots_) {
+        if (slot.fence != nullptr) glDeleteSync(slot.fence);
+        GpuResources_DeferDelete(GPU_KIND_BUFFER, slot.pbo);
+        slot = Slot();
+    }
+    head_ = 0;
+    count_ = 0;
+}
+
+// =============================================================================
+// Image Encoders
+// =============================================================================
+bool EncodePng(const uint8_t* rgba, int32_t width, int32_t height, TrackedVector<uint8_t, MEM_TAG_CAPTURE>& png) {
+    // Each row is stored with the Sub filter (difference to the pixel on the
+    // left), which deflates flat panels and gradients far better than raw bytes.
+    const size_t rowBytes = 1 + static_cast<size_t>(width) * 3;
+    TrackedVector<uint8_t, MEM_TAG_CAPTURE> filtered(rowBytes * height);
+    for (int32_t y = 0; y < height; y++) {
+        const uint8_t* in = rgba + static_cast<size_t>(y) * width * 4;
+        uint8_t* out = filtered.data() + static_cast<size_t>(y) * rowBytes;
+        *out++ = 1;
+        uint8_t left[3] = {0, 0, 0};
+        for (int32_t x = 0; x < width; x++, in += 4, out += 3) {
+            for (int c = 0; c < 3; c++) {
+                out[c] = static_cast<uint8_t>(in[c] - left[c]);
+                left[c] = in[c];
+            }
+        }
+    }
+    uLongf packedSize = compressBound(static_cast<uLong>(filtered.size()));
+    TrackedVector<uint8_t, MEM_TAG_CAPTURE> packed(packedSize);
+    if (compress2(packed.data(), &packedSize, filtered.data(), static_cast<uLong>(filtered.size()), Z_BEST_SPEED) !=
+        Z_OK) {
+        return false;
+    }
+
+    static const uint8_t kSignature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    uint8_t header[13];
+    PutBigEndian32(header, static_cast<uint32_t>(width));
+    PutBigEndian32(header + 4, static_cast<uint32_t>(height));
+    header[8] = 8;    // bits per channel
+    header[9] = 2;    // RGB
+    header[10] = header[11] = header[12] = 0;
+    png.assign(kSignature, kSignature + sizeof(kSignature));
+    png.reserve(sizeof(kSignature) + 3 * 12 + sizeof(header) + packedSize);
+    AppendPngChunk(png, "IHDR", header, sizeof(header));
+    AppendPngChunk(png, "IDAT", packed.data(), static_cast<uint32_t>(packedSize));
+    AppendPngChunk(png, "IEND", nullptr, 0);
+    return true;
+}
+
+bool WritePng(const std::string& path, const uint8_t* rgba, int32_t width, int32_t height, uint64_t* bytesWritten) {
+    TrackedVector<uint8_t, MEM_TAG_CAPTURE> png;
+    if (!EncodePng(rgba, width, height, png)) return false;
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file == nullptr) return false;
+    const bool ok = fwrite(png.data(), 1, png.size(), file) == png.size();
+    fclose(file);
+    if (bytesWritten != nullptr) *bytesWritten = ok ? png.size() : 0;
+    return ok;
+}
+
+void ConvertRgbaToYuv420(const uint8_t* rgba, int32_t width, int32_t height, uint8_t* y, uint8_t* u, uint8_t* v,
+                         int32_t uvStep) {
+    for (int32_t row = 0; row < height; row++) {
+        const uint8_t* in = rgba + static_cast<size_t>(row) * width * 4;
+        uint8_t* out = y + static_cast<size_t>(row) * width;
+        for (int32_t x = 0; x < width; x++, in += 4) {
+            out[x] = static_cast<uint8_t>(((66 * in[0] + 129 * in[1] + 25 * in[2] + 128) >> 8) + 16);
+        }
+    }
+    const int32_t chromaWidth = width / 2;
+    for (int32_t row = 0; row < height / 2; row++) {
+        const uint8_t* top = rgba + static_cast<size_t>(row) * 2 * width * 4;
+        const uint8_t* bottom = top + static_cast<size_t>(width) * 4;
+        const size_t base = static_cast<size_t>(row) * chromaWidth * uvStep;
+        for (int32_t x = 0; x < chromaWidth; x++, top += 8, bottom += 8) {
+            const int r = (top[0] + top[4] + bottom[0] + bottom[4] + 2) >> 2;
+            const int g = (top[1] + top[5] + bottom[1] + bottom[5] + 2) >> 2;
+            const int b = (top[2] + top[6] + bottom[2] + bottom[6] + 2) >> 2;
+            u[base + x * uvStep] = static_cast<uint8_t>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+            v[base + x * uvStep] = static_cast<uint8_t>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+        }
+    }
+}
+
+VideoEncoder* CreateVideoEncoder() {
+#if defined(__ANDROID__)
+    return new MediaCodecEncoder();
+#else
+    return new Y4mEncoder();
+#endif
+}
+
+// =============================================================================
+// Image Capture
+// =============================================================================
+void ImageCapture::RequestStill(const std::string& path) {
+    stillPath_ = path;
+}
+
+void ImageCapture::StartRecording(const std::string& path, int32_t fps) {
+    if (recording_) StopRecording();
+    fps = std::max(1, std::min(fps, 90));
+    recording_ = true;
+    recordingOpen_ = true;
+    recordingGeneration_++;
+    framePeriodNs_ = 1000000000LL / fps;
+    nextFrameNs_ = 0;
+    recordingStartNs_ = 0;
+    Job job;
+    job.kind = JOB_START;
+    job.path = path;
+    job.recording = recordingGeneration_;
+    job.fps = fps;
+    Enqueue(std::move(job));
+}
+
+void ImageCapture::StopRecording() {
+    if (!recording_) return;
+    recording_ = false;
+    // Frames still being read back belong to this recording: stop after the last one.
+    for (auto it = purposes_.rbegin(); it != purposes_.rend(); ++it) {
+        if (it->frame) {
+            it->stopAfter = true;
+            return;
+        }
+    }
+    EnqueueStop(recordingGeneration_);
+}
+
+void ImageCapture::Poll() {
+    if (frameCpuNs_ > 0) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.renderCpuNs += frameCpuNs_;
+        stats_.maxRenderCpuNs = std::max(stats_.maxRenderCpuNs, frameCpuNs_);
+    }
+    frameCpuNs_ = 0;
+    if (readback_.InFlight() == 0) return;
+    const int64_t start = NowNs();
+    readback_.Collect(&ImageCapture::OnReadback, this);
+    frameCpuNs_ += NowNs() - start;
+}
+
+void ImageCapture::CaptureView(int32_t width, int32_t height, int64_t frameTimeNs) {
+    const bool still = !stillPath_.empty();
+    const bool frame = recording_ && frameTimeNs >= nextFrameNs_;
+    if (!still && !frame) return;
+    const int64_t start = NowNs();
+    Purpose purpose;
+    purpose.still = still;
+    purpose.frame = frame;
+    purpose.issuedNs = start;
+    if (frame) {
+        purpose.recording = recordingGeneration_;
+        if (recordingStartNs_ == 0) recordingStartNs_ = frameTimeNs;
+        purpose.ptsNs = frameTimeNs - recordingStartNs_;
+        // Keep to the recording's own clock; after a stall, restart it from here.
+        nextFrameNs_ = nextFrameNs_ == 0 ? frameTimeNs + framePeriodNs_ : nextFrameNs_ + framePeriodNs_;
+        if (nextFrameNs_ <= frameTimeNs) nextFrameNs_ = frameTimeNs + framePeriodNs_;
+    }
+    if (readback_.Issue(width, height, frameTimeNs, "image capture")) {
+        if (still) purpose.path = std::move(stillPath_);
+        stillPath_.clear();
+        purposes_.push_back(std::move(purpose));
+    } else if (frame) {
+        // The still, if any, stays pending and is read on a later frame.
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.dropped++;
+    }
+    frameCpuNs_ += NowNs() - start;
+}
+
+void ImageCapture::OnReadback(const uint8_t* rgba, int32_t width, int32_t height, int64_t, void* user) {
+    auto* self = static_cast<ImageCapture*>(user);
+    Purpose purpose = std::move(self->purposes_.front());
+    self->purposes_.pop_front();
+
+    bool frame = purpose.frame;
+    PixelBuffer buffer;
+    {
+        std::lock_guard<std::mutex> lock(self->mutex_);
+        if (rgba == nullptr) {
+            if (purpose.still) ALOGE("Screenshot %s: readback buffer could not be mapped", purpose.path.c_str());
+            if (frame) self->stats_.dropped++;
+            frame = false;
+            purpose.still = false;
+        } else if (frame && self->queuedImages_ >= kMaxQueuedImages) {
+            // The encoder is behind; a recording skips a frame rather than stalling the render thread.
+            self->stats_.dropped++;
+            frame = false;
+        }
+        if ((purpose.still || frame) && !self->spareBuffers_.empty()) {
+            buffer = std::move(self->spareBuffers_.back());
+            self->spareBuffers_.pop_back();
+        }
+    }
+    if (purpose.still || frame) {
+        Job job;
+        job.still = purpose.still;
+        job.frame = frame;
+        job.path = std::move(purpose.path);
+        job.recording = purpose.recording;
+        job.width = width;
+        job.height = height;
+        job.ptsNs = purpose.ptsNs;
+        job.issuedNs = purpose.issuedNs;
+        // GL rows are bottom-up; the encoders want the top row first.
+        const size_t rowBytes = static_cast<size_t>(width) * 4;
+        buffer.resize(rowBytes * height);
+        for (int32_t row = 0; row < height; row++) {
+            memcpy(buffer.data() + static_cast<size_t>(row) * rowBytes,
+                   rgba + static_cast<size_t>(height - 1 - row) * rowBytes, rowBytes);
+        }
+        job.rgba = std::move(buffer);
+        self->Enqueue(std::move(job));
+    }
+    if (purpose.stopAfter) self->EnqueueStop(purpose.recording);
+}
+
+void ImageCapture::Enqueue(Job&& job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (job.kind == JOB_IMAGE) queuedImages_++;
+        if (job.kind == JOB_START) stats_.recording = true;
+        if (job.kind == JOB_STOP && job.recording == recordingGeneration_) stats_.recording = false;
+        jobs_.push_back(std::move(job));
+    }
+    // Only the render thread enqueues, so starting the thread here does not race.
+    if (!encoder_.joinable()) encoder_ = std::thread(&ImageCapture::EncoderLoop, this);
+    wake_.notify_one();
+}
+
+void ImageCapture::EnqueueStop(uint32_t recording) {
+    if (recording == recordingGeneration_) recordingOpen_ = false;
+    Job job;
+    job.kind = JOB_STOP;
+    job.recording = recording;
+    Enqueue(std::move(job));
+}
+
+void ImageCapture::ReleaseGl() {
+    readback_.Release();
+    purposes_.clear();
+    stillPath_.clear();
+    recording_ = false;
+    if (recordingOpen_) EnqueueStop(recordingGeneration_);
+}
+
+void ImageCapture::Shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_one();
+    if (encoder_.joinable()) encoder_.join();
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = false;
+    spareBuffers_.clear();
+}
+
+ImageCaptureStats ImageCapture::Stats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void ImageCapture::EncoderLoop() {
+    ThreadRoleScope role(THREAD_ROLE_WORKER, "iris-capture");
+    VideoEncoder* video = nullptr;
+    std::string videoPath;
+    uint32_t videoRecording = 0;
+    int32_t videoFps = 0;
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [this] { return stopping_ || !jobs_.empty(); });
+            if (jobs_.empty()) break;   // stopping, and every queued job is done
+            job = std::move(jobs_.front());
+            jobs_.pop_front();
+        }
+        const int64_t cpuStart = ThreadCpuNs();
+        uint64_t bytes = 0;
+        uint64_t stills = 0;
+        uint64_t frames = 0;
+        uint64_t dropped = 0;
+        if (job.kind == JOB_STOP && job.recording != videoRecording) {
+            // A restart already closed this recording; its late stop must not end the new one.
+        } else if (job.kind == JOB_START || job.kind == JOB_STOP) {
+            if (video != nullptr) {
+                video->Close();
+                bytes += video->BytesWritten();
+                ALOGI("Recording %s closed: %llu bytes (%s)", videoPath.c_str(),
+                      static_cast<unsigned long long>(video->BytesWritten()), video->Name());
+                delete video;
+                video = nullptr;
+            }
+            videoPath = job.kind == JOB_START ? job.path : std::string();
+            videoRecording = job.recording;
+            videoFps = job.fps;
+        } else {
+            if (job.still) {
+                uint64_t pngBytes = 0;
+                if (WritePng(job.path, job.rgba.data(), job.width, job.height, &pngBytes)) {
+                    ALOGI("Screenshot %s: %dx%d, %llu bytes", job.path.c_str(), job.width, job.height,
+                          static_cast<unsigned long long>(pngBytes));
+                    stills++;
+                    bytes += pngBytes;
+                } else {
+                    ALOGE("Screenshot %s could not be written", job.path.c_str());
+                }
+            }
+            if (job.frame && (job.recording != videoRecording || videoPath.empty())) {
+                // Read back for a recording that has since been replaced, or one that could not be opened.
+                dropped++;
+            } else if (job.frame) {
+                // Video wants even dimensions: drop an odd last column and row.
+                const int32_t width = job.width & ~1;
+                const int32_t height = job.height & ~1;
+                if (width != job.width) {
+                    for (int32_t row = 1; row < height; row++) {
+                        memmove(job.rgba.data() + static_cast<size_t>(row) * width * 4,
+                                job.rgba.data() + static_cast<size_t>(row) * job.width * 4,
+                                static_cast<size_t>(width) * 4);
+                    }
+                }
+                if (video == nullptr) {
+                    video = CreateVideoEncoder();
+                    if (video->Open(videoPath, width, height, videoFps)) {
+                        ALOGI("Recording %s: %dx%d at %d fps (%s)", videoPath.c_str(), width, height, videoFps,
+                              video->Name());
+                    } else {
+                        ALOGE("Recording %s could not be opened (%s)", videoPath.c_str(), video->Name());
+                        delete video;
+                        video = nullptr;
+                        videoPath.clear();
+                    }
+                }
+                if (video != nullptr && video->Encode(job.rgba.data(), job.ptsNs)) {
+                    frames++;
+                } else {
+                    dropped++;
+                }
+            }
+        }
+        const int64_t cpuNs = ThreadCpuNs() - cpuStart;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.stills += stills;
+        stats_.frames += frames;
+        stats_.dropped += dropped;
+        stats_.bytesWritten += bytes;
+        stats_.encodeCpuNs += cpuNs;
+        if (job.kind == JOB_IMAGE) {
+            stats_.lastLatencyNs = NowNs() - job.issuedNs;
+            queuedImages_--;
+            if (spareBuffers_.size() < kMaxQueuedImages) spareBuffers_.push_back(std::move(job.rgba));
+        }
+    }
+    if (video != nullptr) {
+        video->Close();
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.bytesWritten += video->BytesWritten();
+        delete video;
+    }
+}
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <GLES3/gl32.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "allocator.h"
+
+// =============================================================================
+// Readback Ring
+// =============================================================================
+// Asynchronous glReadPixels into a small ring of pixel-pack buffers. Issue()
+// starts the copy and fences it; the GPU does the transfer after the frame's
+// own work. Collect() maps only buffers whose fence has already passed, oldest
+// first, so neither call ever waits on the GPU. A readback is typically ready
+// two or three frames after it was issued.
+
+constexpr uint32_t kReadbackSlots = 3;
+
+// Rows are bottom-up as GL returns them, tightly packed RGBA8. `rgba` is only
+// valid during the call.
+typedef void (*ReadbackCallback)(const uint8_t* rgba, int32_t width, int32_t height, int64_t timeNs, void* user);
+
+class ReadbackRing {
+public:
+    ~ReadbackRing() { Release(); }
+
+    // Reads [0, width) x [0, height) of the bound read framebuffer. False when
+    // every buffer is still in flight; the caller drops the image.
+    bool Issue(int32_t width, int32_t height, int64_t timeNs, const char* owner);
+    // Hands each finished readback to `callback`, in issue order.
+    void Collect(ReadbackCallback callback, void* user);
+    // GL thread. Pending readbacks are discarded.
+    void Release();
+    uint32_t InFlight() const { return count_; }
+
+private:
+    struct Slot {
+        GLuint pbo = 0;
+        GLsizeiptr bytes = 0;
+        GLsync fence = nullptr;
+        int32_t width = 0;
+        int32_t height = 0;
+        int64_t timeNs = 0;
+    };
+    Slot slots_[kReadbackSlots];
+    uint32_t head_ = 0;    // oldest in flight
+    uint32_t count_ = 0;
+};
+
+// =============================================================================
+// Image Encoders
+// =============================================================================
+// PNG stills are deflated with zlib. Recordings go through a VideoEncoder:
+// H.264 in MP4 via MediaCodec on device, and a YUV4MPEG2 writer elsewhere that
+// stands in for the codec (any player or ffmpeg reads it) so the pipeline can
+// be run and timed off-device. Images are RGBA8, top row first; alpha is dropped.
+
+// Replaces `png` with the encoded file.
+bool EncodePng(const uint8_t* rgba, int32_t width, int32_t height, TrackedVector<uint8_t, MEM_TAG_CAPTURE>& png);
+bool WritePng(const std::string& path, const uint8_t* rgba, int32_t width, int32_t height, uint64_t* bytesWritten = nullptr);
+
+// BT.601 limited range, 4:2:0 with each chroma sample averaging a 2x2 block.
+// `uvStep` is 1 for planar (I420) and 2 for interleaved chroma (NV12: v = u + 1).
+void ConvertRgbaToYuv420(const uint8_t* rgba, int32_t width, int32_t height, uint8_t* y, uint8_t* u, uint8_t* v,
+                         int32_t uvStep);
+
+class VideoEncoder {
+public:
+    virtual ~VideoEncoder() = default;
+    // Dimensions are even.
+    virtual bool Open(const std::string& path, int32_t width, int32_t height, int32_t fps) = 0;
+    // False when the frame could not be taken; it is counted as dropped.
+    virtual bool Encode(const uint8_t* rgba, int64_t ptsNs) = 0;
+    virtual void Close() = 0;
+    virtual uint64_t BytesWritten() const = 0;
+    virtual const char* Name() const = 0;
+};
+
+VideoEncoder* CreateVideoEncoder();
+
+// =============================================================================
+// Image Capture
+// =============================================================================
+// Screenshots and recordings of an eye buffer. The render thread only issues
+// readbacks and copies finished ones out of the mapped buffers; encoding and
+// file writes happen on an encoder thread. With no still pending and no
+// recording running, CaptureView() returns before touching GL and no buffers
+// or threads exist, so an idle capture costs nothing.
+
+struct ImageCaptureStats {
+    uint64_t stills = 0;           // PNGs written
+    uint64_t frames = 0;           // frames handed to the video encoder
+    uint64_t dropped = 0;          // readback ring, encoder queue or encoder full
+    int64_t renderCpuNs = 0;       // render thread: issuing, mapping and copying, total
+    int64_t maxRenderCpuNs = 0;    // the most any one frame spent on it
+    int64_t encodeCpuNs = 0;       // encoder thread, total
+    int64_t lastLatencyNs = 0;     // frame drawn -> image encoded
+    uint64_t bytesWritten = 0;     // PNGs plus closed recordings
+    bool recording = false;
+};
+
+class ImageCapture {
+public:
+    ~ImageCapture() { Shutdown(); }
+
+    // Render thread.
+    void RequestStill(const std::string& path);
+    void StartRecording(const std::string& path, int32_t fps);
+    void StopRecording();
+    bool Idle() const { return stillPath_.empty() && !recording_ && readback_.InFlight() == 0; }
+
+    // Once per frame, before any view is drawn: collects finished readbacks.
+    void Poll();
+    // With the eye's framebuffer bound for reading, right after its view is drawn.
+    void CaptureView(int32_t width, int32_t height, int64_t frameTimeNs);
+    // GL thread. Discards readbacks in flight and ends any recording.
+    void ReleaseGl();
+    // Finishes every queued image and stops the encoder thread. Call after ReleaseGl().
+    void Shutdown();
+
+    // Any thread.
+    ImageCaptureStats Stats();
+
+private:
+    typedef TrackedVector<uint8_t, MEM_TAG_CAPTURE> PixelBuffer;
+    enum JobKind : uint8_t { JOB_IMAGE, JOB_START, JOB_STOP };
+    struct Job {
+        JobKind kind = JOB_IMAGE;
+        bool still = false;
+        bool frame = false;
+        std::string path;          // the still's, or the recording's for JOB_START
+        uint32_t recording = 0;    // generation of the recording a start, stop or frame belongs to
+        int32_t fps = 0;
+        int32_t width = 0;
+        int32_t height = 0;
+        int64_t ptsNs = 0;
+        int64_t issuedNs = 0;
+        PixelBuffer rgba;
+    };
+    // What an issued readback is for, in issue order.
+    struct Purpose {
+        bool still = false;
+        bool frame = false;
+        bool stopAfter = false;   // the recording's last frame
+        uint32_t recording = 0;   // generation, for frames
+        std::string path;
+        int64_t ptsNs = 0;
+        int64_t issuedNs = 0;
+    };
+    static constexpr size_t kMaxQueuedImages = 3;
+
+    static void OnReadback(const uint8_t* rgba, int32_t width, int32_t height, int64_t timeNs, void* self);
+    void Enqueue(Job&& job);
+    void EnqueueStop(uint32_t recording);
+    void EncoderLoop();
+
+    // Render thread.
+    ReadbackRing readback_;
+    std::deque<Purpose> purposes_;
+    std::string stillPath_;   // the next CaptureView reads for this still
+    bool recording_ = false;
+    bool recordingOpen_ = false;   // started on the encoder thread, stop not yet queued
+    // Bumped by every StartRecording. A restart can overlap the previous
+    // recording's frames still being read back; their stop and any of them
+    // reaching the encoder after the new start are matched by generation and
+    // ignored or dropped there.
+    uint32_t recordingGeneration_ = 0;
+    int64_t framePeriodNs_ = 0;
+    int64_t nextFrameNs_ = 0;
+    int64_t recordingStartNs_ = 0;
+    int64_t frameCpuNs_ = 0;   // this frame's share of renderCpuNs
+
+    // Shared with the encoder thread.
+    std::thread encoder_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::deque<Job> jobs_;
+    size_t queuedImages_ = 0;
+    bool stopping_ = false;
+    std::deque<PixelBuffer> spareBuffers_;
+    ImageCaptureStats stats_;
+};
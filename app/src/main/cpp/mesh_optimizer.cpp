@@ -0,0 +1,307 @@
+#include "mesh_optimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+namespace {
+
+// =============================================================================
+// Vertex Cache (Forsyth, "Linear-Speed Vertex Cache Optimisation")
+// =============================================================================
+constexpr int kCacheSize = 32;
+constexpr float kCacheDecayPower = 1.5f;
+constexpr float kLastTriangleScore = 0.75f;
+constexpr float kValenceBoostScale = 2.0f;
+constexpr float kValenceBoostPower = 0.5f;
+
+float VertexScore(int cachePosition, uint32_t remainingTriangles) {
+    if (remainingTriangles == 0) return -1.0f;
+    float score = 0.0f;
+    if (cachePosition >= 0) {
+        // The three vertices of the triangle just emitted score a flat value so
+        // the next triangle is not forced to share an edge with it.
+        if (cachePosition < 3) {
+            score = kLastTriangleScore;
+        } else {
+            const float scaler = 1.0f / (kCacheSize - 3);
+            score = powf(1.0f - (cachePosition - 3) * scaler, kCacheDecayPower);
+        }
+    }
+    // Vertices with few triangles left are finished off first so they leave the working set.
+    return score + kValenceBoostScale * powf(static_cast<float>(remainingTriangles), -kValenceBoostPower);
+}
+
+uint16_t HalfFromFloat(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    const uint32_t sign = (bits >> 16) & 0x8000;
+    const int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = bits & 0x7fffff;
+    if (exponent >= 31) return static_cast<uint16_t>(sign | 0x7c00);   // overflow and inf; meshes have no NaNs
+    if (exponent <= 0) {
+        if (exponent < -10) return static_cast<uint16_t>(sign);
+        mantissa |= 0x800000;
+        const uint32_t shift = static_cast<uint32_t>(14 - exponent);
+        return static_cast<uint16_t>(sign | ((mantissa + (1u << (shift - 1))) >> shift));
+    }
+    // Round to nearest; a carry out of the mantissa correctly bumps the exponent.
+    return static_cast<uint16_t>((sign | (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13)) + ((mantissa >> 12) & 1));
+}
+
+} // namespace
+
+// =============================================================================
+// Analysis
+// =============================================================================
+VertexCacheStats MeshOpt_AnalyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount,
+                                             uint32_t cacheSize) {
+    VertexCacheStats stats;
+    if (indexCount < 3 || vertexCount == 0) return stats;
+    // A vertex is still cached if fewer than cacheSize misses happened since it was loaded.
+    std::vector<uint64_t> loadedAt(vertexCount, 0);
+    std::vector<bool> referenced(vertexCount, false);
+    uint64_t misses = 0;
+    size_t unique = 0;
+    for (size_t i = 0; i < indexCount; ++i) {
+        const uint32_t v = indices[i];
+        if (!referenced[v]) { referenced[v] = true; unique++; }
+        if (loadedAt[v] == 0 || misses - loadedAt[v] >= cacheSize) loadedAt[v] = ++misses;
+    }
+    stats.acmr = static_cast<float>(misses) / static_cast<float>(indexCount / 3);
+    stats.atvr = static_cast<float>(misses) / static_cast<float>(unique);
+    return stats;
+}
+
+VertexFetchStats MeshOpt_AnalyzeVertexFetch(const uint32_t* indices, size_t indexCount, size_t vertexCount,
+                                            size_t vertexStride) {
+    constexpr size_t kLineBytes = 64;
+    constexpr size_t kLines = 32;
+    VertexFetchStats stats;
+    if (indexCount == 0 || vertexCount == 0) return stats;
+    uint64_t lines[kLines];
+    uint64_t usedAt[kLines] = {};
+    for (uint64_t& line : lines) line = UINT64_MAX;
+    uint64_t clock = 0;
+    for (size_t i = 0; i < indexCount; ++i) {
+        const uint64_t first = indices[i] * vertexStride / kLineBytes;
+        const uint64_t last = (indices[i] * vertexStride + vertexStride - 1) / kLineBytes;
+        for (uint64_t line = first; line <= last; ++line) {
+            clock++;
+            size_t slot = 0;
+            bool hit = false;
+            for (size_t k = 0; k < kLines; ++k) {
+                if (lines[k] == line) { slot = k; hit = true; break; }
+                if (usedAt[k] < usedAt[slot]) slot = k;   // least recently used
+            }
+            if (!hit) {
+                lines[slot] = line;
+                stats.bytesFetched += kLineBytes;
+            }
+            usedAt[slot] = clock;
+        }
+    }
+    stats.overfetch = static_cast<float>(stats.bytesFetched) / static_cast<float>(vertexCount * vertexStride);
+    return stats;
+}
+
+// =============================================================================
+// Reordering
+// =============================================================================
+void MeshOpt_OptimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount) {
+    const size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0) return;
+
+    // Triangles of each vertex, as offsets into one flat array; the tail past
+    // remaining[v] holds triangles already emitted.
+    std::vector<uint32_t> remaining(vertexCount, 0);
+    for (size_t i = 0; i < triangleCount * 3; ++i) remaining[indices[i]]++;
+    std::vector<uint32_t> firstTriangle(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; ++v) firstTriangle[v + 1] = firstTriangle[v] + remaining[v];
+    std::vector<uint32_t> vertexTriangles(triangleCount * 3);
+    {
+        std::vector<uint32_t> fill(firstTriangle.begin(), firstTriangle.end() - 1);
+        for (size_t t = 0; t < triangleCount; ++t) {
+            for (int k = 0; k < 3; ++k) vertexTriangles[fill[indices[t * 3 + k]]++] = static_cast<uint32_t>(t);
+        }
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v) vertexScore[v] = VertexScore(-1, remaining[v]);
+    std::vector<float> triangleScore(triangleCount);
+    std::vector<bool> emitted(triangleCount, false);
+    for (size_t t = 0; t < triangleCount; ++t) {
+        triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+    }
+
+    std::vector<uint32_t> output;
+    output.reserve(triangleCount * 3);
+    uint32_t cache[kCacheSize + 3];
+    int cacheCount = 0;
+    size_t scanFrom = 0;
+    size_t best = std::max_element(triangleScore.begin(), triangleScore.end()) - triangleScore.begin();
+    while (output.size() < triangleCount * 3) {
+        const uint32_t* tri = indices + best * 3;
+        output.insert(output.end(), tri, tri + 3);
+        emitted[best] = true;
+
+        // Emitted triangle's vertices go to the front of the LRU cache.
+        uint32_t next[kCacheSize + 3];
+        int nextCount = 0;
+        for (int k = 0; k < 3; ++k) {
+            const uint32_t v = tri[k];
+            // Move the triangle to the emitted tail of the vertex's list.
+            uint32_t* list = vertexTriangles.data() + firstTriangle[v];
+            for (uint32_t j = 0; j < remaining[v]; ++j) {
+                if (list[j] == best) { std::swap(list[j], list[remaining[v] - 1]); break; }
+            }
+            remaining[v]--;
+            const bool repeated = (k > 0 && v == tri[0]) || (k > 1 && v == tri[1]);   // degenerate triangle
+            if (!repeated) next[nextCount++] = v;
+        }
+        for (int i = 0; i < cacheCount; ++i) {
+            const uint32_t v = cache[i];
+            if (v != tri[0] && v != tri[1] && v != tri[2]) next[nextCount++] = v;
+        }
+        for (int i = kCacheSize; i < nextCount; ++i) cachePosition[next[i]] = -1;   // evicted
+        cacheCount = std::min(nextCount, kCacheSize);
+        for (int i = 0; i < nextCount; ++i) {
+            const uint32_t v = next[i];
+            cachePosition[v] = i < kCacheSize ? i : -1;
+            vertexScore[v] = VertexScore(cachePosition[v], remaining[v]);
+            if (i < kCacheSize) cache[i] = v;
+        }
+
+        // Only triangles touching the cache changed score; the best of them goes next.
+        float bestScore = -1.0f;
+        for (int i = 0; i < nextCount; ++i) {
+            const uint32_t v = next[i];
+            const uint32_t* list = vertexTriangles.data() + firstTriangle[v];
+            for (uint32_t j = 0; j < remaining[v]; ++j) {
+                const uint32_t t = list[j];
+                const float score = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+                triangleScore[t] = score;
+                if (score > bestScore) { bestScore = score; best = t; }
+            }
+        }
+        if (bestScore < 0.0f) {
+            // Nothing left around the cache: continue with the next unemitted triangle.
+            while (scanFrom < triangleCount && emitted[scanFrom]) scanFrom++;
+            if (scanFrom == triangleCount) break;
+            best = scanFrom;
+        }
+    }
+    std::copy(output.begin(), output.end(), indices);
+}
+
+void MeshOpt_OptimizeVertexFetch(MeshData& mesh) {
+    std::vector<uint32_t> remap(mesh.VertexCount(), UINT32_MAX);
+    std::vector<float> vertices;
+    vertices.reserve(mesh.vertices.size());
+    for (uint32_t& index : mesh.indices) {
+        if (remap[index] == UINT32_MAX) {
+            remap[index] = static_cast<uint32_t>(vertices.size() / kMeshFloatsPerVertex);
+            const float* v = mesh.vertices.data() + index * kMeshFloatsPerVertex;
+            vertices.insert(vertices.end(), v, v + kMeshFloatsPerVertex);
+        }
+        index = remap[index];
+    }
+    mesh.vertices.swap(vertices);
+}
+
+// =============================================================================
+// Simplification
+// =============================================================================
+namespace {
+
+// Triangles left after clustering onto a grid of `cell` sized cubes; fills
+// `lod` when given.
+size_t Cluster(const MeshData& mesh, const float minimum[3], float cell, MeshData* lod) {
+    std::unordered_map<uint64_t, uint32_t> cells;
+    std::vector<uint32_t> cluster(mesh.VertexCount());
+    for (size_t v = 0; v < mesh.VertexCount(); ++v) {
+        const float* p = mesh.vertices.data() + v * kMeshFloatsPerVertex;
+        uint64_t key = 0;
+        for (int axis = 0; axis < 3; ++axis) key = (key << 21) | static_cast<uint64_t>((p[axis] - minimum[axis]) / cell);
+        cluster[v] = cells.emplace(key, static_cast<uint32_t>(cells.size())).first->second;
+    }
+    size_t triangles = 0;
+    for (size_t t = 0; t < mesh.TriangleCount(); ++t) {
+        const uint32_t a = cluster[mesh.indices[t * 3]], b = cluster[mesh.indices[t * 3 + 1]], c = cluster[mesh.indices[t * 3 + 2]];
+        if (a == b || b == c || a == c) continue;   // collapsed
+        triangles++;
+        if (lod != nullptr) lod->indices.insert(lod->indices.end(), {a, b, c});
+    }
+    if (lod != nullptr) {
+        // Each cluster is represented by the mean of its vertices.
+        lod->vertices.assign(cells.size() * kMeshFloatsPerVertex, 0.0f);
+        std::vector<uint32_t> members(cells.size(), 0);
+        for (size_t v = 0; v < mesh.VertexCount(); ++v) {
+            members[cluster[v]]++;
+            for (size_t k = 0; k < kMeshFloatsPerVertex; ++k) {
+                lod->vertices[cluster[v] * kMeshFloatsPerVertex + k] += mesh.vertices[v * kMeshFloatsPerVertex + k];
+            }
+        }
+        for (size_t c = 0; c < cells.size(); ++c) {
+            for (size_t k = 0; k < kMeshFloatsPerVertex; ++k) lod->vertices[c * kMeshFloatsPerVertex + k] /= members[c];
+        }
+    }
+    return triangles;
+}
+
+} // namespace
+
+bool MeshOpt_Simplify(const MeshData& mesh, size_t targetTriangles, MeshData& lod, float& error) {
+    if (mesh.VertexCount() == 0 || targetTriangles >= mesh.TriangleCount()) return false;
+    float minimum[3] = {INFINITY, INFINITY, INFINITY}, maximum[3] = {-INFINITY, -INFINITY, -INFINITY};
+    for (size_t v = 0; v < mesh.VertexCount(); ++v) {
+        for (int axis = 0; axis < 3; ++axis) {
+            minimum[axis] = std::min(minimum[axis], mesh.vertices[v * kMeshFloatsPerVertex + axis]);
+            maximum[axis] = std::max(maximum[axis], mesh.vertices[v * kMeshFloatsPerVertex + axis]);
+        }
+    }
+    const float extent = std::max({maximum[0] - minimum[0], maximum[1] - minimum[1], maximum[2] - minimum[2], 1e-6f});
+    // Triangle count grows with grid resolution; find the coarsest grid that keeps enough.
+    int low = 1, high = 1 << 20;
+    while (low < high) {
+        const int resolution = low + (high - low) / 2;
+        if (Cluster(mesh, minimum, extent / resolution, nullptr) >= targetTriangles) high = resolution;
+        else low = resolution + 1;
+    }
+    const float cell = extent / low;
+    lod = {};
+    if (Cluster(mesh, minimum, cell, &lod) >= mesh.TriangleCount()) return false;
+    error = cell * 1.7320508f;
+    return !lod.indices.empty();
+}
+
+// =============================================================================
+// Quantization
+// =============================================================================
+uint32_t MeshOpt_Quantize(const MeshData& mesh, std::vector<uint8_t>& out) {
+    // half x, y, z, pad | unorm8 r, g, b, a: 12 bytes, every attribute 4-byte aligned.
+    constexpr uint32_t kStride = 12;
+    out.assign(mesh.VertexCount() * kStride, 0);
+    for (size_t v = 0; v < mesh.VertexCount(); ++v) {
+        const float* src = mesh.vertices.data() + v * kMeshFloatsPerVertex;
+        uint8_t* dst = out.data() + v * kStride;
+        for (int k = 0; k < 3; ++k) {
+            const uint16_t half = HalfFromFloat(src[k]);
+            memcpy(dst + k * 2, &half, sizeof(half));
+        }
+        for (int k = 0; k < 3; ++k) dst[8 + k] = static_cast<uint8_t>(lroundf(std::min(std::max(src[3 + k], 0.0f), 1.0f) * 255.0f));
+        dst[11] = 255;
+    }
+    return kStride;
+}
+
+float MeshOpt_BoundingRadius(const MeshData& mesh) {
+    float radius = 0.0f;
+    for (size_t v = 0; v < mesh.VertexCount(); ++v) {
+        const float* p = mesh.vertices.data() + v * kMeshFloatsPerVertex;
+        radius = std::max(radius, sqrtf(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]));
+    }
+    return radius;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// =============================================================================
+// Mesh Optimizer (host packer)
+// =============================================================================
+// Offline passes run by asset_packer before a mesh goes into the bundle:
+//
+//   - vertex cache: triangles reordered (Forsyth's linear-speed algorithm) so
+//     recently shaded vertices are reused by the post-transform cache;
+//   - vertex fetch: vertices renumbered in first-use order so the vertex
+//     fetcher walks memory mostly forward, and unused vertices dropped;
+//   - simplification: vertex clustering on a uniform grid for the LOD chain;
+//   - quantization: half-float positions and unorm8 colors, half the bytes of
+//     the float layout, still read by a plain glVertexAttribPointer.
+//
+// Meshes are position + color, six floats per vertex, with 32-bit indices.
+
+constexpr size_t kMeshFloatsPerVertex = 6;
+
+struct MeshData {
+    std::vector<float> vertices;
+    std::vector<uint32_t> indices;
+
+    size_t VertexCount() const { return vertices.size() / kMeshFloatsPerVertex; }
+    size_t TriangleCount() const { return indices.size() / 3; }
+};
+
+struct VertexCacheStats {
+    float acmr = 0.0f;   // vertices shaded per triangle (3 = no reuse, ~0.5 = ideal for a regular grid)
+    float atvr = 0.0f;   // vertices shaded per unique vertex (1 = ideal)
+};
+
+struct VertexFetchStats {
+    uint64_t bytesFetched = 0;   // whole cache lines pulled in
+    float overfetch = 0.0f;      // bytesFetched / vertex buffer size (1 = ideal)
+};
+
+// FIFO post-transform cache of `cacheSize` entries, as on most mobile GPUs.
+VertexCacheStats MeshOpt_AnalyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount,
+                                             uint32_t cacheSize);
+// 64-byte lines through a small fully associative cache.
+VertexFetchStats MeshOpt_AnalyzeVertexFetch(const uint32_t* indices, size_t indexCount, size_t vertexCount,
+                                            size_t vertexStride);
+
+// Reorders triangles in place.
+void MeshOpt_OptimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount);
+// Renumbers vertices in order of first use and drops unreferenced ones.
+void MeshOpt_OptimizeVertexFetch(MeshData& mesh);
+
+// Clusters vertices on the coarsest grid that still keeps at least
+// `targetTriangles` triangles. `error` is the grid's cell diagonal, in mesh
+// units: no vertex moves further than that. False if nothing could be removed.
+bool MeshOpt_Simplify(const MeshData& mesh, size_t targetTriangles, MeshData& lod, float& error);
+
+// Interleaves the quantized layout (ASSET_VERTEX_POSITION_HALF |
+// ASSET_VERTEX_COLOR_UNORM8) into `out`; returns the stride.
+uint32_t MeshOpt_Quantize(const MeshData& mesh, std::vector<uint8_t>& out);
+
+float MeshOpt_BoundingRadius(const MeshData& mesh);
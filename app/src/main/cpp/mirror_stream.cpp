@@ -0,0 +1,458 @@
+#include "mirror_stream.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "gl_trace.h"
+#include "gpu_resources.h"
+#include "thread_roles.h"
+
+namespace {
+
+int64_t ThreadCpuNs() {
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+void PutLittleEndian32(uint8_t* out, uint32_t value) {
+    for (int i = 0; i < 4; i++) out[i] = static_cast<uint8_t>(value >> (8 * i));
+}
+
+uint32_t GetLittleEndian32(const uint8_t* in) {
+    return static_cast<uint32_t>(in[0]) | static_cast<uint32_t>(in[1]) << 8 | static_cast<uint32_t>(in[2]) << 16 |
+           static_cast<uint32_t>(in[3]) << 24;
+}
+
+bool SendAll(int fd, const uint8_t* data, size_t length) {
+    while (length > 0) {
+        const ssize_t n = send(fd, data, length, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        data += n;
+        length -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Bytes handed to the socket that the peer has not yet acknowledged.
+int QueuedBytes(int fd) {
+    int queued = 0;
+    return ioctl(fd, TIOCOUTQ, &queued) == 0 ? queued : 0;
+}
+
+// A client never sends anything; readable means it hung up (or misbehaves).
+bool ClientHungUp(int fd) {
+    pollfd pfd = {fd, POLLIN, 0};
+    if (poll(&pfd, 1, 0) <= 0) return false;
+    if (pfd.revents & (POLLHUP | POLLERR)) return true;
+    uint8_t scratch[256];
+    return recv(fd, scratch, sizeof(scratch), MSG_DONTWAIT) == 0;
+}
+
+const uint8_t kPngSignature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+
+} // namespace
+
+void PackMirrorHeader(const MirrorFrameHeader& header, uint8_t* out) {
+    PutLittleEndian32(out, kMirrorMagic);
+    PutLittleEndian32(out + 4, header.sequence);
+    PutLittleEndian32(out + 8, header.width);
+    PutLittleEndian32(out + 12, header.height);
+    PutLittleEndian32(out + 16, header.payloadBytes);
+    PutLittleEndian32(out + 20, static_cast<uint32_t>(static_cast<uint64_t>(header.timeNs)));
+    PutLittleEndian32(out + 24, static_cast<uint32_t>(static_cast<uint64_t>(header.timeNs) >> 32));
+}
+
+bool UnpackMirrorHeader(const uint8_t* in, MirrorFrameHeader& header) {
+    if (GetLittleEndian32(in) != kMirrorMagic) return false;
+    header.sequence = GetLittleEndian32(in + 4);
+    header.width = GetLittleEndian32(in + 8);
+    header.height = GetLittleEndian32(in + 12);
+    header.payloadBytes = GetLittleEndian32(in + 16);
+    header.timeNs = static_cast<int64_t>(GetLittleEndian32(in + 20) | static_cast<uint64_t>(GetLittleEndian32(in + 24)) << 32);
+    return true;
+}
+
+// =============================================================================
+// Mirror Stream
+// =============================================================================
+bool MirrorStream::Start(const MirrorConfig& config) {
+    Stop();
+    listenFd_ = socket(AF_INET, SOCK_STREAM, 0);
+    if (listenFd_ < 0) return false;
+    int one = 1;
+    setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(config.loopbackOnly ? INADDR_LOOPBACK : INADDR_ANY);
+    addr.sin_port = htons(config.port);
+    socklen_t len = sizeof(addr);
+    if (bind(listenFd_, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(listenFd_, 1) != 0 ||
+        getsockname(listenFd_, (sockaddr*)&addr, &len) != 0) {
+        ALOGE("Mirror stream: bind/listen on port %u failed: %s", config.port, strerror(errno));
+        close(listenFd_);
+        listenFd_ = -1;
+        return false;
+    }
+    port_ = ntohs(addr.sin_port);
+    config_ = config;
+    config_.width = std::max(16, std::min(config.width, 4096)) & ~1;
+    config_.fps = std::max(1, std::min(config.fps, 60));
+    nextFrameNs_ = 0;
+    sourceWidth_ = sourceHeight_ = 0;   // rebuilds the blit chain for the new width
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.port = port_;
+        frameReady_ = false;
+    }
+    running_ = true;
+    thread_ = std::thread(&MirrorStream::SendLoop, this);
+    ALOGI("Mirror stream listening on %s:%u, %d px wide at %d fps", config_.loopbackOnly ? "127.0.0.1" : "0.0.0.0",
+          port_, config_.width, config_.fps);
+    return true;
+}
+
+void MirrorStream::Stop() {
+    if (!running_) return;
+    running_ = false;
+    wake_.notify_one();
+    if (thread_.joinable()) thread_.join();
+    close(listenFd_);
+    listenFd_ = -1;
+    port_ = 0;
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.port = 0;
+}
+
+void MirrorStream::Poll() {
+    if (frameCpuNs_ > 0) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.renderCpuNs += frameCpuNs_;
+        stats_.maxRenderCpuNs = std::max(stats_.maxRenderCpuNs, frameCpuNs_);
+    }
+    frameCpuNs_ = 0;
+    if (readback_.InFlight() == 0) return;
+    const int64_t start = NowNs();
+    readback_.Collect(&MirrorStream::OnReadback, this);
+    frameCpuNs_ += NowNs() - start;
+}
+
+void MirrorStream::CaptureView(GLuint framebuffer, int32_t width, int32_t height, int64_t frameTimeNs) {
+    if (!clientConnected_.load(std::memory_order_relaxed) || frameTimeNs < nextFrameNs_) return;
+    const int64_t start = NowNs();
+    const int64_t periodNs = 1000000000LL / config_.fps;
+    nextFrameNs_ = nextFrameNs_ == 0 ? frameTimeNs + periodNs : nextFrameNs_ + periodNs;
+    if (nextFrameNs_ <= frameTimeNs) nextFrameNs_ = frameTimeNs + periodNs;
+    sequence_++;
+    if (readback_.InFlight() == kReadbackSlots) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.dropped++;
+        return;
+    }
+
+    if (width != sourceWidth_ || height != sourceHeight_) BuildLevels(width, height);
+    GLuint read = framebuffer;
+    int32_t readWidth = width;
+    int32_t readHeight = height;
+    for (uint32_t i = 0; i < levelCount_; i++) {
+        const Level& level = levels_[i];
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, read);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, level.framebuffer);
+        glBlitFramebuffer(0, 0, readWidth, readHeight, 0, 0, level.width, level.height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+        read = level.framebuffer;
+        readWidth = level.width;
+        readHeight = level.height;
+    }
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, read);
+    readback_.Issue(readWidth, readHeight, frameTimeNs, "mirror stream");
+    pending_.push_back({sequence_, start});
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    frameCpuNs_ += NowNs() - start;
+}
+
+void MirrorStream::BuildLevels(int32_t sourceWidth, int32_t sourceHeight) {
+    DestroyLevels();
+    sourceWidth_ = sourceWidth;
+    sourceHeight_ = sourceHeight;
+    // Halving with a linear filter averages exact 2x2 blocks; only the last
+    // step, to the requested width, resamples.
+    const int32_t target = std::min(config_.width, sourceWidth);
+    int32_t width = sourceWidth;
+    int32_t height = sourceHeight;
+    auto addLevel = [this](int32_t w, int32_t h) {
+        Level& level = levels_[levelCount_++];
+        level.width = w;
+        level.height = h;
+        glGenTextures(1, &level.texture);
+        glBindTexture(GL_TEXTURE_2D, level.texture);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, w, h);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        GpuResources_Register(GPU_KIND_TEXTURE, level.texture, GPU_CATEGORY_RENDER_TARGET, GL_RGBA8,
+                              GpuResources_ImageBytes(GL_RGBA8, w, h), "mirror stream");
+        glGenFramebuffers(1, &level.framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, level.framebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, level.texture, 0);
+    };
+    while (levelCount_ < kMaxMirrorLevels - 1 && width / 2 >= target) {
+        width /= 2;
+        height /= 2;
+        addLevel(width, height);
+    }
+    if (width != target) {
+        addLevel(target, std::max<int32_t>(2, static_cast<int32_t>(static_cast<int64_t>(sourceHeight) * target / sourceWidth) & ~1));
+    }
+    ALOGI("Mirror stream: %dx%d eye downsampled to %dx%d in %u blits", sourceWidth, sourceHeight,
+          levelCount_ > 0 ? levels_[levelCount_ - 1].width : sourceWidth,
+          levelCount_ > 0 ? levels_[levelCount_ - 1].height : sourceHeight, levelCount_);
+}
+
+void MirrorStream::DestroyLevels() {
+    for (uint32_t i = 0; i < levelCount_; i++) {
+        GpuResources_DeferDelete(GPU_KIND_FRAMEBUFFER, levels_[i].framebuffer);
+        GpuResources_DeferDelete(GPU_KIND_TEXTURE, levels_[i].texture);
+        levels_[i] = Level();
+    }
+    levelCount_ = 0;
+    sourceWidth_ = sourceHeight_ = 0;
+}
+
+void MirrorStream::ReleaseGl() {
+    readback_.Release();
+    pending_.clear();
+    DestroyLevels();
+}
+
+void MirrorStream::OnReadback(const uint8_t* rgba, int32_t width, int32_t height, int64_t timeNs, void* user) {
+    auto* self = static_cast<MirrorStream*>(user);
+    const Pending pending = self->pending_.front();
+    self->pending_.pop_front();
+    if (rgba == nullptr) return;
+
+    PixelBuffer buffer;
+    {
+        std::lock_guard<std::mutex> lock(self->mutex_);
+        if (self->frameReady_) {
+            // The mirror thread has not taken the last one: the newer image wins.
+            self->stats_.dropped++;
+            self->frameReady_ = false;
+            buffer = std::move(self->frame_.rgba);
+        } else {
+            buffer = std::move(self->spare_);
+        }
+    }
+    // GL rows are bottom-up; PNG wants the top row first.
+    const size_t rowBytes = static_cast<size_t>(width) * 4;
+    buffer.resize(rowBytes * height);
+    for (int32_t row = 0; row < height; row++) {
+        memcpy(buffer.data() + static_cast<size_t>(row) * rowBytes,
+               rgba + static_cast<size_t>(height - 1 - row) * rowBytes, rowBytes);
+    }
+    {
+        std::lock_guard<std::mutex> lock(self->mutex_);
+        self->frame_.header.sequence = pending.sequence;
+        self->frame_.header.width = static_cast<uint32_t>(width);
+        self->frame_.header.height = static_cast<uint32_t>(height);
+        self->frame_.header.timeNs = timeNs;
+        self->frame_.issuedNs = pending.issuedNs;
+        self->frame_.rgba = std::move(buffer);
+        self->frameReady_ = true;
+    }
+    self->wake_.notify_one();
+}
+
+MirrorStats MirrorStream::Stats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void MirrorStream::SendLoop() {
+    ThreadRoleScope role(THREAD_ROLE_WORKER, "iris-mirror");
+    int client = -1;
+    auto disconnect = [&](const char* reason) {
+        close(client);
+        client = -1;
+        clientConnected_ = false;
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.clientConnected = false;
+        ALOGI("Mirror client disconnected (%s)", reason);
+    };
+    TrackedVector<uint8_t, MEM_TAG_CAPTURE> png;
+    size_t lastFrameBytes = 0;
+    while (running_) {
+        if (client < 0) {
+            pollfd pfd = {listenFd_, POLLIN, 0};
+            if (poll(&pfd, 1, 100) <= 0) continue;
+            client = accept(listenFd_, nullptr, nullptr);
+            if (client < 0) continue;
+            int one = 1;
+            setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            // A client that stops reading for this long is dropped.
+            timeval timeout = {1, 0};
+            setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stats_.clients++;
+                stats_.clientConnected = true;
+                frameReady_ = false;   // read back before anyone was watching
+            }
+            clientConnected_ = true;
+            lastFrameBytes = 0;
+            ALOGI("Mirror client connected");
+            continue;
+        }
+
+        Frame frame;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait_for(lock, std::chrono::milliseconds(100), [this] { return frameReady_ || !running_; });
+            if (frameReady_) {
+                frame.header = frame_.header;
+                frame.issuedNs = frame_.issuedNs;
+                frame.rgba = std::move(frame_.rgba);
+                frameReady_ = false;
+            }
+        }
+        if (frame.rgba.empty()) {
+            if (ClientHungUp(client)) disconnect("closed by peer");
+            continue;
+        }
+
+        // Socket buffers hold seconds of small frames; letting them fill would
+        // turn a slow link into growing latency. While the previous frame is
+        // still mostly unacknowledged, skip this one, encoding included.
+        if (lastFrameBytes > 0 && static_cast<size_t>(QueuedBytes(client)) > lastFrameBytes / 2) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stats_.dropped++;
+            spare_ = std::move(frame.rgba);
+            continue;
+        }
+
+        const int64_t cpuStart = ThreadCpuNs();
+        const bool encoded = EncodePng(frame.rgba.data(), static_cast<int32_t>(frame.header.width),
+                                       static_cast<int32_t>(frame.header.height), png);
+        const int64_t encodeNs = ThreadCpuNs() - cpuStart;
+        bool sent = false;
+        if (encoded) {
+            uint8_t header[kMirrorHeaderBytes];
+            frame.header.payloadBytes = static_cast<uint32_t>(png.size());
+            PackMirrorHeader(frame.header, header);
+            sent = SendAll(client, header, sizeof(header)) && SendAll(client, png.data(), png.size());
+            lastFrameBytes = sizeof(header) + png.size();
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            spare_ = std::move(frame.rgba);
+            stats_.encodeCpuNs += encodeNs;
+            if (sent) {
+                stats_.framesSent++;
+                stats_.bytesSent += kMirrorHeaderBytes + png.size();
+                stats_.lastLatencyNs = NowNs() - frame.issuedNs;
+            }
+        }
+        if (encoded && !sent) disconnect(errno == EAGAIN || errno == EWOULDBLOCK ? "send timed out" : strerror(errno));
+    }
+    if (client >= 0) disconnect("stream stopped");
+}
+
+// =============================================================================
+// Loopback Client
+// =============================================================================
+bool MirrorLoopbackClient::Start(uint16_t port, int readDelayMs, const std::string& savePath) {
+    if (running_) return true;
+    fd_ = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd_ < 0) return false;
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if (connect(fd_, (sockaddr*)&addr, sizeof(addr)) != 0) {
+        ALOGE("MirrorLoopbackClient: connect to 127.0.0.1:%u failed: %s", port, strerror(errno));
+        close(fd_);
+        fd_ = -1;
+        return false;
+    }
+    readDelayMs_ = readDelayMs;
+    savePath_ = savePath;
+    running_ = true;
+    thread_ = std::thread(&MirrorLoopbackClient::Receive, this);
+    return true;
+}
+
+void MirrorLoopbackClient::Stop() {
+    if (fd_ < 0) return;
+    running_ = false;
+    if (thread_.joinable()) thread_.join();
+    close(fd_);
+    fd_ = -1;
+    if (!savePath_.empty() && !lastPng_.empty()) {
+        FILE* file = fopen(savePath_.c_str(), "wb");
+        if (file != nullptr) {
+            fwrite(lastPng_.data(), 1, lastPng_.size(), file);
+            fclose(file);
+        }
+    }
+}
+
+MirrorClientStats MirrorLoopbackClient::Stats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void MirrorLoopbackClient::Receive() {
+    auto readAll = [this](uint8_t* out, size_t length) {
+        while (length > 0) {
+            pollfd pfd = {fd_, POLLIN, 0};
+            const int ready = poll(&pfd, 1, 100);
+            if (!running_) return false;
+            if (ready <= 0) continue;
+            const ssize_t n = recv(fd_, out, length, 0);
+            if (n <= 0) return false;
+            out += n;
+            length -= static_cast<size_t>(n);
+        }
+        return true;
+    };
+    TrackedVector<uint8_t, MEM_TAG_CAPTURE> png;
+    bool first = true;
+    uint32_t lastSequence = 0;
+    while (running_) {
+        uint8_t head[kMirrorHeaderBytes];
+        MirrorFrameHeader header;
+        if (!readAll(head, sizeof(head))) break;
+        if (!UnpackMirrorHeader(head, header) || header.payloadBytes > (64u << 20)) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stats_.malformed++;
+            break;   // the stream cannot be resynchronized
+        }
+        png.resize(header.payloadBytes);
+        if (!readAll(png.data(), png.size())) break;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stats_.frames++;
+            stats_.bytes += kMirrorHeaderBytes + png.size();
+            if (!first && header.sequence > lastSequence + 1) stats_.sequenceGaps += header.sequence - lastSequence - 1;
+            stats_.lastWidth = header.width;
+            stats_.lastHeight = header.height;
+            if (png.size() >= sizeof(kPngSignature) && memcmp(png.data(), kPngSignature, sizeof(kPngSignature)) == 0) {
+                lastPng_.swap(png);
+            } else {
+                stats_.malformed++;
+            }
+        }
+        first = false;
+        lastSequence = header.sequence;
+        if (readDelayMs_ > 0) std::this_thread::sleep_for(std::chrono::milliseconds(readDelayMs_));
+    }
+}
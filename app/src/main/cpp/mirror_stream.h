@@ -0,0 +1,177 @@
+#pragma once
+
+#include <GLES3/gl32.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "allocator.h"
+#include "image_capture.h"
+
+// =============================================================================
+// Mirror Stream
+// =============================================================================
+// Shows a companion device what the wearer sees, for demos and debugging. One
+// eye is downsampled on the GPU by a chain of linear blits (exact 2:1 box
+// filters, then one step to the requested width), read back through a
+// ReadbackRing, PNG-encoded on the "iris-mirror" thread and sent over TCP to a
+// single client. The device listens; a laptop reaches it through
+// `adb forward tcp:<port> tcp:<port>` or, with loopbackOnly off, over Wi-Fi.
+//
+// Every stage drops rather than waits. With no client connected CaptureView()
+// does no GL work at all; a full readback ring skips the frame; a frame not yet
+// picked up by the mirror thread is replaced by the newer one; and a slow
+// client only ever blocks the mirror thread, never the render loop.
+//
+// Wire format: for every frame a kMirrorHeaderBytes header (MirrorFrameHeader
+// fields in declaration order, little-endian, after a kMirrorMagic word), then
+// payloadBytes of PNG.
+
+constexpr uint32_t kMirrorMagic = 0x464d5249;   // "IRMF"
+constexpr size_t kMirrorHeaderBytes = 28;
+constexpr uint32_t kMaxMirrorLevels = 6;
+
+struct MirrorFrameHeader {
+    uint32_t sequence = 0;       // frames captured so far; gaps are drops
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t payloadBytes = 0;
+    int64_t timeNs = 0;          // display time of the frame
+};
+
+void PackMirrorHeader(const MirrorFrameHeader& header, uint8_t* out);
+// False when the magic word does not match.
+bool UnpackMirrorHeader(const uint8_t* in, MirrorFrameHeader& header);
+
+struct MirrorConfig {
+    uint16_t port = 0;           // 0 picks a free one
+    bool loopbackOnly = true;
+    int32_t width = 480;         // of the streamed image; the height keeps the eye's aspect
+    int32_t fps = 15;
+};
+
+struct MirrorStats {
+    uint16_t port = 0;           // 0 while stopped
+    bool clientConnected = false;
+    uint64_t clients = 0;        // accepted so far
+    uint64_t framesSent = 0;
+    uint64_t dropped = 0;        // readback ring full or replaced before it was sent
+    uint64_t bytesSent = 0;
+    int64_t renderCpuNs = 0;     // render thread: blits, readback, copy, total
+    int64_t maxRenderCpuNs = 0;  // the most any one frame spent on it
+    int64_t encodeCpuNs = 0;     // mirror thread, encoding only, total
+    int64_t lastLatencyNs = 0;   // blit issued -> last byte handed to the socket
+};
+
+class MirrorStream {
+public:
+    ~MirrorStream() { Stop(); }
+
+    // Render thread. Start() binds the port and starts the mirror thread.
+    bool Start(const MirrorConfig& config);
+    void Stop();
+    bool IsRunning() const { return running_; }
+    uint16_t Port() const { return port_; }
+
+    // Once per frame, before any view is drawn: collects finished readbacks.
+    void Poll();
+    // After the eye is drawn into `framebuffer`, which is left bound to GL_FRAMEBUFFER.
+    void CaptureView(GLuint framebuffer, int32_t width, int32_t height, int64_t frameTimeNs);
+    // GL thread. Frees the blit targets and readback buffers.
+    void ReleaseGl();
+
+    // Any thread.
+    MirrorStats Stats();
+
+private:
+    typedef TrackedVector<uint8_t, MEM_TAG_CAPTURE> PixelBuffer;
+    struct Level {
+        GLuint texture = 0;
+        GLuint framebuffer = 0;
+        int32_t width = 0;
+        int32_t height = 0;
+    };
+    // One readback in flight.
+    struct Pending {
+        uint32_t sequence;
+        int64_t issuedNs;
+    };
+    // The newest image waiting for the mirror thread.
+    struct Frame {
+        MirrorFrameHeader header;
+        int64_t issuedNs = 0;
+        PixelBuffer rgba;
+    };
+
+    void BuildLevels(int32_t sourceWidth, int32_t sourceHeight);
+    void DestroyLevels();
+    static void OnReadback(const uint8_t* rgba, int32_t width, int32_t height, int64_t timeNs, void* self);
+    void SendLoop();
+
+    // Render thread.
+    MirrorConfig config_;
+    uint16_t port_ = 0;
+    ReadbackRing readback_;
+    Level levels_[kMaxMirrorLevels];
+    uint32_t levelCount_ = 0;
+    int32_t sourceWidth_ = 0;
+    int32_t sourceHeight_ = 0;
+    std::deque<Pending> pending_;
+    uint32_t sequence_ = 0;
+    int64_t nextFrameNs_ = 0;
+    int64_t frameCpuNs_ = 0;
+
+    // Shared with the mirror thread.
+    std::thread thread_;
+    std::atomic<bool> running_{false};
+    std::atomic<bool> clientConnected_{false};
+    int listenFd_ = -1;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    Frame frame_;
+    bool frameReady_ = false;
+    PixelBuffer spare_;
+    MirrorStats stats_;
+};
+
+// -----------------------------------------------------------------------------
+// Loopback client for testing the whole pipeline on one machine. Connects to
+// 127.0.0.1, checks every frame's header and PNG signature, and can read slowly
+// to exercise the drop path.
+// -----------------------------------------------------------------------------
+struct MirrorClientStats {
+    uint64_t frames = 0;
+    uint64_t bytes = 0;
+    uint64_t sequenceGaps = 0;   // frames the sender dropped between two received ones
+    uint64_t malformed = 0;
+    uint32_t lastWidth = 0;
+    uint32_t lastHeight = 0;
+};
+
+class MirrorLoopbackClient {
+public:
+    ~MirrorLoopbackClient() { Stop(); }
+
+    // readDelayMs pauses after every frame, like a slow link or a busy viewer.
+    // With a savePath, the last frame received is written there as a PNG on Stop().
+    bool Start(uint16_t port, int readDelayMs, const std::string& savePath = std::string());
+    void Stop();
+    MirrorClientStats Stats();
+
+private:
+    void Receive();
+
+    std::thread thread_;
+    std::atomic<bool> running_{false};
+    int fd_ = -1;
+    int readDelayMs_ = 0;
+    std::string savePath_;
+    std::mutex mutex_;
+    MirrorClientStats stats_;
+    TrackedVector<uint8_t, MEM_TAG_CAPTURE> lastPng_;
+};
@@ -4,9 +4,11 @@
 #include <vector>
 #include <mutex>
 #include <condition_variable>
+#include <atomic>
+#include <algorithm>
 #include <cmath> // For sinf and cosf
 
-#include <android/log.h>
+#include <android/asset_manager_jni.h>
 #include <android/native_window.h>
 
 #include <EGL/egl.h>
@@ -20,9 +22,23 @@
 #include <openxr/openxr_platform.h>
 #include <openxr/openxr_reflection.h>
 
-#define LOG_TAG "IrisAgent_Native"
-#define ALOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
-#define ALOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+#include "allocator.h"
+#include "asset_bundle.h"
+#include "audio_capture.h"
+#include "common.h"
+#include "frame_capture.h"
+#include "frame_pacing.h"
+#include "gl_trace.h"
+#include "gpu_resources.h"
+#include "image_capture.h"
+#include "mirror_stream.h"
+#include "perf_hint.h"
+#include "renderer.h"
+#include "spatial_mixer.h"
+#include "stream_client.h"
+#include "thread_roles.h"
+#include "vision_roi.h"
+#include "visual_dedup.h"
 
 #define OXR_CHECK(instance, result, message) \
     [&](XrResult res) { \
@@ -37,76 +53,6 @@
         return res; \
     }(result)
 
-// =============================================================================
-// 3D Math Library (Matrix)
-// =============================================================================
-struct Matrix4f {
-    float M[16];
-    static Matrix4f CreateIdentity() {
-        Matrix4f r;
-        for (int i = 0; i < 16; i++) r.M[i] = (i % 5 == 0) ? 1.0f : 0.0f;
-        return r;
-    }
-};
-
-Matrix4f Matrix4f_Multiply(const Matrix4f& a, const Matrix4f& b) {
-    Matrix4f result;
-    for (int i = 0; i < 4; i++) {
-        for (int j = 0; j < 4; j++) {
-            result.M[i * 4 + j] = a.M[i * 4 + 0] * b.M[0 * 4 + j] +
-                                  a.M[i * 4 + 1] * b.M[1 * 4 + j] +
-                                  a.M[i * 4 + 2] * b.M[2 * 4 + j] +
-                                  a.M[i * 4 + 3] * b.M[3 * 4 + j];
-        }
-    }
-    return result;
-}
-
-Matrix4f Matrix4f_CreateProjectionFov(const XrFovf fov, const float nearZ, const float farZ) {
-    const float tanLeft = tanf(fov.angleLeft);
-    const float tanRight = tanf(fov.angleRight);
-    const float tanDown = tanf(fov.angleDown);
-    const float tanUp = tanf(fov.angleUp);
-    const float tanAngleWidth = tanRight - tanLeft;
-    const float tanAngleHeight = tanUp - tanDown;
-    Matrix4f result = {};
-    result.M[0] = 2.0f / tanAngleWidth;
-    result.M[5] = 2.0f / tanAngleHeight;
-    result.M[8] = (tanRight + tanLeft) / tanAngleWidth;
-    result.M[9] = (tanUp + tanDown) / tanAngleHeight;
-    result.M[10] = -(farZ + nearZ) / (farZ - nearZ);
-    result.M[11] = -1.0f;
-    result.M[14] = -2.0f * farZ * nearZ / (farZ - nearZ);
-    return result;
-}
-
-Matrix4f Matrix4f_CreateFromQuaternion(const XrQuaternionf& q) {
-    Matrix4f result = Matrix4f::CreateIdentity();
-    const float x2 = q.x + q.x, y2 = q.y + q.y, z2 = q.z + q.z;
-    const float xx = q.x * x2, xy = q.x * y2, xz = q.x * z2;
-    const float yy = q.y * y2, yz = q.y * z2, zz = q.z * z2;
-    const float wx = q.w * x2, wy = q.w * y2, wz = q.w * z2;
-    result.M[0] = 1.0f - (yy + zz); result.M[1] = xy - wz; result.M[2] = xz + wy;
-    result.M[4] = xy + wz; result.M[5] = 1.0f - (xx + zz); result.M[6] = yz - wx;
-    result.M[8] = xz - wy; result.M[9] = yz + wx; result.M[10] = 1.0f - (xx + yy);
-    return result;
-}
-
-Matrix4f Matrix4f_CreateView(const XrPosef& pose) {
-    Matrix4f rotation = Matrix4f_CreateFromQuaternion(pose.orientation);
-    Matrix4f translation = Matrix4f::CreateIdentity();
-    translation.M[12] = -pose.position.x;
-    translation.M[13] = -pose.position.y;
-    translation.M[14] = -pose.position.z;
-    return Matrix4f_Multiply(rotation, translation);
-}
-
-Matrix4f Matrix4f_CreateTranslation(float x, float y, float z) {
-    Matrix4f r = Matrix4f::CreateIdentity();
-    r.M[12] = x; r.M[13] = y; r.M[14] = z;
-    return r;
-}
-
 // =============================================================================
 // App State & Structures
 // =============================================================================
@@ -116,25 +62,47 @@ struct GraphicsState {
     EGLConfig config = nullptr;
 };
 
+// Time spent in xrWaitSwapchainImage. A wait runs in bounded slices; every slice
+// that expires is a timeout, and an acquire that needed more than one is a stall.
+struct SwapchainWaitStats {
+    uint64_t acquires = 0;
+    uint64_t timeouts = 0;
+    uint64_t stalls = 0;
+    int64_t totalWaitNs = 0;
+    int64_t maxWaitNs = 0;
+    int64_t lastWaitNs = 0;
+};
+
 struct Swapchain {
     XrSwapchain handle = XR_NULL_HANDLE;
     int32_t width = 0;
     int32_t height = 0;
     std::vector<XrSwapchainImageOpenGLESKHR> images;
     GLuint depthTexture = 0;
+    GLenum depthFormat = 0;
+    SwapchainWaitStats waitStats;
+};
+
+// How much had to be rebuilt before frames flowed again.
+enum ResumeKind : uint8_t {
+    RESUME_COLD = 0,    // EGL context, programs and assets created from scratch
+    RESUME_WARM,        // activity recreated: new instance and session, GL state kept
+    RESUME_SESSION,     // session lost and recreated on the same instance
+    RESUME_HOT,         // activity pause/resume or session STOPPING/READY: nothing rebuilt
+    RESUME_KIND_COUNT
 };
 
-struct GraphicsPipeline {
-    GLuint shaderProgram = 0;
-    GLint mvpLocation = -1;
-    GLuint vao = 0;
-    GLuint vbo = 0;
-    GLuint ebo = 0;
+struct ResumeStats {
+    uint64_t count = 0;
+    int64_t lastNs = 0;
+    int64_t bestNs = 0;
 };
 
 struct AppState {
     JavaVM* vm = nullptr;
     jobject mainActivity = nullptr;
+    jobject assetManagerRef = nullptr;   // keeps assetManager alive
+    AAssetManager* assetManager = nullptr;
     XrInstance xrInstance = XR_NULL_HANDLE;
     XrSession xrSession = XR_NULL_HANDLE;
     XrSystemId systemId = XR_NULL_SYSTEM_ID;
@@ -142,89 +110,112 @@ struct AppState {
     XrEnvironmentBlendMode blendMode = XR_ENVIRONMENT_BLEND_MODE_OPAQUE;
     GraphicsState graphics = {};
     GraphicsPipeline pipeline = {};
+    AssetBundle bundle;   // stays mapped while the pipeline lives: an evicted mesh is reloaded from it
+    Scene scene;
+    int32_t msaaSamplesRequested = 1;   // set from JNI before the app thread creates swapchains
+    MsaaConfig msaa = {};
+    bool reversedZRequested = false;    // likewise
+    int32_t depthBitsRequested = 24;
+    DepthConfig depth = {};
     std::vector<XrViewConfigurationView> viewConfigs;
     std::vector<Swapchain> swapchains;
     std::vector<XrView> views;
     std::vector<uint32_t> framebuffers;
+    std::vector<SwapchainWaitStats> swapchainWaitStats;   // copied for JNI under appMutex
+    float lodPixelErrorRequested = 1.0f;   // set from JNI, applied at the top of every frame
+    SceneLodStats lodStats;                // copied for JNI under appMutex
+    uint32_t lodCount = 0;                 // likewise
+    // XR_KHR_visibility_mask hidden-area meshes, one per view; refetched only
+    // when the runtime sends XrEventDataVisibilityMaskChangedKHR.
+    bool visibilityMaskEnabled = false;
+    PFN_xrGetVisibilityMaskKHR xrGetVisibilityMask = nullptr;
+    std::vector<VisibilityMask> visibilityMasks;
+    // Per-frame scratch (layer lists, projection views), reset at the top of every frame.
+    LinearArena frameArena{MEM_TAG_FRAME, 16 * 1024};
     std::thread appThread;
     std::mutex appMutex;
     std::condition_variable appCondition;
     bool resumed = false;
     bool running = false;
     bool sessionReady = false;
+    uint64_t frameIndex = 0;
+    // What survives the app thread and the runtime's losses. The EGL context,
+    // programs and scene outlive an activity that is only being recreated; the
+    // instance outlives a lost session. Only what the runtime invalidated is rebuilt.
+    bool graphicsAssetsReady = false;
+    bool keepGraphics = false;      // set by onDestroyNative when the activity is not finishing
+    bool sessionLost = false;       // XR_SESSION_STATE_LOSS_PENDING: session resources gone
+    bool instanceLost = false;      // XrEventDataInstanceLossPending: instance gone as well
+    PFN_xrGetOpenGLESGraphicsRequirementsKHR xrGetOpenGLESGraphicsRequirements = nullptr;
+    // Resume-to-first-frame timing, under appMutex: started when frames are
+    // wanted again, finished by the first frame submitted with a layer.
+    int64_t resumeStartNs = 0;
+    ResumeKind resumeKind = RESUME_COLD;
+    ResumeStats resumeStats[RESUME_KIND_COUNT];
+    // XR_KHR_android_thread_settings, when the runtime has it; threads are
+    // reported through ThreadRoles once the session exists.
+    bool threadSettingsEnabled = false;
+    PFN_xrSetAndroidApplicationThreadKHR xrSetAndroidApplicationThread = nullptr;
+    int32_t mainThreadId = 0;
+    int64_t lastFrameWakeNs = 0;   // xrWaitFrame return, for the render-thread latency probe
+    // ADPF session for the render and worker threads, opened on the first frame
+    // once the display period is known. Stats are copied for JNI under appMutex.
+    PerfHintSession perfHint;
+    bool perfHintTried = false;
+    PerfHintStats perfHintStats = {};
+    // Missed/duplicated frame detection with per-phase CPU and GPU times.
+    FramePacingMonitor framePacing;
+    GpuTimer gpuTimer;
+    // Assistant backend streaming; tokens are drained by the render thread each frame.
+    StreamClient streamClient;
+    StreamStandInServer streamStandIn;
+    std::basic_string<char, std::char_traits<char>, TrackingAllocator<char, MEM_TAG_TEXT>> assistantText;
+    uint32_t assistantRequestId = 0;
+    // Microphone capture with voice activity segmentation.
+    AudioCapture audioCapture;
+    // Spatialized speech/earcon output, listener pose fed from the frame loop.
+    SpatialMixer spatialMixer;
+    TrackedVector<float, MEM_TAG_AUDIO> earconClip;
+    // Per-frame input recording for off-device replay. The path is handed over
+    // from JNI under appMutex and picked up by the app thread.
+    FrameCaptureWriter frameCapture;
+    std::string frameCaptureRequest;
+    bool frameCaptureRequested = false;
+    CapturedInput lastCapturedInput = {};
+    // Screenshots and recordings of the left eye. Requests are handed over from
+    // JNI under appMutex; stats are snapshotted there once per frame.
+    ImageCapture imageCapture;
+    std::string stillRequest;
+    std::string recordingRequest;
+    int32_t recordingFps = 30;
+    bool recordingRequested = false;
+    ImageCaptureStats imageCaptureStats;
+    // Downsampled left eye streamed to a companion. Like the capture requests,
+    // configuration changes go through appMutex and are applied by the app thread.
+    MirrorStream mirror;
+    MirrorConfig mirrorRequest;
+    bool mirrorEnabledRequested = false;
+    bool mirrorRequested = false;
+    MirrorStats mirrorStats;
+    // Gate in front of the vision queries. Called from the Java sender's thread;
+    // it reads head poses from the history below.
+    VisualQueryDedup visualDedup;
+    // Crops vision uploads around the view direction. The history matches a
+    // camera frame with the head pose it was captured at.
+    VisionRoiCropper visionRoi;
+    HeadPoseHistory headPoses;
 };
 static AppState appState = {};
+static constexpr uint32_t kMaxFrameLayers = 4;
+// While the runtime is unavailable after a loss, recreation is retried this often.
+static constexpr int kXrRecoveryRetryMs = 500;
+// Stall warnings repeat at this interval while the compositor keeps an image.
+static constexpr int64_t kSwapchainStallLogIntervalNs = 1000000000LL;
 
 // =============================================================================
 // Graphics Setup & Lifecycle
 // =============================================================================
 
-bool CreateGraphicsPipeline() {
-    const char* vertexShaderSrc = R"glsl(
-        #version 320 es
-        layout (location = 0) in vec3 aPos;
-        layout (location = 1) in vec3 aColor; // Input for vertex color
-        uniform mat4 uMvp;
-        out vec3 vColor;
-        void main() {
-            gl_Position = uMvp * vec4(aPos, 1.0);
-            vColor = aColor; // Pass color to fragment shader
-        }
-    )glsl";
-    const char* fragmentShaderSrc = R"glsl(
-        #version 320 es
-        precision mediump float;
-        in vec3 vColor;
-        out vec4 FragColor;
-        void main() {
-            FragColor = vec4(vColor, 1.0);
-        }
-    )glsl";
-
-    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexShaderSrc, nullptr);
-    glCompileShader(vertexShader);
-    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentShaderSrc, nullptr);
-    glCompileShader(fragmentShader);
-    appState.pipeline.shaderProgram = glCreateProgram();
-    glAttachShader(appState.pipeline.shaderProgram, vertexShader);
-    glAttachShader(appState.pipeline.shaderProgram, fragmentShader);
-    glLinkProgram(appState.pipeline.shaderProgram);
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
-    appState.pipeline.mvpLocation = glGetUniformLocation(appState.pipeline.shaderProgram, "uMvp");
-
-    float vertices[] = {
-            -0.5f, -0.5f, 0.0f,   1.0f, 0.0f, 0.0f, // Bottom-left, Red
-            0.5f, -0.5f, 0.0f,   0.0f, 1.0f, 0.0f, // Bottom-right, Green
-            0.5f,  0.5f, 0.0f,   0.0f, 0.0f, 1.0f, // Top-right, Blue
-            -0.5f,  0.5f, 0.0f,   1.0f, 1.0f, 0.0f  // Top-left, Yellow
-    };
-
-    unsigned int indices[] = {
-            0, 1, 2, // First triangle
-            2, 3, 0  // Second triangle
-    };
-
-    glGenVertexArrays(1, &appState.pipeline.vao);
-    glGenBuffers(1, &appState.pipeline.vbo);
-    glGenBuffers(1, &appState.pipeline.ebo);
-    glBindVertexArray(appState.pipeline.vao);
-    glBindBuffer(GL_ARRAY_BUFFER, appState.pipeline.vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, appState.pipeline.ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-
-    glBindVertexArray(0);
-
-    return true;
-}
-
 bool initializeGraphics() {
     ALOGI("Initializing EGL graphics...");
     appState.graphics.display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
@@ -242,20 +233,337 @@ bool initializeGraphics() {
     return true;
 }
 
+static_assert(RUNTIME_THREAD_APPLICATION_MAIN == static_cast<int32_t>(XR_ANDROID_THREAD_TYPE_APPLICATION_MAIN_KHR) &&
+              RUNTIME_THREAD_APPLICATION_WORKER == static_cast<int32_t>(XR_ANDROID_THREAD_TYPE_APPLICATION_WORKER_KHR) &&
+              RUNTIME_THREAD_RENDERER_MAIN == static_cast<int32_t>(XR_ANDROID_THREAD_TYPE_RENDERER_MAIN_KHR) &&
+              RUNTIME_THREAD_RENDERER_WORKER == static_cast<int32_t>(XR_ANDROID_THREAD_TYPE_RENDERER_WORKER_KHR),
+              "RuntimeThreadType must mirror XrAndroidThreadTypeKHR");
+
+static bool RegisterThreadWithRuntime(RuntimeThreadType type, int32_t tid, void*) {
+    const XrResult result = appState.xrSetAndroidApplicationThread(appState.xrSession, static_cast<XrAndroidThreadTypeKHR>(type), static_cast<uint32_t>(tid));
+    return XR_SUCCEEDED(result);
+}
+
+static bool InstanceExtensionSupported(const char* name) {
+    uint32_t count = 0;
+    if (XR_FAILED(xrEnumerateInstanceExtensionProperties(nullptr, 0, &count, nullptr))) return false;
+    std::vector<XrExtensionProperties> properties(count, {XR_TYPE_EXTENSION_PROPERTIES});
+    if (XR_FAILED(xrEnumerateInstanceExtensionProperties(nullptr, count, &count, properties.data()))) return false;
+    for (const auto& p : properties) {
+        if (strcmp(p.extensionName, name) == 0) return true;
+    }
+    return false;
+}
+
+static void FetchVisibilityMask(uint32_t viewIndex) {
+    if (appState.xrGetVisibilityMask == nullptr || viewIndex >= appState.visibilityMasks.size()) return;
+    XrVisibilityMaskKHR mask = {XR_TYPE_VISIBILITY_MASK_KHR};
+    if (OXR_CHECK(appState.xrInstance, appState.xrGetVisibilityMask(appState.xrSession, XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO, viewIndex, XR_VISIBILITY_MASK_TYPE_HIDDEN_TRIANGLE_MESH_KHR, &mask), "xrGetVisibilityMaskKHR") != XR_SUCCESS) return;
+    std::vector<XrVector2f> vertices(mask.vertexCountOutput);
+    std::vector<uint32_t> indices(mask.indexCountOutput);
+    mask.vertexCapacityInput = mask.vertexCountOutput;
+    mask.vertices = vertices.data();
+    mask.indexCapacityInput = mask.indexCountOutput;
+    mask.indices = indices.data();
+    if (OXR_CHECK(appState.xrInstance, appState.xrGetVisibilityMask(appState.xrSession, XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO, viewIndex, XR_VISIBILITY_MASK_TYPE_HIDDEN_TRIANGLE_MESH_KHR, &mask), "xrGetVisibilityMaskKHR") != XR_SUCCESS) return;
+    UpdateVisibilityMask(appState.visibilityMasks[viewIndex], vertices.data(), mask.vertexCountOutput, indices.data(), mask.indexCountOutput);
+    ALOGI("Visibility mask for view %u: %u triangles.", viewIndex, mask.indexCountOutput / 3);
+}
+
+// Acquire plus a wait bounded by `timeoutNs` per attempt. A timeout means the
+// compositor still holds the image; it is counted, reported to the pacing monitor
+// and GL trace, and retried. The image cannot be released before its wait
+// succeeds, so retrying only stops when the app is shutting down.
+static bool AcquireSwapchainImage(Swapchain& sc, uint32_t viewIndex, XrDuration timeoutNs, uint32_t& imageIndex) {
+    if (OXR_CHECK(appState.xrInstance, xrAcquireSwapchainImage(sc.handle, nullptr, &imageIndex), "xrAcquireSwapchainImage") != XR_SUCCESS) return false;
+    const int64_t startNs = NowNs();
+    int64_t lastLogNs = startNs;
+    uint32_t timeouts = 0;
+    XrSwapchainImageWaitInfo waitInfo = {XR_TYPE_SWAPCHAIN_IMAGE_WAIT_INFO, nullptr, timeoutNs};
+    XrResult result;
+    while ((result = OXR_CHECK(appState.xrInstance, xrWaitSwapchainImage(sc.handle, &waitInfo), "xrWaitSwapchainImage")) == XR_TIMEOUT_EXPIRED) {
+        const int64_t now = NowNs();
+        if (timeouts++ == 0) {
+            appState.framePacing.NoteSwapchainStall();
+            ALOGW("Swapchain %u image %u still held by the compositor after %.2f ms, retrying.", viewIndex, imageIndex, (now - startNs) / 1e6);
+        } else if (now - lastLogNs >= kSwapchainStallLogIntervalNs) {
+            ALOGW("Swapchain %u stalled for %.0f ms (%u timeouts).", viewIndex, (now - startNs) / 1e6, timeouts);
+            lastLogNs = now;
+        }
+        GlTrace_Marker("swapchain wait timeout", viewIndex, timeouts);
+        if (!appState.running) break;
+    }
+    const int64_t waitNs = NowNs() - startNs;
+    SwapchainWaitStats& stats = sc.waitStats;
+    stats.acquires++;
+    stats.timeouts += timeouts;
+    stats.totalWaitNs += waitNs;
+    stats.maxWaitNs = std::max(stats.maxWaitNs, waitNs);
+    stats.lastWaitNs = waitNs;
+    if (timeouts != 0) {
+        stats.stalls++;
+        GlTrace_Marker("swapchain stall", viewIndex, static_cast<uint64_t>(waitNs));
+        if (result == XR_SUCCESS) ALOGW("Swapchain %u stall cleared after %.2f ms (%u timeouts).", viewIndex, waitNs / 1e6, timeouts);
+    }
+    return result == XR_SUCCESS;
+}
+
+// =============================================================================
+// Instance & Session Lifetime
+// =============================================================================
+static const char* ResumeKindName(ResumeKind kind) {
+    switch (kind) {
+        case RESUME_COLD: return "cold";
+        case RESUME_WARM: return "warm";
+        case RESUME_SESSION: return "session";
+        default: return "hot";
+    }
+}
+
+// Starts a resume timing unless one is already running; the earliest request wins.
+static void NoteResumeStart(ResumeKind kind, int64_t startNs) {
+    std::unique_lock<std::mutex> lock(appState.appMutex);
+    if (appState.resumeStartNs != 0) return;
+    appState.resumeStartNs = startNs;
+    appState.resumeKind = kind;
+}
+
+static void NoteFirstFrame() {
+    std::unique_lock<std::mutex> lock(appState.appMutex);
+    if (appState.resumeStartNs == 0) return;
+    const int64_t elapsedNs = NowNs() - appState.resumeStartNs;
+    ResumeStats& stats = appState.resumeStats[appState.resumeKind];
+    stats.count++;
+    stats.lastNs = elapsedNs;
+    stats.bestNs = stats.bestNs == 0 ? elapsedNs : std::min(stats.bestNs, elapsedNs);
+    appState.resumeStartNs = 0;
+    ALOGI("Resume (%s) to first frame: %.1f ms.", ResumeKindName(appState.resumeKind), elapsedNs / 1e6);
+}
+
+static bool CreateInstance() {
+    XrApplicationInfo appInfo = {};
+    XrInstanceCreateInfo createInfo = {XR_TYPE_INSTANCE_CREATE_INFO};
+    XrLoaderInitInfoAndroidKHR loaderInitInfo = {XR_TYPE_LOADER_INIT_INFO_ANDROID_KHR};
+    PFN_xrInitializeLoaderKHR xrInitializeLoaderKHR = nullptr;
+    XrInstanceCreateInfoAndroidKHR createInfoAndroid = {XR_TYPE_INSTANCE_CREATE_INFO_ANDROID_KHR};
+    std::vector<const char*> extensions;
+    XrSystemGetInfo systemGetInfo = {XR_TYPE_SYSTEM_GET_INFO, nullptr, XR_FORM_FACTOR_HEAD_MOUNTED_DISPLAY};
+    uint32_t blendModeCount = 0;
+    std::vector<XrEnvironmentBlendMode> blendModes;
+
+    strcpy(appInfo.applicationName, "ProjectIrisMVP"); appInfo.applicationVersion = 1; strcpy(appInfo.engineName, "CustomEngine"); appInfo.engineVersion = 1; appInfo.apiVersion = XR_CURRENT_API_VERSION; createInfo.applicationInfo = appInfo; loaderInitInfo.applicationVM = appState.vm; loaderInitInfo.applicationContext = appState.mainActivity; if (OXR_CHECK(nullptr, xrGetInstanceProcAddr(XR_NULL_HANDLE, "xrInitializeLoaderKHR", (PFN_xrVoidFunction*)&xrInitializeLoaderKHR), "xrGetInstanceProcAddr") != XR_SUCCESS) return false; if (OXR_CHECK(nullptr, xrInitializeLoaderKHR((const XrLoaderInitInfoBaseHeaderKHR*)&loaderInitInfo), "xrInitializeLoaderKHR") != XR_SUCCESS) return false; ALOGI("OpenXR Loader initialized."); createInfoAndroid.applicationVM = appState.vm; createInfoAndroid.applicationActivity = appState.mainActivity; createInfo.next = &createInfoAndroid; extensions = {XR_KHR_ANDROID_CREATE_INSTANCE_EXTENSION_NAME, XR_KHR_OPENGL_ES_ENABLE_EXTENSION_NAME}; appState.threadSettingsEnabled = InstanceExtensionSupported(XR_KHR_ANDROID_THREAD_SETTINGS_EXTENSION_NAME); if (appState.threadSettingsEnabled) extensions.push_back(XR_KHR_ANDROID_THREAD_SETTINGS_EXTENSION_NAME); appState.visibilityMaskEnabled = InstanceExtensionSupported(XR_KHR_VISIBILITY_MASK_EXTENSION_NAME); if (appState.visibilityMaskEnabled) extensions.push_back(XR_KHR_VISIBILITY_MASK_EXTENSION_NAME); createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size()); createInfo.enabledExtensionNames = extensions.data(); if (OXR_CHECK(appState.xrInstance, xrCreateInstance(&createInfo, &appState.xrInstance), "xrCreateInstance") != XR_SUCCESS) return false; ALOGI("OpenXR instance created."); if (OXR_CHECK(appState.xrInstance, xrGetSystem(appState.xrInstance, &systemGetInfo, &appState.systemId), "xrGetSystem") != XR_SUCCESS) return false; ALOGI("OpenXR system found.");
+
+    // Check for passthrough support
+    xrEnumerateEnvironmentBlendModes(appState.xrInstance, appState.systemId, XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO, 0, &blendModeCount, nullptr);
+    blendModes.resize(blendModeCount);
+    xrEnumerateEnvironmentBlendModes(appState.xrInstance, appState.systemId, XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO, blendModeCount, &blendModeCount, blendModes.data());
+    appState.blendMode = XR_ENVIRONMENT_BLEND_MODE_OPAQUE;
+    if (std::find(blendModes.begin(), blendModes.end(), XR_ENVIRONMENT_BLEND_MODE_ALPHA_BLEND) != blendModes.end()) {
+        appState.blendMode = XR_ENVIRONMENT_BLEND_MODE_ALPHA_BLEND;
+        ALOGI("Passthrough (ALPHA_BLEND) is supported and selected.");
+    } else {
+        ALOGI("Passthrough (ALPHA_BLEND) is not supported, falling back to OPAQUE.");
+    }
+
+    if (OXR_CHECK(appState.xrInstance, xrGetInstanceProcAddr(appState.xrInstance, "xrGetOpenGLESGraphicsRequirementsKHR", (PFN_xrVoidFunction*)&appState.xrGetOpenGLESGraphicsRequirements), "xrGetInstanceProcAddr") != XR_SUCCESS) return false;
+    if (!appState.threadSettingsEnabled ||
+        XR_FAILED(xrGetInstanceProcAddr(appState.xrInstance, "xrSetAndroidApplicationThreadKHR", (PFN_xrVoidFunction*)&appState.xrSetAndroidApplicationThread))) {
+        appState.xrSetAndroidApplicationThread = nullptr;
+    }
+    if (!appState.visibilityMaskEnabled ||
+        XR_FAILED(xrGetInstanceProcAddr(appState.xrInstance, "xrGetVisibilityMaskKHR", (PFN_xrVoidFunction*)&appState.xrGetVisibilityMask))) {
+        appState.xrGetVisibilityMask = nullptr;
+    }
+    return true;
+}
+
+static void DestroyInstance() {
+    if (appState.xrInstance != XR_NULL_HANDLE) xrDestroyInstance(appState.xrInstance);
+    appState.xrInstance = XR_NULL_HANDLE;
+    appState.systemId = XR_NULL_SYSTEM_ID;
+    appState.xrGetOpenGLESGraphicsRequirements = nullptr;
+    appState.xrSetAndroidApplicationThread = nullptr;
+    appState.xrGetVisibilityMask = nullptr;
+}
+
+// Everything the runtime hands out per session. The depth textures and
+// framebuffers are ours and survive; they are rebuilt only if the view size changes.
+static void DestroySessionResources() {
+    for (auto& sc : appState.swapchains) {
+        for (const auto& image : sc.images) GpuResources_Unregister(GPU_KIND_TEXTURE, image.image);
+        sc.images.clear();
+        if (sc.handle != XR_NULL_HANDLE) xrDestroySwapchain(sc.handle);
+        sc.handle = XR_NULL_HANDLE;
+    }
+    if (appState.stageSpace != XR_NULL_HANDLE) xrDestroySpace(appState.stageSpace);
+    appState.stageSpace = XR_NULL_HANDLE;
+    ThreadRoles_SetRuntimeHook(nullptr, nullptr);
+    if (appState.xrSession != XR_NULL_HANDLE) xrDestroySession(appState.xrSession);
+    appState.xrSession = XR_NULL_HANDLE;
+    appState.sessionReady = false;
+    appState.lastFrameWakeNs = 0;
+    appState.framePacing.Reset();
+}
+
+static bool CreateSessionResources() {
+    XrGraphicsRequirementsOpenGLESKHR graphicsRequirements = {XR_TYPE_GRAPHICS_REQUIREMENTS_OPENGL_ES_KHR};
+    XrGraphicsBindingOpenGLESAndroidKHR graphicsBinding = {XR_TYPE_GRAPHICS_BINDING_OPENGL_ES_ANDROID_KHR};
+    XrSessionCreateInfo sessionCreateInfo = {XR_TYPE_SESSION_CREATE_INFO};
+    XrReferenceSpaceCreateInfo spaceCreateInfo = {XR_TYPE_REFERENCE_SPACE_CREATE_INFO};
+    uint32_t viewCount = 0;
+
+    // The runtime requires the requirements call before every xrCreateSession.
+    if (OXR_CHECK(appState.xrInstance, appState.xrGetOpenGLESGraphicsRequirements(appState.xrInstance, appState.systemId, &graphicsRequirements), "xrGetOpenGLESGraphicsRequirementsKHR") != XR_SUCCESS) return false; graphicsBinding.display = appState.graphics.display; graphicsBinding.config = appState.graphics.config; graphicsBinding.context = appState.graphics.context; sessionCreateInfo.next = &graphicsBinding; sessionCreateInfo.systemId = appState.systemId; if (OXR_CHECK(appState.xrInstance, xrCreateSession(appState.xrInstance, &sessionCreateInfo, &appState.xrSession), "xrCreateSession") != XR_SUCCESS) return false; ALOGI("OpenXR session created."); spaceCreateInfo.referenceSpaceType = XR_REFERENCE_SPACE_TYPE_STAGE; spaceCreateInfo.poseInReferenceSpace = {{0.0f, 0.0f, 0.0f, 1.0f}, {0.0f, 0.0f, 0.0f}}; if (OXR_CHECK(appState.xrInstance, xrCreateReferenceSpace(appState.xrSession, &spaceCreateInfo, &appState.stageSpace), "xrCreateReferenceSpace") != XR_SUCCESS) { DestroySessionResources(); return false; } ALOGI("OpenXR stage space created.");
+
+    // Threads registered so far (this one, audio, network) are reported now,
+    // later ones as they start.
+    if (appState.xrSetAndroidApplicationThread != nullptr) {
+        ThreadRoles_SetRuntimeHook(RegisterThreadWithRuntime, nullptr);
+        ALOGI("Thread roles reported to the runtime (XR_KHR_android_thread_settings).");
+    } else {
+        ALOGI("XR_KHR_android_thread_settings unavailable, thread roles stay local.");
+    }
+
+    xrEnumerateViewConfigurationViews(appState.xrInstance, appState.systemId, XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO, 0, &viewCount, nullptr);
+    appState.viewConfigs.resize(viewCount, {XR_TYPE_VIEW_CONFIGURATION_VIEW});
+    appState.views.resize(viewCount, {XR_TYPE_VIEW});
+    xrEnumerateViewConfigurationViews(appState.xrInstance, appState.systemId, XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO, viewCount, &viewCount, appState.viewConfigs.data());
+    for (size_t i = viewCount; i < appState.swapchains.size(); ++i) GpuResources_DeferDelete(GPU_KIND_TEXTURE, appState.swapchains[i].depthTexture);
+    for (size_t i = viewCount; i < appState.framebuffers.size(); ++i) GpuResources_DeferDelete(GPU_KIND_FRAMEBUFFER, appState.framebuffers[i]);
+    appState.swapchains.resize(viewCount);
+    appState.framebuffers.resize(viewCount);
+    for (uint32_t i = 0; i < viewCount; ++i) {
+        auto& sc = appState.swapchains[i];
+        const int32_t width = appState.viewConfigs[i].recommendedImageRectWidth;
+        const int32_t height = appState.viewConfigs[i].recommendedImageRectHeight;
+        if (sc.depthTexture != 0 && (sc.width != width || sc.height != height || sc.depthFormat != appState.depth.format)) {
+            GpuResources_DeferDelete(GPU_KIND_TEXTURE, sc.depthTexture);
+            sc.depthTexture = 0;
+        }
+        sc.width = width;
+        sc.height = height;
+        XrSwapchainCreateInfo swapchainCI = {XR_TYPE_SWAPCHAIN_CREATE_INFO};
+        swapchainCI.usageFlags = XR_SWAPCHAIN_USAGE_COLOR_ATTACHMENT_BIT;
+        swapchainCI.format = GL_RGBA8;
+        swapchainCI.width = static_cast<uint32_t>(sc.width);
+        swapchainCI.height = static_cast<uint32_t>(sc.height);
+        swapchainCI.sampleCount = 1;   // MSAA, if any, lives on tile and resolves into these images
+        swapchainCI.faceCount = 1;
+        swapchainCI.arraySize = 1;
+        swapchainCI.mipCount = 1;
+        if (OXR_CHECK(appState.xrInstance, xrCreateSwapchain(appState.xrSession, &swapchainCI, &sc.handle), "xrCreateSwapchain") != XR_SUCCESS) {
+            DestroySessionResources();
+            return false;
+        }
+        uint32_t imageCount = 0;
+        xrEnumerateSwapchainImages(sc.handle, 0, &imageCount, nullptr);
+        sc.images.resize(imageCount, {XR_TYPE_SWAPCHAIN_IMAGE_OPENGL_ES_KHR});
+        xrEnumerateSwapchainImages(sc.handle, imageCount, &imageCount, (XrSwapchainImageBaseHeader*)sc.images.data());
+        // Swapchain images belong to the runtime, but they are GPU memory this app asked for.
+        for (const auto& image : sc.images) {
+            GpuResources_Register(GPU_KIND_TEXTURE, image.image, GPU_CATEGORY_SWAPCHAIN, GL_RGBA8,
+                                  GpuResources_ImageBytes(GL_RGBA8, sc.width, sc.height), "swapchain");
+        }
+
+        if (sc.depthTexture == 0) {
+            glGenTextures(1, &sc.depthTexture);
+            glBindTexture(GL_TEXTURE_2D, sc.depthTexture);
+            glTexStorage2D(GL_TEXTURE_2D, 1, appState.depth.format, sc.width, sc.height);
+            glBindTexture(GL_TEXTURE_2D, 0);
+            sc.depthFormat = appState.depth.format;
+            GpuResources_Register(GPU_KIND_TEXTURE, sc.depthTexture, GPU_CATEGORY_DEPTH, sc.depthFormat,
+                                  GpuResources_ImageBytes(sc.depthFormat, sc.width, sc.height), "swapchain-depth");
+        }
+    }
+    ALOGI("Swapchains created for %d views.", viewCount);
+
+    // The masks' GL buffers are replaced in place when the new session's meshes arrive.
+    appState.visibilityMasks.resize(viewCount);
+    if (appState.xrGetVisibilityMask != nullptr) {
+        for (uint32_t i = 0; i < viewCount; ++i) FetchVisibilityMask(i);
+    } else {
+        ALOGI("XR_KHR_visibility_mask unavailable, every eye pixel is shaded.");
+    }
+    return true;
+}
+
+// Long-lived GL state: programs, scene, timer queries, per-view targets and masks.
+static void DestroyGraphicsAssets() {
+    for (GLuint framebuffer : appState.framebuffers) GpuResources_DeferDelete(GPU_KIND_FRAMEBUFFER, framebuffer);
+    appState.framebuffers.clear();
+    for (auto& mask : appState.visibilityMasks) DestroyVisibilityMask(mask);
+    appState.visibilityMasks.clear();
+    DestroyScene(appState.scene);
+    DestroyGraphicsPipeline(appState.pipeline);
+    appState.bundle.Close();
+    DestroyGpuTimer(appState.gpuTimer);
+    for (auto& sc : appState.swapchains) GpuResources_DeferDelete(GPU_KIND_TEXTURE, sc.depthTexture);
+    appState.swapchains.clear();
+    GpuResources_FlushDeletes();
+    appState.graphicsAssetsReady = false;
+}
+
+// Rebuilds what the runtime took away; the EGL context and GL assets stay.
+static bool RecoverXr() {
+    const bool newInstance = appState.instanceLost;
+    if (newInstance) {
+        if (!CreateInstance()) { DestroyInstance(); return false; }
+        appState.instanceLost = false;
+    }
+    if (!CreateSessionResources()) return false;
+    appState.sessionLost = false;
+    ALOGI("OpenXR %s recreated, GL state kept.", newInstance ? "instance and session" : "session");
+    return true;
+}
+
 void app_main();
 
 extern "C" JNIEXPORT void JNICALL
 Java_cnit355_finalproject_irisagentc_MainActivity_onCreateNative(JNIEnv* env, jobject, jobject activity) {
     ALOGI("--- Native onCreate ---");
     env->GetJavaVM(&appState.vm);
+    if (appState.mainThreadId == 0) appState.mainThreadId = ThreadRoles_RegisterCurrent(THREAD_ROLE_MAIN, "main", false);
     appState.mainActivity = env->NewGlobalRef(activity);
+    {
+        jobject assets = env->CallObjectMethod(activity, env->GetMethodID(env->GetObjectClass(activity), "getAssets",
+                                                                          "()Landroid/content/res/AssetManager;"));
+        appState.assetManagerRef = env->NewGlobalRef(assets);
+        appState.assetManager = AAssetManager_fromJava(env, appState.assetManagerRef);
+        env->DeleteLocalRef(assets);
+    }
+    {
+        std::unique_lock<std::mutex> lock(appState.appMutex);
+        appState.keepGraphics = false;
+        appState.resumeStartNs = NowNs();
+        appState.resumeKind = appState.graphicsAssetsReady ? RESUME_WARM : RESUME_COLD;
+    }
     appState.running = true;
+    appState.assistantText.reserve(16 * 1024);
+    appState.streamClient.Start();
+    if (appState.spatialMixer.Start(48000)) {
+        appState.earconClip.resize(appState.spatialMixer.SampleRate() / 4);
+        SpatialMixer_SynthesizeEarcon(appState.earconClip.data(), appState.earconClip.size(), appState.spatialMixer.SampleRate(), 880.0f);
+    }
     appState.appThread = std::thread(app_main);
 }
 
+extern "C" JNIEXPORT void JNICALL
+Java_cnit355_finalproject_irisagentc_MainActivity_setMsaaSamplesNative(JNIEnv*, jobject, jint samples) {
+    std::unique_lock<std::mutex> lock(appState.appMutex);
+    appState.msaaSamplesRequested = samples >= 4 ? 4 : (samples >= 2 ? 2 : 1);
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_cnit355_finalproject_irisagentc_MainActivity_setDepthModeNative(JNIEnv*, jobject, jboolean reversedZ, jint bits) {
+    std::unique_lock<std::mutex> lock(appState.appMutex);
+    appState.reversedZRequested = reversedZ;
+    appState.depthBitsRequested = bits <= 16 ? 16 : (bits >= 32 ? 32 : 24);
+}
+
 extern "C" JNIEXPORT void JNICALL
 Java_cnit355_finalproject_irisagentc_MainActivity_onResumeNative(JNIEnv*, jobject) {
     ALOGI("--- Native onResume ---");
+    NoteResumeStart(RESUME_HOT, NowNs());
     std::unique_lock<std::mutex> lock(appState.appMutex);
     appState.resumed = true;
     appState.appCondition.notify_all();
@@ -270,44 +578,532 @@ Java_cnit355_finalproject_irisagentc_MainActivity_onPauseNative(JNIEnv*, jobject
 }
 
 extern "C" JNIEXPORT void JNICALL
-Java_cnit355_finalproject_irisagentc_MainActivity_onDestroyNative(JNIEnv* env, jobject) {
-    ALOGI("--- Native onDestroy ---");
+Java_cnit355_finalproject_irisagentc_MainActivity_onDestroyNative(JNIEnv* env, jobject, jboolean finishing) {
+    ALOGI("--- Native onDestroy (%s) ---", finishing ? "finishing" : "recreating");
     std::unique_lock<std::mutex> lock(appState.appMutex);
+    appState.keepGraphics = !finishing;
     appState.running = false;
     appState.appCondition.notify_all();
     lock.unlock();
     if (appState.appThread.joinable()) {
         appState.appThread.join();
     }
+    appState.audioCapture.Stop();
+    appState.spatialMixer.Stop();
+    appState.streamClient.Stop();
+    appState.streamStandIn.Stop();
+    ThreadRoles_Unregister(appState.mainThreadId);
+    appState.mainThreadId = 0;
     env->DeleteGlobalRef(appState.mainActivity);
+    env->DeleteGlobalRef(appState.assetManagerRef);
+    appState.assetManagerRef = nullptr;
+    appState.assetManager = nullptr;
+}
+
+extern "C" JNIEXPORT jint JNICALL
+Java_cnit355_finalproject_irisagentc_MainActivity_startAssistantStreamNative(JNIEnv* env, jobject, jstring host, jint port, jstring path, jstring body) {
+    StreamRequest request;
+    const char* chars = env->GetStringUTFChars(host, nullptr);
+    request.host = chars;
+    env->ReleaseStringUTFChars(host, chars);
+    chars = env->GetStringUTFChars(path, nullptr);
+    request.path = chars;
+    env->ReleaseStringUTFChars(path, chars);
+    chars = env->GetStringUTFChars(body, nullptr);
+    request.body = chars;
+    env->ReleaseStringUTFChars(body, chars);
+    request.port = static_cast<uint16_t>(port);
+    return static_cast<jint>(appState.streamClient.Submit(request));
+}
+
+extern "C" JNIEXPORT jint JNICALL
+Java_cnit355_finalproject_irisagentc_MainActivity_runStreamSelfTestNative(JNIEnv*, jobject, jint tokenCount, jint tokenDelayMs) {
+    appState.streamStandIn.Stop();
+    if (!appState.streamStandIn.Start(tokenCount, tokenDelayMs)) return 0;
+    StreamRequest request;
+    request.port = appState.streamStandIn.Port();
+    request.path = "/v1/chat/completions";
+    request.body = R"({"stream":true,"messages":[{"role":"user","content":"self test"}]})";
+    return static_cast<jint>(appState.streamClient.Submit(request));
+}
+
+extern "C" JNIEXPORT jlongArray JNICALL
+Java_cnit355_finalproject_irisagentc_MainActivity_getStreamMetricsNative(JNIEnv* env, jobject) {
+    StreamMetrics m = appState.streamClient.GetMetrics();
+    jlong values[] = {
+            (jlong)m.requestsCompleted, (jlong)m.requestsFailed, (jlong)m.tokensReceived, (jlong)m.bytesReceived,
+            (jlong)m.readPauses, m.lastFirstTokenNs / 1000, m.lastStreamNs / 1000,
+            (jlong)m.lastBytesPerSec, (jlong)m.lastTokensPerSec, m.readPausedNs / 1000
+    };
+    jlongArray result = env->NewLongArray(sizeof(values) / sizeof(values[0]));
+    env->SetLongArrayRegion(result, 0, sizeof(values) / sizeof(values[0]), values);
+    return result;
+}
+
+// Called on the audio worker thread for every finished utterance. The samples are
+// only valid for the duration of the call; speech recognition will consume them here.
+static void OnVoiceSegment(const VoiceSegment& segment, void*) {
+    ALOGI("Voice segment ready: %zu samples at %d Hz (stream offset %lld).", segment.count, segment.sampleRate, (long long)segment.startSample);
+}
+
+extern "C" JNIEXPORT jboolean JNICALL
+Java_cnit355_finalproject_irisagentc_MainActivity_startAudioCaptureNative(JNIEnv* env, jobject, jstring filePath) {
+    AudioCaptureConfig config;
+    if (filePath != nullptr) {
+        const char* chars = env->GetStringUTFChars(filePath, nullptr);
+        config.filePath = chars;
+        env->ReleaseStringUTFChars(filePath, chars);
+    }
+    return appState.audioCapture.Start(config, OnVoiceSegment, nullptr) ? JNI_TRUE : JNI_FALSE;
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_cnit355_finalproject_irisagentc_MainActivity_stopAudioCaptureNative(JNIEnv*, jobject) {
+    appState.audioCapture.Stop();
+}
+
+extern "C" JNIEXPORT jlongArray JNICALL
+Java_cnit355_finalproject_irisagentc_MainActivity_getAudioMetricsNative(JNIEnv* env, jobject) {
+    AudioCaptureMetrics m = appState.audioCapture.GetMetrics();
+    jlong values[] = {
+            (jlong)m.framesProcessed, (jlong)m.voicedFrames, (jlong)m.segments, (jlong)m.overruns,
+            (jlong)(m.audioSeconds * 1000.0), (jlong)(m.cpuNsPerAudioSecond / 1000.0),
+            m.lastEndOfSpeechLatencyNs / 1000, m.lastSegmentSamples
+    };
+    jlongArray result = env->NewLongArray(sizeof(values) / sizeof(values[0]));
+    env->SetLongArrayRegion(result, 0, sizeof(values) / sizeof(values[0]), values);
+    return result;
+}
+
+extern "C" JNIEXPORT jint JNICALL
+Java_cnit355_finalproject_irisagentc_MainActivity_playEarconNative(JNIEnv*, jobject, jfloat x, jfloat y, jfloat z) {
+    if (appState.earconClip.empty()) return -1;
+    const float position[3] = {x, y, z};
+    return appState.spatialMixer.Play({appState.earconClip.data(), appState.earconClip.size()}, position, 1.0f, false);
+}
+
+extern "C" JNIEXPORT jlong JNICALL
+Java_cnit355_finalproject_irisagentc_MainActivity_benchmarkSpatialMixerNative(JNIEnv*, jobject, jint sources) {
+    // Runs on a private mixer so the live output stream is not disturbed.
+    auto* mixer = new SpatialMixer();
+    const double ns = mixer->Benchmark(sources, 1000);
+    delete mixer;
+    return static_cast<jlong>(ns);
+}
+
+extern "C" JNIEXPORT jlongArray JNICALL
+Java_cnit355_finalproject_irisagentc_MainActivity_getSpatialMixerMetricsNative(JNIEnv* env, jobject) {
+    SpatialMixerMetrics m = appState.spatialMixer.GetMetrics();
+    jlong values[] = {
+            (jlong)m.callbacks, (jlong)m.framesRendered, m.lastCallbackNs, m.maxCallbackNs,
+            (jlong)m.avgCallbackNsPer10ms, m.activeSources, (jlong)m.commandsDropped
+    };
+    jlongArray result = env->NewLongArray(sizeof(values) / sizeof(values[0]));
+    env->SetLongArrayRegion(result, 0, sizeof(values) / sizeof(values[0]), values);
+    return result;
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_cnit355_finalproject_irisagentc_MainActivity_setFrameCaptureNative(JNIEnv* env, jobject, jstring path) {
+    std::unique_lock<std::mutex> lock(appState.appMutex);
+    appState.frameCaptureRequest.clear();
+    if (path != nullptr) {
+        const char* chars = env->GetStringUTFChars(path, nullptr);
+        appState.frameCaptureRequest = chars;
+        env->ReleaseStringUTFChars(path, chars);
+    }
+    appState.frameCaptureRequested = true;
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_cnit355_finalproject_irisagentc_MainActivity_takeScreenshotNative(JNIEnv* env, jobject, jstring path) {
+    if (path == nullptr) return;
+    const char* chars = env->GetStringUTFChars(path, nullptr);
+    std::unique_lock<std::mutex> lock(appState.appMutex);
+    appState.stillRequest = chars;
+    lock.unlock();
+    env->ReleaseStringUTFChars(path, chars);
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_cnit355_finalproject_irisagentc_MainActivity_startRecordingNative(JNIEnv* env, jobject, jstring path, jint fps) {
+    if (path == nullptr) return;
+    const char* chars = env->GetStringUTFChars(path, nullptr);
+    std::unique_lock<std::mutex> lock(appState.appMutex);
+    appState.recordingRequest = chars;
+    appState.recordingFps = fps;
+    appState.recordingRequested = true;
+    lock.unlock();
+    env->ReleaseStringUTFChars(path, chars);
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_cnit355_finalproject_irisagentc_MainActivity_stopRecordingNative(JNIEnv*, jobject) {
+    std::unique_lock<std::mutex> lock(appState.appMutex);
+    appState.recordingRequest.clear();
+    appState.recordingRequested = true;
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_cnit355_finalproject_irisagentc_MainActivity_setMirrorStreamNative(JNIEnv*, jobject, jboolean enabled, jint port,
+                                                                       jint width, jint fps, jboolean loopbackOnly) {
+    std::unique_lock<std::mutex> lock(appState.appMutex);
+    appState.mirrorEnabledRequested = enabled;
+    appState.mirrorRequest.port = static_cast<uint16_t>(std::max(0, std::min(port, 65535)));
+    appState.mirrorRequest.width = width;
+    appState.mirrorRequest.fps = fps;
+    appState.mirrorRequest.loopbackOnly = loopbackOnly;
+    appState.mirrorRequested = true;
+}
+
+extern "C" JNIEXPORT jlongArray JNICALL
+Java_cnit355_finalproject_irisagentc_MainActivity_getMirrorStreamStatsNative(JNIEnv* env, jobject) {
+    MirrorStats s;
+    {
+        std::unique_lock<std::mutex> lock(appState.appMutex);
+        s = appState.mirrorStats;
+    }
+    jlong values[] = {
+            s.port, s.clientConnected ? 1 : 0, (jlong)s.clients, (jlong)s.framesSent, (jlong)s.dropped,
+            (jlong)s.bytesSent, s.renderCpuNs, s.maxRenderCpuNs, s.encodeCpuNs, s.lastLatencyNs
+    };
+    jlongArray result = env->NewLongArray(sizeof(values) / sizeof(values[0]));
+    env->SetLongArrayRegion(result, 0, sizeof(values) / sizeof(values[0]), values);
+    return result;
+}
+
+extern "C" JNIEXPORT jint JNICALL
+Java_cnit355_finalproject_irisagentc_MainActivity_submitVisualFrameNative(JNIEnv* env, jobject, jobject rgba, jint width,
+                                                                         jint height, jint rowStride, jlong captureTimeNs) {
+    const auto* pixels = static_cast<const uint8_t*>(env->GetDirectBufferAddress(rgba));
+    const jlong capacity = env->GetDirectBufferCapacity(rgba);
+    if (pixels == nullptr || width <= 0 || height <= 0 || rowStride < width * 4 ||
+        capacity < static_cast<jlong>(rowStride) * (height - 1) + width * 4) {
+        ALOGW("Visual frame rejected: %dx%d, stride %d, %lld-byte buffer", width, height, rowStride, (long long)capacity);
+        return -1;   // never gated: nothing to upload or complete
+    }
+    // The pose comes from the frame loop's history at capture time. Without a capture
+    // time the latest pose stands in if the loop is running; otherwise judge by pixels alone.
+    const int64_t frameTimeNs = captureTimeNs > 0 ? captureTimeNs : NowNs();
+    HeadPose pose = {};
+    bool posed;
+    if (captureTimeNs > 0) {
+        posed = appState.headPoses.Lookup(captureTimeNs, pose);
+    } else {
+        int64_t poseTimeNs = 0;
+        posed = appState.headPoses.Latest(pose, &poseTimeNs) && frameTimeNs - poseTimeNs < 100000000LL;
+    }
+    return appState.visualDedup.Submit(pixels, width, height, static_cast<size_t>(rowStride), posed ? &pose : nullptr,
+                                       frameTimeNs);
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_cnit355_finalproject_irisagentc_MainActivity_completeVisualQueryNative(JNIEnv*, jobject) {
+    appState.visualDedup.Complete();
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_cnit355_finalproject_irisagentc_MainActivity_setVisualDedupNative(JNIEnv*, jobject, jint maxHammingBits,
+                                                                      jfloat stillMotion) {
+    VisualDedupConfig config;
+    config.maxHammingBits = std::max(0, std::min(maxHammingBits, 64));
+    config.stillMotion = std::max(0.0f, stillMotion);
+    appState.visualDedup.Configure(config);
+}
+
+extern "C" JNIEXPORT jlongArray JNICALL
+Java_cnit355_finalproject_irisagentc_MainActivity_getVisualDedupStatsNative(JNIEnv* env, jobject) {
+    const VisualDedupStats s = appState.visualDedup.Stats();
+    jlong values[] = {
+            (jlong)s.frames, (jlong)s.sent, (jlong)s.reused, (jlong)s.coalesced, (jlong)s.stillMatches, (jlong)s.hashes,
+            s.hashes > 0 ? s.hashNs / (jlong)s.hashes : 0, s.lastDistance
+    };
+    jlongArray result = env->NewLongArray(sizeof(values) / sizeof(values[0]));
+    env->SetLongArrayRegion(result, 0, sizeof(values) / sizeof(values[0]), values);
+    return result;
+}
+
+extern "C" JNIEXPORT jlong JNICALL
+Java_cnit355_finalproject_irisagentc_MainActivity_benchmarkFrameHashNative(JNIEnv*, jobject, jint width, jint height) {
+    if (width < kVisualHashGrid || height < kVisualHashGrid) return 0;
+    return static_cast<jlong>(VisualHash_Benchmark(width, height, 100, true));
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_cnit355_finalproject_irisagentc_MainActivity_setVisionCameraNative(JNIEnv*, jobject, jfloat horizontalFovDegrees,
+                                                                       jfloat verticalFovDegrees, jfloat pitchDegrees) {
+    VisionCamera camera;
+    VisionRoiConfig config;
+    appState.visionRoi.GetConfig(camera, config);
+    const float toRadians = static_cast<float>(M_PI) / 180.0f;
+    const float halfX = std::max(1.0f, std::min(horizontalFovDegrees, 170.0f)) * 0.5f * toRadians;
+    const float halfY = std::max(1.0f, std::min(verticalFovDegrees, 170.0f)) * 0.5f * toRadians;
+    camera.angleLeft = -halfX;
+    camera.angleRight = halfX;
+    camera.angleUp = halfY;
+    camera.angleDown = -halfY;
+    // Pitch is a rotation about +X, so positive tilts the camera up.
+    camera.orientation[0] = sinf(pitchDegrees * 0.5f * toRadians);
+    camera.orientation[1] = 0.0f;
+    camera.orientation[2] = 0.0f;
+    camera.orientation[3] = cosf(pitchDegrees * 0.5f * toRadians);
+    appState.visionRoi.Configure(camera, config);
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_cnit355_finalproject_irisagentc_MainActivity_setVisionRoiNative(JNIEnv*, jobject, jfloat fieldDegrees, jint maxSide) {
+    VisionCamera camera;
+    VisionRoiConfig config;
+    appState.visionRoi.GetConfig(camera, config);
+    config.fieldDegrees = std::max(1.0f, std::min(fieldDegrees, 179.0f));
+    config.maxSide = std::max(32, maxSide);
+    appState.visionRoi.Configure(camera, config);
+}
+
+extern "C" JNIEXPORT jbyteArray JNICALL
+Java_cnit355_finalproject_irisagentc_MainActivity_cropVisionFrameNative(JNIEnv* env, jobject, jobject rgba, jint width,
+                                                                       jint height, jint rowStride, jlong captureTimeNs) {
+    const auto* pixels = static_cast<const uint8_t*>(env->GetDirectBufferAddress(rgba));
+    const jlong capacity = env->GetDirectBufferCapacity(rgba);
+    if (pixels == nullptr || width <= 0 || height <= 0 || rowStride < width * 4 ||
+        capacity < static_cast<jlong>(rowStride) * (height - 1) + width * 4) {
+        ALOGW("Vision crop rejected: %dx%d, stride %d, %lld-byte buffer", width, height, rowStride, (long long)capacity);
+        return nullptr;
+    }
+    // Without a capture time, before the loop has run, or for a frame older than the
+    // pose history, no head motion is compensated.
+    HeadPose viewPose = {};
+    viewPose.orientation[3] = 1.0f;
+    appState.headPoses.Latest(viewPose);
+    HeadPose cameraPose = viewPose;
+    if (captureTimeNs > 0) appState.headPoses.Lookup(captureTimeNs, cameraPose);
+
+    TrackedVector<uint8_t, MEM_TAG_CAPTURE> png;
+    if (!appState.visionRoi.Crop(pixels, width, height, static_cast<size_t>(rowStride), cameraPose, viewPose, nullptr, png)) {
+        ALOGE("Vision crop could not be encoded.");
+        return nullptr;
+    }
+    jbyteArray result = env->NewByteArray(static_cast<jsize>(png.size()));
+    env->SetByteArrayRegion(result, 0, static_cast<jsize>(png.size()), reinterpret_cast<const jbyte*>(png.data()));
+    return result;
+}
+
+extern "C" JNIEXPORT jlongArray JNICALL
+Java_cnit355_finalproject_irisagentc_MainActivity_getVisionRoiStatsNative(JNIEnv* env, jobject) {
+    const VisionRoiStats s = appState.visionRoi.Stats();
+    const jlong crops = std::max<jlong>(1, (jlong)s.crops);
+    jlong values[] = {
+            (jlong)s.crops, (jlong)s.fallbacks, (jlong)s.inputBytes, (jlong)s.outputBytes, s.extractNs / crops,
+            s.encodeNs / crops, s.lastRoi.x, s.lastRoi.y, s.lastRoi.width, s.lastRoi.height
+    };
+    jlongArray result = env->NewLongArray(sizeof(values) / sizeof(values[0]));
+    env->SetLongArrayRegion(result, 0, sizeof(values) / sizeof(values[0]), values);
+    return result;
+}
+
+extern "C" JNIEXPORT jlongArray JNICALL
+Java_cnit355_finalproject_irisagentc_MainActivity_getImageCaptureStatsNative(JNIEnv* env, jobject) {
+    ImageCaptureStats s;
+    {
+        std::unique_lock<std::mutex> lock(appState.appMutex);
+        s = appState.imageCaptureStats;
+    }
+    jlong values[] = {
+            (jlong)s.stills, (jlong)s.frames, (jlong)s.dropped, s.renderCpuNs, s.maxRenderCpuNs, s.encodeCpuNs,
+            s.lastLatencyNs, (jlong)s.bytesWritten, s.recording ? 1 : 0
+    };
+    jlongArray result = env->NewLongArray(sizeof(values) / sizeof(values[0]));
+    env->SetLongArrayRegion(result, 0, sizeof(values) / sizeof(values[0]), values);
+    return result;
+}
+
+extern "C" JNIEXPORT jlongArray JNICALL
+Java_cnit355_finalproject_irisagentc_MainActivity_getGlTraceStatsNative(JNIEnv* env, jobject) {
+    GlTraceFrameStats f = GlTrace_LastFrame();
+    jlong values[] = {(jlong)f.frame, f.calls, f.drawCalls, f.stateSets, f.redundantStateSets, (jlong)f.uploadBytes};
+    jlongArray result = env->NewLongArray(IRIS_GL_TRACE ? sizeof(values) / sizeof(values[0]) : 0);
+    if (IRIS_GL_TRACE) env->SetLongArrayRegion(result, 0, sizeof(values) / sizeof(values[0]), values);
+    return result;
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_cnit355_finalproject_irisagentc_MainActivity_requestGlTraceDumpNative(JNIEnv*, jobject) {
+    GlTrace_RequestDump();
+}
+
+extern "C" JNIEXPORT jlongArray JNICALL
+Java_cnit355_finalproject_irisagentc_MainActivity_getGpuMemoryNative(JNIEnv* env, jobject) {
+    GpuMemoryReport r = GpuResources_Report();
+    jlong values[GPU_CATEGORY_COUNT + 9];
+    for (int c = 0; c < GPU_CATEGORY_COUNT; ++c) values[c] = (jlong)r.bytes[c];
+    values[GPU_CATEGORY_COUNT + 0] = (jlong)r.totalBytes;
+    values[GPU_CATEGORY_COUNT + 1] = (jlong)r.peakBytes;
+    values[GPU_CATEGORY_COUNT + 2] = (jlong)r.budgetBytes;
+    values[GPU_CATEGORY_COUNT + 3] = (jlong)r.evictions;
+    values[GPU_CATEGORY_COUNT + 4] = (jlong)r.overBudgetEvents;
+    values[GPU_CATEGORY_COUNT + 5] = (jlong)r.pendingDeletes;
+    values[GPU_CATEGORY_COUNT + 6] = (jlong)r.pendingBytes;
+    values[GPU_CATEGORY_COUNT + 7] = (jlong)r.peakPendingDeletes;
+    values[GPU_CATEGORY_COUNT + 8] = (jlong)r.deferredDeletes;
+    jlongArray result = env->NewLongArray(sizeof(values) / sizeof(values[0]));
+    env->SetLongArrayRegion(result, 0, sizeof(values) / sizeof(values[0]), values);
+    return result;
+}
+
+extern "C" JNIEXPORT jlongArray JNICALL
+Java_cnit355_finalproject_irisagentc_MainActivity_getMemoryStatsNative(JNIEnv* env, jobject) {
+    MemTagStats stats[MEM_TAG_COUNT];
+    Mem_Sample(stats);
+    constexpr int kFields = 6;
+    jlong values[MEM_TAG_COUNT * kFields];
+    for (int t = 0; t < MEM_TAG_COUNT; ++t) {
+        jlong* v = values + t * kFields;
+        v[0] = (jlong)stats[t].liveBytes;
+        v[1] = (jlong)stats[t].peakBytes;
+        v[2] = (jlong)stats[t].allocsPerSec;
+        v[3] = (jlong)stats[t].allocs;
+        v[4] = (jlong)(stats[t].failures + stats[t].capBreaches);
+        v[5] = (jlong)stats[t].capBytes;
+    }
+    jlongArray result = env->NewLongArray(sizeof(values) / sizeof(values[0]));
+    env->SetLongArrayRegion(result, 0, sizeof(values) / sizeof(values[0]), values);
+    return result;
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_cnit355_finalproject_irisagentc_MainActivity_setMemoryCapNative(JNIEnv*, jobject, jint tag, jlong bytes) {
+    if (tag < 0 || tag >= MEM_TAG_COUNT) return;
+    Mem_SetCap(static_cast<MemTag>(tag), bytes > 0 ? static_cast<uint64_t>(bytes) : 0);
+}
+
+extern "C" JNIEXPORT jlongArray JNICALL
+Java_cnit355_finalproject_irisagentc_MainActivity_getThreadStatsNative(JNIEnv* env, jobject) {
+    constexpr int kFields = 5;
+    jlong values[THREAD_ROLE_COUNT * kFields];
+    for (int role = 0; role < THREAD_ROLE_COUNT; ++role) {
+        const ThreadRoleStats s = ThreadRoles_Stats(static_cast<ThreadRole>(role));
+        jlong* v = values + role * kFields;
+        v[0] = (jlong)s.threads;
+        v[1] = (jlong)s.wakes;
+        v[2] = (jlong)s.misses;
+        v[3] = (jlong)s.meanLatenessNs;
+        v[4] = (jlong)s.maxLatenessNs;
+    }
+    jlongArray result = env->NewLongArray(sizeof(values) / sizeof(values[0]));
+    env->SetLongArrayRegion(result, 0, sizeof(values) / sizeof(values[0]), values);
+    return result;
+}
+
+extern "C" JNIEXPORT jlongArray JNICALL
+Java_cnit355_finalproject_irisagentc_MainActivity_getPerfHintStatsNative(JNIEnv* env, jobject) {
+    PerfHintStats s;
+    {
+        std::unique_lock<std::mutex> lock(appState.appMutex);
+        s = appState.perfHintStats;
+    }
+    jlong values[] = {s.active ? 1 : 0, (jlong)s.reports, (jlong)s.overTarget, (jlong)s.targetUpdates,
+                      (jlong)s.failures, (jlong)s.targetNs, (jlong)s.lastActualNs};
+    jlongArray result = env->NewLongArray(sizeof(values) / sizeof(values[0]));
+    env->SetLongArrayRegion(result, 0, sizeof(values) / sizeof(values[0]), values);
+    return result;
+}
+
+extern "C" JNIEXPORT jlongArray JNICALL
+Java_cnit355_finalproject_irisagentc_MainActivity_getFramePacingNative(JNIEnv* env, jobject) {
+    const FramePacingStats s = appState.framePacing.Stats();
+    constexpr int kHeader = 6;
+    jlong values[kHeader + FRAME_PHASE_COUNT * 3];
+    values[0] = (jlong)s.frames;
+    values[1] = (jlong)s.missedFrames;
+    values[2] = (jlong)s.duplicatedFrames;
+    values[3] = (jlong)s.jankEvents;
+    values[4] = (jlong)s.swapchainStalls;
+    values[5] = (jlong)s.displayPeriodNs;
+    for (int p = 0; p < FRAME_PHASE_COUNT; ++p) {
+        jlong* v = values + kHeader + p * 3;
+        v[0] = (jlong)s.meanPhaseNs[p];
+        v[1] = (jlong)s.maxPhaseNs[p];
+        v[2] = (jlong)s.blamed[p];
+    }
+    jlongArray result = env->NewLongArray(sizeof(values) / sizeof(values[0]));
+    env->SetLongArrayRegion(result, 0, sizeof(values) / sizeof(values[0]), values);
+    return result;
+}
+
+extern "C" JNIEXPORT jstring JNICALL
+Java_cnit355_finalproject_irisagentc_MainActivity_getJankReportNative(JNIEnv* env, jobject) {
+    return env->NewStringUTF(appState.framePacing.JankReport().c_str());
+}
+
+extern "C" JNIEXPORT jlongArray JNICALL
+Java_cnit355_finalproject_irisagentc_MainActivity_getSwapchainWaitStatsNative(JNIEnv* env, jobject) {
+    std::vector<SwapchainWaitStats> stats;
+    {
+        std::unique_lock<std::mutex> lock(appState.appMutex);
+        stats = appState.swapchainWaitStats;
+    }
+    constexpr int kPerSwapchain = 6;
+    std::vector<jlong> values;
+    values.reserve(stats.size() * kPerSwapchain);
+    for (const SwapchainWaitStats& s : stats) {
+        values.insert(values.end(), {(jlong)s.acquires, (jlong)s.timeouts, (jlong)s.stalls, (jlong)s.totalWaitNs,
+                                     (jlong)s.maxWaitNs, (jlong)s.lastWaitNs});
+    }
+    jlongArray result = env->NewLongArray(values.size());
+    env->SetLongArrayRegion(result, 0, values.size(), values.data());
+    return result;
+}
+
+extern "C" JNIEXPORT jlongArray JNICALL
+Java_cnit355_finalproject_irisagentc_MainActivity_getResumeStatsNative(JNIEnv* env, jobject) {
+    jlong values[RESUME_KIND_COUNT * 3];
+    {
+        std::unique_lock<std::mutex> lock(appState.appMutex);
+        for (int k = 0; k < RESUME_KIND_COUNT; ++k) {
+            values[k * 3 + 0] = (jlong)appState.resumeStats[k].count;
+            values[k * 3 + 1] = (jlong)appState.resumeStats[k].lastNs;
+            values[k * 3 + 2] = (jlong)appState.resumeStats[k].bestNs;
+        }
+    }
+    jlongArray result = env->NewLongArray(sizeof(values) / sizeof(values[0]));
+    env->SetLongArrayRegion(result, 0, sizeof(values) / sizeof(values[0]), values);
+    return result;
+}
+
+extern "C" JNIEXPORT jlongArray JNICALL
+Java_cnit355_finalproject_irisagentc_MainActivity_getLodStatsNative(JNIEnv* env, jobject) {
+    jlong values[2 + kMaxMeshLods];
+    {
+        std::unique_lock<std::mutex> lock(appState.appMutex);
+        values[0] = (jlong)appState.lodCount;
+        values[1] = (jlong)appState.lodStats.switches;
+        for (uint32_t i = 0; i < kMaxMeshLods; ++i) values[2 + i] = (jlong)appState.lodStats.objects[i];
+    }
+    jlongArray result = env->NewLongArray(sizeof(values) / sizeof(values[0]));
+    env->SetLongArrayRegion(result, 0, sizeof(values) / sizeof(values[0]), values);
+    return result;
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_cnit355_finalproject_irisagentc_MainActivity_setLodPixelErrorNative(JNIEnv*, jobject, jfloat pixels) {
+    std::unique_lock<std::mutex> lock(appState.appMutex);
+    appState.lodPixelErrorRequested = pixels > 0.1f ? pixels : 0.1f;
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_cnit355_finalproject_irisagentc_MainActivity_setGpuBudgetNative(JNIEnv*, jobject, jlong bytes) {
+    GpuResources_SetBudget(bytes > 0 ? static_cast<uint64_t>(bytes) : 0);
 }
 
 // =============================================================================
 // Main Application Thread
 // =============================================================================
 void app_main() {
+    ThreadRoleScope threadRole(THREAD_ROLE_RENDER, "iris-render");
     JNIEnv* env;
     appState.vm->AttachCurrentThread(&env, nullptr);
     ALOGI("App thread attached to JVM.");
-
-    // **FIX**: All local variables are now declared at the top of the function scope.
-    XrApplicationInfo appInfo = {};
-    XrInstanceCreateInfo createInfo = {XR_TYPE_INSTANCE_CREATE_INFO};
-    XrLoaderInitInfoAndroidKHR loaderInitInfo = {XR_TYPE_LOADER_INIT_INFO_ANDROID_KHR};
-    PFN_xrInitializeLoaderKHR xrInitializeLoaderKHR = nullptr;
-    XrInstanceCreateInfoAndroidKHR createInfoAndroid = {XR_TYPE_INSTANCE_CREATE_INFO_ANDROID_KHR};
-    std::vector<const char*> extensions;
-    XrSystemGetInfo systemGetInfo = {XR_TYPE_SYSTEM_GET_INFO, nullptr, XR_FORM_FACTOR_HEAD_MOUNTED_DISPLAY};
-    PFN_xrGetOpenGLESGraphicsRequirementsKHR pfnGetOpenGLESGraphicsRequirementsKHR = nullptr;
-    XrGraphicsRequirementsOpenGLESKHR graphicsRequirements = {XR_TYPE_GRAPHICS_REQUIREMENTS_OPENGL_ES_KHR};
-    XrGraphicsBindingOpenGLESAndroidKHR graphicsBinding = {XR_TYPE_GRAPHICS_BINDING_OPENGL_ES_ANDROID_KHR};
-    XrSessionCreateInfo sessionCreateInfo = {XR_TYPE_SESSION_CREATE_INFO};
-    XrReferenceSpaceCreateInfo spaceCreateInfo = {XR_TYPE_REFERENCE_SPACE_CREATE_INFO};
-    uint32_t viewCount = 0;
-    uint32_t blendModeCount = 0;
-    std::vector<XrEnvironmentBlendMode> blendModes; // Declare vector
-    bool alphaBlendSupported = false;
-
+    const bool graphicsRetained = appState.graphicsAssetsReady;
 
     {
         std::unique_lock<std::mutex> lock(appState.appMutex);
@@ -316,179 +1112,354 @@ void app_main() {
         ALOGI("App thread resumed.");
     }
 
-    strcpy(appInfo.applicationName, "ProjectIrisMVP"); appInfo.applicationVersion = 1; strcpy(appInfo.engineName, "CustomEngine"); appInfo.engineVersion = 1; appInfo.apiVersion = XR_CURRENT_API_VERSION; createInfo.applicationInfo = appInfo; loaderInitInfo.applicationVM = appState.vm; loaderInitInfo.applicationContext = appState.mainActivity; if (OXR_CHECK(nullptr, xrGetInstanceProcAddr(XR_NULL_HANDLE, "xrInitializeLoaderKHR", (PFN_xrVoidFunction*)&xrInitializeLoaderKHR), "xrGetInstanceProcAddr") != XR_SUCCESS) goto cleanup; if (OXR_CHECK(nullptr, xrInitializeLoaderKHR((const XrLoaderInitInfoBaseHeaderKHR*)&loaderInitInfo), "xrInitializeLoaderKHR") != XR_SUCCESS) goto cleanup; ALOGI("OpenXR Loader initialized."); createInfoAndroid.applicationVM = appState.vm; createInfoAndroid.applicationActivity = appState.mainActivity; createInfo.next = &createInfoAndroid; extensions = {XR_KHR_ANDROID_CREATE_INSTANCE_EXTENSION_NAME, XR_KHR_OPENGL_ES_ENABLE_EXTENSION_NAME}; createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size()); createInfo.enabledExtensionNames = extensions.data(); if (OXR_CHECK(appState.xrInstance, xrCreateInstance(&createInfo, &appState.xrInstance), "xrCreateInstance") != XR_SUCCESS) goto cleanup; ALOGI("OpenXR instance created."); if (OXR_CHECK(appState.xrInstance, xrGetSystem(appState.xrInstance, &systemGetInfo, &appState.systemId), "xrGetSystem") != XR_SUCCESS) goto cleanup; ALOGI("OpenXR system found.");
+    if (!CreateInstance()) goto cleanup;
 
-    if (!initializeGraphics()) goto cleanup;
+    if (!graphicsRetained && !initializeGraphics()) goto cleanup;
 
     if (eglMakeCurrent(appState.graphics.display, EGL_NO_SURFACE, EGL_NO_SURFACE, appState.graphics.context) == EGL_FALSE) { ALOGE("eglMakeCurrent failed!"); goto cleanup; }
-    ALOGI("EGL context made current on app thread.");
-
-    // Check for passthrough support (logic remains here, but declarations are moved up)
-    xrEnumerateEnvironmentBlendModes(appState.xrInstance, appState.systemId, XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO, 0, &blendModeCount, nullptr);
-    blendModes.resize(blendModeCount); // **FIX**: Resize vector after getting count
-    xrEnumerateEnvironmentBlendModes(appState.xrInstance, appState.systemId, XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO, blendModeCount, &blendModeCount, blendModes.data());
-    for (const auto& mode : blendModes) {
-        if (mode == XR_ENVIRONMENT_BLEND_MODE_ALPHA_BLEND) {
-            alphaBlendSupported = true;
-            break;
-        }
+    ALOGI("EGL context made current on app thread%s.", graphicsRetained ? " (kept from the previous activity)" : "");
+    GlTrace_Invalidate();
+    {
+        std::unique_lock<std::mutex> lock(appState.appMutex);
+        appState.msaa = InitializeMsaa(appState.msaaSamplesRequested);
+        appState.depth = InitializeDepth(appState.reversedZRequested, appState.depthBitsRequested);
     }
-    if (alphaBlendSupported) {
-        appState.blendMode = XR_ENVIRONMENT_BLEND_MODE_ALPHA_BLEND;
-        ALOGI("Passthrough (ALPHA_BLEND) is supported and selected.");
+
+    if (!CreateSessionResources()) goto cleanup;
+
+    if (!graphicsRetained) {
+        appState.bundle.OpenAsset(appState.assetManager, "iris.pak");
+        CreateGraphicsPipeline(appState.pipeline, appState.bundle.IsOpen() ? &appState.bundle : nullptr);
+        CreateGpuTimer(appState.gpuTimer);
+        const SceneObject panel = {{0.0f, 0.0f, -1.0f}, 1.0f};
+        CreateScene(appState.scene, appState.pipeline, &panel, 1, true);
+        appState.graphicsAssetsReady = true;
     } else {
-        ALOGI("Passthrough (ALPHA_BLEND) is not supported, falling back to OPAQUE.");
+        ALOGI("Programs, scene and GPU timer kept; only the instance and session were recreated.");
     }
+    GpuResources_LogReport();
 
-    if (OXR_CHECK(appState.xrInstance, xrGetInstanceProcAddr(appState.xrInstance, "xrGetOpenGLESGraphicsRequirementsKHR", (PFN_xrVoidFunction*)&pfnGetOpenGLESGraphicsRequirementsKHR), "xrGetInstanceProcAddr") != XR_SUCCESS) goto cleanup; if (OXR_CHECK(appState.xrInstance, pfnGetOpenGLESGraphicsRequirementsKHR(appState.xrInstance, appState.systemId, &graphicsRequirements), "xrGetOpenGLESGraphicsRequirementsKHR") != XR_SUCCESS) goto cleanup; graphicsBinding.display = appState.graphics.display; graphicsBinding.config = appState.graphics.config; graphicsBinding.context = appState.graphics.context; sessionCreateInfo.next = &graphicsBinding; sessionCreateInfo.systemId = appState.systemId; if (OXR_CHECK(appState.xrInstance, xrCreateSession(appState.xrInstance, &sessionCreateInfo, &appState.xrSession), "xrCreateSession") != XR_SUCCESS) goto cleanup; ALOGI("OpenXR session created."); spaceCreateInfo.referenceSpaceType = XR_REFERENCE_SPACE_TYPE_STAGE; spaceCreateInfo.poseInReferenceSpace = {{0.0f, 0.0f, 0.0f, 1.0f}, {0.0f, 0.0f, 0.0f}}; if (OXR_CHECK(appState.xrInstance, xrCreateReferenceSpace(appState.xrSession, &spaceCreateInfo, &appState.stageSpace), "xrCreateReferenceSpace") != XR_SUCCESS) goto cleanup; ALOGI("OpenXR stage space created.");
-
-    xrEnumerateViewConfigurationViews(appState.xrInstance, appState.systemId, XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO, 0, &viewCount, nullptr);
-    appState.viewConfigs.resize(viewCount, {XR_TYPE_VIEW_CONFIGURATION_VIEW});
-    appState.views.resize(viewCount, {XR_TYPE_VIEW});
-    xrEnumerateViewConfigurationViews(appState.xrInstance, appState.systemId, XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO, viewCount, &viewCount, appState.viewConfigs.data());
-    appState.swapchains.resize(viewCount);
-    appState.framebuffers.resize(viewCount);
-    for (uint32_t i = 0; i < viewCount; ++i) {
-        auto& sc = appState.swapchains[i];
-        sc.width = appState.viewConfigs[i].recommendedImageRectWidth;
-        sc.height = appState.viewConfigs[i].recommendedImageRectHeight;
-        XrSwapchainCreateInfo swapchainCI = {XR_TYPE_SWAPCHAIN_CREATE_INFO};
-        swapchainCI.usageFlags = XR_SWAPCHAIN_USAGE_COLOR_ATTACHMENT_BIT;
-        swapchainCI.format = GL_RGBA8;
-        swapchainCI.width = static_cast<uint32_t>(sc.width);
-        swapchainCI.height = static_cast<uint32_t>(sc.height);
-        swapchainCI.sampleCount = 1;
-        swapchainCI.faceCount = 1;
-        swapchainCI.arraySize = 1;
-        swapchainCI.mipCount = 1;
-        OXR_CHECK(appState.xrInstance, xrCreateSwapchain(appState.xrSession, &swapchainCI, &sc.handle), "xrCreateSwapchain");
-        uint32_t imageCount = 0;
-        xrEnumerateSwapchainImages(sc.handle, 0, &imageCount, nullptr);
-        sc.images.resize(imageCount, {XR_TYPE_SWAPCHAIN_IMAGE_OPENGL_ES_KHR});
-        xrEnumerateSwapchainImages(sc.handle, imageCount, &imageCount, (XrSwapchainImageBaseHeader*)sc.images.data());
+    while (appState.running) {
+        const int64_t frameStartNs = NowNs();
+        const uint64_t frameIndex = appState.frameIndex++;
+        GpuResources_SetFrame(frameIndex);
+        appState.framePacing.BeginFrame(frameIndex);
+        bool mirrorChange = false;
+        bool mirrorEnabled = false;
+        MirrorConfig mirrorConfig;
+        {
+            uint64_t timedFrame;
+            int64_t gpuNs;
+            while (GpuTimer_Poll(appState.gpuTimer, timedFrame, gpuNs)) appState.framePacing.SetGpuTime(timedFrame, gpuNs);
+        }
+        {
+            std::unique_lock<std::mutex> lock(appState.appMutex);
+            appState.perfHintStats = appState.perfHint.Stats();
+            appState.swapchainWaitStats.resize(appState.swapchains.size());
+            for (size_t i = 0; i < appState.swapchains.size(); ++i) appState.swapchainWaitStats[i] = appState.swapchains[i].waitStats;
+            appState.scene.lodPixelError = appState.lodPixelErrorRequested;
+            appState.lodStats = appState.scene.lodStats;
+            appState.lodCount = appState.scene.lodCount;
+            appState.imageCaptureStats = appState.imageCapture.Stats();
+            appState.mirrorStats = appState.mirror.Stats();
+            if (appState.mirrorRequested) {
+                appState.mirrorRequested = false;
+                mirrorChange = true;
+                mirrorEnabled = appState.mirrorEnabledRequested;
+                mirrorConfig = appState.mirrorRequest;
+            }
+            if (!appState.stillRequest.empty()) {
+                appState.imageCapture.RequestStill(appState.stillRequest);
+                appState.stillRequest.clear();
+            }
+            if (appState.recordingRequested) {
+                appState.recordingRequested = false;
+                if (appState.recordingRequest.empty()) {
+                    appState.imageCapture.StopRecording();
+                } else {
+                    appState.imageCapture.StartRecording(appState.recordingRequest, appState.recordingFps);
+                }
+            }
+            if (appState.frameCaptureRequested) {
+                appState.frameCaptureRequested = false;
+                appState.frameCapture.Close();
+                if (!appState.frameCaptureRequest.empty()) {
+                    std::vector<FrameCaptureTarget> targets;
+                    for (const auto& sc : appState.swapchains) targets.push_back({sc.width, sc.height});
+                    appState.frameCapture.Open(appState.frameCaptureRequest, targets);
+                    appState.lastCapturedInput = {0xFF, 0xFF};   // force the first input record
+                }
+            }
+        }
 
-        glGenTextures(1, &sc.depthTexture);
-        glBindTexture(GL_TEXTURE_2D, sc.depthTexture);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, sc.width, sc.height, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, 0);
-        glBindTexture(GL_TEXTURE_2D, 0);
-    }
-    ALOGI("Swapchains created for %d views.", viewCount);
+        if (mirrorChange) {
+            // Outside appMutex: stopping joins the mirror thread.
+            appState.mirror.Stop();
+            appState.mirror.ReleaseGl();
+            if (mirrorEnabled) appState.mirror.Start(mirrorConfig);
+        }
 
-    CreateGraphicsPipeline();
+        if ((appState.sessionLost || appState.instanceLost) && !RecoverXr()) {
+            std::unique_lock<std::mutex> lock(appState.appMutex);
+            appState.appCondition.wait_for(lock, std::chrono::milliseconds(kXrRecoveryRetryMs), [] { return !appState.running; });
+            continue;
+        }
 
-    while (appState.running) {
         XrEventDataBuffer eventData = {XR_TYPE_EVENT_DATA_BUFFER};
         while (xrPollEvent(appState.xrInstance, &eventData) == XR_SUCCESS) {
             if (eventData.type == XR_TYPE_EVENT_DATA_SESSION_STATE_CHANGED) {
                 auto ssc = *reinterpret_cast<XrEventDataSessionStateChanged*>(&eventData);
                 ALOGI("OpenXR session state changed to %d", ssc.state);
+                if (appState.frameCapture.IsOpen()) appState.frameCapture.WriteSessionState({ssc.time, ssc.state});
                 if (ssc.state == XR_SESSION_STATE_READY) {
+                    NoteResumeStart(RESUME_HOT, NowNs());
                     XrSessionBeginInfo bi = {XR_TYPE_SESSION_BEGIN_INFO, nullptr, XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO};
                     xrBeginSession(appState.xrSession, &bi);
                     appState.sessionReady = true;
                 } else if (ssc.state == XR_SESSION_STATE_STOPPING) {
+                    appState.framePacing.LogReport();
                     xrEndSession(appState.xrSession);
                     appState.sessionReady = false;
-                } else if (ssc.state == XR_SESSION_STATE_EXITING || ssc.state == XR_SESSION_STATE_LOSS_PENDING) {
+                } else if (ssc.state == XR_SESSION_STATE_LOSS_PENDING) {
+                    // The instance stays; the session is rebuilt once the runtime has a system again.
+                    ALOGW("OpenXR session lost, recreating it.");
+                    NoteResumeStart(RESUME_SESSION, NowNs());
+                    DestroySessionResources();
+                    appState.sessionLost = true;
+                    break;
+                } else if (ssc.state == XR_SESSION_STATE_EXITING) {
                     appState.running = false;
                 }
+            } else if (eventData.type == XR_TYPE_EVENT_DATA_INSTANCE_LOSS_PENDING) {
+                ALOGW("OpenXR instance lost, recreating it.");
+                NoteResumeStart(RESUME_SESSION, NowNs());
+                DestroySessionResources();
+                DestroyInstance();
+                appState.sessionLost = appState.instanceLost = true;
+                break;
+            } else if (eventData.type == XR_TYPE_EVENT_DATA_VISIBILITY_MASK_CHANGED_KHR) {
+                const auto& changed = *reinterpret_cast<XrEventDataVisibilityMaskChangedKHR*>(&eventData);
+                FetchVisibilityMask(changed.viewIndex);
             }
             eventData = {XR_TYPE_EVENT_DATA_BUFFER};
         }
 
-        if (!appState.sessionReady || !appState.resumed) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        StreamToken token;
+        while (appState.streamClient.PopToken(token)) {
+            if (token.requestId != appState.assistantRequestId) {
+                appState.assistantRequestId = token.requestId;
+                appState.assistantText.clear();
+            }
+            if (token.kind == STREAM_TOKEN_TEXT) {
+                appState.assistantText.append(token.text, token.length);
+            } else {
+                ALOGI("Assistant response %u %s (%zu chars).", token.requestId, token.kind == STREAM_TOKEN_DONE ? "complete" : "failed", appState.assistantText.size());
+            }
+        }
+
+        if (appState.frameCapture.IsOpen()) {
+            // Inputs are recorded only when they change, keeping captures compact.
+            CapturedInput input = {static_cast<uint8_t>(appState.resumed), static_cast<uint8_t>(appState.sessionReady)};
+            if (input.resumed != appState.lastCapturedInput.resumed || input.sessionReady != appState.lastCapturedInput.sessionReady) {
+                appState.frameCapture.WriteInput(input);
+                appState.lastCapturedInput = input;
+            }
+        }
+
+        if (appState.sessionLost || !appState.sessionReady || !appState.resumed) {
+            appState.lastFrameWakeNs = 0;
+            appState.framePacing.Reset();
+            // Paused: sleep until onResume, waking now and then for runtime events.
+            // Resumed but waiting on the session: poll often, READY is due soon
+            // and every millisecond here is added to the resume.
+            std::unique_lock<std::mutex> lock(appState.appMutex);
+            if (!appState.resumed) {
+                appState.appCondition.wait_for(lock, std::chrono::milliseconds(100), [] { return appState.resumed || !appState.running; });
+            } else {
+                lock.unlock();
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            }
             continue;
         }
+        const uint32_t viewCount = static_cast<uint32_t>(appState.swapchains.size());
 
         XrFrameState frameState = {XR_TYPE_FRAME_STATE};
         XrFrameWaitInfo frameWaitInfo = {XR_TYPE_FRAME_WAIT_INFO};
+        appState.framePacing.MarkPhase(FRAME_PHASE_WAIT);
+        const int64_t frameWaitStartNs = NowNs();
         xrWaitFrame(appState.xrSession, &frameWaitInfo, &frameState);
+        const int64_t frameWakeNs = NowNs();
+        appState.framePacing.MarkPhase(FRAME_PHASE_BEGIN);
+        {
+            // xrWaitFrame should return one display period after the previous
+            // return. If the wait began before that point, anything beyond it is
+            // the render thread waiting to be scheduled.
+            const int64_t expectedNs = appState.lastFrameWakeNs + frameState.predictedDisplayPeriod;
+            if (appState.lastFrameWakeNs != 0 && frameWaitStartNs < expectedNs) ThreadRoles_RecordWake(expectedNs, frameWakeNs);
+            appState.lastFrameWakeNs = frameWakeNs;
+        }
+        if (!appState.perfHintTried) {
+            appState.perfHintTried = true;
+            std::vector<int32_t> tids = ThreadRoles_Threads(THREAD_ROLE_RENDER);
+            for (int32_t tid : ThreadRoles_Threads(THREAD_ROLE_WORKER)) tids.push_back(tid);
+            PerfHintBackend* backend = PerfHint_CreateSystemBackend();
+            if (backend == nullptr) ALOGI("APerformanceHint unavailable (API < 33), no perf hint session.");
+            appState.perfHint.Open(backend, tids, frameState.predictedDisplayPeriod);
+        }
 
         xrBeginFrame(appState.xrSession, nullptr);
 
-        std::vector<XrCompositionLayerBaseHeader*> layers;
+        appState.frameArena.Reset();
+        auto** layers = appState.frameArena.AllocArray<XrCompositionLayerBaseHeader*>(kMaxFrameLayers);
+        uint32_t layerCount = 0;
         XrCompositionLayerProjection layer = {XR_TYPE_COMPOSITION_LAYER_PROJECTION};
-        std::vector<XrCompositionLayerProjectionView> projectionViews(viewCount, {XR_TYPE_COMPOSITION_LAYER_PROJECTION_VIEW});
+        auto* projectionViews = appState.frameArena.AllocArray<XrCompositionLayerProjectionView>(viewCount, {XR_TYPE_COMPOSITION_LAYER_PROJECTION_VIEW});
+        auto* imageIndices = appState.frameArena.AllocArray<uint32_t>(viewCount);
 
-        if (frameState.shouldRender) {
+        // A capped-out frame arena submits an empty frame rather than touching the heap.
+        if (frameState.shouldRender && layers != nullptr && projectionViews != nullptr && imageIndices != nullptr) {
             XrViewState viewState = {XR_TYPE_VIEW_STATE};
             XrViewLocateInfo viewLocateInfo = {XR_TYPE_VIEW_LOCATE_INFO, nullptr, XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO, frameState.predictedDisplayTime, appState.stageSpace};
             uint32_t viewCountOutput;
             xrLocateViews(appState.xrSession, &viewLocateInfo, &viewState, viewCount, &viewCountOutput, appState.views.data());
 
+            // The listener sits between the eyes, facing where the first eye faces.
+            HeadPose headPose = {};
             for (uint32_t i = 0; i < viewCount; ++i) {
-                auto& sc = appState.swapchains[i];
-                uint32_t imageIndex;
-                xrAcquireSwapchainImage(sc.handle, nullptr, &imageIndex);
-                XrSwapchainImageWaitInfo waitInfo = {XR_TYPE_SWAPCHAIN_IMAGE_WAIT_INFO, nullptr, XR_INFINITE_DURATION};
-                xrWaitSwapchainImage(sc.handle, &waitInfo);
-
-                if (appState.framebuffers[i] == 0) glGenFramebuffers(1, &appState.framebuffers[i]);
-                glBindFramebuffer(GL_FRAMEBUFFER, appState.framebuffers[i]);
-                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, sc.images[imageIndex].image, 0);
-                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, sc.depthTexture, 0);
-
-                glViewport(0, 0, sc.width, sc.height);
-                glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
-                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-                glEnable(GL_DEPTH_TEST);
-
-                Matrix4f proj = Matrix4f_CreateProjectionFov(appState.views[i].fov, 0.1f, 100.0f);
-                Matrix4f view = Matrix4f_CreateView(appState.views[i].pose);
-
-                Matrix4f model = Matrix4f_CreateTranslation(0.0f, 0.0f, -1.0f);
-                Matrix4f mvp = Matrix4f_Multiply(Matrix4f_Multiply(proj, view), model);
-
-                glUseProgram(appState.pipeline.shaderProgram);
-                glUniformMatrix4fv(appState.pipeline.mvpLocation, 1, GL_FALSE, mvp.M);
-                glBindVertexArray(appState.pipeline.vao);
-                glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-                glBindVertexArray(0);
-                glUseProgram(0);
-
-                glBindFramebuffer(GL_FRAMEBUFFER, 0);
-                xrReleaseSwapchainImage(sc.handle, nullptr);
-
-                projectionViews[i].pose = appState.views[i].pose;
-                projectionViews[i].fov = appState.views[i].fov;
-                projectionViews[i].subImage.swapchain = sc.handle;
-                projectionViews[i].subImage.imageRect = {{0, 0}, {sc.width, sc.height}};
+                headPose.position[0] += appState.views[i].pose.position.x / viewCount;
+                headPose.position[1] += appState.views[i].pose.position.y / viewCount;
+                headPose.position[2] += appState.views[i].pose.position.z / viewCount;
             }
+            const XrQuaternionf& o = appState.views[0].pose.orientation;
+            headPose.orientation[0] = o.x; headPose.orientation[1] = o.y; headPose.orientation[2] = o.z; headPose.orientation[3] = o.w;
+            appState.spatialMixer.HeadPoseInput().Publish(headPose);
+            appState.spatialMixer.RegisterOutputThread();
+            // The pose is predicted for display time, so that is what it is filed under; on
+            // Android XrTime runs on CLOCK_MONOTONIC, the clock camera timestamps use.
+            appState.headPoses.Record(headPose, frameState.predictedDisplayTime);
+
+            if (appState.frameCapture.IsOpen()) {
+                CapturedFrame captured;
+                captured.frameStartNs = frameStartNs;
+                captured.predictedDisplayTime = frameState.predictedDisplayTime;
+                captured.predictedDisplayPeriod = frameState.predictedDisplayPeriod;
+                captured.shouldRender = 1;
+                captured.viewStateFlags = static_cast<uint32_t>(viewState.viewStateFlags);
+                captured.viewCount = std::min<uint32_t>(viewCountOutput, kFrameCaptureMaxViews);
+                for (uint32_t i = 0; i < captured.viewCount; ++i) captured.views[i] = {appState.views[i].pose, appState.views[i].fov};
+                appState.frameCapture.WriteFrame(captured);
+            }
+
+            appState.framePacing.MarkPhase(FRAME_PHASE_CULL);
+            GpuTimer_Begin(appState.gpuTimer, frameIndex);
+            appState.imageCapture.Poll();
+            appState.mirror.Poll();
+            if (!EnsureMeshResident(appState.pipeline, appState.scene)) ALOGE("Pipeline mesh could not be reloaded.");
+            CullScene(appState.scene, appState.views.data(), viewCountOutput, appState.swapchains[0].height);
 
-            layer.space = appState.stageSpace; layer.viewCount = viewCount; layer.views = projectionViews.data();
-            layers.push_back((XrCompositionLayerBaseHeader*)&layer);
+            // Every eye's image is waited for before any GL work, so a compositor
+            // hold-up is sat out once up front instead of between the eyes' draws.
+            appState.framePacing.MarkPhase(FRAME_PHASE_ACQUIRE);
+            const XrDuration waitTimeoutNs = frameState.predictedDisplayPeriod > 0 ? frameState.predictedDisplayPeriod : 1000000000LL / 60;
+            uint32_t acquired = 0;
+            while (acquired < viewCount && AcquireSwapchainImage(appState.swapchains[acquired], acquired, waitTimeoutNs, imageIndices[acquired])) acquired++;
+            appState.framePacing.MarkPhase(FRAME_PHASE_RENDER);
+
+            if (acquired == viewCount) {
+                for (uint32_t i = 0; i < viewCount; ++i) {
+                    auto& sc = appState.swapchains[i];
+                    if (appState.framebuffers[i] == 0) glGenFramebuffers(1, &appState.framebuffers[i]);
+                    glBindFramebuffer(GL_FRAMEBUFFER, appState.framebuffers[i]);
+                    AttachViewTargets(appState.msaa, sc.images[imageIndices[i]].image, sc.depthTexture);
+
+                    RenderView(appState.pipeline, appState.scene, appState.views[i], sc.width, sc.height, &appState.visibilityMasks[i]);
+                    DiscardViewDepth();
+                    if (i == 0) {
+                        appState.imageCapture.CaptureView(sc.width, sc.height, frameState.predictedDisplayTime);
+                        appState.mirror.CaptureView(appState.framebuffers[i], sc.width, sc.height, frameState.predictedDisplayTime);
+                    }
+
+                    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+                    xrReleaseSwapchainImage(sc.handle, nullptr);
+
+                    projectionViews[i].pose = appState.views[i].pose;
+                    projectionViews[i].fov = appState.views[i].fov;
+                    projectionViews[i].subImage.swapchain = sc.handle;
+                    projectionViews[i].subImage.imageRect = {{0, 0}, {sc.width, sc.height}};
+                }
+
+                layer.space = appState.stageSpace; layer.viewCount = viewCount; layer.views = projectionViews;
+                layers[layerCount++] = (XrCompositionLayerBaseHeader*)&layer;
+            } else {
+                // Shutting down or the runtime failed a call: hand back what was waited for, submit nothing.
+                for (uint32_t i = 0; i < acquired; ++i) xrReleaseSwapchainImage(appState.swapchains[i].handle, nullptr);
+            }
+
+            GpuTimer_End(appState.gpuTimer);
+        }
+
+        if (!frameState.shouldRender && appState.frameCapture.IsOpen()) {
+            CapturedFrame captured;
+            captured.frameStartNs = frameStartNs;
+            captured.predictedDisplayTime = frameState.predictedDisplayTime;
+            captured.predictedDisplayPeriod = frameState.predictedDisplayPeriod;
+            appState.frameCapture.WriteFrame(captured);
         }
 
-        XrFrameEndInfo frameEndInfo = {XR_TYPE_FRAME_END_INFO, nullptr, frameState.predictedDisplayTime, appState.blendMode, (uint32_t)layers.size(), layers.data()};
+        XrFrameEndInfo frameEndInfo = {XR_TYPE_FRAME_END_INFO, nullptr, frameState.predictedDisplayTime, appState.blendMode, layerCount, layers};
+        appState.framePacing.MarkPhase(FRAME_PHASE_SUBMIT);
         xrEndFrame(appState.xrSession, &frameEndInfo);
+        appState.framePacing.EndFrame(frameState.predictedDisplayTime, frameState.predictedDisplayPeriod);
+        // The frame's CPU work runs from xrWaitFrame returning to xrEndFrame returning.
+        appState.perfHint.ReportFrame(NowNs() - frameWakeNs, frameState.predictedDisplayPeriod);
+        if (layerCount != 0) NoteFirstFrame();
+        GpuResources_EndFrame();
+        GlTrace_EndFrame();
+        GlTrace_Invalidate();   // the runtime may use our context while composing
     }
 
     cleanup:
     ALOGI("Cleaning up native resources...");
-    glDeleteFramebuffers(appState.framebuffers.size(), appState.framebuffers.data());
-    glDeleteProgram(appState.pipeline.shaderProgram);
-    glDeleteBuffers(1, &appState.pipeline.vbo);
-    glDeleteBuffers(1, &appState.pipeline.ebo);
-    glDeleteVertexArrays(1, &appState.pipeline.vao);
-    for(auto& sc : appState.swapchains) {
-        if (sc.handle != XR_NULL_HANDLE) xrDestroySwapchain(sc.handle);
-        if (sc.depthTexture != 0) glDeleteTextures(1, &sc.depthTexture);
-    }
-    if (appState.stageSpace != XR_NULL_HANDLE) xrDestroySpace(appState.stageSpace);
-    if (appState.xrSession != XR_NULL_HANDLE) xrDestroySession(appState.xrSession);
-    if (appState.graphics.context != EGL_NO_CONTEXT) {
-        eglMakeCurrent(appState.graphics.display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
-        eglDestroyContext(appState.graphics.display, appState.graphics.context);
+    appState.perfHint.Close();
+    appState.perfHintTried = false;
+    appState.frameCapture.Close();
+    appState.imageCapture.ReleaseGl();
+    appState.imageCapture.Shutdown();   // queued stills and the recording's tail reach disk
+    appState.mirror.ReleaseGl();        // the listener stays up; a connected client just sees a pause
+    DestroySessionResources();
+    DestroyInstance();
+    appState.sessionLost = appState.instanceLost = false;
+    Mem_LogReport();
+    ThreadRoles_LogReport();
+    appState.framePacing.LogReport();
+    {
+        bool keepGraphics;
+        {
+            std::unique_lock<std::mutex> lock(appState.appMutex);
+            keepGraphics = appState.keepGraphics;
+            appState.resumeStartNs = 0;
+        }
+        if (keepGraphics && appState.graphicsAssetsReady) {
+            // The activity is being recreated; the next app thread picks the context up again.
+            GpuResources_FlushDeletes();
+            GpuResources_LogReport();
+            eglMakeCurrent(appState.graphics.display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+            ALOGI("EGL context, programs and assets kept for the next activity.");
+        } else {
+            if (appState.graphics.context != EGL_NO_CONTEXT &&
+                eglMakeCurrent(appState.graphics.display, EGL_NO_SURFACE, EGL_NO_SURFACE, appState.graphics.context) == EGL_TRUE) {
+                DestroyGraphicsAssets();
+            }
+            GpuResources_LogReport();
+            if (GpuResources_ReportLeaks() != 0) ALOGW("GPU resources still registered at shutdown, see above.");
+            if (appState.graphics.context != EGL_NO_CONTEXT) {
+                eglMakeCurrent(appState.graphics.display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+                eglDestroyContext(appState.graphics.display, appState.graphics.context);
+            }
+            if (appState.graphics.display != EGL_NO_DISPLAY) eglTerminate(appState.graphics.display);
+            appState.graphics = {};
+        }
     }
-    if (appState.graphics.display != EGL_NO_DISPLAY) eglTerminate(appState.graphics.display);
-    if (appState.xrInstance != XR_NULL_HANDLE) xrDestroyInstance(appState.xrInstance);
-
-    appState.xrInstance = XR_NULL_HANDLE;
-    appState.xrSession = XR_NULL_HANDLE;
-    appState.stageSpace = XR_NULL_HANDLE;
-    appState.systemId = XR_NULL_SYSTEM_ID;
-    appState.graphics = {};
 
     ALOGI("App thread detached from JVM.");
     appState.vm->DetachCurrentThread();
@@ -0,0 +1,153 @@
+#include "perf_hint.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+#if defined(__ANDROID__)
+#include <dlfcn.h>
+#endif
+
+#include "common.h"
+
+namespace {
+
+// Periods closer than this are the same refresh rate; the runtime's estimate jitters.
+constexpr int64_t kPeriodToleranceDivisor = 100;
+
+#if defined(__ANDROID__)
+// =============================================================================
+// APerformanceHint backend
+// =============================================================================
+class AndroidPerfHintBackend : public PerfHintBackend {
+public:
+    bool Load() {
+        void* lib = dlopen("libandroid.so", RTLD_NOW | RTLD_LOCAL);
+        if (lib == nullptr) return false;
+        getManager_ = reinterpret_cast<GetManagerFn>(dlsym(lib, "APerformanceHint_getManager"));
+        createSession_ = reinterpret_cast<CreateSessionFn>(dlsym(lib, "APerformanceHint_createSession"));
+        updateTarget_ = reinterpret_cast<UpdateTargetFn>(dlsym(lib, "APerformanceHint_updateTargetWorkDuration"));
+        reportActual_ = reinterpret_cast<ReportActualFn>(dlsym(lib, "APerformanceHint_reportActualWorkDuration"));
+        closeSession_ = reinterpret_cast<CloseSessionFn>(dlsym(lib, "APerformanceHint_closeSession"));
+        // libandroid.so stays loaded for the life of the process anyway.
+        return getManager_ && createSession_ && updateTarget_ && reportActual_ && closeSession_;
+    }
+
+    bool Open(const std::vector<int32_t>& tids, int64_t targetNs) override {
+        void* manager = getManager_();
+        if (manager == nullptr) return false;
+        session_ = createSession_(manager, tids.data(), tids.size(), targetNs);
+        return session_ != nullptr;
+    }
+
+    bool UpdateTarget(int64_t targetNs) override { return updateTarget_(session_, targetNs) == 0; }
+    bool ReportActual(int64_t actualNs) override { return reportActual_(session_, actualNs) == 0; }
+
+    void Close() override {
+        if (session_ != nullptr) closeSession_(session_);
+        session_ = nullptr;
+    }
+
+    const char* Name() const override { return "APerformanceHint"; }
+
+private:
+    // Handles are opaque, so the NDK header (API 33) is not needed.
+    typedef void* (*GetManagerFn)();
+    typedef void* (*CreateSessionFn)(void*, const int32_t*, size_t, int64_t);
+    typedef int (*UpdateTargetFn)(void*, int64_t);
+    typedef int (*ReportActualFn)(void*, int64_t);
+    typedef void (*CloseSessionFn)(void*);
+
+    GetManagerFn getManager_ = nullptr;
+    CreateSessionFn createSession_ = nullptr;
+    UpdateTargetFn updateTarget_ = nullptr;
+    ReportActualFn reportActual_ = nullptr;
+    CloseSessionFn closeSession_ = nullptr;
+    void* session_ = nullptr;
+};
+#endif
+
+} // namespace
+
+PerfHintBackend* PerfHint_CreateSystemBackend() {
+#if defined(__ANDROID__)
+    auto* backend = new AndroidPerfHintBackend();
+    if (backend->Load()) return backend;
+    delete backend;
+#endif
+    return nullptr;
+}
+
+// =============================================================================
+// Recording backend
+// =============================================================================
+bool RecordingPerfHintBackend::Open(const std::vector<int32_t>&, int64_t targetNs) {
+    return UpdateTarget(targetNs);
+}
+
+bool RecordingPerfHintBackend::UpdateTarget(int64_t targetNs) {
+    targetNs_ = targetNs;
+    records_.push_back({NowNs(), targetNs, 0});
+    return true;
+}
+
+bool RecordingPerfHintBackend::ReportActual(int64_t actualNs) {
+    records_.push_back({NowNs(), targetNs_, actualNs});
+    return true;
+}
+
+bool RecordingPerfHintBackend::WriteCsv(const char* path) const {
+    FILE* f = fopen(path, "w");
+    if (f == nullptr) { ALOGE("Perf hint log %s could not be opened", path); return false; }
+    fprintf(f, "at_ns,target_ns,actual_ns\n");
+    for (const PerfHintRecord& r : records_) {
+        fprintf(f, "%lld,%lld,%lld\n", (long long)r.atNs, (long long)r.targetNs, (long long)r.actualNs);
+    }
+    fclose(f);
+    return true;
+}
+
+// =============================================================================
+// Session
+// =============================================================================
+bool PerfHintSession::Open(PerfHintBackend* backend, const std::vector<int32_t>& tids, int64_t displayPeriodNs) {
+    Close();
+    if (backend == nullptr) return false;
+    if (tids.empty() || displayPeriodNs <= 0 || !backend->Open(tids, displayPeriodNs)) {
+        ALOGW("Perf hint session (%s) could not be opened", backend->Name());
+        delete backend;
+        return false;
+    }
+    backend_ = backend;
+    stats_ = {};
+    stats_.active = true;
+    stats_.targetNs = displayPeriodNs;
+    ALOGI("Perf hint session (%s) opened for %zu threads, target %.2f ms", backend->Name(), tids.size(),
+          displayPeriodNs / 1e6);
+    return true;
+}
+
+void PerfHintSession::Close() {
+    if (backend_ == nullptr) return;
+    backend_->Close();
+    delete backend_;
+    backend_ = nullptr;
+    stats_.active = false;
+    ALOGI("Perf hint session closed: %llu reports, %llu over target, %llu target updates",
+          (unsigned long long)stats_.reports, (unsigned long long)stats_.overTarget,
+          (unsigned long long)stats_.targetUpdates);
+}
+
+void PerfHintSession::ReportFrame(int64_t workNs, int64_t displayPeriodNs) {
+    if (backend_ == nullptr) return;
+    if (displayPeriodNs > 0 && llabs(displayPeriodNs - stats_.targetNs) > stats_.targetNs / kPeriodToleranceDivisor) {
+        ALOGI("Display period %.2f -> %.2f ms, updating perf hint target", stats_.targetNs / 1e6, displayPeriodNs / 1e6);
+        // Not retried on failure: the next report still carries the right actual duration.
+        if (backend_->UpdateTarget(displayPeriodNs)) stats_.targetUpdates++;
+        else stats_.failures++;
+        stats_.targetNs = displayPeriodNs;
+    }
+    if (!backend_->ReportActual(workNs)) stats_.failures++;
+    stats_.reports++;
+    stats_.lastActualNs = workNs;
+    if (workNs > stats_.targetNs) stats_.overTarget++;
+}
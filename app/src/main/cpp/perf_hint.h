@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// =============================================================================
+// Performance Hint Session (ADPF)
+// =============================================================================
+// Tells the CPU governor what the frame deadline is. The render and worker
+// threads are grouped into one hint session whose target is the display period;
+// every frame reports how long its CPU work actually took, so clocks ramp before
+// a frame is missed rather than after. The target follows refresh-rate changes.
+
+class PerfHintBackend {
+public:
+    virtual ~PerfHintBackend() = default;
+    virtual bool Open(const std::vector<int32_t>& tids, int64_t targetNs) = 0;
+    virtual bool UpdateTarget(int64_t targetNs) = 0;
+    virtual bool ReportActual(int64_t actualNs) = 0;
+    virtual void Close() = 0;
+    virtual const char* Name() const = 0;
+};
+
+// APerformanceHint from libandroid.so (API 33+). Resolved at runtime so the app
+// still loads on older releases; nullptr when unavailable.
+PerfHintBackend* PerfHint_CreateSystemBackend();
+
+// Linux stand-in: keeps every call so the reported durations can be checked.
+struct PerfHintRecord {
+    int64_t atNs;
+    int64_t targetNs;
+    int64_t actualNs;   // 0 for a target update
+};
+
+class RecordingPerfHintBackend : public PerfHintBackend {
+public:
+    bool Open(const std::vector<int32_t>& tids, int64_t targetNs) override;
+    bool UpdateTarget(int64_t targetNs) override;
+    bool ReportActual(int64_t actualNs) override;
+    void Close() override {}
+    const char* Name() const override { return "recording"; }
+
+    const std::vector<PerfHintRecord>& Records() const { return records_; }
+    // One "at_ns,target_ns,actual_ns" line per call.
+    bool WriteCsv(const char* path) const;
+
+private:
+    std::vector<PerfHintRecord> records_;
+    int64_t targetNs_ = 0;
+};
+
+struct PerfHintStats {
+    bool active = false;
+    uint64_t reports = 0;
+    uint64_t overTarget = 0;       // frames whose work exceeded the target
+    uint64_t targetUpdates = 0;    // refresh-rate changes followed
+    uint64_t failures = 0;         // calls the backend rejected
+    int64_t targetNs = 0;
+    int64_t lastActualNs = 0;
+};
+
+class PerfHintSession {
+public:
+    ~PerfHintSession() { Close(); }
+
+    // Takes ownership of the backend (deleted on Close, or right away on failure).
+    bool Open(PerfHintBackend* backend, const std::vector<int32_t>& tids, int64_t displayPeriodNs);
+    void Close();
+    bool IsOpen() const { return backend_ != nullptr; }
+
+    // Once per frame, with the CPU time the frame's work took and the period
+    // reported by the runtime for it.
+    void ReportFrame(int64_t workNs, int64_t displayPeriodNs);
+
+    PerfHintStats Stats() const { return stats_; }
+
+private:
+    PerfHintBackend* backend_ = nullptr;
+    PerfHintStats stats_;
+};
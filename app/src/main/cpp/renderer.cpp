@@ -0,0 +1,771 @@
+#include "renderer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+
+#include <EGL/egl.h>
+
+#include "common.h"
+#include "gl_trace.h"
+#include "gpu_resources.h"
+#include "xr_math.h"
+
+namespace {
+
+constexpr uint32_t kPipelineFeatures = SHADER_FEATURE_VERTEX_COLOR;
+
+// Built-in quad bounding sphere radius at scale 1 (half-diagonal of the unit quad).
+constexpr float kQuadRadius = 0.7072f;
+constexpr uint32_t kPanelVertexFormat = ASSET_VERTEX_POSITION | ASSET_VERTEX_COLOR;
+constexpr float kNearZ = 0.1f;
+constexpr float kFarZ = 100.0f;
+
+bool HasExtension(const char* name) {
+    const char* extensions = reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS));
+    if (extensions == nullptr) return false;
+    const size_t length = strlen(name);
+    for (const char* p = strstr(extensions, name); p != nullptr; p = strstr(p + length, name)) {
+        const bool startOk = p == extensions || p[-1] == ' ';
+        const bool endOk = p[length] == ' ' || p[length] == '\0';
+        if (startOk && endOk) return true;
+    }
+    return false;
+}
+
+DepthConfig& CurrentDepth() {
+    static DepthConfig depth;
+    return depth;
+}
+
+Matrix4f Projection(const XrView& view) {
+    const DepthConfig& depth = CurrentDepth();
+    return depth.reversedZ ? Matrix4f_CreateProjectionFovReversedInfinite(view.fov, kNearZ, depth.zeroToOne)
+                           : Matrix4f_CreateProjectionFov(view.fov, kNearZ, kFarZ);
+}
+
+Matrix4f ViewProjection(const XrView& view) {
+    return Matrix4f_Multiply(Projection(view), Matrix4f_CreateView(view.pose));
+}
+
+// The budget wants one of the mesh buffers back; the pair goes together, and
+// EnsureMeshResident uploads both again before the mesh is next drawn.
+void EvictPipelineMesh(GpuResourceKind, GLuint, void* user) {
+    auto* pipeline = static_cast<GraphicsPipeline*>(user);
+    if (!pipeline->meshResident) return;   // the other buffer of the pair already took both
+    GpuResources_DeferDelete(GPU_KIND_BUFFER, pipeline->vbo);
+    GpuResources_DeferDelete(GPU_KIND_BUFFER, pipeline->ebo);
+    pipeline->vbo = pipeline->ebo = 0;
+    pipeline->meshResident = false;
+}
+
+} // namespace
+
+// =============================================================================
+// Graphics Pipeline
+// =============================================================================
+bool CreateGraphicsPipeline(GraphicsPipeline& pipeline, const AssetBundle* bundle) {
+    // Every variant the renderer can ask for is built here, while loading, so
+    // nothing compiles mid-frame.
+    pipeline.shaders.Prewarm({kPipelineFeatures, kPipelineFeatures | SHADER_FEATURE_INSTANCED, 0});
+    const ShaderVariant* variant = pipeline.shaders.Get(kPipelineFeatures);
+    if (variant == nullptr) return false;
+    pipeline.shaderProgram = variant->program;
+    pipeline.mvpLocation = variant->mvpLocation;
+    if (const ShaderVariant* depthOnly = pipeline.shaders.Get(0)) {
+        pipeline.depthOnlyProgram = depthOnly->program;
+        pipeline.depthOnlyMvpLocation = depthOnly->mvpLocation;
+    }
+
+    // Vertex-color variant layout: position then color, three floats each.
+    static const float kQuadVertices[] = {
+            -0.5f, -0.5f, 0.0f,   1.0f, 0.0f, 0.0f, // Bottom-left, Red
+            0.5f, -0.5f, 0.0f,   0.0f, 1.0f, 0.0f, // Bottom-right, Green
+            0.5f,  0.5f, 0.0f,   0.0f, 0.0f, 1.0f, // Top-right, Blue
+            -0.5f,  0.5f, 0.0f,   1.0f, 1.0f, 0.0f  // Top-left, Yellow
+    };
+    static const uint32_t kQuadIndices[] = {
+            0, 1, 2, // First triangle
+            2, 3, 0  // Second triangle
+    };
+
+    AssetMesh levels[kMaxMeshLods];
+    uint32_t levelCount = 0;
+    if (bundle != nullptr && bundle->GetMesh("panel", levels[0])) {
+        if (MeshVertexStride(levels[0].vertexFormat) == levels[0].vertexStride) {
+            levelCount = 1;
+        } else {
+            ALOGW("Bundled panel mesh has vertex format 0x%x stride %u; using the built-in quad.", levels[0].vertexFormat, levels[0].vertexStride);
+        }
+    }
+    for (; levelCount > 0 && levelCount < kMaxMeshLods; ++levelCount) {
+        char name[kAssetNameLength];
+        snprintf(name, sizeof(name), "panel%c%u", kAssetLodSeparator, levelCount);
+        AssetMesh& level = levels[levelCount];
+        if (!bundle->GetMesh(name, level)) break;
+        if (level.vertexFormat != levels[0].vertexFormat || level.vertexStride != levels[0].vertexStride ||
+            level.indexType != levels[0].indexType) {
+            ALOGW("Bundled %s is laid out unlike the panel mesh; the LOD chain stops there.", name);
+            break;
+        }
+    }
+    if (levelCount == 0) {
+        AssetMesh& mesh = levels[0];
+        mesh.vertices = kQuadVertices;
+        mesh.indices = kQuadIndices;
+        mesh.vertexCount = 4;
+        mesh.indexCount = 6;
+        mesh.vertexStride = 6 * sizeof(float);
+        mesh.vertexFormat = kPanelVertexFormat;
+        mesh.indexType = GL_UNSIGNED_INT;
+        mesh.boundingRadius = kQuadRadius;
+        levelCount = 1;
+    }
+
+    glGenVertexArrays(1, &pipeline.vao);
+    glBindVertexArray(pipeline.vao);
+    if (!UploadMesh(levels, levelCount, pipeline.vbo, pipeline.ebo, pipeline.lods, "pipeline", EvictPipelineMesh, &pipeline)) {
+        glBindVertexArray(0);
+        return false;
+    }
+    std::copy(levels, levels + levelCount, pipeline.meshLevels);
+    pipeline.meshResident = true;
+    pipeline.lodCount = levelCount;
+    pipeline.vertexFormat = levels[0].vertexFormat;
+    pipeline.vertexStride = static_cast<GLsizei>(levels[0].vertexStride);
+    pipeline.indexType = levels[0].indexType;
+    pipeline.boundingRadius = levels[0].boundingRadius;
+    SetMeshVertexLayout(pipeline.vertexFormat, pipeline.vertexStride);
+    glBindVertexArray(0);
+
+    return true;
+}
+
+void DestroyGraphicsPipeline(GraphicsPipeline& pipeline) {
+    pipeline.shaders.Destroy();
+    GpuResources_DeferDelete(GPU_KIND_BUFFER, pipeline.vbo);
+    GpuResources_DeferDelete(GPU_KIND_BUFFER, pipeline.ebo);
+    GpuResources_DeferDelete(GPU_KIND_VERTEX_ARRAY, pipeline.vao);
+    pipeline = {};
+}
+
+// =============================================================================
+// Bundled Assets
+// =============================================================================
+bool UploadMesh(const AssetMesh* levels, uint32_t levelCount, GLuint& vbo, GLuint& ebo, MeshLod* lods, const char* owner,
+                GpuEvictCallback evict, void* evictUser) {
+    // Straight from the mapping: the driver's copy is the only one, and the
+    // pages are faulted in by it as it reads them.
+    const GLsizeiptr indexSize = levels[0].indexType == GL_UNSIGNED_SHORT ? 2 : 4;
+    GLsizeiptr vertexBytes = 0, indexBytes = 0;
+    for (uint32_t i = 0; i < levelCount; ++i) {
+        if (levels[i].vertexCount == 0 || levels[i].indexCount == 0) return false;
+        lods[i].indexCount = static_cast<GLsizei>(levels[i].indexCount);
+        lods[i].firstIndex = static_cast<GLuint>(indexBytes / indexSize);
+        lods[i].baseVertex = static_cast<GLint>(vertexBytes / levels[0].vertexStride);
+        lods[i].error = levels[i].lodError;
+        vertexBytes += static_cast<GLsizeiptr>(levels[i].vertexCount) * levels[0].vertexStride;
+        indexBytes += static_cast<GLsizeiptr>(levels[i].indexCount) * indexSize;
+    }
+    glGenBuffers(1, &vbo);
+    glGenBuffers(1, &ebo);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    if (levelCount == 1) {
+        glBufferData(GL_ARRAY_BUFFER, vertexBytes, levels[0].vertices, GL_STATIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, levels[0].indices, GL_STATIC_DRAW);
+    } else {
+        glBufferData(GL_ARRAY_BUFFER, vertexBytes, nullptr, GL_STATIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, nullptr, GL_STATIC_DRAW);
+        for (uint32_t i = 0; i < levelCount; ++i) {
+            glBufferSubData(GL_ARRAY_BUFFER, static_cast<GLintptr>(lods[i].baseVertex) * levels[0].vertexStride,
+                            static_cast<GLsizeiptr>(levels[i].vertexCount) * levels[0].vertexStride, levels[i].vertices);
+            glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLintptr>(lods[i].firstIndex) * indexSize,
+                            static_cast<GLsizeiptr>(levels[i].indexCount) * indexSize, levels[i].indices);
+        }
+    }
+    if (evict != nullptr) {
+        GpuResources_RegisterCacheable(GPU_KIND_BUFFER, vbo, GPU_CATEGORY_VERTEX_BUFFER, GL_FLOAT, vertexBytes, owner,
+                                       evict, evictUser);
+        GpuResources_RegisterCacheable(GPU_KIND_BUFFER, ebo, GPU_CATEGORY_INDEX_BUFFER, levels[0].indexType, indexBytes,
+                                       owner, evict, evictUser);
+    } else {
+        GpuResources_Register(GPU_KIND_BUFFER, vbo, GPU_CATEGORY_VERTEX_BUFFER, GL_FLOAT, vertexBytes, owner);
+        GpuResources_Register(GPU_KIND_BUFFER, ebo, GPU_CATEGORY_INDEX_BUFFER, levels[0].indexType, indexBytes, owner);
+    }
+    return true;
+}
+
+uint32_t MeshVertexStride(uint32_t vertexFormat) {
+    switch (vertexFormat) {
+        case ASSET_VERTEX_POSITION | ASSET_VERTEX_COLOR: return 6 * sizeof(float);
+        case ASSET_VERTEX_POSITION_HALF | ASSET_VERTEX_COLOR_UNORM8: return 8 + 4;
+        default: return 0;
+    }
+}
+
+void SetMeshVertexLayout(uint32_t vertexFormat, GLsizei stride) {
+    // The shaders read vec3 position and color either way; the fetcher expands
+    // half floats and normalized bytes for free.
+    if (vertexFormat & ASSET_VERTEX_POSITION_HALF) {
+        glVertexAttribPointer(0, 3, GL_HALF_FLOAT, GL_FALSE, stride, (void*)0);
+        glVertexAttribPointer(1, 3, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void*)8);
+    } else {
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
+    }
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+}
+
+GLuint UploadTexture(const AssetTexture& texture, const char* owner) {
+    if (texture.pixels == nullptr || texture.levels == 0) return 0;
+    GLuint name = 0;
+    glGenTextures(1, &name);
+    glBindTexture(GL_TEXTURE_2D, name);
+    glTexStorage2D(GL_TEXTURE_2D, static_cast<GLsizei>(texture.levels), texture.internalFormat,
+                   static_cast<GLsizei>(texture.width), static_cast<GLsizei>(texture.height));
+    // Bundle rows are tightly packed, whatever the texel size.
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    const uint8_t* level = static_cast<const uint8_t*>(texture.pixels);
+    uint32_t width = texture.width, height = texture.height;
+    for (uint32_t i = 0; i < texture.levels; ++i) {
+        glTexSubImage2D(GL_TEXTURE_2D, static_cast<GLint>(i), 0, 0, static_cast<GLsizei>(width), static_cast<GLsizei>(height),
+                        texture.format, texture.type, level);
+        level += static_cast<size_t>(width) * height * texture.bytesPerTexel;
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, texture.levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    GpuResources_Register(GPU_KIND_TEXTURE, name, GPU_CATEGORY_TEXTURE, texture.internalFormat,
+                          GpuResources_ImageBytes(texture.internalFormat, static_cast<int32_t>(texture.width),
+                                                  static_cast<int32_t>(texture.height), static_cast<int32_t>(texture.levels)),
+                          owner);
+    return name;
+}
+
+// =============================================================================
+// Scene
+// =============================================================================
+namespace {
+
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint reservedMustBeZero;
+};
+
+const char* const kCullComputeShader = R"glsl(
+    #version 320 es
+    layout (local_size_x = 64) in;
+    struct Command {
+        uint count;
+        uint instanceCount;
+        uint firstIndex;
+        int baseVertex;
+        uint reserved;
+    };
+    layout (std430, binding = 0) readonly buffer Objects { vec4 objects[]; };
+    layout (std430, binding = 1) writeonly buffer Instances { vec4 instances[]; };
+    layout (std430, binding = 2) buffer Commands { Command commands[]; };
+    layout (std430, binding = 3) buffer Lods { uint lods[]; };
+    uniform vec4 uPlanes[12];   // six per eye
+    uniform uint uObjectCount;
+    uniform float uRadius;   // the mesh's bounding radius at scale 1
+    uniform vec4 uEyes[2];   // position, pixels per unit at distance 1
+    uniform vec4 uLodErrors;   // per level at scale 1
+    uniform vec4 uLodParams;   // pixel error, hysteresis, level count, nearest distance
+
+    bool InFrustum(int first, vec3 center, float radius) {
+        for (int i = 0; i < 6; ++i) {
+            if (dot(uPlanes[first + i].xyz, center) + uPlanes[first + i].w < -radius) return false;
+        }
+        return true;
+    }
+
+    // Mirrors SelectLod in renderer.cpp.
+    uint SelectLod(uint lod, float pixelsPerUnit) {
+        uint count = uint(uLodParams.z);
+        lod = min(lod, count - 1u);
+        while (lod > 0u && uLodErrors[lod] * pixelsPerUnit > uLodParams.x * (1.0 + uLodParams.y)) --lod;
+        while (lod + 1u < count && uLodErrors[lod + 1u] * pixelsPerUnit < uLodParams.x * (1.0 - uLodParams.y)) ++lod;
+        return lod;
+    }
+
+    void main() {
+        uint index = gl_GlobalInvocationID.x;
+        if (index >= uObjectCount) return;
+        vec4 object = objects[index];
+        float pixelsPerUnit = object.w * max(uEyes[0].w / max(distance(uEyes[0].xyz, object.xyz), uLodParams.w),
+                                             uEyes[1].w / max(distance(uEyes[1].xyz, object.xyz), uLodParams.w));
+        uint lod = SelectLod(lods[index], pixelsPerUnit);
+        lods[index] = lod;
+        float radius = object.w * uRadius;
+        if (InFrustum(0, object.xyz, radius) || InFrustum(6, object.xyz, radius)) {
+            instances[lod * uObjectCount + atomicAdd(commands[lod].instanceCount, 1u)] = object;
+        }
+    }
+)glsl";
+
+// A level is refined once its projected error exceeds the threshold by this
+// fraction, and coarsened once the next level's falls this far under it.
+constexpr float kLodHysteresis = 0.25f;
+
+// Per eye: position, then pixels per unit of size at distance 1. M[5] maps the
+// view's tangent-space height onto clip space, so half the view height times
+// it converts to pixels, asymmetric frusta included.
+void LodEyes(const XrView* views, uint32_t viewCount, int32_t viewHeight, float eyes[2][4]) {
+    for (uint32_t i = 0; i < 2; ++i) {
+        const XrView& view = views[i < viewCount ? i : 0];
+        const Matrix4f projection = Matrix4f_CreateProjectionFov(view.fov, kNearZ, kFarZ);
+        eyes[i][0] = view.pose.position.x;
+        eyes[i][1] = view.pose.position.y;
+        eyes[i][2] = view.pose.position.z;
+        eyes[i][3] = projection.M[5] * 0.5f * static_cast<float>(viewHeight);
+    }
+}
+
+// Pixels one mesh unit covers for the eye that sees the object largest.
+float PixelsPerUnit(const float eyes[2][4], const float center[3], float scale) {
+    float best = 0.0f;
+    for (int i = 0; i < 2; ++i) {
+        const float dx = center[0] - eyes[i][0], dy = center[1] - eyes[i][1], dz = center[2] - eyes[i][2];
+        best = std::max(best, eyes[i][3] / std::max(sqrtf(dx * dx + dy * dy + dz * dz), kNearZ));
+    }
+    return best * scale;
+}
+
+uint32_t SelectLod(const float* errors, uint32_t count, uint32_t lod, float pixelsPerUnit, float pixelError) {
+    lod = std::min(lod, count - 1);
+    while (lod > 0 && errors[lod] * pixelsPerUnit > pixelError * (1.0f + kLodHysteresis)) --lod;
+    while (lod + 1 < count && errors[lod + 1] * pixelsPerUnit < pixelError * (1.0f - kLodHysteresis)) ++lod;
+    return lod;
+}
+
+bool SphereInFrustum(const float planes[6][4], const float center[3], float radius) {
+    for (int i = 0; i < 6; ++i) {
+        if (planes[i][0] * center[0] + planes[i][1] * center[1] + planes[i][2] * center[2] + planes[i][3] < -radius) return false;
+    }
+    return true;
+}
+
+bool CreateGpuCulling(Scene& scene, GraphicsPipeline& pipeline) {
+    GLint major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    if (major < 3 || (major == 3 && minor < 1)) {
+        ALOGW("GPU culling needs OpenGL ES 3.1 compute, context is %d.%d; using the CPU path.", major, minor);
+        return false;
+    }
+    // Instances are fed as a per-instance attribute rather than read from an SSBO,
+    // since many GPUs expose no storage blocks to the vertex stage.
+    const ShaderVariant* instanced = pipeline.shaders.Get(kPipelineFeatures | SHADER_FEATURE_INSTANCED);
+    scene.cullProgram = Shader_Link({Shader_Compile(GL_COMPUTE_SHADER, kCullComputeShader)});
+    if (instanced == nullptr || scene.cullProgram == 0) return false;
+    scene.instancedProgram = instanced->program;
+    scene.viewProjLocation = instanced->mvpLocation;
+    scene.planesLocation = glGetUniformLocation(scene.cullProgram, "uPlanes");
+    scene.objectCountLocation = glGetUniformLocation(scene.cullProgram, "uObjectCount");
+    scene.radiusLocation = glGetUniformLocation(scene.cullProgram, "uRadius");
+    scene.eyesLocation = glGetUniformLocation(scene.cullProgram, "uEyes");
+    scene.lodErrorsLocation = glGetUniformLocation(scene.cullProgram, "uLodErrors");
+    scene.lodParamsLocation = glGetUniformLocation(scene.cullProgram, "uLodParams");
+
+    // Each level gets an instance range as long as the whole scene, since any
+    // number of objects can land in one level.
+    const GLsizeiptr objectBytes = static_cast<GLsizeiptr>(scene.objects.size() * sizeof(SceneObject));
+    const GLsizeiptr instanceBytes = objectBytes * pipeline.lodCount;
+    const GLsizeiptr lodBytes = static_cast<GLsizeiptr>(scene.objects.size() * sizeof(GLuint));
+    DrawElementsIndirectCommand commands[kMaxMeshLods] = {};
+    for (uint32_t i = 0; i < pipeline.lodCount; ++i) {
+        commands[i] = {static_cast<GLuint>(pipeline.lods[i].indexCount), 0, pipeline.lods[i].firstIndex, pipeline.lods[i].baseVertex, 0};
+    }
+    const GLsizeiptr commandBytes = static_cast<GLsizeiptr>(pipeline.lodCount * sizeof(DrawElementsIndirectCommand));
+    const TrackedVector<GLuint, MEM_TAG_SCENE> initialLods(scene.objects.size(), 0);
+    glGenBuffers(1, &scene.objectBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, scene.objectBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, objectBytes, scene.objects.data(), GL_STATIC_DRAW);
+    glGenBuffers(1, &scene.lodBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, scene.lodBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, lodBytes, initialLods.data(), GL_DYNAMIC_COPY);
+    glGenBuffers(1, &scene.instanceBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, scene.instanceBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, instanceBytes, nullptr, GL_DYNAMIC_COPY);
+    glGenBuffers(1, &scene.commandBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, scene.commandBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, commandBytes, commands, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    GpuResources_Register(GPU_KIND_BUFFER, scene.objectBuffer, GPU_CATEGORY_OTHER, GL_FLOAT, objectBytes, "scene");
+    GpuResources_Register(GPU_KIND_BUFFER, scene.lodBuffer, GPU_CATEGORY_OTHER, GL_UNSIGNED_INT, lodBytes, "scene");
+    GpuResources_Register(GPU_KIND_BUFFER, scene.instanceBuffer, GPU_CATEGORY_VERTEX_BUFFER, GL_FLOAT, instanceBytes, "scene");
+    GpuResources_Register(GPU_KIND_BUFFER, scene.commandBuffer, GPU_CATEGORY_OTHER, GL_UNSIGNED_INT, commandBytes, "scene");
+
+    glGenVertexArrays(static_cast<GLsizei>(pipeline.lodCount), scene.vaos);
+    for (uint32_t i = 0; i < pipeline.lodCount; ++i) {
+        glBindVertexArray(scene.vaos[i]);
+        glBindBuffer(GL_ARRAY_BUFFER, pipeline.vbo);
+        SetMeshVertexLayout(pipeline.vertexFormat, pipeline.vertexStride);
+        glBindBuffer(GL_ARRAY_BUFFER, scene.instanceBuffer);
+        glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(SceneObject), reinterpret_cast<const void*>(i * objectBytes));
+        glVertexAttribDivisor(2, 1);
+        glEnableVertexAttribArray(2);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pipeline.ebo);
+    }
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return true;
+}
+
+void ReleaseGpuCulling(Scene& scene) {
+    for (GLuint* buffer : {&scene.objectBuffer, &scene.lodBuffer, &scene.instanceBuffer, &scene.commandBuffer}) {
+        GpuResources_DeferDelete(GPU_KIND_BUFFER, *buffer);
+        *buffer = 0;
+    }
+    for (GLuint& vao : scene.vaos) {
+        GpuResources_DeferDelete(GPU_KIND_VERTEX_ARRAY, vao);
+        vao = 0;
+    }
+    GpuResources_DeferDelete(GPU_KIND_PROGRAM, scene.cullProgram);
+    scene.instancedProgram = scene.cullProgram = 0;
+    scene.gpuCulling = false;
+}
+
+} // namespace
+
+bool CreateScene(Scene& scene, GraphicsPipeline& pipeline, const SceneObject* objects, size_t count, bool allowGpuCulling) {
+    scene.objects.assign(objects, objects + count);
+    scene.objectLods.assign(count, 0);
+    scene.lodStats = {};
+    scene.boundingRadius = pipeline.boundingRadius;
+    scene.lodCount = pipeline.lodCount;
+    for (uint32_t i = 0; i < kMaxMeshLods; ++i) scene.lodErrors[i] = i < pipeline.lodCount ? pipeline.lods[i].error : 0.0f;
+    scene.gpuCulling = allowGpuCulling && count > 0 && CreateGpuCulling(scene, pipeline);
+    if (!scene.gpuCulling) ReleaseGpuCulling(scene);   // whatever got created before the failure
+    ALOGI("Scene: %zu objects, %s culling, %u mesh LODs.", count, scene.gpuCulling ? "GPU indirect" : "CPU", scene.lodCount);
+    return true;
+}
+
+void DestroyScene(Scene& scene) {
+    ReleaseGpuCulling(scene);
+    scene.objects.clear();
+    scene.objects.shrink_to_fit();
+    scene.objectLods.clear();
+    scene.objectLods.shrink_to_fit();
+}
+
+void CullScene(Scene& scene, const XrView* views, uint32_t viewCount, int32_t viewHeight) {
+    if (viewCount == 0) return;
+    // A mono view configuration sizes and tests against the same view twice.
+    float eyes[2][4];
+    LodEyes(views, viewCount, viewHeight, eyes);
+    if (!scene.gpuCulling) {
+        SceneLodStats& stats = scene.lodStats;
+        std::fill(std::begin(stats.objects), std::end(stats.objects), 0u);
+        for (size_t i = 0; i < scene.objects.size(); ++i) {
+            const SceneObject& object = scene.objects[i];
+            const uint8_t lod = static_cast<uint8_t>(SelectLod(scene.lodErrors, scene.lodCount, scene.objectLods[i],
+                                                               PixelsPerUnit(eyes, object.position, object.scale),
+                                                               scene.lodPixelError));
+            if (lod != scene.objectLods[i]) ++stats.switches;
+            scene.objectLods[i] = lod;
+            ++stats.objects[lod];
+        }
+        return;
+    }
+
+    float planes[12][4];
+    Matrix4f_ExtractFrustumPlanes(ViewProjection(views[0]), reinterpret_cast<float(*)[4]>(planes[0]));
+    Matrix4f_ExtractFrustumPlanes(ViewProjection(views[viewCount > 1 ? 1 : 0]), reinterpret_cast<float(*)[4]>(planes[6]));
+
+    const float lodParams[4] = {scene.lodPixelError, kLodHysteresis, static_cast<float>(scene.lodCount), kNearZ};
+
+    const GLuint zero = 0;
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, scene.objectBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, scene.instanceBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, scene.lodBuffer);
+    // Last, so the generic binding the counters are reset through is the command buffer.
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, scene.commandBuffer);
+    for (uint32_t i = 0; i < scene.lodCount; ++i) {
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, i * sizeof(DrawElementsIndirectCommand) + offsetof(DrawElementsIndirectCommand, instanceCount),
+                        sizeof(zero), &zero);
+    }
+    glUseProgram(scene.cullProgram);
+    glUniform4fv(scene.planesLocation, 12, planes[0]);
+    glUniform1ui(scene.objectCountLocation, static_cast<GLuint>(scene.objects.size()));
+    glUniform1f(scene.radiusLocation, scene.boundingRadius);
+    glUniform4fv(scene.eyesLocation, 2, eyes[0]);
+    glUniform4fv(scene.lodErrorsLocation, 1, scene.lodErrors);
+    glUniform4fv(scene.lodParamsLocation, 1, lodParams);
+    glDispatchCompute(static_cast<GLuint>((scene.objects.size() + 63) / 64), 1, 1);
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+    glUseProgram(0);
+}
+
+bool EnsureMeshResident(GraphicsPipeline& pipeline, Scene& scene) {
+    if (!pipeline.meshResident) {
+        glBindVertexArray(pipeline.vao);
+        if (!UploadMesh(pipeline.meshLevels, pipeline.lodCount, pipeline.vbo, pipeline.ebo, pipeline.lods, "pipeline",
+                        EvictPipelineMesh, &pipeline)) {
+            glBindVertexArray(0);
+            return false;
+        }
+        SetMeshVertexLayout(pipeline.vertexFormat, pipeline.vertexStride);
+        // The GPU path's per-level arrays read the same buffers; their instance attribute stays as it was.
+        for (uint32_t i = 0; scene.gpuCulling && i < pipeline.lodCount; ++i) {
+            glBindVertexArray(scene.vaos[i]);
+            glBindBuffer(GL_ARRAY_BUFFER, pipeline.vbo);
+            SetMeshVertexLayout(pipeline.vertexFormat, pipeline.vertexStride);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pipeline.ebo);
+        }
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        pipeline.meshResident = true;
+        pipeline.meshReloads++;
+        ALOGI("Pipeline mesh reloaded after eviction (%u levels)", pipeline.lodCount);
+    }
+    GpuResources_Touch(GPU_KIND_BUFFER, pipeline.vbo);
+    GpuResources_Touch(GPU_KIND_BUFFER, pipeline.ebo);
+    return true;
+}
+
+// =============================================================================
+// Visibility Mask
+// =============================================================================
+bool UpdateVisibilityMask(VisibilityMask& mask, const XrVector2f* vertices, uint32_t vertexCount,
+                          const uint32_t* indices, uint32_t indexCount) {
+    DestroyVisibilityMask(mask);
+    if (vertexCount == 0 || indexCount == 0) return true;
+    // The base shader takes a vec3 position; the runtime's points sit on z = -1.
+    TrackedVector<float, MEM_TAG_SCENE> positions(static_cast<size_t>(vertexCount) * 3);
+    for (uint32_t i = 0; i < vertexCount; ++i) {
+        positions[i * 3 + 0] = vertices[i].x;
+        positions[i * 3 + 1] = vertices[i].y;
+        positions[i * 3 + 2] = -1.0f;
+    }
+    const GLsizeiptr vertexBytes = static_cast<GLsizeiptr>(positions.size() * sizeof(float));
+    const GLsizeiptr indexBytes = static_cast<GLsizeiptr>(indexCount * sizeof(uint32_t));
+    glGenVertexArrays(1, &mask.vao);
+    glGenBuffers(1, &mask.vbo);
+    glGenBuffers(1, &mask.ebo);
+    glBindVertexArray(mask.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, mask.vbo);
+    glBufferData(GL_ARRAY_BUFFER, vertexBytes, positions.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mask.ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, indices, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glBindVertexArray(0);
+    GpuResources_Register(GPU_KIND_BUFFER, mask.vbo, GPU_CATEGORY_VERTEX_BUFFER, GL_FLOAT, vertexBytes, "visibility-mask");
+    GpuResources_Register(GPU_KIND_BUFFER, mask.ebo, GPU_CATEGORY_INDEX_BUFFER, GL_UNSIGNED_INT, indexBytes, "visibility-mask");
+    mask.indexCount = static_cast<GLsizei>(indexCount);
+    return true;
+}
+
+void DestroyVisibilityMask(VisibilityMask& mask) {
+    if (mask.vao == 0) return;
+    // The runtime can replace a mask mid-session while the old one is still in flight.
+    GpuResources_DeferDelete(GPU_KIND_BUFFER, mask.vbo);
+    GpuResources_DeferDelete(GPU_KIND_BUFFER, mask.ebo);
+    GpuResources_DeferDelete(GPU_KIND_VERTEX_ARRAY, mask.vao);
+    mask = {};
+}
+
+namespace {
+
+// Projects the mask with the view's frustum, then forces clip z = -w (z = w when
+// reversed) so every vertex lands exactly on the near plane and passes the clip
+// test. z = w is window depth 1 under either clip depth range.
+void DrawVisibilityMask(const GraphicsPipeline& pipeline, const VisibilityMask& mask, const XrView& view) {
+    Matrix4f flat = Projection(view);
+    const float nearSign = CurrentDepth().reversedZ ? 1.0f : -1.0f;
+    for (int column = 0; column < 4; ++column) flat.M[column * 4 + 2] = nearSign * flat.M[column * 4 + 3];
+    glUseProgram(pipeline.depthOnlyProgram);
+    glUniformMatrix4fv(pipeline.depthOnlyMvpLocation, 1, GL_FALSE, flat.M);
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glBindVertexArray(mask.vao);
+    glDrawElements(GL_TRIANGLES, mask.indexCount, GL_UNSIGNED_INT, 0);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
+
+} // namespace
+
+// =============================================================================
+// Per-View Rendering
+// =============================================================================
+void RenderView(const GraphicsPipeline& pipeline, const Scene& scene, const XrView& view, int32_t width, int32_t height,
+                const VisibilityMask* mask) {
+    glViewport(0, 0, width, height);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glEnable(GL_DEPTH_TEST);
+    if (mask != nullptr && mask->indexCount > 0 && pipeline.depthOnlyProgram != 0) {
+        DrawVisibilityMask(pipeline, *mask, view);
+    }
+
+    const Matrix4f viewProj = ViewProjection(view);
+
+    if (scene.gpuCulling) {
+        glUseProgram(scene.instancedProgram);
+        glUniformMatrix4fv(scene.viewProjLocation, 1, GL_FALSE, viewProj.M);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, scene.commandBuffer);
+        for (uint32_t i = 0; i < scene.lodCount; ++i) {
+            glBindVertexArray(scene.vaos[i]);
+            glDrawElementsIndirect(GL_TRIANGLES, pipeline.indexType, reinterpret_cast<const void*>(i * sizeof(DrawElementsIndirectCommand)));
+        }
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    } else {
+        float planes[6][4];
+        Matrix4f_ExtractFrustumPlanes(viewProj, planes);
+        glUseProgram(pipeline.shaderProgram);
+        glBindVertexArray(pipeline.vao);
+        const uintptr_t indexSize = pipeline.indexType == GL_UNSIGNED_SHORT ? 2 : 4;
+        for (size_t i = 0; i < scene.objects.size(); ++i) {
+            const SceneObject& object = scene.objects[i];
+            if (!SphereInFrustum(planes, object.position, object.scale * pipeline.boundingRadius)) continue;
+            Matrix4f model = Matrix4f_CreateTranslation(object.position[0], object.position[1], object.position[2]);
+            model.M[0] = model.M[5] = model.M[10] = object.scale;
+            const Matrix4f mvp = Matrix4f_Multiply(viewProj, model);
+            glUniformMatrix4fv(pipeline.mvpLocation, 1, GL_FALSE, mvp.M);
+            const MeshLod& lod = pipeline.lods[scene.objectLods[i]];
+            glDrawElementsBaseVertex(GL_TRIANGLES, lod.indexCount, pipeline.indexType,
+                                     reinterpret_cast<const void*>(lod.firstIndex * indexSize), lod.baseVertex);
+        }
+    }
+    glBindVertexArray(0);
+    glUseProgram(0);
+}
+
+// =============================================================================
+// Depth Mapping
+// =============================================================================
+DepthConfig InitializeDepth(bool reversedZ, int32_t depthBits) {
+    DepthConfig depth;
+    depth.reversedZ = reversedZ;
+    depth.format = depthBits <= 16 ? GL_DEPTH_COMPONENT16 : (depthBits >= 32 ? GL_DEPTH_COMPONENT32F : GL_DEPTH_COMPONENT24);
+    // eglGetProcAddress may hand back a pointer for an extension the context
+    // does not expose, so the pointer alone never gates the call.
+    auto clipControl = HasExtension("GL_EXT_clip_control")
+            ? reinterpret_cast<PFNGLCLIPCONTROLEXTPROC>(eglGetProcAddress("glClipControlEXT")) : nullptr;
+    if (reversedZ && clipControl != nullptr) {
+        depth.zeroToOne = true;
+        clipControl(GL_LOWER_LEFT_EXT, GL_ZERO_TO_ONE_EXT);
+    } else if (clipControl != nullptr) {
+        clipControl(GL_LOWER_LEFT_EXT, GL_NEGATIVE_ONE_TO_ONE_EXT);   // a kept context may still have it on
+    }
+    if (reversedZ && !depth.zeroToOne) {
+        ALOGW("Reversed-Z without GL_EXT_clip_control: ordering holds, but the [-1, 1] remap loses the float precision gain.");
+    }
+    glClearDepthf(reversedZ ? 0.0f : 1.0f);
+    glDepthFunc(reversedZ ? GL_GREATER : GL_LESS);
+    CurrentDepth() = depth;
+    ALOGI("Depth: %s, %s.", reversedZ ? (depth.zeroToOne ? "reversed-Z infinite, [0, 1] clip" : "reversed-Z infinite, [-1, 1] clip")
+                                      : "conventional 0.1-100 m",
+          depth.format == GL_DEPTH_COMPONENT16 ? "16-bit" : (depth.format == GL_DEPTH_COMPONENT32F ? "32-bit float" : "24-bit"));
+    return depth;
+}
+
+// =============================================================================
+// Multisampled Render-To-Texture
+// =============================================================================
+MsaaConfig InitializeMsaa(int32_t requestedSamples) {
+    MsaaConfig msaa;
+    if (requestedSamples <= 1) return msaa;
+    if (!HasExtension("GL_EXT_multisampled_render_to_texture")) {
+        ALOGW("MSAA %dx requested but GL_EXT_multisampled_render_to_texture is missing; rendering single-sampled.", requestedSamples);
+        return msaa;
+    }
+    msaa.framebufferTexture2DMultisample = reinterpret_cast<PFNGLFRAMEBUFFERTEXTURE2DMULTISAMPLEEXTPROC>(
+            eglGetProcAddress("glFramebufferTexture2DMultisampleEXT"));
+    if (msaa.framebufferTexture2DMultisample == nullptr) {
+        ALOGW("glFramebufferTexture2DMultisampleEXT not found; rendering single-sampled.");
+        return msaa;
+    }
+    GLint maxSamples = 1;
+    glGetIntegerv(GL_MAX_SAMPLES_EXT, &maxSamples);
+    msaa.samples = requestedSamples >= 4 && maxSamples >= 4 ? 4 : (maxSamples >= 2 ? 2 : 1);
+    ALOGI("MSAA: %dx on-tile (requested %d, max %d).", msaa.samples, requestedSamples, maxSamples);
+    return msaa;
+}
+
+void AttachViewTargets(const MsaaConfig& msaa, GLuint color, GLuint depth) {
+    if (msaa.samples > 1) {
+        // Both attachments must use the same sample count; the depth texture
+        // keeps single-sampled storage and its multisampled copy stays on tile.
+        msaa.framebufferTexture2DMultisample(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color, 0, msaa.samples);
+        msaa.framebufferTexture2DMultisample(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth, 0, msaa.samples);
+        return;
+    }
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+}
+
+void DiscardViewDepth() {
+    const GLenum attachments[] = {GL_DEPTH_ATTACHMENT};
+    glInvalidateFramebuffer(GL_FRAMEBUFFER, 1, attachments);
+}
+
+// =============================================================================
+// GPU Frame Timing
+// =============================================================================
+bool CreateGpuTimer(GpuTimer& timer) {
+    timer = {};
+    if (!HasExtension("GL_EXT_disjoint_timer_query")) {
+        ALOGW("GL_EXT_disjoint_timer_query is missing; GPU frame time is not measured.");
+        return false;
+    }
+    timer.getQueryObjectui64v = reinterpret_cast<PFNGLGETQUERYOBJECTUI64VEXTPROC>(eglGetProcAddress("glGetQueryObjectui64vEXT"));
+    if (timer.getQueryObjectui64v == nullptr) return false;
+    glGenQueries(GpuTimer::kQueries, timer.queries);
+    GLint disjoint = 0;
+    glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);   // clears the flag
+    return true;
+}
+
+void DestroyGpuTimer(GpuTimer& timer) {
+    if (timer.getQueryObjectui64v != nullptr) glDeleteQueries(GpuTimer::kQueries, timer.queries);
+    timer = {};
+}
+
+void GpuTimer_Begin(GpuTimer& timer, uint64_t frameIndex) {
+    if (timer.getQueryObjectui64v == nullptr || timer.pending[timer.next]) return;
+    glBeginQuery(GL_TIME_ELAPSED_EXT, timer.queries[timer.next]);
+    timer.frames[timer.next] = frameIndex;
+    timer.running = true;
+}
+
+void GpuTimer_End(GpuTimer& timer) {
+    if (!timer.running) return;
+    glEndQuery(GL_TIME_ELAPSED_EXT);
+    timer.pending[timer.next] = true;
+    timer.next = (timer.next + 1) % GpuTimer::kQueries;
+    timer.running = false;
+}
+
+bool GpuTimer_Poll(GpuTimer& timer, uint64_t& frameIndex, int64_t& gpuNs) {
+    if (timer.getQueryObjectui64v == nullptr) return false;
+    // Oldest first: queries finish in submission order.
+    for (uint32_t i = 0; i < GpuTimer::kQueries; ++i) {
+        const uint32_t slot = (timer.next + i) % GpuTimer::kQueries;
+        if (!timer.pending[slot]) continue;
+        GLuint available = GL_FALSE;
+        glGetQueryObjectuiv(timer.queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available != GL_TRUE) return false;
+        timer.pending[slot] = false;
+        GLint disjoint = 0;
+        glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+        if (disjoint) continue;
+        GLuint64 elapsed = 0;
+        timer.getQueryObjectui64v(timer.queries[slot], GL_QUERY_RESULT, &elapsed);
+        frameIndex = timer.frames[slot];
+        gpuNs = static_cast<int64_t>(elapsed);
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,241 @@
+#pragma once
+
+#include <GLES3/gl32.h>
+#include <GLES2/gl2ext.h>
+
+#include <openxr/openxr.h>
+
+#include "allocator.h"
+#include "asset_bundle.h"
+#include "gpu_resources.h"
+#include "shader_variants.h"
+
+// =============================================================================
+// Renderer
+// =============================================================================
+// GL-only frame logic, kept free of OpenXR runtime calls so the same code runs
+// against the swapchain on device and against offscreen targets in frame replay.
+
+// Levels of detail of the panel mesh, finest first. All levels live in the
+// pipeline's one vertex and index buffer; level i starts at its baseVertex and
+// firstIndex, so switching level never rebinds anything.
+constexpr uint32_t kMaxMeshLods = 4;
+
+struct MeshLod {
+    GLsizei indexCount = 0;
+    GLuint firstIndex = 0;
+    GLint baseVertex = 0;
+    float error = 0.0f;   // how far the level deviates from level 0, at scale 1
+};
+
+struct GraphicsPipeline {
+    ShaderCache shaders;
+    GLuint shaderProgram = 0;   // vertex-color variant, owned by shaders
+    GLint mvpLocation = -1;
+    GLuint depthOnlyProgram = 0;   // base variant for the visibility mask, owned by shaders
+    GLint depthOnlyMvpLocation = -1;
+    GLuint vao = 0;
+    GLuint vbo = 0;
+    GLuint ebo = 0;
+    uint32_t vertexFormat = 0;     // AssetVertexFormat bits
+    GLsizei vertexStride = 0;
+    GLenum indexType = GL_UNSIGNED_INT;
+    float boundingRadius = 0.0f;   // at scale 1, for culling
+    MeshLod lods[kMaxMeshLods];
+    uint32_t lodCount = 0;
+    // The mesh buffers are cacheable: the GPU budget may drop them, and they
+    // are uploaded again from these levels before the next frame draws.
+    AssetMesh meshLevels[kMaxMeshLods];
+    bool meshResident = false;
+    uint32_t meshReloads = 0;
+};
+
+// The panel mesh comes from the bundle's "panel" entry when one is given and
+// has it, with its coarser levels from "panel#1", "panel#2", ...; otherwise the
+// built-in quad is used as a single level. The bundle must stay open while the
+// pipeline exists, since an evicted mesh is reloaded from its pages. The
+// pipeline must not move once created: the eviction callback holds its address.
+bool CreateGraphicsPipeline(GraphicsPipeline& pipeline, const AssetBundle* bundle = nullptr);
+void DestroyGraphicsPipeline(GraphicsPipeline& pipeline);
+
+// =============================================================================
+// Bundled Assets
+// =============================================================================
+// Uploads read straight from the bundle's mapped pages; nothing is staged in
+// the heap. Buffers and textures are registered with GpuResources under `owner`.
+
+// Packs `levelCount` levels of one mesh into a single vertex and index buffer
+// and fills in where each level landed. The levels must share vertex format,
+// stride and index type. The index buffer is bound into whichever vertex array
+// is bound on entry. With an `evict` callback both buffers are cacheable.
+bool UploadMesh(const AssetMesh* levels, uint32_t levelCount, GLuint& vbo, GLuint& ebo, MeshLod* lods, const char* owner,
+                GpuEvictCallback evict = nullptr, void* evictUser = nullptr);
+// Stride of a vertex format the pipeline's shaders can read (float or
+// quantized position and color); 0 for anything else.
+uint32_t MeshVertexStride(uint32_t vertexFormat);
+// Points attributes 0 (position) and 1 (color) into the bound GL_ARRAY_BUFFER.
+void SetMeshVertexLayout(uint32_t vertexFormat, GLsizei stride);
+// Immutable storage with the bundle's full mip chain; 0 on failure.
+GLuint UploadTexture(const AssetTexture& texture, const char* owner);
+
+// =============================================================================
+// Scene
+// =============================================================================
+// Instances of the pipeline's panel mesh. With GPU culling a compute shader tests
+// every object against both eye frusta once per frame, appends the survivors to
+// an instance buffer and counts them into a glDrawElementsIndirect command, so
+// each eye is a single draw whatever the object count. Without ES 3.1 compute (or when
+// disabled) objects are culled and drawn one by one on the CPU instead.
+//
+// Each object also gets a mesh level of detail: the coarsest level whose error,
+// projected with the eye's own Matrix4f_CreateProjectionFov, stays under
+// lodPixelError pixels. The larger projection of the two eyes decides, so both
+// eyes always draw the same level, and the current level is kept until the
+// error leaves a band around the threshold, so objects at the boundary do not
+// pop back and forth. The GPU path selects in the cull pass and keeps the
+// levels in a buffer, with one indirect command and instance range per level.
+
+struct SceneObject {
+    float position[3];
+    float scale;
+};
+
+struct SceneLodStats {
+    uint32_t objects[kMaxMeshLods] = {};   // per level, last CullScene; CPU path only
+    uint64_t switches = 0;                 // level changes since creation; CPU path only
+};
+
+struct Scene {
+    TrackedVector<SceneObject, MEM_TAG_SCENE> objects;
+    TrackedVector<uint8_t, MEM_TAG_SCENE> objectLods;   // current level per object; CPU path
+    float lodPixelError = 1.0f;   // screen-space error a level may show, in pixels
+    SceneLodStats lodStats;
+    bool gpuCulling = false;
+    GLuint instancedProgram = 0;   // owned by the pipeline's shader cache
+    GLint viewProjLocation = -1;
+    GLuint cullProgram = 0;
+    GLint planesLocation = -1;
+    GLint objectCountLocation = -1;
+    GLint radiusLocation = -1;
+    GLint eyesLocation = -1;
+    GLint lodErrorsLocation = -1;
+    GLint lodParamsLocation = -1;
+    float boundingRadius = 0.0f;   // the pipeline mesh's, copied at creation
+    uint32_t lodCount = 1;         // likewise
+    float lodErrors[kMaxMeshLods] = {};
+    GLuint vaos[kMaxMeshLods] = {};   // the pipeline's mesh plus a per-instance attribute into the level's range
+    GLuint objectBuffer = 0;     // SSBO, vec4(position, scale) per object
+    GLuint lodBuffer = 0;        // SSBO, current level per object
+    GLuint instanceBuffer = 0;   // visible objects, one range of objects.size() per level
+    GLuint commandBuffer = 0;    // one DrawElementsIndirectCommand per level
+};
+
+bool CreateScene(Scene& scene, GraphicsPipeline& pipeline, const SceneObject* objects, size_t count, bool allowGpuCulling);
+void DestroyScene(Scene& scene);
+
+// Once per frame, before any view is rendered: selects every object's level
+// for the views' projections at `viewHeight` pixels, and on the GPU path culls.
+void CullScene(Scene& scene, const XrView* views, uint32_t viewCount, int32_t viewHeight);
+
+// Once per frame, before any view is rendered: uploads the pipeline's mesh
+// again if the GPU budget evicted it (re-pointing the pipeline's and the
+// scene's vertex arrays) and marks its buffers used this frame. False if the
+// upload failed; nothing should be drawn then.
+bool EnsureMeshResident(GraphicsPipeline& pipeline, Scene& scene);
+
+// =============================================================================
+// Visibility Mask
+// =============================================================================
+// The hidden-area mesh of one eye (XR_KHR_visibility_mask): the ring of pixels
+// the lens never shows. It is drawn into depth at the near plane (0, or 1 when
+// reversed) right after the clear, so early-Z rejects every fragment there
+// before it is shaded.
+
+struct VisibilityMask {
+    GLuint vao = 0;
+    GLuint vbo = 0;
+    GLuint ebo = 0;
+    GLsizei indexCount = 0;
+};
+
+// Replaces the mesh. Vertices are as the runtime returns them: view space, on
+// the z = -1 plane. An empty mesh disables the prefill for the view.
+bool UpdateVisibilityMask(VisibilityMask& mask, const XrVector2f* vertices, uint32_t vertexCount,
+                          const uint32_t* indices, uint32_t indexCount);
+void DestroyVisibilityMask(VisibilityMask& mask);
+
+// Draws one view into the currently bound framebuffer, prefilling depth with
+// the view's visibility mask when one is given.
+void RenderView(const GraphicsPipeline& pipeline, const Scene& scene, const XrView& view, int32_t width, int32_t height,
+                const VisibilityMask* mask = nullptr);
+
+// =============================================================================
+// Depth Mapping
+// =============================================================================
+// Conventional: near 0.1 / far 100, depth growing with distance, cleared to 1
+// and tested with GL_LESS. Reversed-Z: far plane at infinity, depth is
+// near / distance, cleared to 0 and tested with GL_GREATER; with
+// GL_EXT_clip_control the clip depth range is [0, w], so nothing is lost to
+// the [-1, 1] remap. The reversal pays off with a float depth buffer, whose
+// exponent spends its precision near 0, i.e. far away. Fixed-point buffers
+// resolve the same distances either way, so 16 bits is a bandwidth choice for
+// content within a few metres; `frame_replay --depth-check` prints the numbers.
+
+struct DepthConfig {
+    bool reversedZ = false;
+    bool zeroToOne = false;   // GL_EXT_clip_control in effect
+    GLenum format = GL_DEPTH_COMPONENT24;
+};
+
+// Resolves the request against the context and makes it current. Depth
+// function, clear value and clip control are context state, so it applies to
+// every view rendered and culled afterwards. depthBits is 16, 24 or 32 (float).
+DepthConfig InitializeDepth(bool reversedZ, int32_t depthBits);
+
+// =============================================================================
+// Multisampled Render-To-Texture
+// =============================================================================
+// With GL_EXT_multisampled_render_to_texture the multisampled color and depth
+// only exist in tile memory and are resolved as tiles are written out, so MSAA
+// costs no extra bandwidth and no separate resolve pass.
+
+struct MsaaConfig {
+    int32_t samples = 1;   // effective count; 1 when off or unsupported
+    PFNGLFRAMEBUFFERTEXTURE2DMULTISAMPLEEXTPROC framebufferTexture2DMultisample = nullptr;
+};
+
+// Resolves a requested sample count (1, 2 or 4) against the extension and
+// GL_MAX_SAMPLES_EXT. Falls back to single-sampled when the extension is missing.
+MsaaConfig InitializeMsaa(int32_t requestedSamples);
+
+// Attaches the view's color and depth textures to the bound framebuffer.
+void AttachViewTargets(const MsaaConfig& msaa, GLuint color, GLuint depth);
+
+// Ends a view pass: depth is not needed afterwards, so it is never written back.
+void DiscardViewDepth();
+
+// =============================================================================
+// GPU Frame Timing
+// =============================================================================
+// GL_EXT_disjoint_timer_query around a frame's GL work. Results are read a few
+// frames later without stalling; a frame whose query slot is still busy is
+// simply not timed.
+
+struct GpuTimer {
+    static constexpr uint32_t kQueries = 4;
+    PFNGLGETQUERYOBJECTUI64VEXTPROC getQueryObjectui64v = nullptr;
+    GLuint queries[kQueries] = {};
+    uint64_t frames[kQueries] = {};
+    bool pending[kQueries] = {};
+    uint32_t next = 0;
+    bool running = false;
+};
+
+// False (and the timer stays inert) without GL_EXT_disjoint_timer_query.
+bool CreateGpuTimer(GpuTimer& timer);
+void DestroyGpuTimer(GpuTimer& timer);
+void GpuTimer_Begin(GpuTimer& timer, uint64_t frameIndex);
+void GpuTimer_End(GpuTimer& timer);
+// Returns one finished frame per call; false when none is ready. Results that
+// straddle a GPU disjoint event (clock change, context loss) are dropped.
+bool GpuTimer_Poll(GpuTimer& timer, uint64_t& frameIndex, int64_t& gpuNs);
@@ -0,0 +1,229 @@
+#include "shader_variants.h"
+
+#include "common.h"
+#include "gl_trace.h"
+#include "gpu_resources.h"
+
+namespace {
+
+// Feature defines are always emitted (as 0 or 1) so the bodies can use #if.
+const char* const kDefineNames[SHADER_FEATURE_COUNT] = {
+    "FEATURE_VERTEX_COLOR", "FEATURE_INSTANCED", "FEATURE_TEXTURED",
+    "FEATURE_SDF_TEXT", "FEATURE_MSAA", "FEATURE_MULTIVIEW",
+};
+
+const char* const kVertexBody = R"glsl(
+layout (location = 0) in vec3 aPos;
+#if FEATURE_VERTEX_COLOR
+layout (location = 1) in vec3 aColor;
+out vec3 vColor;
+#endif
+#if FEATURE_INSTANCED
+layout (location = 2) in vec4 aInstance;   // xyz position, w scale
+#endif
+#if FEATURE_TEXTURED || FEATURE_SDF_TEXT
+layout (location = 3) in vec2 aUv;
+out vec2 vUv;
+#endif
+#if FEATURE_MULTIVIEW
+layout (num_views = 2) in;
+uniform mat4 uMvp[2];
+#define MVP uMvp[gl_ViewID_OVR]
+#else
+uniform mat4 uMvp;
+#define MVP uMvp
+#endif
+
+void main() {
+    vec3 position = aPos;
+#if FEATURE_INSTANCED
+    position = position * aInstance.w + aInstance.xyz;
+#endif
+    gl_Position = MVP * vec4(position, 1.0);
+#if FEATURE_VERTEX_COLOR
+    vColor = aColor;
+#endif
+#if FEATURE_TEXTURED || FEATURE_SDF_TEXT
+    vUv = aUv;
+#endif
+}
+)glsl";
+
+const char* const kFragmentBody = R"glsl(
+precision mediump float;
+#if FEATURE_VERTEX_COLOR
+in vec3 vColor;
+#endif
+#if FEATURE_TEXTURED || FEATURE_SDF_TEXT
+in vec2 vUv;
+uniform sampler2D uTexture;
+#endif
+#if FEATURE_SDF_TEXT
+uniform vec4 uColor;
+#endif
+out vec4 FragColor;
+
+void main() {
+    vec4 color = vec4(1.0);
+#if FEATURE_VERTEX_COLOR
+    color.rgb = vColor;
+#endif
+#if FEATURE_SDF_TEXT
+    float distance = texture(uTexture, vUv).r;
+#if FEATURE_MSAA
+    float width = 0.5 * fwidth(distance);
+#else
+    float width = fwidth(distance);
+#endif
+    color *= vec4(uColor.rgb, uColor.a * smoothstep(0.5 - width, 0.5 + width, distance));
+#elif FEATURE_TEXTURED
+    color *= texture(uTexture, vUv);
+#endif
+    FragColor = color;
+}
+)glsl";
+
+// Drops bits that would not change the generated code, so equivalent requests
+// share one program.
+uint32_t NormalizeFeatures(uint32_t features) {
+    if ((features & SHADER_FEATURE_SDF_TEXT) == 0) features &= ~SHADER_FEATURE_MSAA;
+    return features & ((1u << SHADER_FEATURE_COUNT) - 1);
+}
+
+std::string VariantName(uint32_t features) {
+    std::string name;
+    for (uint32_t bit = 0; bit < SHADER_FEATURE_COUNT; ++bit) {
+        if ((features & (1u << bit)) == 0) continue;
+        if (!name.empty()) name += '+';
+        name += ShaderCache::FeatureName(1u << bit);
+    }
+    return name.empty() ? "base" : name;
+}
+
+} // namespace
+
+GLuint Shader_Compile(GLenum stage, const char* source) {
+    GLuint shader = glCreateShader(stage);
+    glShaderSource(shader, 1, &source, nullptr);
+    glCompileShader(shader);
+    GLint ok = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+    if (ok != GL_TRUE) {
+        char log[1024] = {};
+        glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+        ALOGE("Shader compile failed: %s", log);
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+GLuint Shader_Link(std::initializer_list<GLuint> shaders) {
+    bool compiled = true;
+    for (GLuint shader : shaders) compiled = compiled && shader != 0;
+    GLuint program = 0;
+    if (compiled) {
+        program = glCreateProgram();
+        for (GLuint shader : shaders) glAttachShader(program, shader);
+        glLinkProgram(program);
+        GLint ok = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &ok);
+        if (ok != GL_TRUE) {
+            char log[1024] = {};
+            glGetProgramInfoLog(program, sizeof(log), nullptr, log);
+            ALOGE("Program link failed: %s", log);
+            glDeleteProgram(program);
+            program = 0;
+        }
+    }
+    for (GLuint shader : shaders) {
+        if (shader != 0) glDeleteShader(shader);
+    }
+    return program;
+}
+
+// =============================================================================
+// Shader Cache
+// =============================================================================
+std::string ShaderCache::GenerateSource(GLenum stage, uint32_t features) {
+    features = NormalizeFeatures(features);
+    std::string source = "#version 320 es\n";
+    if (features & SHADER_FEATURE_MULTIVIEW) source += "#extension GL_OVR_multiview2 : require\n";
+    for (uint32_t bit = 0; bit < SHADER_FEATURE_COUNT; ++bit) {
+        source += "#define ";
+        source += kDefineNames[bit];
+        source += (features & (1u << bit)) ? " 1\n" : " 0\n";
+    }
+    source += stage == GL_VERTEX_SHADER ? kVertexBody : kFragmentBody;
+    return source;
+}
+
+const char* ShaderCache::FeatureName(uint32_t feature) {
+    switch (feature) {
+        case SHADER_FEATURE_VERTEX_COLOR: return "vertex-color";
+        case SHADER_FEATURE_INSTANCED: return "instanced";
+        case SHADER_FEATURE_TEXTURED: return "textured";
+        case SHADER_FEATURE_SDF_TEXT: return "sdf-text";
+        case SHADER_FEATURE_MSAA: return "msaa";
+        case SHADER_FEATURE_MULTIVIEW: return "multiview";
+        default: return "unknown";
+    }
+}
+
+ShaderVariant* ShaderCache::Compile(uint32_t features) {
+    const int64_t start = NowNs();
+    ShaderVariant& variant = variants_[features];
+    variant.features = features;
+    const std::string vertexSource = GenerateSource(GL_VERTEX_SHADER, features);
+    const std::string fragmentSource = GenerateSource(GL_FRAGMENT_SHADER, features);
+    variant.program = Shader_Link({Shader_Compile(GL_VERTEX_SHADER, vertexSource.c_str()),
+                                   Shader_Compile(GL_FRAGMENT_SHADER, fragmentSource.c_str())});
+    variant.compileNs = NowNs() - start;
+    stats_.compileNs += variant.compileNs;
+    if (variant.program == 0) {
+        // Kept as a failed entry so it is not rebuilt every frame.
+        stats_.failures++;
+        ALOGE("Shader variant %s failed to build.", VariantName(features).c_str());
+        return &variant;
+    }
+    stats_.variants++;
+    variant.mvpLocation = glGetUniformLocation(variant.program, "uMvp");
+    variant.textureLocation = glGetUniformLocation(variant.program, "uTexture");
+    variant.colorLocation = glGetUniformLocation(variant.program, "uColor");
+    if (variant.textureLocation >= 0) {
+        glUseProgram(variant.program);
+        glUniform1i(variant.textureLocation, 0);
+        glUseProgram(0);
+    }
+    ALOGI("Shader variant %s built in %.2f ms.", VariantName(features).c_str(), variant.compileNs / 1e6);
+    return &variant;
+}
+
+const ShaderVariant* ShaderCache::Get(uint32_t features) {
+    features = NormalizeFeatures(features);
+    auto it = variants_.find(features);
+    const ShaderVariant* variant;
+    if (it != variants_.end()) {
+        stats_.hits++;
+        variant = &it->second;
+    } else {
+        stats_.misses++;
+        variant = Compile(features);
+    }
+    return variant->program != 0 ? variant : nullptr;
+}
+
+void ShaderCache::Prewarm(std::initializer_list<uint32_t> featureSets) {
+    for (uint32_t features : featureSets) {
+        features = NormalizeFeatures(features);
+        if (variants_.find(features) == variants_.end()) Compile(features);
+    }
+}
+
+void ShaderCache::Destroy() {
+    for (auto& entry : variants_) {
+        GpuResources_DeferDelete(GPU_KIND_PROGRAM, entry.second.program);
+    }
+    variants_.clear();
+    stats_ = {};
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <unordered_map>
+
+#include <GLES3/gl32.h>
+
+// =============================================================================
+// Shader Variants
+// =============================================================================
+// All surface shaders come from one source with a #if block per feature. A
+// variant is that source compiled with the feature bitmask turned into defines,
+// so a shader never carries branches for features it does not use. Variants are
+// compiled on first use or pre-warmed while loading, and kept for the lifetime
+// of the GL context.
+
+enum ShaderFeature : uint32_t {
+    SHADER_FEATURE_VERTEX_COLOR = 1u << 0,   // per-vertex color at location 1
+    SHADER_FEATURE_INSTANCED    = 1u << 1,   // vec4(position, scale) per instance at location 2
+    SHADER_FEATURE_TEXTURED     = 1u << 2,   // uv at location 3, sampler uTexture
+    SHADER_FEATURE_SDF_TEXT     = 1u << 3,   // uTexture is a signed distance field, tinted by uColor
+    SHADER_FEATURE_MSAA         = 1u << 4,   // narrower SDF edge band, MSAA smooths the rest
+    SHADER_FEATURE_MULTIVIEW    = 1u << 5,   // OVR_multiview2, uMvp indexed by gl_ViewID_OVR
+    SHADER_FEATURE_COUNT        = 6
+};
+
+struct ShaderVariant {
+    uint32_t features = 0;
+    GLuint program = 0;
+    // Model-view-projection, or view-projection for instanced variants. Two
+    // consecutive matrices for multiview.
+    GLint mvpLocation = -1;
+    GLint textureLocation = -1;
+    GLint colorLocation = -1;
+    int64_t compileNs = 0;
+};
+
+struct ShaderCacheStats {
+    uint32_t variants = 0;
+    uint32_t failures = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;      // lazy compiles during rendering
+    int64_t compileNs = 0;    // total, pre-warm included
+};
+
+class ShaderCache {
+public:
+    // Compiles the variant if needed; nullptr if it does not build.
+    const ShaderVariant* Get(uint32_t features);
+    // Compiles every listed variant up front so none is built mid-frame.
+    void Prewarm(std::initializer_list<uint32_t> featureSets);
+    void Destroy();
+
+    ShaderCacheStats Stats() const { return stats_; }
+
+    // Full source of one stage of a variant, exposed for logging and tests.
+    static std::string GenerateSource(GLenum stage, uint32_t features);
+    static const char* FeatureName(uint32_t feature);
+
+private:
+    ShaderVariant* Compile(uint32_t features);
+
+    std::unordered_map<uint32_t, ShaderVariant> variants_;
+    ShaderCacheStats stats_;
+};
+
+// Compiles one shader stage; 0 (with the info log reported) on failure.
+GLuint Shader_Compile(GLenum stage, const char* source);
+// Links the shaders into a program and deletes them. Returns 0 if any of them
+// failed to compile or the link fails.
+GLuint Shader_Link(std::initializer_list<GLuint> shaders);
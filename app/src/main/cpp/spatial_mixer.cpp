@@ -0,0 +1,459 @@
+#include "spatial_mixer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#if defined(__ANDROID__)
+#include <aaudio/AAudio.h>
+#endif
+
+#include "common.h"
+#include "thread_roles.h"
+
+namespace {
+
+constexpr float kHeadRadius = 0.0875f;    // metres
+constexpr float kSpeedOfSound = 343.0f;
+constexpr float kReferenceDistance = 0.5f;
+constexpr int kBaseDelay = 2;             // leaves room for the centred head-shadow kernel
+
+// out[i] += sum_k h[k] * x[i + T - 1 - k]; x carries T - 1 samples of history before the block.
+void FirAccumulate(const float* x, const float* h, int n, float* out) {
+    int i = 0;
+#if defined(__ARM_NEON)
+    for (; i + 4 <= n; i += 4) {
+        float32x4_t acc = vld1q_f32(out + i);
+        for (int k = 0; k < kMixerHrirTaps; ++k) {
+            acc = vmlaq_n_f32(acc, vld1q_f32(x + i + kMixerHrirTaps - 1 - k), h[k]);
+        }
+        vst1q_f32(out + i, acc);
+    }
+#elif defined(__SSE2__)
+    for (; i + 4 <= n; i += 4) {
+        __m128 acc = _mm_loadu_ps(out + i);
+        for (int k = 0; k < kMixerHrirTaps; ++k) {
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(h[k]), _mm_loadu_ps(x + i + kMixerHrirTaps - 1 - k)));
+        }
+        _mm_storeu_ps(out + i, acc);
+    }
+#endif
+    for (; i < n; ++i) {
+        float acc = out[i];
+        for (int k = 0; k < kMixerHrirTaps; ++k) acc += h[k] * x[i + kMixerHrirTaps - 1 - k];
+        out[i] = acc;
+    }
+}
+
+// Places a fractionally delayed impulse, optionally smeared by a binomial low-pass
+// standing in for the head shadow on the far ear.
+void BuildEarResponse(float* h, float delay, float gain, float shadow) {
+    static const float kShadowKernel[5] = {1.0f / 16, 4.0f / 16, 6.0f / 16, 4.0f / 16, 1.0f / 16};
+    memset(h, 0, sizeof(float) * kMixerHrirTaps);
+    delay = std::min(delay, static_cast<float>(kMixerHrirTaps - kBaseDelay - 4));
+    const int whole = static_cast<int>(delay);
+    const float frac = delay - whole;
+    const int centre = kBaseDelay + whole;
+    for (int t = 0; t < 2; ++t) {
+        const float w = gain * (t == 0 ? 1.0f - frac : frac);
+        h[centre + t] += w * (1.0f - shadow);
+        for (int k = 0; k < 5; ++k) h[centre + t + k - 2] += w * shadow * kShadowKernel[k];
+    }
+}
+
+} // namespace
+
+// =============================================================================
+// Head Pose Mailbox
+// =============================================================================
+void HeadPoseMailbox::Publish(const HeadPose& pose) {
+    const uint32_t seq = sequence_.load(std::memory_order_relaxed);
+    sequence_.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (int i = 0; i < 3; ++i) values_[i].store(pose.position[i], std::memory_order_relaxed);
+    for (int i = 0; i < 4; ++i) values_[3 + i].store(pose.orientation[i], std::memory_order_relaxed);
+    sequence_.store(seq + 2, std::memory_order_release);
+}
+
+HeadPose HeadPoseMailbox::Read() const {
+    HeadPose pose;
+    for (;;) {
+        const uint32_t before = sequence_.load(std::memory_order_acquire);
+        for (int i = 0; i < 3; ++i) pose.position[i] = values_[i].load(std::memory_order_relaxed);
+        for (int i = 0; i < 4; ++i) pose.orientation[i] = values_[3 + i].load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if ((before & 1) == 0 && sequence_.load(std::memory_order_relaxed) == before) return pose;
+    }
+}
+
+// =============================================================================
+// Control Side
+// =============================================================================
+SpatialMixer::SpatialMixer() {
+    for (auto& busy : voiceBusy_) busy = false;
+    memset(input_, 0, sizeof(input_));
+}
+
+bool SpatialMixer::PushCommand(const Command& command) {
+    std::lock_guard<std::mutex> lock(commandMutex_);
+    if (commands_.TryPush(command)) return true;
+    commandsDropped_++;
+    return false;
+}
+
+int SpatialMixer::Play(const MixerClip& clip, const float position[3], float gain, bool loop) {
+    for (int v = 0; v < kMixerMaxSources; ++v) {
+        bool expected = false;
+        if (!voiceBusy_[v].compare_exchange_strong(expected, true)) continue;
+        std::lock_guard<std::mutex> lock(commandMutex_);
+        const uint32_t generation = (voiceGeneration_[v] + 1) & (0x7fffffffu >> kVoiceSlotBits);
+        const int32_t handle = static_cast<int32_t>(generation << kVoiceSlotBits) | v;
+        Command command = {CMD_PLAY, static_cast<uint8_t>(loop), handle, gain,
+                           {position[0], position[1], position[2]}, clip.samples, clip.length};
+        if (!commands_.TryPush(command)) {
+            commandsDropped_++;
+            voiceBusy_[v] = false;
+            return -1;
+        }
+        voiceGeneration_[v] = generation;
+        return handle;
+    }
+    return -1;
+}
+
+void SpatialMixer::Move(int voice, const float position[3]) {
+    if (voice < 0) return;
+    Command command = {CMD_MOVE, 0, voice, 0.0f, {position[0], position[1], position[2]}, nullptr, 0};
+    PushCommand(command);
+}
+
+void SpatialMixer::StopVoice(int voice) {
+    if (voice < 0) return;
+    Command command = {CMD_STOP, 0, voice, 0.0f, {0.0f, 0.0f, 0.0f}, nullptr, 0};
+    PushCommand(command);
+}
+
+SpatialMixerMetrics SpatialMixer::GetMetrics() const {
+    SpatialMixerMetrics m;
+    m.callbacks = callbacks_;
+    m.framesRendered = framesRendered_;
+    m.lastCallbackNs = lastCallbackNs_;
+    m.maxCallbackNs = maxCallbackNs_;
+    m.avgCallbackNsPer10ms = m.framesRendered > 0
+            ? static_cast<double>(totalCallbackNs_) / m.framesRendered * (sampleRate_ / 100.0) : 0.0;
+    m.activeSources = activeSources_;
+    m.commandsDropped = commandsDropped_;
+    return m;
+}
+
+// =============================================================================
+// Audio Callback Side
+// =============================================================================
+void SpatialMixer::DrainCommands() {
+    Command command;
+    while (commands_.TryPop(command)) {
+        const int slot = command.voice & ((1 << kVoiceSlotBits) - 1);
+        Voice& voice = voices_[slot];
+        // Moves and stops only reach the voice their handle was issued for; a
+        // handle kept past its voice's end no longer matches once the slot is reused.
+        if (command.type != CMD_PLAY && (!voice.active || voice.handle != command.voice)) continue;
+        switch (command.type) {
+            case CMD_PLAY:
+                voice.active = true;
+                voice.handle = command.voice;
+                voice.loop = command.loop != 0;
+                voice.samples = command.samples;
+                voice.length = command.length;
+                voice.cursor = 0;
+                voice.gain = command.gain;
+                memcpy(voice.position, command.position, sizeof(voice.position));
+                voice.lastAzimuth = voice.lastElevation = 1000.0f;   // force a fresh response without fading
+                voice.lastDistance = -1.0f;
+                memset(voice.history, 0, sizeof(voice.history));
+                break;
+            case CMD_MOVE:
+                memcpy(voice.position, command.position, sizeof(voice.position));
+                break;
+            case CMD_STOP:
+                voice.active = false;
+                voiceBusy_[slot] = false;
+                break;
+        }
+    }
+}
+
+// Returns true when the response changed enough to need a crossfade; the previous
+// response is left in oldL/oldR.
+bool SpatialMixer::UpdateHrir(Voice& voice, const HeadPose& head, float* oldL, float* oldR) {
+    // Rotate the head-to-source vector into head space (inverse orientation).
+    const float* q = head.orientation;
+    const float v[3] = {voice.position[0] - head.position[0], voice.position[1] - head.position[1], voice.position[2] - head.position[2]};
+    const float tx = 2.0f * (-q[1] * v[2] + q[2] * v[1]);
+    const float ty = 2.0f * (-q[2] * v[0] + q[0] * v[2]);
+    const float tz = 2.0f * (-q[0] * v[1] + q[1] * v[0]);
+    const float x = v[0] + q[3] * tx + (-q[1] * tz + q[2] * ty);
+    const float y = v[1] + q[3] * ty + (-q[2] * tx + q[0] * tz);
+    const float z = v[2] + q[3] * tz + (-q[0] * ty + q[1] * tx);
+
+    // OpenXR: +X right, +Y up, -Z forward.
+    const float distance = sqrtf(x * x + y * y + z * z);
+    const float azimuth = atan2f(x, -z);
+    const float elevation = atan2f(y, sqrtf(x * x + z * z));
+
+    const float kAngleEpsilon = 0.5f * static_cast<float>(M_PI) / 180.0f;
+    const bool fresh = voice.lastDistance < 0.0f;
+    if (!fresh && fabsf(azimuth - voice.lastAzimuth) < kAngleEpsilon && fabsf(elevation - voice.lastElevation) < kAngleEpsilon &&
+        fabsf(distance - voice.lastDistance) < 0.01f * voice.lastDistance) {
+        return false;
+    }
+    memcpy(oldL, voice.hrirL, sizeof(voice.hrirL));
+    memcpy(oldR, voice.hrirR, sizeof(voice.hrirR));
+    voice.lastAzimuth = azimuth;
+    voice.lastElevation = elevation;
+    voice.lastDistance = distance;
+
+    // Woodworth interaural time difference on the lateral angle, plus a level
+    // difference and low-pass shadow on the far ear.
+    const float lateral = asinf(std::max(-1.0f, std::min(1.0f, sinf(azimuth) * cosf(elevation))));
+    const float itdSamples = kHeadRadius / kSpeedOfSound * (fabsf(lateral) + sinf(fabsf(lateral))) * sampleRate_;
+    const float side = fabsf(sinf(lateral));
+    const float gain = voice.gain * std::min(1.0f, kReferenceDistance / std::max(distance, 0.05f));
+    const float nearGain = gain * (1.0f + 0.2f * side);
+    const float farGain = gain * (1.0f - 0.35f * side);
+    const float farShadow = 0.7f * side;
+    if (lateral >= 0.0f) {
+        BuildEarResponse(voice.hrirR, 0.0f, nearGain, 0.0f);
+        BuildEarResponse(voice.hrirL, itdSamples, farGain, farShadow);
+    } else {
+        BuildEarResponse(voice.hrirL, 0.0f, nearGain, 0.0f);
+        BuildEarResponse(voice.hrirR, itdSamples, farGain, farShadow);
+    }
+    return !fresh;
+}
+
+void SpatialMixer::RenderBlock(int frames, const HeadPose& head) {
+    memset(left_, 0, sizeof(float) * frames);
+    memset(right_, 0, sizeof(float) * frames);
+    alignas(16) float oldL[kMixerHrirTaps], oldR[kMixerHrirTaps];
+    int active = 0;
+
+    for (int v = 0; v < kMixerMaxSources; ++v) {
+        Voice& voice = voices_[v];
+        if (!voice.active) continue;
+        active++;
+
+        // Stage the source: history followed by this block's samples.
+        float* block = input_ + kMixerHrirTaps - 1;
+        memcpy(input_, voice.history, sizeof(voice.history));
+        int filled = 0;
+        while (filled < frames) {
+            if (voice.cursor >= voice.length) {
+                if (!voice.loop || voice.length == 0) break;
+                voice.cursor = 0;
+            }
+            const int count = static_cast<int>(std::min<size_t>(frames - filled, voice.length - voice.cursor));
+            memcpy(block + filled, voice.samples + voice.cursor, sizeof(float) * count);
+            voice.cursor += count;
+            filled += count;
+        }
+        if (filled < frames) memset(block + filled, 0, sizeof(float) * (frames - filled));
+        memcpy(voice.history, input_ + frames, sizeof(voice.history));
+
+        if (UpdateHrir(voice, head, oldL, oldR)) {
+            // Crossfade old to new response across the block to avoid zipper noise.
+            const float step = 1.0f / frames;
+            for (int ear = 0; ear < 2; ++ear) {
+                memset(fadeOld_, 0, sizeof(float) * frames);
+                memset(fadeNew_, 0, sizeof(float) * frames);
+                FirAccumulate(input_, ear == 0 ? oldL : oldR, frames, fadeOld_);
+                FirAccumulate(input_, ear == 0 ? voice.hrirL : voice.hrirR, frames, fadeNew_);
+                float* out = ear == 0 ? left_ : right_;
+                for (int i = 0; i < frames; ++i) {
+                    const float t = i * step;
+                    out[i] += fadeOld_[i] + t * (fadeNew_[i] - fadeOld_[i]);
+                }
+            }
+        } else {
+            FirAccumulate(input_, voice.hrirL, frames, left_);
+            FirAccumulate(input_, voice.hrirR, frames, right_);
+        }
+
+        if (filled < frames) {
+            voice.active = false;
+            voiceBusy_[v] = false;
+        }
+    }
+    activeSources_.store(active, std::memory_order_relaxed);
+}
+
+void SpatialMixer::Render(float* out, int frames) {
+    const int64_t start = NowNs();
+    DrainCommands();
+    const HeadPose head = headPose_.Read();
+    const int total = frames;
+    while (frames > 0) {
+        const int n = std::min(frames, kMixerMaxBlock);
+        RenderBlock(n, head);
+        for (int i = 0; i < n; ++i) {
+            out[2 * i] = std::max(-1.0f, std::min(1.0f, left_[i]));
+            out[2 * i + 1] = std::max(-1.0f, std::min(1.0f, right_[i]));
+        }
+        out += 2 * n;
+        frames -= n;
+    }
+    const int64_t elapsed = NowNs() - start;
+    callbacks_.fetch_add(1, std::memory_order_relaxed);
+    framesRendered_.fetch_add(total, std::memory_order_relaxed);
+    totalCallbackNs_.fetch_add(elapsed, std::memory_order_relaxed);
+    lastCallbackNs_.store(elapsed, std::memory_order_relaxed);
+    if (elapsed > maxCallbackNs_.load(std::memory_order_relaxed)) maxCallbackNs_.store(elapsed, std::memory_order_relaxed);
+}
+
+// =============================================================================
+// Output Stream
+// =============================================================================
+#if defined(__ANDROID__)
+static aaudio_data_callback_result_t MixerDataCallback(AAudioStream*, void* user, void* audioData, int32_t numFrames) {
+    auto* mixer = static_cast<SpatialMixer*>(user);
+    mixer->NoteOutputThread();
+    mixer->Render(static_cast<float*>(audioData), numFrames);
+    return AAUDIO_CALLBACK_RESULT_CONTINUE;
+}
+
+static void MixerErrorCallback(AAudioStream*, void*, aaudio_result_t error) {
+    ALOGE("AAudio output error: %s", AAudio_convertResultToText(error));
+}
+#endif
+
+void SpatialMixer::NoteOutputThread() {
+    // Registration locks and logs, so the callback only hands its id over.
+    if (callbackTid_.load(std::memory_order_relaxed) != 0) return;
+    callbackTid_.store(static_cast<int32_t>(syscall(SYS_gettid)), std::memory_order_relaxed);
+}
+
+void SpatialMixer::RegisterOutputThread() {
+    const int32_t tid = callbackTid_.load(std::memory_order_relaxed);
+    if (tid == 0 || tid == outputTid_) return;
+    if (outputTid_ != 0) ThreadRoles_Unregister(outputTid_);
+    // AAudio owns this thread's scheduling, so only the runtime is told about it.
+    outputTid_ = ThreadRoles_RegisterThread(tid, THREAD_ROLE_AUDIO, "aaudio-mixer", false);
+}
+
+bool SpatialMixer::Start(int sampleRate) {
+    if (running_) return true;
+    sampleRate_ = sampleRate;
+#if defined(__ANDROID__)
+    AAudioStreamBuilder* builder = nullptr;
+    if (AAudio_createStreamBuilder(&builder) != AAUDIO_OK) return false;
+    AAudioStreamBuilder_setDirection(builder, AAUDIO_DIRECTION_OUTPUT);
+    AAudioStreamBuilder_setSampleRate(builder, sampleRate);
+    AAudioStreamBuilder_setChannelCount(builder, 2);
+    AAudioStreamBuilder_setFormat(builder, AAUDIO_FORMAT_PCM_FLOAT);
+    AAudioStreamBuilder_setPerformanceMode(builder, AAUDIO_PERFORMANCE_MODE_LOW_LATENCY);
+    AAudioStreamBuilder_setDataCallback(builder, MixerDataCallback, this);
+    AAudioStreamBuilder_setErrorCallback(builder, MixerErrorCallback, nullptr);
+    AAudioStream* stream = nullptr;
+    aaudio_result_t result = AAudioStreamBuilder_openStream(builder, &stream);
+    AAudioStreamBuilder_delete(builder);
+    if (result != AAUDIO_OK) {
+        ALOGE("AAudio output stream open failed: %s", AAudio_convertResultToText(result));
+        return false;
+    }
+    sampleRate_ = AAudioStream_getSampleRate(stream);
+    if (AAudioStream_requestStart(stream) != AAUDIO_OK) {
+        AAudioStream_close(stream);
+        return false;
+    }
+    stream_ = stream;
+    running_ = true;
+    ALOGI("Spatial mixer output started: %d Hz, burst %d frames", sampleRate_, AAudioStream_getFramesPerBurst(stream));
+#else
+    StartNullSink();
+#endif
+    return true;
+}
+
+void SpatialMixer::StartNullSink() {
+    running_ = true;
+    nullSink_ = std::thread([this] {
+        ThreadRoleScope role(THREAD_ROLE_AUDIO, "iris-mix-null");
+        std::vector<float> buffer(2 * (sampleRate_ / 100));
+        int64_t next = NowNs();
+        while (running_) {
+            Render(buffer.data(), sampleRate_ / 100);
+            next += 10000000;
+            ThreadRoles_SleepUntil(next);
+        }
+    });
+    ALOGI("Spatial mixer null sink started: %d Hz", sampleRate_);
+}
+
+void SpatialMixer::Stop() {
+    if (!running_) return;
+    running_ = false;
+#if defined(__ANDROID__)
+    if (stream_ != nullptr) {
+        AAudioStream_requestStop(static_cast<AAudioStream*>(stream_));
+        AAudioStream_close(static_cast<AAudioStream*>(stream_));
+        stream_ = nullptr;
+    }
+#endif
+    if (nullSink_.joinable()) nullSink_.join();
+    callbackTid_.store(0, std::memory_order_relaxed);
+    if (outputTid_ != 0) ThreadRoles_Unregister(outputTid_);
+    outputTid_ = 0;
+}
+
+// =============================================================================
+// Benchmark & Earcons
+// =============================================================================
+double SpatialMixer::Benchmark(int sources, int iterations) {
+    if (running_) return -1.0;
+    const int block = sampleRate_ / 100;
+    std::vector<float> clip(static_cast<size_t>(sampleRate_) / 2);
+    SpatialMixer_SynthesizeEarcon(clip.data(), clip.size(), sampleRate_, 660.0f);
+    std::vector<float> out(2 * block);
+
+    sources = std::min(sources, kMixerMaxSources);
+    int handles[kMixerMaxSources];
+    for (int s = 0; s < sources; ++s) {
+        const float angle = 2.0f * static_cast<float>(M_PI) * s / sources;
+        const float position[3] = {1.5f * sinf(angle), 0.2f * (s % 3), -1.5f * cosf(angle)};
+        handles[s] = Play({clip.data(), clip.size()}, position, 0.5f, true);
+    }
+
+    int64_t total = 0;
+    for (int i = 0; i < iterations; ++i) {
+        // Turn the head a little every block so responses keep being rebuilt and crossfaded.
+        const float yaw = 0.01f * i;
+        HeadPose pose = {{0.0f, 1.6f, 0.0f}, {0.0f, sinf(yaw * 0.5f), 0.0f, cosf(yaw * 0.5f)}};
+        headPose_.Publish(pose);
+        const int64_t start = NowNs();
+        Render(out.data(), block);
+        total += NowNs() - start;
+    }
+    for (int s = 0; s < sources; ++s) StopVoice(handles[s]);
+    DrainCommands();
+    const double mean = iterations > 0 ? static_cast<double>(total) / iterations : 0.0;
+    ALOGI("Spatial mixer benchmark: %d sources, %.1f us per 10 ms buffer", sources, mean / 1000.0);
+    return mean;
+}
+
+void SpatialMixer_SynthesizeEarcon(float* buffer, size_t length, int sampleRate, float frequency) {
+    const float twoPi = 2.0f * static_cast<float>(M_PI);
+    for (size_t i = 0; i < length; ++i) {
+        const float t = static_cast<float>(i) / sampleRate;
+        const float envelope = expf(-6.0f * t) * std::min(1.0f, t * 200.0f);
+        buffer[i] = 0.4f * envelope * (sinf(twoPi * frequency * t) + 0.3f * sinf(twoPi * 2.0f * frequency * t));
+    }
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include "head_pose.h"
+#include "spsc_ring.h"
+
+// =============================================================================
+// Spatialized Audio Output Mixer
+// =============================================================================
+// Mixes up to kMixerMaxSources mono sources into a stereo output, each placed in stage
+// space (e.g. at the panel that is speaking). The frame loop publishes the head
+// pose through a lock-free mailbox; the audio callback reads it, derives a short
+// binaural impulse response per source (interaural delay, head shadow, distance
+// gain) and convolves with NEON/SSE. The callback never locks or allocates:
+// control-thread changes arrive through an SPSC command ring.
+
+constexpr int kMixerMaxSources = 64;
+constexpr int kMixerHrirTaps = 32;
+constexpr int kMixerMaxBlock = 1024;
+
+// Seqlock over atomics: the writer (frame loop) never waits, readers retry on a torn read.
+class HeadPoseMailbox {
+public:
+    void Publish(const HeadPose& pose);
+    HeadPose Read() const;
+
+private:
+    std::atomic<uint32_t> sequence_{0};
+    std::atomic<float> values_[7] = {{0.0f}, {0.0f}, {0.0f}, {0.0f}, {0.0f}, {0.0f}, {1.0f}};
+};
+
+struct MixerClip {
+    const float* samples;   // mono, mixer rate; must outlive playback
+    size_t length;
+};
+
+struct SpatialMixerMetrics {
+    uint64_t callbacks = 0;
+    uint64_t framesRendered = 0;
+    int64_t lastCallbackNs = 0;
+    int64_t maxCallbackNs = 0;
+    double avgCallbackNsPer10ms = 0.0;    // callback cost normalized to a 10 ms buffer
+    int activeSources = 0;
+    uint64_t commandsDropped = 0;
+};
+
+class SpatialMixer {
+public:
+    SpatialMixer();
+    ~SpatialMixer() { Stop(); }
+
+    // Opens the output stream (AAudio on device, a paced null sink elsewhere).
+    bool Start(int sampleRate);
+    void Stop();
+    int SampleRate() const { return sampleRate_; }
+
+    // Control thread. Returns a voice handle usable with Move/StopVoice, or -1.
+    // Handles carry the slot's generation, so one kept after its voice ended
+    // (and the slot was reused) does nothing.
+    int Play(const MixerClip& clip, const float position[3], float gain, bool loop);
+    void Move(int voice, const float position[3]);
+    void StopVoice(int voice);
+
+    HeadPoseMailbox& HeadPoseInput() { return headPose_; }
+
+    // Real-time safe. Renders interleaved stereo.
+    void Render(float* out, int frames);
+    // Called from the AAudio callback: records the callback thread id without
+    // locking or allocating.
+    void NoteOutputThread();
+    // Called from the render loop: registers the thread NoteOutputThread saw
+    // with the audio role so the XR runtime knows about it.
+    void RegisterOutputThread();
+
+    SpatialMixerMetrics GetMetrics() const;
+
+    // Renders `iterations` 10 ms blocks offline with `sources` looping voices
+    // spread around the listener; returns the mean cost per block in ns.
+    // Only valid on a mixer that has not been started.
+    double Benchmark(int sources, int iterations);
+
+private:
+    enum CommandType : uint8_t { CMD_PLAY, CMD_MOVE, CMD_STOP };
+    struct Command {
+        CommandType type;
+        uint8_t loop;
+        int32_t voice;   // handle: generation << kVoiceSlotBits | slot
+        float gain;
+        float position[3];
+        const float* samples;
+        size_t length;
+    };
+
+    static constexpr int kVoiceSlotBits = 6;
+    static_assert(kMixerMaxSources <= (1 << kVoiceSlotBits), "voice slots must fit in a handle");
+
+    struct Voice {
+        bool active = false;
+        int32_t handle = -1;
+        bool loop = false;
+        const float* samples = nullptr;
+        size_t length = 0;
+        size_t cursor = 0;
+        float gain = 1.0f;
+        float position[3] = {};
+        float lastAzimuth = 1000.0f;
+        float lastElevation = 1000.0f;
+        float lastDistance = -1.0f;
+        alignas(16) float hrirL[kMixerHrirTaps];
+        alignas(16) float hrirR[kMixerHrirTaps];
+        alignas(16) float history[kMixerHrirTaps - 1];
+    };
+
+    bool PushCommand(const Command& command);
+    void DrainCommands();
+    bool UpdateHrir(Voice& voice, const HeadPose& head, float* oldL, float* oldR);
+    void RenderBlock(int frames, const HeadPose& head);
+    void StartNullSink();
+
+    int sampleRate_ = 48000;
+    HeadPoseMailbox headPose_;
+    std::mutex commandMutex_;   // serializes producers; the callback side never takes it
+    SpscRing<Command, 256> commands_;
+    Voice voices_[kMixerMaxSources];                // audio callback only
+    std::atomic<bool> voiceBusy_[kMixerMaxSources];  // claimed by Play, released by the callback
+    uint32_t voiceGeneration_[kMixerMaxSources] = {};  // bumped by Play under commandMutex_
+
+    alignas(16) float input_[kMixerHrirTaps - 1 + kMixerMaxBlock];
+    alignas(16) float left_[kMixerMaxBlock];
+    alignas(16) float right_[kMixerMaxBlock];
+    alignas(16) float fadeOld_[kMixerMaxBlock];
+    alignas(16) float fadeNew_[kMixerMaxBlock];
+
+    void* stream_ = nullptr;   // AAudioStream on device
+    std::atomic<int32_t> callbackTid_{0};   // written by the AAudio callback
+    int32_t outputTid_ = 0;                 // registered by RegisterOutputThread
+    std::thread nullSink_;
+    std::atomic<bool> running_{false};
+
+    std::atomic<uint64_t> callbacks_{0};
+    std::atomic<uint64_t> framesRendered_{0};
+    std::atomic<int64_t> lastCallbackNs_{0};
+    std::atomic<int64_t> maxCallbackNs_{0};
+    std::atomic<int64_t> totalCallbackNs_{0};
+    std::atomic<int> activeSources_{0};
+    std::atomic<uint64_t> commandsDropped_{0};
+};
+
+// Fills `buffer` with a short decaying chime, handy as an earcon.
+void SpatialMixer_SynthesizeEarcon(float* buffer, size_t length, int sampleRate, float frequency);
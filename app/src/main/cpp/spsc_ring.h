@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+// =============================================================================
+// Lock-free single-producer / single-consumer ring
+// =============================================================================
+// One thread pushes, one thread pops; neither ever blocks or allocates.
+// Capacity must be a power of two. Head and tail sit on separate cache lines so
+// producer and consumer do not false-share.
+template <typename T, size_t Capacity>
+class SpscRing {
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+    static_assert(std::is_trivially_copyable<T>::value, "SpscRing holds trivially copyable items");
+
+public:
+    bool TryPush(const T& item) {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) == Capacity) return false;
+        slots_[tail & kMask] = item;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool TryPop(T& out) {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) return false;
+        out = slots_[head & kMask];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Bulk variants copy as many items as fit and return how many were moved.
+    size_t Write(const T* data, size_t count) {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        const size_t space = Capacity - (tail - head_.load(std::memory_order_acquire));
+        if (count > space) count = space;
+        const size_t start = tail & kMask;
+        const size_t first = (count < Capacity - start) ? count : Capacity - start;
+        memcpy(&slots_[start], data, first * sizeof(T));
+        memcpy(&slots_[0], data + first, (count - first) * sizeof(T));
+        tail_.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+    size_t Read(T* out, size_t count) {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        const size_t available = tail_.load(std::memory_order_acquire) - head;
+        if (count > available) count = available;
+        const size_t start = head & kMask;
+        const size_t first = (count < Capacity - start) ? count : Capacity - start;
+        memcpy(out, &slots_[start], first * sizeof(T));
+        memcpy(out + first, &slots_[0], (count - first) * sizeof(T));
+        head_.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+    size_t Size() const {
+        return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+    }
+
+    static constexpr size_t kCapacity = Capacity;
+
+private:
+    static constexpr size_t kMask = Capacity - 1;
+    T slots_[Capacity];
+    alignas(64) std::atomic<size_t> head_{0};
+    alignas(64) std::atomic<size_t> tail_{0};
+};
@@ -0,0 +1,694 @@
+#include "stream_client.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string_view>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "thread_roles.h"
+
+// =============================================================================
+// Connection State
+// =============================================================================
+struct StreamConnection {
+    enum State { CONNECTING, SENDING, HEADERS, BODY, CLOSED };
+    enum ChunkState { CHUNK_SIZE, CHUNK_EXT, CHUNK_DATA, CHUNK_DATA_CR, CHUNK_DATA_LF, CHUNK_END };
+
+    uint32_t requestId = 0;
+    int fd = -1;
+    State state = CONNECTING;
+
+    std::string outgoing;
+    size_t sent = 0;
+
+    std::string headers;            // only the response head is ever copied
+    int status = 0;
+    bool chunked = false;
+    bool sse = false;
+    int64_t contentRemaining = -1;  // -1: read until close
+
+    ChunkState chunkState = CHUNK_SIZE;
+    uint64_t chunkRemaining = 0;
+
+    std::string lineCarry;          // a line split across two reads
+
+    int64_t submitNs = 0;
+    int64_t firstTokenNs = 0;
+    uint64_t bytes = 0;
+    uint64_t tokens = 0;
+
+    char recvBuf[16 * 1024];
+};
+
+namespace {
+
+bool StartsWithNoCase(std::string_view s, std::string_view prefix) {
+    if (s.size() < prefix.size()) return false;
+    for (size_t i = 0; i < prefix.size(); ++i) {
+        if (tolower(static_cast<unsigned char>(s[i])) != tolower(static_cast<unsigned char>(prefix[i]))) return false;
+    }
+    return true;
+}
+
+bool ContainsNoCase(std::string_view s, std::string_view needle) {
+    for (size_t i = 0; i + needle.size() <= s.size(); ++i) {
+        if (StartsWithNoCase(s.substr(i), needle)) return true;
+    }
+    return false;
+}
+
+std::string_view Trim(std::string_view s) {
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t' || s.back() == '\r')) s.remove_suffix(1);
+    return s;
+}
+
+int HexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+size_t EncodeUtf8(uint32_t cp, char* out) {
+    if (cp < 0x80) { out[0] = static_cast<char>(cp); return 1; }
+    if (cp < 0x800) {
+        out[0] = static_cast<char>(0xC0 | (cp >> 6));
+        out[1] = static_cast<char>(0x80 | (cp & 0x3F));
+        return 2;
+    }
+    if (cp < 0x10000) {
+        out[0] = static_cast<char>(0xE0 | (cp >> 12));
+        out[1] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out[2] = static_cast<char>(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    out[0] = static_cast<char>(0xF0 | (cp >> 18));
+    out[1] = static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+    out[2] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+    out[3] = static_cast<char>(0x80 | (cp & 0x3F));
+    return 4;
+}
+
+// Keys whose string values carry generated text in the common streaming APIs:
+// OpenAI "choices[].delta.content", Anthropic "delta.text", Ollama "response".
+bool IsTextKey(std::string_view key) {
+    return key == "content" || key == "text" || key == "response" || key == "token";
+}
+
+// Reads the raw (still escaped) body of a JSON string starting just after the
+// opening quote. Returns the index of the closing quote, or npos if unterminated.
+size_t ScanJsonString(std::string_view s, size_t i) {
+    while (i < s.size()) {
+        if (s[i] == '\\') { i += 2; continue; }
+        if (s[i] == '"') return i;
+        ++i;
+    }
+    return std::string_view::npos;
+}
+
+} // namespace
+
+// =============================================================================
+// Client Lifecycle
+// =============================================================================
+bool StreamClient::Start() {
+    if (running_) return true;
+    if (pipe(wakePipe_) != 0) { ALOGE("StreamClient: pipe failed: %s", strerror(errno)); return false; }
+    fcntl(wakePipe_[0], F_SETFL, O_NONBLOCK);
+    fcntl(wakePipe_[1], F_SETFL, O_NONBLOCK);
+    running_ = true;
+    thread_ = std::thread(&StreamClient::EventLoop, this);
+    ALOGI("StreamClient event loop started.");
+    return true;
+}
+
+void StreamClient::Stop() {
+    if (!running_) return;
+    running_ = false;
+    char b = 0;
+    write(wakePipe_[1], &b, 1);
+    if (thread_.joinable()) thread_.join();
+    close(wakePipe_[0]);
+    close(wakePipe_[1]);
+    wakePipe_[0] = wakePipe_[1] = -1;
+    ALOGI("StreamClient event loop stopped.");
+}
+
+uint32_t StreamClient::Submit(const StreamRequest& request) {
+    if (!running_) return 0;
+    uint32_t id;
+    {
+        std::lock_guard<std::mutex> lock(submitMutex_);
+        id = nextRequestId_++;
+        pending_.emplace_back(id, request);
+    }
+    char b = 1;
+    write(wakePipe_[1], &b, 1);
+    return id;
+}
+
+StreamMetrics StreamClient::GetMetrics() {
+    std::lock_guard<std::mutex> lock(metricsMutex_);
+    return metrics_;
+}
+
+// =============================================================================
+// Event Loop
+// =============================================================================
+void StreamClient::EventLoop() {
+    ThreadRoleScope role(THREAD_ROLE_NETWORK, "iris-stream");
+    std::vector<pollfd> fds;
+    int64_t pausedSinceNs = 0;   // nonzero while reads are paused
+    while (running_) {
+        // While the render queue is full no socket is read; the render thread
+        // does not signal when it pops, so the loop polls the queue instead.
+        const bool throttled = !FlushOverflow();
+        if (throttled != (pausedSinceNs != 0)) {
+            const int64_t now = NowNs();
+            std::lock_guard<std::mutex> lock(metricsMutex_);
+            if (throttled) {
+                metrics_.readPauses++;
+                pausedSinceNs = now;
+            } else {
+                metrics_.readPausedNs += now - pausedSinceNs;
+                pausedSinceNs = 0;
+            }
+        }
+        OpenPending();
+
+        fds.clear();
+        fds.push_back({wakePipe_[0], POLLIN, 0});
+        for (StreamConnection* conn : connections_) {
+            const bool writing = conn->state == StreamConnection::CONNECTING || conn->state == StreamConnection::SENDING;
+            fds.push_back({conn->fd, static_cast<short>(writing ? POLLOUT : (throttled ? 0 : POLLIN)), 0});
+        }
+
+        if (poll(fds.data(), fds.size(), throttled ? 2 : 100) < 0 && errno != EINTR) {
+            ALOGE("StreamClient: poll failed: %s", strerror(errno));
+            break;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            char drain[64];
+            while (read(wakePipe_[0], drain, sizeof(drain)) > 0) {}
+        }
+
+        for (size_t i = 0; i < connections_.size(); ++i) {
+            StreamConnection& conn = *connections_[i];
+            if (fds[i + 1].revents == 0) continue;
+            // Hang-ups are reported even when not asked for; they wait with the rest of the stream.
+            const bool reading = conn.state == StreamConnection::HEADERS || conn.state == StreamConnection::BODY;
+            if (reading && Throttled()) continue;
+            Service(conn, fds[i + 1].revents);
+        }
+
+        connections_.erase(std::remove_if(connections_.begin(), connections_.end(), [this](StreamConnection* c) {
+            if (c->state != StreamConnection::CLOSED) return false;
+            connectionPool_.Destroy(c);
+            return true;
+        }), connections_.end());
+    }
+
+    for (StreamConnection* conn : connections_) {
+        Finish(*conn, false, "client stopped");
+        connectionPool_.Destroy(conn);
+    }
+    connections_.clear();
+    // A stopped client keeps no backlog; whatever the queue could not take is gone with it.
+    overflow_.clear();
+    overflowHead_ = 0;
+}
+
+void StreamClient::OpenPending() {
+    std::vector<std::pair<uint32_t, StreamRequest>> requests;
+    {
+        std::lock_guard<std::mutex> lock(submitMutex_);
+        requests.swap(pending_);
+    }
+
+    for (auto& entry : requests) {
+        const StreamRequest& req = entry.second;
+        StreamConnection* conn = connectionPool_.Create();
+        if (conn == nullptr) {
+            ALOGW("StreamClient: network memory cap reached, dropping request %u", entry.first);
+            EmitMarker(entry.first, STREAM_TOKEN_ERROR);
+            continue;
+        }
+        conn->requestId = entry.first;
+        conn->submitNs = NowNs();
+        connections_.push_back(conn);
+
+        // Name resolution blocks, but only this thread; loopback and literal
+        // addresses resolve without touching the network.
+        addrinfo hints = {};
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* addr = nullptr;
+        char port[8];
+        snprintf(port, sizeof(port), "%u", req.port);
+        if (getaddrinfo(req.host.c_str(), port, &hints, &addr) != 0 || addr == nullptr) {
+            Finish(*conn, false, "resolve failed");
+            continue;
+        }
+
+        conn->fd = socket(addr->ai_family, SOCK_STREAM, 0);
+        if (conn->fd < 0) {
+            freeaddrinfo(addr);
+            Finish(*conn, false, "socket failed");
+            continue;
+        }
+        fcntl(conn->fd, F_SETFL, fcntl(conn->fd, F_GETFL) | O_NONBLOCK);
+        int one = 1;
+        setsockopt(conn->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        int rc = connect(conn->fd, addr->ai_addr, addr->ai_addrlen);
+        freeaddrinfo(addr);
+        if (rc != 0 && errno != EINPROGRESS) {
+            Finish(*conn, false, "connect failed");
+            continue;
+        }
+
+        char head[512];
+        snprintf(head, sizeof(head),
+                 "%s %s HTTP/1.1\r\nHost: %s:%u\r\nAccept: text/event-stream\r\n"
+                 "Content-Type: application/json\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n",
+                 req.body.empty() ? "GET" : "POST", req.path.c_str(), req.host.c_str(), req.port, req.body.size());
+        conn->outgoing = head;
+        conn->outgoing += req.body;
+        conn->state = StreamConnection::CONNECTING;
+    }
+}
+
+// =============================================================================
+// Incremental Parsing
+// =============================================================================
+// Everything below works on views into the connection's receive buffer. Bytes
+// are only copied when a line straddles two reads, and decoded text is written
+// straight into token slots.
+struct StreamParser {
+    StreamClient& client;
+    StreamConnection& conn;
+    bool done = false;
+
+    void ExtractText(std::string_view json);
+    void Line(std::string_view line);
+    void Payload(const char* data, size_t length);
+    void Body(const char* data, size_t length);
+    bool Headers(const char* data, size_t length);
+};
+
+void StreamClient::EmitText(StreamConnection& conn, const char* data, size_t length) {
+    if (length == 0) return;
+    if (conn.firstTokenNs == 0) conn.firstTokenNs = NowNs();
+    while (length > 0) {
+        StreamToken token;
+        token.requestId = conn.requestId;
+        token.kind = STREAM_TOKEN_TEXT;
+        token.length = static_cast<uint16_t>(std::min(length, sizeof(token.text)));
+        memcpy(token.text, data, token.length);
+        Enqueue(token);
+        data += token.length;
+        length -= token.length;
+    }
+}
+
+void StreamClient::EmitMarker(uint32_t requestId, StreamTokenKind kind) {
+    StreamToken token = {};
+    token.requestId = requestId;
+    token.kind = kind;
+    Enqueue(token);
+}
+
+void StreamClient::Enqueue(const StreamToken& token) {
+    // Behind an existing backlog even when the queue has room, to keep the order.
+    if (Throttled() || !tokens_.TryPush(token)) overflow_.push_back(token);
+}
+
+bool StreamClient::FlushOverflow() {
+    while (overflowHead_ < overflow_.size() && tokens_.TryPush(overflow_[overflowHead_])) overflowHead_++;
+    if (overflowHead_ < overflow_.size()) return false;
+    overflow_.clear();
+    overflowHead_ = 0;
+    return true;
+}
+
+void StreamParser::ExtractText(std::string_view s) {
+    std::string_view pendingKey;
+    size_t i = 0;
+    while (i < s.size()) {
+        char c = s[i];
+        if (c == '"') {
+            size_t end = ScanJsonString(s, i + 1);
+            if (end == std::string_view::npos) return;
+            std::string_view raw = s.substr(i + 1, end - i - 1);
+            i = end + 1;
+            while (i < s.size() && (s[i] == ' ' || s[i] == '\t')) ++i;
+            if (i < s.size() && s[i] == ':') {
+                pendingKey = raw;
+                ++i;
+                continue;
+            }
+            if (!pendingKey.empty() && IsTextKey(pendingKey)) {
+                // Decode escapes into a small stack buffer and flush it in slot-sized pieces.
+                char out[256];
+                size_t n = 0;
+                uint32_t highSurrogate = 0;
+                for (size_t j = 0; j < raw.size(); ++j) {
+                    if (n + 4 > sizeof(out)) { client.EmitText(conn, out, n); n = 0; }
+                    if (raw[j] != '\\' || j + 1 >= raw.size()) { out[n++] = raw[j]; continue; }
+                    char e = raw[++j];
+                    switch (e) {
+                        case 'n': out[n++] = '\n'; break;
+                        case 't': out[n++] = '\t'; break;
+                        case 'r': out[n++] = '\r'; break;
+                        case 'b': out[n++] = '\b'; break;
+                        case 'f': out[n++] = '\f'; break;
+                        case 'u': {
+                            if (j + 4 >= raw.size()) break;
+                            uint32_t cp = 0;
+                            for (int k = 1; k <= 4; ++k) cp = (cp << 4) | static_cast<uint32_t>(std::max(HexValue(raw[j + k]), 0));
+                            j += 4;
+                            if (cp >= 0xD800 && cp < 0xDC00) { highSurrogate = cp; break; }
+                            if (cp >= 0xDC00 && cp < 0xE000 && highSurrogate != 0) {
+                                cp = 0x10000 + ((highSurrogate - 0xD800) << 10) + (cp - 0xDC00);
+                                highSurrogate = 0;
+                            }
+                            n += EncodeUtf8(cp, out + n);
+                            break;
+                        }
+                        default: out[n++] = e; break;   // \" \\ \/
+                    }
+                }
+                client.EmitText(conn, out, n);
+                if (!raw.empty()) conn.tokens++;
+            }
+            pendingKey = {};
+            continue;
+        }
+        pendingKey = (c == '[') ? pendingKey : std::string_view();
+        ++i;
+    }
+}
+
+void StreamParser::Line(std::string_view line) {
+    if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+    if (line.empty()) return;
+    if (!conn.sse) {
+        ExtractText(line);   // newline-delimited JSON
+        return;
+    }
+    if (line.substr(0, 5) != "data:") return;   // event:, id:, retry: and comments carry no text
+    std::string_view data = line.substr(5);
+    if (!data.empty() && data.front() == ' ') data.remove_prefix(1);
+    if (data == "[DONE]") { done = true; return; }
+    ExtractText(data);
+}
+
+void StreamParser::Payload(const char* data, size_t length) {
+    std::string_view rest(data, length);
+    while (!rest.empty() && !done) {
+        size_t nl = rest.find('\n');
+        if (nl == std::string_view::npos) {
+            conn.lineCarry.append(rest.data(), rest.size());
+            return;
+        }
+        if (conn.lineCarry.empty()) {
+            Line(rest.substr(0, nl));
+        } else {
+            conn.lineCarry.append(rest.data(), nl);
+            Line(conn.lineCarry);
+            conn.lineCarry.clear();
+        }
+        rest.remove_prefix(nl + 1);
+    }
+}
+
+void StreamParser::Body(const char* data, size_t length) {
+    if (!conn.chunked) {
+        if (conn.contentRemaining >= 0) {
+            length = std::min<size_t>(length, static_cast<size_t>(conn.contentRemaining));
+            conn.contentRemaining -= static_cast<int64_t>(length);
+        }
+        Payload(data, length);
+        if (conn.contentRemaining == 0) done = true;
+        return;
+    }
+
+    const char* end = data + length;
+    while (data < end && !done) {
+        switch (conn.chunkState) {
+            case StreamConnection::CHUNK_SIZE: {
+                int v = HexValue(*data);
+                if (v >= 0) { conn.chunkRemaining = conn.chunkRemaining * 16 + v; ++data; break; }
+                conn.chunkState = StreamConnection::CHUNK_EXT;
+                break;
+            }
+            case StreamConnection::CHUNK_EXT:
+                if (*data++ == '\n') {
+                    if (conn.chunkRemaining == 0) { conn.chunkState = StreamConnection::CHUNK_END; done = true; }
+                    else conn.chunkState = StreamConnection::CHUNK_DATA;
+                }
+                break;
+            case StreamConnection::CHUNK_DATA: {
+                size_t n = std::min<size_t>(end - data, conn.chunkRemaining);
+                Payload(data, n);
+                data += n;
+                conn.chunkRemaining -= n;
+                if (conn.chunkRemaining == 0) conn.chunkState = StreamConnection::CHUNK_DATA_CR;
+                break;
+            }
+            case StreamConnection::CHUNK_DATA_CR:
+            case StreamConnection::CHUNK_DATA_LF:
+                if (*data++ == '\n') conn.chunkState = StreamConnection::CHUNK_SIZE;
+                break;
+            case StreamConnection::CHUNK_END:
+                return;
+        }
+    }
+}
+
+// Returns false on a malformed or non-200 response.
+bool StreamParser::Headers(const char* data, size_t length) {
+    conn.headers.append(data, length);
+    size_t end = conn.headers.find("\r\n\r\n");
+    if (end == std::string::npos) return conn.headers.size() < 16 * 1024;
+
+    std::string_view head(conn.headers.data(), end);
+    if (sscanf(conn.headers.c_str(), "HTTP/1.%*d %d", &conn.status) != 1) return false;
+    size_t pos = head.find("\r\n");
+    while (pos != std::string_view::npos) {
+        size_t next = head.find("\r\n", pos + 2);
+        std::string_view line = head.substr(pos + 2, next == std::string_view::npos ? std::string_view::npos : next - pos - 2);
+        size_t colon = line.find(':');
+        if (colon != std::string_view::npos) {
+            std::string_view name = Trim(line.substr(0, colon));
+            std::string_view value = Trim(line.substr(colon + 1));
+            if (StartsWithNoCase(name, "transfer-encoding") && ContainsNoCase(value, "chunked")) conn.chunked = true;
+            else if (StartsWithNoCase(name, "content-type") && ContainsNoCase(value, "text/event-stream")) conn.sse = true;
+            else if (StartsWithNoCase(name, "content-length")) conn.contentRemaining = strtoll(std::string(value).c_str(), nullptr, 10);
+        }
+        pos = next;
+    }
+    if (conn.status != 200) return false;
+
+    conn.state = StreamConnection::BODY;
+    const size_t bodyStart = end + 4;
+    if (bodyStart < conn.headers.size()) Body(conn.headers.data() + bodyStart, conn.headers.size() - bodyStart);
+    conn.headers.clear();
+    conn.headers.shrink_to_fit();
+    return true;
+}
+
+// =============================================================================
+// Socket Servicing
+// =============================================================================
+bool StreamClient::Service(StreamConnection& conn, short revents) {
+    if (conn.state == StreamConnection::CONNECTING) {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        getsockopt(conn.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+        if (err != 0 || (revents & (POLLERR | POLLHUP))) { Finish(conn, false, "connect failed"); return false; }
+        conn.state = StreamConnection::SENDING;
+    }
+
+    if (conn.state == StreamConnection::SENDING) {
+        ssize_t n = send(conn.fd, conn.outgoing.data() + conn.sent, conn.outgoing.size() - conn.sent, MSG_NOSIGNAL);
+        if (n < 0 && errno != EAGAIN) { Finish(conn, false, "send failed"); return false; }
+        if (n > 0) conn.sent += static_cast<size_t>(n);
+        if (conn.sent == conn.outgoing.size()) {
+            conn.outgoing.clear();
+            conn.outgoing.shrink_to_fit();
+            conn.state = StreamConnection::HEADERS;
+        }
+        return true;
+    }
+
+    StreamParser parser{*this, conn};
+    for (;;) {
+        ssize_t n = recv(conn.fd, conn.recvBuf, sizeof(conn.recvBuf), 0);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return true;
+            Finish(conn, false, "recv failed");
+            return false;
+        }
+        if (n == 0) {
+            // Identity bodies without a length end at close; anything else is truncated.
+            bool ok = conn.state == StreamConnection::BODY && !conn.chunked && conn.contentRemaining < 0;
+            if (ok && !conn.lineCarry.empty()) { parser.Line(conn.lineCarry); conn.lineCarry.clear(); }
+            Finish(conn, ok, "connection closed mid-stream");
+            return ok;
+        }
+        conn.bytes += static_cast<uint64_t>(n);
+
+        if (conn.state == StreamConnection::HEADERS) {
+            if (!parser.Headers(conn.recvBuf, static_cast<size_t>(n))) {
+                ALOGE("StreamClient: request %u rejected (HTTP %d)", conn.requestId, conn.status);
+                Finish(conn, false, "bad response");
+                return false;
+            }
+        } else {
+            parser.Body(conn.recvBuf, static_cast<size_t>(n));
+        }
+
+        if (parser.done) {
+            Finish(conn, true, nullptr);
+            return true;
+        }
+        // The render queue filled up: leave the rest in the socket until it drains.
+        if (Throttled()) return true;
+    }
+}
+
+void StreamClient::Finish(StreamConnection& conn, bool ok, const char* reason) {
+    if (conn.state == StreamConnection::CLOSED) return;
+    if (conn.fd >= 0) close(conn.fd);
+    conn.fd = -1;
+    conn.state = StreamConnection::CLOSED;
+    EmitMarker(conn.requestId, ok ? STREAM_TOKEN_DONE : STREAM_TOKEN_ERROR);
+
+    const int64_t streamNs = NowNs() - conn.submitNs;
+    std::lock_guard<std::mutex> lock(metricsMutex_);
+    metrics_.bytesReceived += conn.bytes;
+    metrics_.tokensReceived += conn.tokens;
+    if (!ok) {
+        metrics_.requestsFailed++;
+        ALOGE("StreamClient: request %u failed: %s", conn.requestId, reason);
+        return;
+    }
+    metrics_.requestsCompleted++;
+    metrics_.lastFirstTokenNs = conn.firstTokenNs ? conn.firstTokenNs - conn.submitNs : 0;
+    metrics_.lastStreamNs = streamNs;
+    const double seconds = streamNs / 1e9;
+    metrics_.lastBytesPerSec = seconds > 0 ? conn.bytes / seconds : 0.0;
+    metrics_.lastTokensPerSec = seconds > 0 ? conn.tokens / seconds : 0.0;
+    ALOGI("StreamClient: request %u done: %llu tokens, %llu bytes, first token %.1f ms, total %.1f ms, %.1f tok/s",
+          conn.requestId, (unsigned long long)conn.tokens, (unsigned long long)conn.bytes,
+          metrics_.lastFirstTokenNs / 1e6, streamNs / 1e6, metrics_.lastTokensPerSec);
+}
+
+// =============================================================================
+// Loopback Stand-in Server
+// =============================================================================
+bool StreamStandInServer::Start(int tokenCount, int tokenDelayMs) {
+    if (running_) return true;
+    listenFd_ = socket(AF_INET, SOCK_STREAM, 0);
+    if (listenFd_ < 0) return false;
+    int one = 1;
+    setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    socklen_t len = sizeof(addr);
+    if (bind(listenFd_, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(listenFd_, 4) != 0 ||
+        getsockname(listenFd_, (sockaddr*)&addr, &len) != 0) {
+        ALOGE("StreamStandInServer: bind/listen failed: %s", strerror(errno));
+        close(listenFd_);
+        listenFd_ = -1;
+        return false;
+    }
+    port_ = ntohs(addr.sin_port);
+    tokenCount_ = tokenCount;
+    tokenDelayMs_ = tokenDelayMs;
+    running_ = true;
+    thread_ = std::thread(&StreamStandInServer::Serve, this);
+    ALOGI("StreamStandInServer listening on 127.0.0.1:%u", port_);
+    return true;
+}
+
+void StreamStandInServer::Stop() {
+    if (!running_) return;
+    running_ = false;
+    if (thread_.joinable()) thread_.join();
+    close(listenFd_);
+    listenFd_ = -1;
+}
+
+void StreamStandInServer::Serve() {
+    auto sendAll = [](int fd, const char* data, size_t len) {
+        while (len > 0) {
+            ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+            if (n <= 0) return false;
+            data += n;
+            len -= static_cast<size_t>(n);
+        }
+        return true;
+    };
+    auto sendChunk = [&](int fd, const char* payload, size_t len) {
+        char size[16];
+        int n = snprintf(size, sizeof(size), "%zx\r\n", len);
+        return sendAll(fd, size, n) && sendAll(fd, payload, len) && sendAll(fd, "\r\n", 2);
+    };
+
+    while (running_) {
+        pollfd pfd = {listenFd_, POLLIN, 0};
+        if (poll(&pfd, 1, 100) <= 0) continue;
+        int fd = accept(listenFd_, nullptr, nullptr);
+        if (fd < 0) continue;
+
+        // Read the request head plus any declared body, then ignore it.
+        std::string request;
+        char buf[4096];
+        size_t bodyNeeded = std::string::npos;
+        while (running_) {
+            ssize_t n = recv(fd, buf, sizeof(buf), 0);
+            if (n <= 0) break;
+            request.append(buf, static_cast<size_t>(n));
+            size_t headEnd = request.find("\r\n\r\n");
+            if (headEnd == std::string::npos) continue;
+            if (bodyNeeded == std::string::npos) {
+                size_t cl = request.find("Content-Length:");
+                bodyNeeded = headEnd + 4 + (cl != std::string::npos ? strtoul(request.c_str() + cl + 15, nullptr, 10) : 0);
+            }
+            if (request.size() >= bodyNeeded) break;
+        }
+
+        static const char kHead[] = "HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\n"
+                                    "Transfer-Encoding: chunked\r\nConnection: close\r\n\r\n";
+        bool ok = sendAll(fd, kHead, sizeof(kHead) - 1);
+        char event[160];
+        for (int i = 0; ok && running_ && i < tokenCount_; ++i) {
+            // Every eighth token carries escapes so the decoder path is exercised too.
+            int n = snprintf(event, sizeof(event),
+                             (i % 8 == 7) ? "data: {\"choices\":[{\"delta\":{\"content\":\"caf\\u00e9 \\\"%d\\\"\\n\"}}]}\n\n"
+                                          : "data: {\"choices\":[{\"delta\":{\"content\":\"token%d \"}}]}\n\n", i);
+            ok = sendChunk(fd, event, static_cast<size_t>(n));
+            if (tokenDelayMs_ > 0) std::this_thread::sleep_for(std::chrono::milliseconds(tokenDelayMs_));
+        }
+        static const char kDone[] = "data: [DONE]\n\n";
+        if (ok) ok = sendChunk(fd, kDone, sizeof(kDone) - 1) && sendAll(fd, "0\r\n\r\n", 5);
+        close(fd);
+    }
+}
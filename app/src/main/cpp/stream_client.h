@@ -0,0 +1,136 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "allocator.h"
+#include "spsc_ring.h"
+
+// =============================================================================
+// Streaming Assistant Backend Client
+// =============================================================================
+// Speaks plain HTTP/1.1 to the assistant backend (or a local gateway in front of
+// it) on its own event-loop thread. Responses may be chunked or identity encoded
+// and carry either Server-Sent Events or newline-delimited JSON. Text fragments are
+// decoded straight out of the receive buffer into fixed-size token slots and handed
+// to the render thread through a lock-free queue, so the frame loop never touches
+// a socket or a lock. Nothing is ever dropped: when the queue is full, the tokens
+// already decoded wait in an overflow list and no socket is read until it drains,
+// which leaves TCP flow control to slow the server down.
+
+enum StreamTokenKind : uint8_t {
+    STREAM_TOKEN_TEXT = 0,
+    STREAM_TOKEN_DONE = 1,
+    STREAM_TOKEN_ERROR = 2,
+};
+
+// One cache line per token. Longer fragments are split across consecutive slots.
+struct StreamToken {
+    uint32_t requestId;
+    uint16_t length;
+    uint8_t kind;
+    char text[57];
+};
+static_assert(sizeof(StreamToken) == 64, "StreamToken should fill one cache line");
+
+struct StreamRequest {
+    std::string host = "127.0.0.1";
+    uint16_t port = 80;
+    std::string path = "/";
+    std::string body;   // JSON payload, POSTed when non-empty
+};
+
+struct StreamMetrics {
+    uint64_t requestsCompleted = 0;
+    uint64_t requestsFailed = 0;
+    uint64_t tokensReceived = 0;
+    uint64_t bytesReceived = 0;
+    uint64_t readPauses = 0;          // times reads paused because the render queue filled up
+    int64_t readPausedNs = 0;         // total time reads stayed paused
+    int64_t lastFirstTokenNs = 0;     // submit -> first decoded text
+    int64_t lastStreamNs = 0;         // submit -> end of stream
+    double lastBytesPerSec = 0.0;
+    double lastTokensPerSec = 0.0;
+};
+
+struct StreamConnection;
+
+class StreamClient {
+public:
+    StreamClient() = default;
+    ~StreamClient() { Stop(); }
+
+    bool Start();
+    void Stop();
+
+    // Thread-safe. Returns the request id carried by every token of the response,
+    // or 0 if the client is not running.
+    uint32_t Submit(const StreamRequest& request);
+
+    // Render thread only. Never blocks.
+    bool PopToken(StreamToken& out) { return tokens_.TryPop(out); }
+
+    StreamMetrics GetMetrics();
+
+private:
+    void EventLoop();
+    void OpenPending();
+    bool Service(StreamConnection& conn, short revents);
+    void Finish(StreamConnection& conn, bool ok, const char* reason);
+    void EmitText(StreamConnection& conn, const char* data, size_t length);
+    void EmitMarker(uint32_t requestId, StreamTokenKind kind);
+    void Enqueue(const StreamToken& token);
+    // Moves overflow into the render queue; true once it is empty.
+    bool FlushOverflow();
+    bool Throttled() const { return overflowHead_ < overflow_.size(); }
+
+    std::thread thread_;
+    std::atomic<bool> running_{false};
+    int wakePipe_[2] = {-1, -1};
+
+    std::mutex submitMutex_;
+    std::vector<std::pair<uint32_t, StreamRequest>> pending_;
+    uint32_t nextRequestId_ = 1;
+
+    std::vector<StreamConnection*> connections_;   // event-loop thread only
+    ObjectPool<StreamConnection> connectionPool_{MEM_TAG_NETWORK, 4};
+    SpscRing<StreamToken, 1024> tokens_;
+    // Event-loop thread only. Tokens the full render queue could not take, in
+    // order; at most what one receive buffer decodes to.
+    TrackedVector<StreamToken, MEM_TAG_NETWORK> overflow_;
+    size_t overflowHead_ = 0;
+
+    std::mutex metricsMutex_;
+    StreamMetrics metrics_;
+
+    friend struct StreamParser;
+};
+
+// -----------------------------------------------------------------------------
+// Loopback stand-in for the assistant backend. Answers every request with a
+// canned chunked SSE stream so the client can be exercised without a network.
+// -----------------------------------------------------------------------------
+class StreamStandInServer {
+public:
+    ~StreamStandInServer() { Stop(); }
+
+    // Binds 127.0.0.1 on an ephemeral port. tokenDelayMs spaces out events to
+    // mimic model generation speed.
+    bool Start(int tokenCount, int tokenDelayMs);
+    void Stop();
+    uint16_t Port() const { return port_; }
+
+private:
+    void Serve();
+
+    std::thread thread_;
+    std::atomic<bool> running_{false};
+    int listenFd_ = -1;
+    uint16_t port_ = 0;
+    int tokenCount_ = 0;
+    int tokenDelayMs_ = 0;
+};
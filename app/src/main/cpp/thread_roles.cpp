@@ -0,0 +1,267 @@
+#include "thread_roles.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+
+#include <sched.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "common.h"
+
+namespace {
+
+// Render and audio miss their slot if they wake up late, so they get the big
+// cores and the strongest nice values an app may set without privileges. The
+// network thread mostly waits on sockets and can live on the little cores.
+const ThreadRolePolicy kPolicies[THREAD_ROLE_COUNT] = {
+    {"main",    RUNTIME_THREAD_APPLICATION_MAIN,   CORE_CLASS_ANY,    0,   16000000},
+    {"render",  RUNTIME_THREAD_RENDERER_MAIN,      CORE_CLASS_BIG,    -8,  2000000},
+    {"audio",   RUNTIME_THREAD_APPLICATION_WORKER, CORE_CLASS_BIG,    -16, 2000000},
+    {"network", RUNTIME_THREAD_APPLICATION_WORKER, CORE_CLASS_LITTLE, 0,   10000000},
+    {"worker",  RUNTIME_THREAD_APPLICATION_WORKER, CORE_CLASS_ANY,    -4,  5000000},
+};
+
+struct RoleCounters {
+    std::atomic<uint32_t> threads{0};
+    std::atomic<uint64_t> wakes{0};
+    std::atomic<uint64_t> misses{0};
+    std::atomic<int64_t> latenessSumNs{0};
+    std::atomic<int64_t> maxLatenessNs{0};
+};
+
+RoleCounters gCounters[THREAD_ROLE_COUNT];
+
+struct ThreadRecord {
+    int32_t tid;
+    ThreadRole role;
+    std::string name;
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<ThreadRecord> threads;
+    RuntimeThreadHook hook = nullptr;
+    void* hookUser = nullptr;
+    bool coresKnown = false;
+    std::vector<int> bigCores;
+    std::vector<int> littleCores;
+};
+
+Registry& Roles() {
+    static Registry registry;
+    return registry;
+}
+
+LinuxThreadPlatform gLinuxPlatform;
+std::atomic<ThreadPlatform*> gPlatform{&gLinuxPlatform};
+
+// Role used by the latency probe; unregistered threads count as workers.
+thread_local ThreadRole tRole = THREAD_ROLE_WORKER;
+
+// Splits the CPUs by capacity once. On a homogeneous CPU (or when sysfs says
+// nothing) both classes stay empty and affinity is left alone.
+void ClassifyCores(Registry& r, ThreadPlatform& platform) {
+    if (r.coresKnown) return;
+    r.coresKnown = true;
+    const std::vector<uint32_t> capacities = platform.CpuCapacities();
+    if (capacities.empty()) return;
+    const uint32_t lowest = *std::min_element(capacities.begin(), capacities.end());
+    for (int cpu = 0; cpu < static_cast<int>(capacities.size()); ++cpu) {
+        (capacities[cpu] > lowest ? r.bigCores : r.littleCores).push_back(cpu);
+    }
+    if (r.bigCores.empty()) r.littleCores.clear();   // homogeneous
+    ALOGI("Thread roles: %zu big cores, %zu little cores", r.bigCores.size(), r.littleCores.size());
+}
+
+bool ReadUint(const char* path, uint32_t& value) {
+    FILE* file = fopen(path, "r");
+    if (file == nullptr) return false;
+    unsigned long v = 0;
+    const bool ok = fscanf(file, "%lu", &v) == 1;
+    fclose(file);
+    value = static_cast<uint32_t>(v);
+    return ok;
+}
+
+} // namespace
+
+// =============================================================================
+// Linux platform
+// =============================================================================
+int32_t LinuxThreadPlatform::CurrentThreadId() { return static_cast<int32_t>(syscall(SYS_gettid)); }
+
+bool LinuxThreadPlatform::SetAffinity(int32_t tid, const std::vector<int>& cpus) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) CPU_SET(cpu, &set);
+    if (sched_setaffinity(tid, sizeof(set), &set) != 0) {
+        ALOGW("sched_setaffinity(%d) failed: %s", tid, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+bool LinuxThreadPlatform::SetNice(int32_t tid, int nice) {
+    if (setpriority(PRIO_PROCESS, static_cast<id_t>(tid), nice) != 0) {
+        ALOGW("setpriority(%d, %d) failed: %s", tid, nice, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+void LinuxThreadPlatform::SetName(const char* name) { prctl(PR_SET_NAME, name, 0, 0, 0); }
+
+std::vector<uint32_t> LinuxThreadPlatform::CpuCapacities() {
+    // cpu_capacity is the scheduler's own view (energy model); older kernels
+    // only expose the maximum frequency, which ranks the clusters the same way.
+    std::vector<uint32_t> capacities;
+    const long cpus = sysconf(_SC_NPROCESSORS_CONF);
+    for (long cpu = 0; cpu < cpus; ++cpu) {
+        char path[96];
+        uint32_t value = 0;
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%ld/cpu_capacity", cpu);
+        if (!ReadUint(path, value)) {
+            snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%ld/cpufreq/cpuinfo_max_freq", cpu);
+            if (!ReadUint(path, value)) return {};
+        }
+        capacities.push_back(value);
+    }
+    return capacities;
+}
+
+// =============================================================================
+// Registration
+// =============================================================================
+void ThreadRoles_SetPlatform(ThreadPlatform* platform) {
+    gPlatform.store(platform != nullptr ? platform : &gLinuxPlatform);
+    std::lock_guard<std::mutex> lock(Roles().mutex);
+    Roles().coresKnown = false;
+    Roles().bigCores.clear();
+    Roles().littleCores.clear();
+}
+
+const ThreadRolePolicy& ThreadRoles_Policy(ThreadRole role) { return kPolicies[role]; }
+
+int32_t ThreadRoles_RegisterCurrent(ThreadRole role, const char* name, bool applyPolicy) {
+    tRole = role;
+    if (applyPolicy) gPlatform.load()->SetName(name);
+    return ThreadRoles_RegisterThread(gPlatform.load()->CurrentThreadId(), role, name, applyPolicy);
+}
+
+int32_t ThreadRoles_RegisterThread(int32_t tid, ThreadRole role, const char* name, bool applyPolicy) {
+    ThreadPlatform& platform = *gPlatform.load();
+    const ThreadRolePolicy& policy = kPolicies[role];
+
+    Registry& r = Roles();
+    RuntimeThreadHook hook;
+    void* hookUser;
+    std::vector<int> cores;
+    {
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.threads.push_back({tid, role, name});
+        hook = r.hook;
+        hookUser = r.hookUser;
+        if (applyPolicy) {
+            ClassifyCores(r, platform);
+            if (policy.cores == CORE_CLASS_BIG) cores = r.bigCores;
+            if (policy.cores == CORE_CLASS_LITTLE) cores = r.littleCores;
+        }
+    }
+    gCounters[role].threads.fetch_add(1, std::memory_order_relaxed);
+
+    if (applyPolicy) {
+        if (!cores.empty()) platform.SetAffinity(tid, cores);
+        if (policy.nice != 0) platform.SetNice(tid, policy.nice);
+    }
+    if (hook != nullptr && !hook(policy.runtimeType, tid, hookUser)) {
+        ALOGW("Runtime refused %s thread %s (%d)", policy.name, name, tid);
+    }
+    ALOGI("Thread %s (%d) registered as %s%s", name, tid, policy.name, applyPolicy ? "" : " (runtime only)");
+    return tid;
+}
+
+void ThreadRoles_Unregister(int32_t tid) {
+    Registry& r = Roles();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    auto it = std::find_if(r.threads.begin(), r.threads.end(), [tid](const ThreadRecord& t) { return t.tid == tid; });
+    if (it == r.threads.end()) return;
+    gCounters[it->role].threads.fetch_sub(1, std::memory_order_relaxed);
+    r.threads.erase(it);
+}
+
+std::vector<int32_t> ThreadRoles_Threads(ThreadRole role) {
+    Registry& r = Roles();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    std::vector<int32_t> tids;
+    for (const ThreadRecord& t : r.threads) {
+        if (t.role == role) tids.push_back(t.tid);
+    }
+    return tids;
+}
+
+void ThreadRoles_SetRuntimeHook(RuntimeThreadHook hook, void* user) {
+    Registry& r = Roles();
+    std::vector<ThreadRecord> threads;
+    {
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.hook = hook;
+        r.hookUser = user;
+        if (hook != nullptr) threads = r.threads;
+    }
+    for (const ThreadRecord& t : threads) {
+        const ThreadRolePolicy& policy = kPolicies[t.role];
+        if (!hook(policy.runtimeType, t.tid, user)) {
+            ALOGW("Runtime refused %s thread %s (%d)", policy.name, t.name.c_str(), t.tid);
+        }
+    }
+}
+
+// =============================================================================
+// Scheduling-latency probe
+// =============================================================================
+void ThreadRoles_SleepUntil(int64_t deadlineNs) {
+    timespec ts;
+    ts.tv_sec = static_cast<time_t>(deadlineNs / 1000000000LL);
+    ts.tv_nsec = static_cast<long>(deadlineNs % 1000000000LL);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {}
+    ThreadRoles_RecordWake(deadlineNs, NowNs());
+}
+
+void ThreadRoles_RecordWake(int64_t expectedNs, int64_t actualNs) {
+    RoleCounters& c = gCounters[tRole];
+    const int64_t lateness = std::max<int64_t>(0, actualNs - expectedNs);
+    c.wakes.fetch_add(1, std::memory_order_relaxed);
+    c.latenessSumNs.fetch_add(lateness, std::memory_order_relaxed);
+    if (lateness > kPolicies[tRole].wakeDeadlineNs) c.misses.fetch_add(1, std::memory_order_relaxed);
+    int64_t max = c.maxLatenessNs.load(std::memory_order_relaxed);
+    while (lateness > max && !c.maxLatenessNs.compare_exchange_weak(max, lateness, std::memory_order_relaxed)) {}
+}
+
+ThreadRoleStats ThreadRoles_Stats(ThreadRole role) {
+    const RoleCounters& c = gCounters[role];
+    ThreadRoleStats s;
+    s.threads = c.threads.load(std::memory_order_relaxed);
+    s.wakes = c.wakes.load(std::memory_order_relaxed);
+    s.misses = c.misses.load(std::memory_order_relaxed);
+    s.maxLatenessNs = c.maxLatenessNs.load(std::memory_order_relaxed);
+    s.meanLatenessNs = s.wakes != 0 ? c.latenessSumNs.load(std::memory_order_relaxed) / static_cast<int64_t>(s.wakes) : 0;
+    return s;
+}
+
+void ThreadRoles_LogReport() {
+    for (int role = 0; role < THREAD_ROLE_COUNT; ++role) {
+        const ThreadRoleStats s = ThreadRoles_Stats(static_cast<ThreadRole>(role));
+        if (s.wakes == 0) continue;
+        ALOGI("Thread role %-8s %llu wakes  mean late %6.1f us  max %7.1f us  %llu over %.1f ms",
+              kPolicies[role].name, (unsigned long long)s.wakes, s.meanLatenessNs / 1e3, s.maxLatenessNs / 1e3,
+              (unsigned long long)s.misses, kPolicies[role].wakeDeadlineNs / 1e6);
+    }
+}
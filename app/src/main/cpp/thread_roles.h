@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// =============================================================================
+// Thread Roles
+// =============================================================================
+// Every long-lived native thread registers itself with a role. The role decides
+// its CPU affinity and nice value, and the thread type it is reported to the XR
+// runtime with (XR_KHR_android_thread_settings) so the runtime can schedule the
+// render thread accordingly. Threads that sleep towards a deadline do so through
+// ThreadRoles_SleepUntil, which records how late each role wakes up.
+
+enum ThreadRole : uint8_t {
+    THREAD_ROLE_MAIN = 0,   // Java UI thread
+    THREAD_ROLE_RENDER,     // app_main: frame loop and GL submission
+    THREAD_ROLE_AUDIO,      // mixer output, capture processing
+    THREAD_ROLE_NETWORK,    // assistant streaming
+    THREAD_ROLE_WORKER,     // anything else
+    THREAD_ROLE_COUNT
+};
+
+// Mirrors XrAndroidThreadTypeKHR so this header needs no platform defines.
+enum RuntimeThreadType : int32_t {
+    RUNTIME_THREAD_APPLICATION_MAIN = 1,
+    RUNTIME_THREAD_APPLICATION_WORKER = 2,
+    RUNTIME_THREAD_RENDERER_MAIN = 3,
+    RUNTIME_THREAD_RENDERER_WORKER = 4,
+};
+
+enum CoreClass : uint8_t {
+    CORE_CLASS_ANY,
+    CORE_CLASS_BIG,      // every core above the lowest capacity
+    CORE_CLASS_LITTLE,   // lowest-capacity cores only
+};
+
+struct ThreadRolePolicy {
+    const char* name;
+    RuntimeThreadType runtimeType;
+    CoreClass cores;
+    int nice;                  // applied with setpriority
+    int64_t wakeDeadlineNs;    // wake-ups later than this count as a miss
+};
+
+struct ThreadRoleStats {
+    uint32_t threads = 0;
+    uint64_t wakes = 0;
+    uint64_t misses = 0;
+    int64_t maxLatenessNs = 0;
+    int64_t meanLatenessNs = 0;
+};
+
+// -----------------------------------------------------------------------------
+// Platform calls, swappable so the policy logic can be exercised off-device.
+// -----------------------------------------------------------------------------
+class ThreadPlatform {
+public:
+    virtual ~ThreadPlatform() = default;
+    virtual int32_t CurrentThreadId() = 0;
+    virtual bool SetAffinity(int32_t tid, const std::vector<int>& cpus) = 0;
+    virtual bool SetNice(int32_t tid, int nice) = 0;
+    virtual void SetName(const char* name) = 0;
+    // Relative capacity per CPU index; empty if unknown.
+    virtual std::vector<uint32_t> CpuCapacities() = 0;
+};
+
+// sched_setaffinity / setpriority / prctl, reading capacities from sysfs.
+// Also what runs on Android.
+class LinuxThreadPlatform : public ThreadPlatform {
+public:
+    int32_t CurrentThreadId() override;
+    bool SetAffinity(int32_t tid, const std::vector<int>& cpus) override;
+    bool SetNice(int32_t tid, int nice) override;
+    void SetName(const char* name) override;
+    std::vector<uint32_t> CpuCapacities() override;
+};
+
+// Installs a platform (nullptr restores the Linux one). Call before any thread registers.
+void ThreadRoles_SetPlatform(ThreadPlatform* platform);
+
+const ThreadRolePolicy& ThreadRoles_Policy(ThreadRole role);
+
+// Registers the calling thread. applyPolicy=false for threads someone else
+// schedules (AAudio callbacks): they are only reported to the runtime.
+// Returns the thread id.
+int32_t ThreadRoles_RegisterCurrent(ThreadRole role, const char* name, bool applyPolicy = true);
+// Registers another thread by id, for threads that must not take the registry
+// lock themselves (the AAudio callback hands its id over instead). The name is
+// only recorded; it is not applied to the thread.
+int32_t ThreadRoles_RegisterThread(int32_t tid, ThreadRole role, const char* name, bool applyPolicy = false);
+void ThreadRoles_Unregister(int32_t tid);
+// Thread ids currently registered with the role.
+std::vector<int32_t> ThreadRoles_Threads(ThreadRole role);
+
+// Reports a thread to the XR runtime; returns false if the runtime refused it.
+typedef bool (*RuntimeThreadHook)(RuntimeThreadType type, int32_t tid, void* user);
+// Reports every registered thread now and each later one as it registers.
+// nullptr detaches (e.g. before the session is destroyed).
+void ThreadRoles_SetRuntimeHook(RuntimeThreadHook hook, void* user);
+
+// Scheduling-latency probe for the calling thread's role.
+void ThreadRoles_SleepUntil(int64_t deadlineNs);
+// For waits that end inside someone else's API (e.g. xrWaitFrame).
+void ThreadRoles_RecordWake(int64_t expectedNs, int64_t actualNs);
+
+ThreadRoleStats ThreadRoles_Stats(ThreadRole role);
+void ThreadRoles_LogReport();
+
+// Registers on construction, unregisters when the thread function returns.
+class ThreadRoleScope {
+public:
+    ThreadRoleScope(ThreadRole role, const char* name) : tid_(ThreadRoles_RegisterCurrent(role, name)) {}
+    ~ThreadRoleScope() { ThreadRoles_Unregister(tid_); }
+    ThreadRoleScope(const ThreadRoleScope&) = delete;
+    ThreadRoleScope& operator=(const ThreadRoleScope&) = delete;
+
+private:
+    int32_t tid_;
+};
@@ -0,0 +1,288 @@
+#include "vision_roi.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "common.h"
+#include "image_capture.h"
+
+namespace {
+
+// v rotated by the unit quaternion q (x, y, z, w); by its inverse when `inverse`.
+void Rotate(const float q[4], bool inverse, const float v[3], float out[3]) {
+    const float x = inverse ? -q[0] : q[0], y = inverse ? -q[1] : q[1], z = inverse ? -q[2] : q[2], w = q[3];
+    // t = 2 (q x v); v' = v + w t + q x t
+    const float tx = 2.0f * (y * v[2] - z * v[1]);
+    const float ty = 2.0f * (z * v[0] - x * v[2]);
+    const float tz = 2.0f * (x * v[1] - y * v[0]);
+    out[0] = v[0] + w * tx + (y * tz - z * ty);
+    out[1] = v[1] + w * ty + (z * tx - x * tz);
+    out[2] = v[2] + w * tz + (x * ty - y * tx);
+}
+
+inline uint8_t Average(uint8_t a, uint8_t b) { return static_cast<uint8_t>((a + b + 1) >> 1); }
+
+// Bilinear resample of a tightly packed RGBA8 image, for the final step of
+// less than 2:1 where a box filter would not line up. Weights are 8-bit fixed
+// point; the column taps are worked out once per call.
+void Resample(const uint8_t* src, int32_t srcWidth, int32_t srcHeight, uint8_t* dst, int32_t dstWidth, int32_t dstHeight) {
+    thread_local TrackedVector<int32_t, MEM_TAG_VISION> columns;
+    columns.resize(static_cast<size_t>(dstWidth) * 2);
+    const float sx = static_cast<float>(srcWidth) / dstWidth;
+    const float sy = static_cast<float>(srcHeight) / dstHeight;
+    for (int32_t x = 0; x < dstWidth; ++x) {
+        const float fx = std::max(0.0f, (x + 0.5f) * sx - 0.5f);
+        const int32_t x0 = std::min(static_cast<int32_t>(fx), srcWidth - 1);
+        columns[x * 2] = x0 * 4;
+        columns[x * 2 + 1] = x0 + 1 < srcWidth ? static_cast<int32_t>((fx - x0) * 256.0f) : 0;
+    }
+    for (int32_t y = 0; y < dstHeight; ++y) {
+        const float fy = std::max(0.0f, (y + 0.5f) * sy - 0.5f);
+        const int32_t y0 = std::min(static_cast<int32_t>(fy), srcHeight - 1);
+        const int32_t wy = y0 + 1 < srcHeight ? static_cast<int32_t>((fy - y0) * 256.0f) : 0;
+        const uint8_t* top = src + static_cast<size_t>(y0) * srcWidth * 4;
+        const uint8_t* bottom = wy > 0 ? top + static_cast<size_t>(srcWidth) * 4 : top;
+        uint8_t* out = dst + static_cast<size_t>(y) * dstWidth * 4;
+        for (int32_t x = 0; x < dstWidth; ++x) {
+            const uint8_t* t = top + columns[x * 2];
+            const uint8_t* b = bottom + columns[x * 2];
+            const int32_t wx = columns[x * 2 + 1];
+            for (int c = 0; c < 4; ++c) {
+                const int32_t upper = t[c] * 256 + (t[c + 4 * (wx > 0)] - t[c]) * wx;
+                const int32_t lower = b[c] * 256 + (b[c + 4 * (wx > 0)] - b[c]) * wx;
+                out[x * 4 + c] = static_cast<uint8_t>((upper * 256 + (lower - upper) * wy + 32768) >> 16);
+            }
+        }
+    }
+}
+
+} // namespace
+
+// =============================================================================
+// Region Selection
+// =============================================================================
+VisionRoi SelectVisionRoi(const VisionCamera& camera, int32_t width, int32_t height, const HeadPose& cameraPose,
+                          const HeadPose& viewPose, const float* gaze, const VisionRoiConfig& config) {
+    VisionRoi roi;
+    roi.width = width;
+    roi.height = height;
+    roi.gazeX = width * 0.5f;
+    roi.gazeY = height * 0.5f;
+
+    // Head space at the view's time -> world -> head space at capture time -> camera space.
+    static const float kForward[3] = {0.0f, 0.0f, -1.0f};
+    float world[3], head[3], local[3];
+    Rotate(viewPose.orientation, false, gaze != nullptr ? gaze : kForward, world);
+    Rotate(cameraPose.orientation, true, world, head);
+    Rotate(camera.orientation, true, head, local);
+    if (local[2] > -1e-3f) return roi;   // behind the camera
+
+    const float tanLeft = tanf(camera.angleLeft), tanRight = tanf(camera.angleRight);
+    const float tanUp = tanf(camera.angleUp), tanDown = tanf(camera.angleDown);
+    const float pixelsPerTanX = width / (tanRight - tanLeft);
+    const float pixelsPerTanY = height / (tanUp - tanDown);
+    const float gazeX = (local[0] / -local[2] - tanLeft) * pixelsPerTanX;
+    const float gazeY = (tanUp - local[1] / -local[2]) * pixelsPerTanY;
+    if (gazeX < 0.0f || gazeX >= width || gazeY < 0.0f || gazeY >= height) return roi;
+
+    // The field is measured at the centre; the region is slid, not shrunk, to stay inside the frame.
+    const float halfTan = tanf(std::max(1.0f, config.fieldDegrees) * 0.5f * static_cast<float>(M_PI) / 180.0f);
+    roi.width = std::min(width, std::max(2, static_cast<int32_t>(2.0f * halfTan * pixelsPerTanX)));
+    roi.height = std::min(height, std::max(2, static_cast<int32_t>(2.0f * halfTan * pixelsPerTanY)));
+    roi.x = std::max(0, std::min(width - roi.width, static_cast<int32_t>(gazeX - roi.width * 0.5f)));
+    roi.y = std::max(0, std::min(height - roi.height, static_cast<int32_t>(gazeY - roi.height * 0.5f)));
+    roi.gazeX = gazeX;
+    roi.gazeY = gazeY;
+    roi.fallback = false;
+    return roi;
+}
+
+// =============================================================================
+// SIMD Kernels
+// =============================================================================
+void VisionRoi_HalveScalar(const uint8_t* src, size_t srcStrideBytes, int32_t dstWidth, int32_t dstHeight, uint8_t* dst,
+                           size_t dstStrideBytes) {
+    for (int32_t y = 0; y < dstHeight; ++y) {
+        const uint8_t* a = src + 2 * y * srcStrideBytes;
+        const uint8_t* b = a + srcStrideBytes;
+        uint8_t* out = dst + y * dstStrideBytes;
+        for (int32_t x = 0; x < dstWidth * 4; ++x) {
+            const int32_t i = (x / 4) * 8 + (x % 4);
+            out[x] = Average(Average(a[i], b[i]), Average(a[i + 4], b[i + 4]));
+        }
+    }
+}
+
+void VisionRoi_Halve(const uint8_t* src, size_t srcStrideBytes, int32_t dstWidth, int32_t dstHeight, uint8_t* dst,
+                     size_t dstStrideBytes) {
+    for (int32_t y = 0; y < dstHeight; ++y) {
+        const uint8_t* a = src + 2 * y * srcStrideBytes;
+        const uint8_t* b = a + srcStrideBytes;
+        uint8_t* out = dst + y * dstStrideBytes;
+        int32_t x = 0;
+#if defined(__ARM_NEON)
+        // LD2 splits 8 pixels into even and odd ones.
+        for (; x + 4 <= dstWidth; x += 4) {
+            const uint32x4x2_t pa = vld2q_u32(reinterpret_cast<const uint32_t*>(a + x * 8));
+            const uint32x4x2_t pb = vld2q_u32(reinterpret_cast<const uint32_t*>(b + x * 8));
+            const uint8x16_t even = vrhaddq_u8(vreinterpretq_u8_u32(pa.val[0]), vreinterpretq_u8_u32(pb.val[0]));
+            const uint8x16_t odd = vrhaddq_u8(vreinterpretq_u8_u32(pa.val[1]), vreinterpretq_u8_u32(pb.val[1]));
+            vst1q_u8(out + x * 4, vrhaddq_u8(even, odd));
+        }
+#elif defined(__SSE2__)
+        for (; x + 4 <= dstWidth; x += 4) {
+            const __m128i r0 = _mm_avg_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + x * 8)),
+                                            _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + x * 8)));
+            const __m128i r1 = _mm_avg_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + x * 8 + 16)),
+                                            _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + x * 8 + 16)));
+            const __m128 f0 = _mm_castsi128_ps(r0), f1 = _mm_castsi128_ps(r1);
+            const __m128i even = _mm_castps_si128(_mm_shuffle_ps(f0, f1, _MM_SHUFFLE(2, 0, 2, 0)));
+            const __m128i odd = _mm_castps_si128(_mm_shuffle_ps(f0, f1, _MM_SHUFFLE(3, 1, 3, 1)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x * 4), _mm_avg_epu8(even, odd));
+        }
+#endif
+        for (int32_t i = x * 4; i < dstWidth * 4; ++i) {
+            const int32_t s = (i / 4) * 8 + (i % 4);
+            out[i] = Average(Average(a[s], b[s]), Average(a[s + 4], b[s + 4]));
+        }
+    }
+}
+
+void VisionRoi_Extract(const uint8_t* rgba, size_t strideBytes, const VisionRoi& roi, int32_t maxSide,
+                       TrackedVector<uint8_t, MEM_TAG_VISION>& out, int32_t& outWidth, int32_t& outHeight,
+                       bool vectorized) {
+    // The first halving reads the frame in place; later ones ping-pong between scratch buffers.
+    thread_local TrackedVector<uint8_t, MEM_TAG_VISION> scratch[2];
+    maxSide = std::max(1, maxSide);
+    const uint8_t* src = rgba + roi.y * strideBytes + static_cast<size_t>(roi.x) * 4;
+    size_t srcStride = strideBytes;
+    int32_t w = roi.width, h = roi.height;
+    int buffer = 0;
+    while (std::max(w, h) / 2 >= maxSide && std::min(w, h) >= 2) {
+        const int32_t dw = w / 2, dh = h / 2;
+        TrackedVector<uint8_t, MEM_TAG_VISION>& dst = scratch[buffer];
+        dst.resize(static_cast<size_t>(dw) * dh * 4);
+        if (vectorized) {
+            VisionRoi_Halve(src, srcStride, dw, dh, dst.data(), static_cast<size_t>(dw) * 4);
+        } else {
+            VisionRoi_HalveScalar(src, srcStride, dw, dh, dst.data(), static_cast<size_t>(dw) * 4);
+        }
+        src = dst.data();
+        srcStride = static_cast<size_t>(dw) * 4;
+        w = dw;
+        h = dh;
+        buffer ^= 1;
+    }
+
+    if (std::max(w, h) > maxSide) {
+        // Resample needs a packed source; after any halving it already is.
+        if (srcStride != static_cast<size_t>(w) * 4) {
+            TrackedVector<uint8_t, MEM_TAG_VISION>& packed = scratch[buffer];
+            packed.resize(static_cast<size_t>(w) * h * 4);
+            for (int32_t y = 0; y < h; ++y) memcpy(packed.data() + static_cast<size_t>(y) * w * 4, src + y * srcStride, w * 4);
+            src = packed.data();
+        }
+        outWidth = std::max(1, static_cast<int32_t>(static_cast<int64_t>(w) * maxSide / std::max(w, h)));
+        outHeight = std::max(1, static_cast<int32_t>(static_cast<int64_t>(h) * maxSide / std::max(w, h)));
+        out.resize(static_cast<size_t>(outWidth) * outHeight * 4);
+        Resample(src, w, h, out.data(), outWidth, outHeight);
+        return;
+    }
+    outWidth = w;
+    outHeight = h;
+    out.resize(static_cast<size_t>(w) * h * 4);
+    for (int32_t y = 0; y < h; ++y) memcpy(out.data() + static_cast<size_t>(y) * w * 4, src + y * srcStride, w * 4);
+}
+
+// =============================================================================
+// Head Pose History
+// =============================================================================
+void HeadPoseHistory::Record(const HeadPose& pose, int64_t timeNs) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_[next_] = {pose, timeNs};
+    next_ = (next_ + 1) % kCapacity;
+    count_ = std::min(count_ + 1, kCapacity);
+}
+
+bool HeadPoseHistory::Lookup(int64_t timeNs, HeadPose& pose) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (count_ == 0) return false;
+    const int64_t newest = entries_[(next_ + kCapacity - 1) % kCapacity].timeNs;
+    const int64_t oldest = entries_[(next_ + kCapacity - count_) % kCapacity].timeNs;
+    if (timeNs < oldest - kLookupSlackNs || timeNs > newest + kLookupSlackNs) return false;
+    int64_t best = INT64_MAX;
+    for (uint32_t i = 0; i < count_; ++i) {
+        const Entry& e = entries_[(next_ + kCapacity - 1 - i) % kCapacity];
+        const int64_t distance = e.timeNs > timeNs ? e.timeNs - timeNs : timeNs - e.timeNs;
+        if (distance < best) {
+            best = distance;
+            pose = e.pose;
+        }
+    }
+    return true;
+}
+
+bool HeadPoseHistory::Latest(HeadPose& pose, int64_t* timeNs) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (count_ == 0) return false;
+    const Entry& e = entries_[(next_ + kCapacity - 1) % kCapacity];
+    pose = e.pose;
+    if (timeNs != nullptr) *timeNs = e.timeNs;
+    return true;
+}
+
+// =============================================================================
+// Cropper
+// =============================================================================
+void VisionRoiCropper::Configure(const VisionCamera& camera, const VisionRoiConfig& config) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    camera_ = camera;
+    config_ = config;
+}
+
+void VisionRoiCropper::GetConfig(VisionCamera& camera, VisionRoiConfig& config) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    camera = camera_;
+    config = config_;
+}
+
+bool VisionRoiCropper::Crop(const uint8_t* rgba, int32_t width, int32_t height, size_t strideBytes,
+                            const HeadPose& cameraPose, const HeadPose& viewPose, const float* gaze,
+                            TrackedVector<uint8_t, MEM_TAG_CAPTURE>& png, VisionRoi* roiOut) {
+    VisionCamera camera;
+    VisionRoiConfig config;
+    GetConfig(camera, config);
+    const VisionRoi roi = SelectVisionRoi(camera, width, height, cameraPose, viewPose, gaze, config);
+
+    thread_local TrackedVector<uint8_t, MEM_TAG_VISION> image;
+    int32_t outWidth = 0, outHeight = 0;
+    const int64_t start = NowNs();
+    VisionRoi_Extract(rgba, strideBytes, roi, config.maxSide, image, outWidth, outHeight);
+    const int64_t extracted = NowNs();
+    const bool encoded = EncodePng(image.data(), outWidth, outHeight, png);
+    const int64_t end = NowNs();
+    if (roiOut != nullptr) *roiOut = roi;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.crops++;
+    if (roi.fallback) stats_.fallbacks++;
+    stats_.inputBytes += static_cast<uint64_t>(width) * height * 4;
+    stats_.outputBytes += encoded ? png.size() : 0;
+    stats_.extractNs += extracted - start;
+    stats_.encodeNs += end - extracted;
+    stats_.lastRoi = roi;
+    return encoded;
+}
+
+VisionRoiStats VisionRoiCropper::Stats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+#include "allocator.h"
+#include "head_pose.h"
+
+// =============================================================================
+// Vision Region of Interest
+// =============================================================================
+// Camera frames are cropped to what the wearer is looking at before they are
+// uploaded. The view direction (head forward, or an eye-gaze direction where
+// the runtime provides one) is taken at the time the crop is made and
+// projected into the camera frame using the head pose from when the frame
+// was captured, so head motion in between moves the crop with it. The region
+// is a fixed angular field around that point; it is downsampled by 2:1 box
+// filters (the per-pixel pass, vectorized) and one final bilinear step to at
+// most maxSide pixels, then PNG-encoded.
+//
+// Only rotation is compensated: the eye-to-camera offset and head translation
+// shift near objects by a few degrees at arm's length, which the field absorbs.
+
+// The camera's field of view as XrFovf angles (radians, left/down negative)
+// and its orientation in head space. The defaults describe a camera facing
+// forward with a 90 degree field.
+struct VisionCamera {
+    float angleLeft = -0.785398f;
+    float angleRight = 0.785398f;
+    float angleUp = 0.785398f;
+    float angleDown = -0.785398f;
+    float orientation[4] = {0.0f, 0.0f, 0.0f, 1.0f};   // x, y, z, w
+};
+
+struct VisionRoiConfig {
+    float fieldDegrees = 40.0f;   // angular width and height of the region
+    int32_t maxSide = 448;        // longer side of the uploaded image; regions are never enlarged
+};
+
+struct VisionRoi {
+    int32_t x = 0;
+    int32_t y = 0;
+    int32_t width = 0;
+    int32_t height = 0;
+    float gazeX = 0.0f;     // where the view direction lands, in pixels
+    float gazeY = 0.0f;
+    bool fallback = true;   // the view direction is outside the frame; the whole frame is used
+};
+
+// Rows are top-down. `gaze` is a unit direction in head space, null for
+// straight ahead (-Z).
+VisionRoi SelectVisionRoi(const VisionCamera& camera, int32_t width, int32_t height, const HeadPose& cameraPose,
+                          const HeadPose& viewPose, const float* gaze, const VisionRoiConfig& config);
+
+// Halves an RGBA8 image: each output pixel is the rounded mean of a 2x2 block,
+// rows averaged first. NEON on device, SSE2 on x86 hosts; the scalar version
+// is the reference and matches them exactly.
+void VisionRoi_Halve(const uint8_t* src, size_t srcStrideBytes, int32_t dstWidth, int32_t dstHeight, uint8_t* dst,
+                     size_t dstStrideBytes);
+void VisionRoi_HalveScalar(const uint8_t* src, size_t srcStrideBytes, int32_t dstWidth, int32_t dstHeight, uint8_t* dst,
+                           size_t dstStrideBytes);
+
+// Cuts `roi` out of the frame and scales it to at most maxSide; the result is
+// tightly packed RGBA8. `vectorized` exists for the evaluator.
+void VisionRoi_Extract(const uint8_t* rgba, size_t strideBytes, const VisionRoi& roi, int32_t maxSide,
+                       TrackedVector<uint8_t, MEM_TAG_VISION>& out, int32_t& outWidth, int32_t& outHeight,
+                       bool vectorized = true);
+
+// -----------------------------------------------------------------------------
+// Recent head poses by time, so a frame can be matched with the pose it was
+// captured at. Written by the frame loop, read from any thread.
+// -----------------------------------------------------------------------------
+class HeadPoseHistory {
+public:
+    void Record(const HeadPose& pose, int64_t timeNs);
+    // The recorded pose closest to timeNs; false when none is recorded or
+    // timeNs is more than kLookupSlackNs outside the recorded span.
+    bool Lookup(int64_t timeNs, HeadPose& pose) const;
+    // The newest pose; false when none is recorded.
+    bool Latest(HeadPose& pose, int64_t* timeNs = nullptr) const;
+
+private:
+    static constexpr uint32_t kCapacity = 128;   // about 1.4 s at 90 Hz
+    static constexpr int64_t kLookupSlackNs = 50000000;
+    struct Entry {
+        HeadPose pose;
+        int64_t timeNs;
+    };
+    mutable std::mutex mutex_;
+    Entry entries_[kCapacity] = {};
+    uint32_t next_ = 0;
+    uint32_t count_ = 0;
+};
+
+struct VisionRoiStats {
+    uint64_t crops = 0;
+    uint64_t fallbacks = 0;      // whole frames sent because the view was outside them
+    uint64_t inputBytes = 0;     // RGBA bytes of the frames handed in
+    uint64_t outputBytes = 0;    // encoded bytes handed back
+    int64_t extractNs = 0;       // crop and downsample, total
+    int64_t encodeNs = 0;        // total
+    VisionRoi lastRoi;
+};
+
+class VisionRoiCropper {
+public:
+    void Configure(const VisionCamera& camera, const VisionRoiConfig& config);
+    void GetConfig(VisionCamera& camera, VisionRoiConfig& config);
+    // Any thread. Selects, extracts and PNG-encodes the region; false when encoding fails.
+    bool Crop(const uint8_t* rgba, int32_t width, int32_t height, size_t strideBytes, const HeadPose& cameraPose,
+              const HeadPose& viewPose, const float* gaze, TrackedVector<uint8_t, MEM_TAG_CAPTURE>& png,
+              VisionRoi* roi = nullptr);
+    VisionRoiStats Stats();
+
+private:
+    std::mutex mutex_;
+    VisionCamera camera_;
+    VisionRoiConfig config_;
+    VisionRoiStats stats_;
+};
@@ -0,0 +1,244 @@
+#include "visual_dedup.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "allocator.h"
+#include "common.h"
+
+namespace {
+
+constexpr int kDctSize = 8;
+
+// cos((2x + 1) u pi / 2N) for the low kDctSize frequencies of an N = kVisualHashGrid DCT-II.
+struct DctBasis {
+    float c[kDctSize][kVisualHashGrid];
+    DctBasis() {
+        for (int u = 0; u < kDctSize; ++u) {
+            for (int x = 0; x < kVisualHashGrid; ++x) {
+                c[u][x] = cosf(static_cast<float>(M_PI) * (2 * x + 1) * u / (2 * kVisualHashGrid));
+            }
+        }
+    }
+};
+
+const DctBasis& Basis() {
+    static const DctBasis basis;
+    return basis;
+}
+
+} // namespace
+
+// =============================================================================
+// SIMD Kernels
+// =============================================================================
+void VisualHash_AccumulateRowsScalar(const uint8_t* rgba, size_t strideBytes, int32_t width, int32_t rows,
+                                     uint16_t* acc) {
+    const size_t n = static_cast<size_t>(width) * 4;
+    for (int32_t r = 0; r < rows; ++r) {
+        const uint8_t* row = rgba + r * strideBytes;
+        for (size_t i = 0; i < n; ++i) acc[i] = static_cast<uint16_t>(acc[i] + row[i]);
+    }
+}
+
+void VisualHash_AccumulateRows(const uint8_t* rgba, size_t strideBytes, int32_t width, int32_t rows, uint16_t* acc) {
+    const size_t n = static_cast<size_t>(width) * 4;
+    for (int32_t r = 0; r < rows; ++r) {
+        const uint8_t* row = rgba + r * strideBytes;
+        size_t i = 0;
+#if defined(__ARM_NEON)
+        for (; i + 16 <= n; i += 16) {
+            const uint8x16_t v = vld1q_u8(row + i);
+            vst1q_u16(acc + i, vaddw_u8(vld1q_u16(acc + i), vget_low_u8(v)));
+            vst1q_u16(acc + i + 8, vaddw_u8(vld1q_u16(acc + i + 8), vget_high_u8(v)));
+        }
+#elif defined(__SSE2__)
+        const __m128i zero = _mm_setzero_si128();
+        for (; i + 16 <= n; i += 16) {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+            __m128i* lo = reinterpret_cast<__m128i*>(acc + i);
+            __m128i* hi = reinterpret_cast<__m128i*>(acc + i + 8);
+            _mm_storeu_si128(lo, _mm_add_epi16(_mm_loadu_si128(lo), _mm_unpacklo_epi8(v, zero)));
+            _mm_storeu_si128(hi, _mm_add_epi16(_mm_loadu_si128(hi), _mm_unpackhi_epi8(v, zero)));
+        }
+#endif
+        for (; i < n; ++i) acc[i] = static_cast<uint16_t>(acc[i] + row[i]);
+    }
+}
+
+// =============================================================================
+// Perceptual Hash
+// =============================================================================
+uint64_t VisualHash_Compute(const uint8_t* rgba, int32_t width, int32_t height, size_t strideBytes, bool vectorized) {
+    // One band of rows at a time is summed per column into 16-bit lanes, then
+    // the band's columns are folded into cells. 256 rows per pass keep the
+    // lanes exact for any band height.
+    thread_local TrackedVector<uint16_t, MEM_TAG_VISION> acc;
+    acc.resize(static_cast<size_t>(width) * 4);
+    float grid[kVisualHashGrid][kVisualHashGrid];
+    for (int32_t by = 0; by < kVisualHashGrid; ++by) {
+        const int32_t y0 = by * height / kVisualHashGrid;
+        const int32_t y1 = (by + 1) * height / kVisualHashGrid;
+        uint32_t cells[kVisualHashGrid][3] = {};
+        for (int32_t y = y0; y < y1; y += 256) {
+            const int32_t rows = std::min<int32_t>(256, y1 - y);
+            std::fill(acc.begin(), acc.end(), 0);
+            if (vectorized) {
+                VisualHash_AccumulateRows(rgba + y * strideBytes, strideBytes, width, rows, acc.data());
+            } else {
+                VisualHash_AccumulateRowsScalar(rgba + y * strideBytes, strideBytes, width, rows, acc.data());
+            }
+            for (int32_t bx = 0; bx < kVisualHashGrid; ++bx) {
+                const int32_t x0 = bx * width / kVisualHashGrid;
+                const int32_t x1 = (bx + 1) * width / kVisualHashGrid;
+                for (int32_t x = x0; x < x1; ++x) {
+                    cells[bx][0] += acc[x * 4];
+                    cells[bx][1] += acc[x * 4 + 1];
+                    cells[bx][2] += acc[x * 4 + 2];
+                }
+            }
+        }
+        for (int32_t bx = 0; bx < kVisualHashGrid; ++bx) {
+            const float pixels = static_cast<float>((y1 - y0) * ((bx + 1) * width / kVisualHashGrid - bx * width / kVisualHashGrid));
+            grid[by][bx] = (0.299f * cells[bx][0] + 0.587f * cells[bx][1] + 0.114f * cells[bx][2]) / pixels;
+        }
+    }
+
+    // Separable DCT-II, low frequencies only: rows first, then columns.
+    const DctBasis& basis = Basis();
+    float rowsDct[kVisualHashGrid][kDctSize];
+    for (int y = 0; y < kVisualHashGrid; ++y) {
+        for (int u = 0; u < kDctSize; ++u) {
+            float sum = 0.0f;
+            for (int x = 0; x < kVisualHashGrid; ++x) sum += grid[y][x] * basis.c[u][x];
+            rowsDct[y][u] = sum;
+        }
+    }
+    float coefficients[kDctSize * kDctSize];
+    for (int v = 0; v < kDctSize; ++v) {
+        for (int u = 0; u < kDctSize; ++u) {
+            float sum = 0.0f;
+            for (int y = 0; y < kVisualHashGrid; ++y) sum += rowsDct[y][u] * basis.c[v][y];
+            coefficients[v * kDctSize + u] = sum;
+        }
+    }
+    // The median leaves out the DC term, which only tracks overall brightness.
+    float ac[kDctSize * kDctSize - 1];
+    std::copy(coefficients + 1, coefficients + kDctSize * kDctSize, ac);
+    std::nth_element(ac, ac + (kDctSize * kDctSize - 1) / 2, ac + kDctSize * kDctSize - 1);
+    const float median = ac[(kDctSize * kDctSize - 1) / 2];
+    uint64_t hash = 0;
+    for (int i = 0; i < kDctSize * kDctSize; ++i) {
+        if (coefficients[i] > median) hash |= 1ULL << i;
+    }
+    return hash;
+}
+
+double VisualHash_Benchmark(int32_t width, int32_t height, int iterations, bool vectorized, uint64_t* hash) {
+    // Gradients plus a few hard-edged blocks and noise, so no cell is flat.
+    TrackedVector<uint8_t, MEM_TAG_VISION> frame(static_cast<size_t>(width) * height * 4);
+    uint32_t seed = 12345;
+    for (int32_t y = 0; y < height; ++y) {
+        for (int32_t x = 0; x < width; ++x) {
+            seed = seed * 1664525u + 1013904223u;
+            uint8_t* p = frame.data() + (static_cast<size_t>(y) * width + x) * 4;
+            const int block = ((x * 5 / width) + (y * 3 / height)) % 2 ? 60 : 0;
+            p[0] = static_cast<uint8_t>(std::min(255, x * 200 / width + block + static_cast<int>(seed >> 29)));
+            p[1] = static_cast<uint8_t>(std::min(255, y * 200 / height + static_cast<int>(seed >> 28 & 7)));
+            p[2] = static_cast<uint8_t>(std::min(255, (x + y) * 100 / (width + height) + block));
+            p[3] = 255;
+        }
+    }
+    uint64_t result = VisualHash_Compute(frame.data(), width, height, static_cast<size_t>(width) * 4, vectorized);
+    const int64_t start = NowNs();
+    for (int i = 0; i < iterations; ++i) {
+        result = VisualHash_Compute(frame.data(), width, height, static_cast<size_t>(width) * 4, vectorized);
+    }
+    const double mean = iterations > 0 ? static_cast<double>(NowNs() - start) / iterations : 0.0;
+    if (hash != nullptr) *hash = result;
+    return mean;
+}
+
+float VisualMotionScore(const HeadPose& from, const HeadPose& to, float motionAngleDegrees, float motionMeters) {
+    float dot = 0.0f;
+    for (int i = 0; i < 4; ++i) dot += from.orientation[i] * to.orientation[i];
+    const float angleDegrees = 2.0f * acosf(std::min(1.0f, fabsf(dot))) * 180.0f / static_cast<float>(M_PI);
+    float distanceSq = 0.0f;
+    for (int i = 0; i < 3; ++i) {
+        const float d = to.position[i] - from.position[i];
+        distanceSq += d * d;
+    }
+    return std::max(angleDegrees / motionAngleDegrees, sqrtf(distanceSq) / motionMeters);
+}
+
+// =============================================================================
+// Deduplication
+// =============================================================================
+void VisualQueryDedup::Configure(const VisualDedupConfig& config) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    config_ = config;
+}
+
+VisualQueryDecision VisualQueryDedup::Submit(const uint8_t* rgba, int32_t width, int32_t height, size_t strideBytes,
+                                             const HeadPose* headPose, int64_t timeNs) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.frames++;
+    const bool recent = haveReference_ && timeNs - referenceTimeNs_ <= config_.maxReuseNs;
+    const float motion = headPose != nullptr && referenceHasPose_ && haveReference_
+                                 ? VisualMotionScore(referencePose_, *headPose, config_.motionAngleDegrees, config_.motionMeters)
+                                 : -1.0f;
+    stats_.lastMotion = motion;
+
+    bool duplicate = false;
+    if (rgba != nullptr && width >= kVisualHashGrid && height >= kVisualHashGrid) {
+        const int64_t start = NowNs();
+        const uint64_t hash = VisualHash_Compute(rgba, width, height, strideBytes);
+        stats_.hashNs += NowNs() - start;
+        stats_.hashes++;
+        stats_.lastDistance = haveReference_ ? VisualHash_Distance(hash, referenceHash_) : -1;
+        const bool still = motion >= 0.0f && motion < config_.stillMotion;
+        const int threshold = still ? std::max(config_.maxHammingBits, config_.stillHammingBits) : config_.maxHammingBits;
+        duplicate = recent && stats_.lastDistance >= 0 && stats_.lastDistance <= threshold;
+        if (duplicate && stats_.lastDistance > config_.maxHammingBits) stats_.stillMatches++;
+        if (!duplicate) referenceHash_ = hash;
+    }
+    if (!duplicate) {
+        // Too small to hash counts as new content; it then has no usable reference.
+        haveReference_ = rgba != nullptr && width >= kVisualHashGrid && height >= kVisualHashGrid;
+        referenceHasPose_ = headPose != nullptr;
+        if (headPose != nullptr) referencePose_ = *headPose;
+        referenceTimeNs_ = timeNs;
+        inFlight_ = true;
+        stats_.sent++;
+        return VISUAL_QUERY_SEND;
+    }
+    if (inFlight_) {
+        stats_.coalesced++;
+        return VISUAL_QUERY_COALESCE;
+    }
+    stats_.reused++;
+    return VISUAL_QUERY_REUSE;
+}
+
+void VisualQueryDedup::Complete() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    inFlight_ = false;
+}
+
+void VisualQueryDedup::Reset() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    haveReference_ = false;
+    inFlight_ = false;
+}
+
+VisualDedupStats VisualQueryDedup::Stats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+#include "head_pose.h"
+
+// =============================================================================
+// Visual Query Deduplication
+// =============================================================================
+// Frames bound for the vision model are compared with the last one actually
+// sent before they leave the device. The comparison is a 64-bit perceptual
+// hash: the frame is box-filtered to a 32x32 luma grid (the only pass over
+// every pixel, vectorized), and the signs of its lowest 8x8 DCT coefficients
+// against their median form the bits. Small shifts, exposure changes and
+// sensor noise move a few bits; a different scene moves about half of them.
+//
+// Every frame is hashed; the head pose only tunes how close the hash must be.
+// A head that has not moved since the last query (and not long ago) is most
+// likely looking at the same thing, so a few more bits may differ, but a new
+// object held up in front of a still head still changes far more than that.
+//
+// A near-duplicate is either reused (the last answer is already back) or
+// coalesced (it is still pending and this frame should wait for it).
+
+constexpr int32_t kVisualHashGrid = 32;
+
+// Sums `rows` RGBA8 rows into `acc` (width * 4 lanes), which must start zeroed
+// or hold earlier rows of the same band. rows <= 257 keeps the 16-bit lanes exact.
+// NEON on device, SSE2 on x86 hosts; the scalar version is the reference.
+void VisualHash_AccumulateRows(const uint8_t* rgba, size_t strideBytes, int32_t width, int32_t rows, uint16_t* acc);
+void VisualHash_AccumulateRowsScalar(const uint8_t* rgba, size_t strideBytes, int32_t width, int32_t rows,
+                                     uint16_t* acc);
+
+// Both dimensions must be at least kVisualHashGrid. `vectorized` exists for the benchmark.
+uint64_t VisualHash_Compute(const uint8_t* rgba, int32_t width, int32_t height, size_t strideBytes,
+                            bool vectorized = true);
+inline int VisualHash_Distance(uint64_t a, uint64_t b) { return __builtin_popcountll(a ^ b); }
+// Mean ns per hash of a synthetic frame; the frame's hash goes to `hash` if given.
+double VisualHash_Benchmark(int32_t width, int32_t height, int iterations, bool vectorized, uint64_t* hash = nullptr);
+
+// 0 when still; 1 at either a motionAngleDegrees turn or a motionMeters step.
+float VisualMotionScore(const HeadPose& from, const HeadPose& to, float motionAngleDegrees, float motionMeters);
+
+enum VisualQueryDecision : uint8_t {
+    VISUAL_QUERY_SEND = 0,       // new content: send it, then call Complete() when answered
+    VISUAL_QUERY_REUSE = 1,      // same as the last answered query
+    VISUAL_QUERY_COALESCE = 2,   // same as the query still in flight
+};
+
+struct VisualDedupConfig {
+    int maxHammingBits = 8;          // hash distance still counted as the same view
+    int stillHammingBits = 14;       // the same, while the head is still
+    float stillMotion = 0.05f;       // below this motion score the head counts as still
+    float motionAngleDegrees = 20.0f;
+    float motionMeters = 0.5f;
+    int64_t maxReuseNs = 10000000000LL;   // older answers are never reused
+};
+
+struct VisualDedupStats {
+    uint64_t frames = 0;
+    uint64_t sent = 0;
+    uint64_t reused = 0;
+    uint64_t coalesced = 0;
+    uint64_t stillMatches = 0;   // duplicates only within the still-head distance
+    uint64_t hashes = 0;
+    int64_t hashNs = 0;          // total time spent hashing
+    int32_t lastDistance = -1;   // hash distance of the last hashed frame, -1 if none
+    float lastMotion = -1.0f;    // motion score of the last frame, -1 without a pose
+};
+
+class VisualQueryDedup {
+public:
+    void Configure(const VisualDedupConfig& config);
+    // Any thread. `headPose` may be null when no pose is known.
+    VisualQueryDecision Submit(const uint8_t* rgba, int32_t width, int32_t height, size_t strideBytes,
+                               const HeadPose* headPose, int64_t timeNs);
+    // The query last sent has been answered.
+    void Complete();
+    // Forget the reference, e.g. after the answer turned out useless.
+    void Reset();
+    VisualDedupStats Stats();
+
+private:
+    std::mutex mutex_;
+    VisualDedupConfig config_;
+    bool haveReference_ = false;
+    bool inFlight_ = false;
+    uint64_t referenceHash_ = 0;
+    bool referenceHasPose_ = false;
+    HeadPose referencePose_ = {};
+    int64_t referenceTimeNs_ = 0;
+    VisualDedupStats stats_;
+};
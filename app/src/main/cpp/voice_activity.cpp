@@ -0,0 +1,183 @@
+#include "voice_activity.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "common.h"
+
+// =============================================================================
+// SIMD Kernels
+// =============================================================================
+float Vad_SumSquares(const float* x, size_t n) {
+    size_t i = 0;
+    float sum = 0.0f;
+#if defined(__ARM_NEON)
+    float32x4_t acc0 = vdupq_n_f32(0.0f), acc1 = vdupq_n_f32(0.0f);
+    for (; i + 8 <= n; i += 8) {
+        float32x4_t a = vld1q_f32(x + i), b = vld1q_f32(x + i + 4);
+        acc0 = vmlaq_f32(acc0, a, a);
+        acc1 = vmlaq_f32(acc1, b, b);
+    }
+    acc0 = vaddq_f32(acc0, acc1);
+    float lanes[4];
+    vst1q_f32(lanes, acc0);
+    sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#elif defined(__SSE2__)
+    __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+    for (; i + 8 <= n; i += 8) {
+        __m128 a = _mm_loadu_ps(x + i), b = _mm_loadu_ps(x + i + 4);
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(a, a));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(b, b));
+    }
+    acc0 = _mm_add_ps(acc0, acc1);
+    float lanes[4];
+    _mm_storeu_ps(lanes, acc0);
+    sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+    for (; i < n; ++i) sum += x[i] * x[i];
+    return sum;
+}
+
+float Vad_PreEmphasisSumSquares(const float* x, size_t n, float previous, float k) {
+    if (n == 0) return 0.0f;
+    // The first sample needs the previous frame's tail; the rest are x[i] - k * x[i-1].
+    float first = x[0] - k * previous;
+    float sum = first * first;
+    size_t i = 1;
+#if defined(__ARM_NEON)
+    float32x4_t acc = vdupq_n_f32(0.0f);
+    for (; i + 4 <= n; i += 4) {
+        float32x4_t d = vmlsq_n_f32(vld1q_f32(x + i), vld1q_f32(x + i - 1), k);
+        acc = vmlaq_f32(acc, d, d);
+    }
+    float lanes[4];
+    vst1q_f32(lanes, acc);
+    sum += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#elif defined(__SSE2__)
+    __m128 acc = _mm_setzero_ps();
+    const __m128 kv = _mm_set1_ps(k);
+    for (; i + 4 <= n; i += 4) {
+        __m128 d = _mm_sub_ps(_mm_loadu_ps(x + i), _mm_mul_ps(kv, _mm_loadu_ps(x + i - 1)));
+        acc = _mm_add_ps(acc, _mm_mul_ps(d, d));
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, acc);
+    sum += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+    for (; i < n; ++i) {
+        float d = x[i] - k * x[i - 1];
+        sum += d * d;
+    }
+    return sum;
+}
+
+// =============================================================================
+// Detector
+// =============================================================================
+bool VoiceActivityDetector::Init(int sampleRate, const VoiceActivityConfig& config, VoiceSegmentCallback callback, void* user) {
+    if (sampleRate < 8000) { ALOGE("VAD: unsupported sample rate %d", sampleRate); return false; }
+    if (config.prerollFrames < 0 || config.startFrames < 1 || config.hangoverFrames < 1 ||
+        config.maxSegmentSeconds * 100.0f < config.prerollFrames + 1) {
+        ALOGE("VAD: invalid config (preroll %d, start %d, hangover %d frames, %.2f s max segment)", config.prerollFrames,
+              config.startFrames, config.hangoverFrames, config.maxSegmentSeconds);
+        return false;
+    }
+    config_ = config;
+    callback_ = callback;
+    user_ = user;
+    sampleRate_ = sampleRate;
+    frameSize_ = static_cast<size_t>(sampleRate / 100);
+
+    noiseFloorDb_ = -60.0f;
+    previousSample_ = 0.0f;
+    voicedRun_ = unvoicedRun_ = 0;
+    inSpeech_ = false;
+    samplePosition_ = 0;
+    lastVoicedSample_ = -1;
+
+    preroll_.assign(frameSize_ * static_cast<size_t>(config.prerollFrames), 0.0f);
+    prerollHead_ = prerollFill_ = 0;
+    segment_.assign(static_cast<size_t>(config.maxSegmentSeconds * sampleRate), 0.0f);
+    segmentLength_ = segmentVoicedEnd_ = 0;
+    ALOGI("VAD initialized: %d Hz, %zu-sample frames, %.1f s max segment", sampleRate, frameSize_, config.maxSegmentSeconds);
+    return true;
+}
+
+bool VoiceActivityDetector::Process(const float* frame) {
+    const size_t n = frameSize_;
+    const float energy = Vad_SumSquares(frame, n) / n;
+    const float tilt = Vad_PreEmphasisSumSquares(frame, n, previousSample_, 0.97f) / n / (energy + 1e-12f);
+    previousSample_ = frame[n - 1];
+    const float energyDb = 10.0f * log10f(energy + 1e-10f);
+
+    const bool voiced = energyDb > noiseFloorDb_ + config_.thresholdDb && tilt < config_.maxTiltRatio;
+    if (!voiced) {
+        // Fall quickly to quieter backgrounds, rise slowly so speech does not raise the floor.
+        const float rate = energyDb < noiseFloorDb_ ? 0.3f : 0.02f;
+        noiseFloorDb_ += rate * (energyDb - noiseFloorDb_);
+    }
+
+    if (voiced) {
+        voicedRun_++;
+        unvoicedRun_ = 0;
+        lastVoicedSample_ = samplePosition_ + static_cast<int64_t>(n);
+    } else {
+        voicedRun_ = 0;
+        unvoicedRun_++;
+    }
+
+    if (!inSpeech_ && voicedRun_ >= config_.startFrames) {
+        // Open a segment seeded with the preroll (which already holds the onset frames).
+        inSpeech_ = true;
+        segmentLength_ = 0;
+        if (!preroll_.empty()) {
+            const size_t start = (prerollHead_ + preroll_.size() - prerollFill_) % preroll_.size();
+            for (size_t k = 0; k < prerollFill_; ++k) segment_[segmentLength_++] = preroll_[(start + k) % preroll_.size()];
+        }
+        segmentStart_ = samplePosition_ - static_cast<int64_t>(prerollFill_);
+        prerollFill_ = 0;
+    }
+
+    if (inSpeech_) {
+        const size_t room = segment_.size() - segmentLength_;
+        const size_t count = std::min(room, n);
+        memcpy(&segment_[segmentLength_], frame, count * sizeof(float));
+        segmentLength_ += count;
+        if (voiced) segmentVoicedEnd_ = segmentLength_;
+        samplePosition_ += static_cast<int64_t>(n);
+        if (unvoicedRun_ >= config_.hangoverFrames || segmentLength_ == segment_.size()) Emit();
+        return voiced;
+    }
+
+    // Outside speech the frame only feeds the preroll ring.
+    if (!preroll_.empty()) {
+        for (size_t k = 0; k < n; ++k) {
+            preroll_[prerollHead_] = frame[k];
+            prerollHead_ = (prerollHead_ + 1) % preroll_.size();
+        }
+        prerollFill_ = std::min(prerollFill_ + n, preroll_.size());
+    }
+    samplePosition_ += static_cast<int64_t>(n);
+    return voiced;
+}
+
+void VoiceActivityDetector::Flush() {
+    if (inSpeech_) Emit();
+}
+
+void VoiceActivityDetector::Emit() {
+    // Trim the trailing hangover but keep one frame of tail so word endings are not clipped.
+    const size_t length = std::min(segmentLength_, segmentVoicedEnd_ + frameSize_);
+    VoiceSegment segment = {segment_.data(), length, sampleRate_, segmentStart_, lastVoicedSample_};
+    inSpeech_ = false;
+    voicedRun_ = unvoicedRun_ = 0;
+    segmentLength_ = segmentVoicedEnd_ = 0;
+    if (callback_ != nullptr) callback_(segment, user_);
+}
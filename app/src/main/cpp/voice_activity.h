@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// =============================================================================
+// Voice Activity Detection
+// =============================================================================
+// Works on fixed 10 ms mono frames. Each frame is classified from its energy
+// against an adaptive noise floor and from its spectral tilt (energy after
+// pre-emphasis relative to raw energy), which rejects broadband noise bursts
+// that are loud but not speech-shaped. Utterances are assembled into a buffer
+// allocated once in Init(), so Process() never allocates.
+
+struct VoiceSegment {
+    const float* samples;   // valid only for the duration of the callback
+    size_t count;
+    int sampleRate;
+    int64_t startSample;    // position in the capture stream
+    int64_t lastVoicedSample;
+};
+
+typedef void (*VoiceSegmentCallback)(const VoiceSegment& segment, void* user);
+
+struct VoiceActivityConfig {
+    float thresholdDb = 9.0f;       // above noise floor
+    float maxTiltRatio = 1.8f;      // white noise sits near 1.94
+    int startFrames = 3;            // consecutive voiced frames to open a segment
+    int hangoverFrames = 30;        // consecutive unvoiced frames to close one
+    int prerollFrames = 20;         // audio kept from before the onset
+    float maxSegmentSeconds = 15.0f;
+};
+
+class VoiceActivityDetector {
+public:
+    bool Init(int sampleRate, const VoiceActivityConfig& config, VoiceSegmentCallback callback, void* user);
+
+    // frame must hold FrameSize() samples. Returns whether the frame was voiced.
+    bool Process(const float* frame);
+
+    // Closes any open segment, e.g. when capture stops mid-utterance.
+    void Flush();
+
+    size_t FrameSize() const { return frameSize_; }
+    bool InSpeech() const { return inSpeech_; }
+    float NoiseFloorDb() const { return noiseFloorDb_; }
+    int64_t LastVoicedSample() const { return lastVoicedSample_; }
+
+private:
+    void Emit();
+
+    VoiceActivityConfig config_;
+    VoiceSegmentCallback callback_ = nullptr;
+    void* user_ = nullptr;
+    int sampleRate_ = 0;
+    size_t frameSize_ = 0;
+
+    float noiseFloorDb_ = -60.0f;
+    float previousSample_ = 0.0f;
+    int voicedRun_ = 0;
+    int unvoicedRun_ = 0;
+    bool inSpeech_ = false;
+    int64_t samplePosition_ = 0;
+    int64_t segmentStart_ = 0;
+    int64_t lastVoicedSample_ = -1;
+
+    std::vector<float> preroll_;    // circular, prerollFrames * frameSize
+    size_t prerollHead_ = 0;
+    size_t prerollFill_ = 0;
+    std::vector<float> segment_;
+    size_t segmentLength_ = 0;
+    size_t segmentVoicedEnd_ = 0;
+};
+
+// Vectorized kernels (NEON on device, SSE on x86 hosts, scalar otherwise).
+float Vad_SumSquares(const float* x, size_t n);
+// Sum of (x[i] - k * x[i-1])^2 with x[-1] = previous.
+float Vad_PreEmphasisSumSquares(const float* x, size_t n, float previous, float k);
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cmath>
+
+#include <openxr/openxr.h>
+
+// =============================================================================
+// 3D Math Library (Matrix)
+// =============================================================================
+struct Matrix4f {
+    float M[16];
+    static Matrix4f CreateIdentity() {
+        Matrix4f r;
+        for (int i = 0; i < 16; i++) r.M[i] = (i % 5 == 0) ? 1.0f : 0.0f;
+        return r;
+    }
+};
+
+// Column-major, like everything handed to GL: returns a * b.
+inline Matrix4f Matrix4f_Multiply(const Matrix4f& a, const Matrix4f& b) {
+    Matrix4f result;
+    for (int col = 0; col < 4; col++) {
+        for (int row = 0; row < 4; row++) {
+            result.M[col * 4 + row] = a.M[0 * 4 + row] * b.M[col * 4 + 0] +
+                                      a.M[1 * 4 + row] * b.M[col * 4 + 1] +
+                                      a.M[2 * 4 + row] * b.M[col * 4 + 2] +
+                                      a.M[3 * 4 + row] * b.M[col * 4 + 3];
+        }
+    }
+    return result;
+}
+
+inline Matrix4f Matrix4f_CreateProjectionFov(const XrFovf fov, const float nearZ, const float farZ) {
+    const float tanLeft = tanf(fov.angleLeft);
+    const float tanRight = tanf(fov.angleRight);
+    const float tanDown = tanf(fov.angleDown);
+    const float tanUp = tanf(fov.angleUp);
+    const float tanAngleWidth = tanRight - tanLeft;
+    const float tanAngleHeight = tanUp - tanDown;
+    Matrix4f result = {};
+    result.M[0] = 2.0f / tanAngleWidth;
+    result.M[5] = 2.0f / tanAngleHeight;
+    result.M[8] = (tanRight + tanLeft) / tanAngleWidth;
+    result.M[9] = (tanUp + tanDown) / tanAngleHeight;
+    result.M[10] = -(farZ + nearZ) / (farZ - nearZ);
+    result.M[11] = -1.0f;
+    result.M[14] = -2.0f * farZ * nearZ / (farZ - nearZ);
+    return result;
+}
+
+// Reversed-Z with the far plane at infinity: window depth is nearZ / distance,
+// 1 on the near plane and falling toward 0, for a depth clear of 0 and
+// GL_GREATER. zeroToOne is for a [0, w] clip depth range (GL_EXT_clip_control);
+// otherwise the default [-w, w] range is targeted.
+inline Matrix4f Matrix4f_CreateProjectionFovReversedInfinite(const XrFovf fov, const float nearZ, const bool zeroToOne) {
+    Matrix4f result = Matrix4f_CreateProjectionFov(fov, nearZ, 2.0f * nearZ);
+    result.M[10] = zeroToOne ? 0.0f : 1.0f;
+    result.M[14] = zeroToOne ? nearZ : 2.0f * nearZ;
+    return result;
+}
+
+inline Matrix4f Matrix4f_CreateFromQuaternion(const XrQuaternionf& q) {
+    Matrix4f result = Matrix4f::CreateIdentity();
+    const float x2 = q.x + q.x, y2 = q.y + q.y, z2 = q.z + q.z;
+    const float xx = q.x * x2, xy = q.x * y2, xz = q.x * z2;
+    const float yy = q.y * y2, yz = q.y * z2, zz = q.z * z2;
+    const float wx = q.w * x2, wy = q.w * y2, wz = q.w * z2;
+    result.M[0] = 1.0f - (yy + zz); result.M[1] = xy - wz; result.M[2] = xz + wy;
+    result.M[4] = xy + wz; result.M[5] = 1.0f - (xx + zz); result.M[6] = yz - wx;
+    result.M[8] = xz - wy; result.M[9] = yz + wx; result.M[10] = 1.0f - (xx + yy);
+    return result;
+}
+
+inline Matrix4f Matrix4f_CreateView(const XrPosef& pose) {
+    Matrix4f rotation = Matrix4f_CreateFromQuaternion(pose.orientation);
+    Matrix4f translation = Matrix4f::CreateIdentity();
+    translation.M[12] = -pose.position.x;
+    translation.M[13] = -pose.position.y;
+    translation.M[14] = -pose.position.z;
+    return Matrix4f_Multiply(rotation, translation);
+}
+
+inline Matrix4f Matrix4f_CreateTranslation(float x, float y, float z) {
+    Matrix4f r = Matrix4f::CreateIdentity();
+    r.M[12] = x; r.M[13] = y; r.M[14] = z;
+    return r;
+}
+
+// Six normalized planes (left, right, bottom, top, near, far) of a column-major
+// view-projection, as (a, b, c, d) with a*x + b*y + c*z + d >= 0 inside.
+inline void Matrix4f_ExtractFrustumPlanes(const Matrix4f& viewProj, float planes[6][4]) {
+    const float* m = viewProj.M;
+    for (int i = 0; i < 6; ++i) {
+        const int axis = i / 2;
+        const float sign = (i % 2 == 0) ? 1.0f : -1.0f;
+        for (int c = 0; c < 4; ++c) planes[i][c] = m[c * 4 + 3] + sign * m[c * 4 + axis];
+        const float length = sqrtf(planes[i][0] * planes[i][0] + planes[i][1] * planes[i][1] + planes[i][2] * planes[i][2]);
+        if (length > 0.0f) for (int c = 0; c < 4; ++c) planes[i][c] /= length;
+    }
+}
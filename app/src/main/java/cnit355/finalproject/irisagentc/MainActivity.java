@@ -22,6 +22,10 @@ public class MainActivity extends AppCompatActivity {
 //        setContentView(new SurfaceView(this));
         Log.i(TAG, "Activity onCreate: Calling native layer.");
 
+        // MSAA is chosen once, before the render thread creates its swapchains:
+        // adb shell am start -n cnit355.finalproject.irisagentc/.MainActivity --ei msaa 4
+        setMsaaSamplesNative(getIntent().getIntExtra("msaa", 1));
+
         // 2. Pass the activity context and asset manager to the native layer for initialization.
         onCreateNative(this);
     }
@@ -47,7 +51,8 @@ public class MainActivity extends AppCompatActivity {
         super.onDestroy();
         Log.i(TAG, "Activity onDestroy: Calling native layer.");
         // 5. Notify the native layer that the app is being destroyed for cleanup.
-        onDestroyNative();
+        // When the activity is only being recreated, GL state is kept for the next one.
+        onDestroyNative(isFinishing());
     }
 
     // --- Native Method Declarations ---
@@ -66,6 +71,21 @@ public class MainActivity extends AppCompatActivity {
      */
     public native void onResumeNative();
 
+    /**
+     * Selects 1x, 2x or 4x MSAA for the eye buffers. Only read when the render
+     * thread sets up its swapchains, so call it before onCreateNative(). Falls back
+     * to 1x when GL_EXT_multisampled_render_to_texture is unavailable.
+     */
+    public native void setMsaaSamplesNative(int samples);
+
+    /**
+     * Selects the eye buffers' depth: a reversed-Z, infinite-far projection or
+     * the conventional 0.1-100 m one, and 16, 24 or 32 (float) depth bits.
+     * Read, like the MSAA setting, when the render thread sets up its swapchains.
+     * 16 bits halves depth bandwidth and suits content within a few metres.
+     */
+    public native void setDepthModeNative(boolean reversedZ, int bits);
+
     /**
      * Called when the activity is no longer in the foreground.
      * This is where the OpenXR session ends and the render loop stops.
@@ -74,7 +94,298 @@ public class MainActivity extends AppCompatActivity {
 
     /**
      * The final call before the activity is destroyed.
-     * This is where all OpenXR resources are released.
+     * This is where all OpenXR resources are released. Unless the activity is
+     * finishing, the EGL context, compiled programs and uploaded assets are kept
+     * for the next onCreateNative().
+     * @param finishing Whether the activity is going away for good.
+     */
+    public native void onDestroyNative(boolean finishing);
+
+    /**
+     * Streams an assistant response from the backend. Tokens are consumed by
+     * the native render thread as they arrive.
+     * @return The request id, or 0 if the native client is not running.
+     */
+    public native int startAssistantStreamNative(String host, int port, String path, String body);
+
+    /**
+     * Starts the loopback stand-in backend and streams a canned response from it.
+     * @return The request id, or 0 if the stand-in could not be started.
+     */
+    public native int runStreamSelfTestNative(int tokenCount, int tokenDelayMs);
+
+    /**
+     * Streaming metrics: requests completed, requests failed, tokens, bytes,
+     * times socket reads paused because the render queue was full, last first-token latency (us), last stream duration (us),
+     * last bytes/s, last tokens/s, total time reads stayed paused (us).
+     */
+    public native long[] getStreamMetricsNative();
+
+    /**
+     * Starts microphone capture with voice activity segmentation.
+     * @param filePath Optional raw s16le/WAV clip to capture from instead of the microphone; null for the device.
+     * @return Whether capture started.
+     */
+    public native boolean startAudioCaptureNative(String filePath);
+
+    /**
+     * Stops audio capture and closes any utterance in progress.
+     */
+    public native void stopAudioCaptureNative();
+
+    /**
+     * Audio metrics: frames processed, voiced frames, utterances, ring overruns,
+     * audio processed (ms), VAD CPU per second of audio (us), last end-of-speech
+     * detection latency (us), last utterance length (samples).
+     */
+    public native long[] getAudioMetricsNative();
+
+    /**
+     * Plays the earcon from a point in stage space (metres).
+     * @return A handle for the voice, or -1 if no voice was free. Handles are
+     *         not reused, so one kept after its earcon ended is inert.
+     */
+    public native int playEarconNative(float x, float y, float z);
+
+    /**
+     * Renders 10 ms buffers offline with the given number of spatialized sources.
+     * @return Mean mixer cost per 10 ms buffer in nanoseconds.
+     */
+    public native long benchmarkSpatialMixerNative(int sources);
+
+    /**
+     * Spatial mixer metrics: callbacks, frames rendered, last callback (ns),
+     * max callback (ns), mean cost per 10 ms buffer (ns), active sources, commands dropped.
+     */
+    public native long[] getSpatialMixerMetricsNative();
+
+    /**
+     * Starts recording every per-frame input of the render loop to a file that
+     * the host frame_replay tool can play back. Pass null to stop recording.
+     * @param path Writable file path, e.g. under getExternalFilesDir().
+     */
+    public native void setFrameCaptureNative(String path);
+
+    /**
+     * Saves the left eye's next frame as a PNG. The pixels are read back
+     * asynchronously and written on a worker thread, so the file appears a few
+     * frames later.
+     * @param path Writable file path ending in .png.
+     */
+    public native void takeScreenshotNative(String path);
+
+    /**
+     * Records the left eye as H.264 in an MP4 file, replacing any recording in
+     * progress. Frames are dropped rather than slowing rendering when the
+     * encoder falls behind.
+     * @param path Writable file path ending in .mp4.
+     * @param fps Recording frame rate, 1 to 90.
+     */
+    public native void startRecordingNative(String path, int fps);
+
+    /** Stops the recording; the file is finalized once its last frames are encoded. */
+    public native void stopRecordingNative();
+
+    /**
+     * Screenshot and recording statistics: stills written, frames encoded,
+     * frames dropped, render-thread cost total (ns), worst render-thread cost in
+     * one frame (ns), encoder-thread CPU total (ns), last readback-to-encoded
+     * latency (ns), bytes written, recording (1/0).
+     */
+    public native long[] getImageCaptureStatsNative();
+
+    /**
+     * Streams a downsampled copy of the left eye to one TCP client as
+     * length-prefixed PNG frames. Frames are dropped, never waited for, when the
+     * client or encoder cannot keep up. With no client connected nothing is
+     * captured.
+     * @param enabled False stops the stream and closes the port.
+     * @param port Port to listen on; 0 picks a free one (see getMirrorStreamStatsNative).
+     * @param width Streamed image width in pixels; the height keeps the eye's aspect.
+     * @param fps Frames per second, 1 to 60.
+     * @param loopbackOnly Listen on 127.0.0.1 only, for use through adb forward.
+     */
+    public native void setMirrorStreamNative(boolean enabled, int port, int width, int fps, boolean loopbackOnly);
+
+    /**
+     * Mirror stream statistics: listening port (0 when stopped), client
+     * connected (1/0), clients accepted, frames sent, frames dropped, bytes
+     * sent, render-thread cost total (ns), worst render-thread cost in one frame
+     * (ns), encoder CPU total (ns), last capture-to-sent latency (ns).
+     */
+    public native long[] getMirrorStreamStatsNative();
+
+    /**
+     * Decides whether a camera frame needs a new vision query. Near-duplicates of
+     * the last frame sent, by perceptual hash or because the head has not moved,
+     * are not sent again.
+     * @param rgba Direct buffer of RGBA8 pixels.
+     * @param rowStride Bytes per row, at least width * 4.
+     * @param captureTimeNs When the frame was captured, in nanoseconds on the
+     *                      CLOCK_MONOTONIC timebase (System.nanoTime); 0 if unknown.
+     * @return 0 to send the frame (then call completeVisualQueryNative() when
+     *         answered), 1 to reuse the last answer, 2 to wait for the query in flight,
+     *         -1 if the buffer was invalid (do not send it or call completeVisualQueryNative()).
+     */
+    public native int submitVisualFrameNative(java.nio.ByteBuffer rgba, int width, int height, int rowStride,
+                                              long captureTimeNs);
+
+    /** The vision query last sent has been answered. */
+    public native void completeVisualQueryNative();
+
+    /**
+     * Tunes the vision query gate.
+     * @param maxHammingBits Hash bits (of 64) that may differ for a frame to count as a duplicate; default 8.
+     * @param stillMotion Head motion below which up to 14 bits may differ instead, as a fraction
+     *                    of a 20 degree turn or 0.5 m step; default 0.05. 0 never loosens the match.
+     */
+    public native void setVisualDedupNative(int maxHammingBits, float stillMotion);
+
+    /**
+     * Vision query gate statistics: frames submitted, sent, reused, coalesced,
+     * matched only within the still-head distance, hashed, mean hash cost (ns),
+     * last hash distance (-1 when none).
+     */
+    public native long[] getVisualDedupStatsNative();
+
+    /**
+     * Hashes a synthetic frame of the given size repeatedly.
+     * @return Mean hash cost per frame in nanoseconds.
+     */
+    public native long benchmarkFrameHashNative(int width, int height);
+
+    /**
+     * Describes the camera whose frames go to cropVisionFrameNative(): its
+     * field of view and how far it is tilted from the head's forward direction.
+     * Defaults to 90 x 90 degrees, facing forward.
+     * @param pitchDegrees Positive when the camera looks above the head's forward direction.
+     */
+    public native void setVisionCameraNative(float horizontalFovDegrees, float verticalFovDegrees, float pitchDegrees);
+
+    /**
+     * Sizes the region cropped for vision uploads.
+     * @param fieldDegrees Angular width and height around the view direction; default 40.
+     * @param maxSide Longer side of the uploaded image in pixels; default 448. Crops are never enlarged.
+     */
+    public native void setVisionRoiNative(float fieldDegrees, int maxSide);
+
+    /**
+     * Crops a camera frame to where the wearer is looking, downsamples it and
+     * encodes it as PNG. Head motion since the frame was captured is taken
+     * into account. The whole frame is used when the view is outside it.
+     * @param rgba Direct buffer of RGBA8 pixels, top row first.
+     * @param rowStride Bytes per row, at least width * 4.
+     * @param captureTimeNs When the frame was captured, in nanoseconds on the
+     *                      CLOCK_MONOTONIC timebase (System.nanoTime); 0 if unknown.
+     * @return The encoded crop, or null if the buffer was invalid.
+     */
+    public native byte[] cropVisionFrameNative(java.nio.ByteBuffer rgba, int width, int height, int rowStride,
+                                               long captureTimeNs);
+
+    /**
+     * Vision crop statistics: crops, whole-frame fallbacks, RGBA bytes handed
+     * in, encoded bytes handed back, mean crop-and-scale cost (ns), mean encode
+     * cost (ns), then the last region's x, y, width and height.
+     */
+    public native long[] getVisionRoiStatsNative();
+
+    /**
+     * GL statistics for the last frame: frame number, GL calls, draw calls, state
+     * sets, redundant state sets, upload bytes. Empty unless built with IRIS_GL_TRACE.
+     */
+    public native long[] getGlTraceStatsNative();
+
+    /**
+     * Logs the full GL call list and per-entry-point counts of the next frame.
+     * No-op unless built with IRIS_GL_TRACE.
+     */
+    public native void requestGlTraceDumpNative();
+
+    /**
+     * GPU memory by category in bytes: swapchain, depth, vertex buffers, index
+     * buffers, textures, render targets, other; then total, peak, budget (0 when
+     * unlimited), evictions, over-budget events; then the deferred deletion queue:
+     * objects waiting on a frame fence, their bytes, the longest the queue has
+     * been, and objects deleted through it so far.
+     */
+    public native long[] getGpuMemoryNative();
+
+    /**
+     * Sets the GPU memory budget. When exceeded, cacheable resources (the bundled
+     * panel mesh) that sat idle for a whole frame are evicted least recently used
+     * first, on the render thread at the start of the next frame, and uploaded
+     * again when next drawn. Pass 0 to remove the budget.
+     */
+    public native void setGpuBudgetNative(long bytes);
+
+    /**
+     * Native heap usage by subsystem, six values per tag in the order frame,
+     * scene, text, vision, network, audio, capture, general: live bytes, peak bytes,
+     * allocations per second since the previous call, lifetime allocations,
+     * cap refusals/breaches, cap (0 when uncapped).
+     */
+    public native long[] getMemoryStatsNative();
+
+    /**
+     * Caps a subsystem's native heap. Raw, arena and pool allocations are refused
+     * past the cap; container growth is only counted. Pass 0 to remove the cap.
+     * @param tag Index into the tag order of getMemoryStatsNative().
+     */
+    public native void setMemoryCapNative(int tag, long bytes);
+
+    /**
+     * Scheduling statistics per thread role, five values per role in the order
+     * main, render, audio, network, worker: registered threads, timed wake-ups,
+     * wake-ups past the role's deadline, mean lateness (ns), max lateness (ns).
+     */
+    public native long[] getThreadStatsNative();
+
+    /**
+     * Performance hint (ADPF) session: active (0/1), frames reported, frames over
+     * target, target updates after refresh-rate changes, rejected calls, current
+     * target (ns), last reported work duration (ns). Inactive below API 33.
+     */
+    public native long[] getPerfHintStatsNative();
+
+    /**
+     * Frame pacing: frames, missed vsyncs, duplicated frames, jank events, frames
+     * with a swapchain stall, display period (ns); then three values per phase in
+     * the order update, wait, begin, cull, acquire, render, submit, gpu: mean (ns)
+     * and max (ns) over the last 128 frames, and how many jank events were blamed on it.
+     */
+    public native long[] getFramePacingNative();
+
+    /**
+     * The most recent jank events, one line each: the late frame, vsyncs missed,
+     * the phase that overran and the frame's CPU and GPU time.
+     */
+    public native String getJankReportNative();
+
+    /**
+     * Swapchain image waits, six values per eye: images acquired, wait timeouts,
+     * stalls (acquires that timed out at least once), total wait (ns), longest
+     * wait (ns), last wait (ns). Each wait attempt is bounded by one display period.
+     */
+    public native long[] getSwapchainWaitStatsNative();
+
+    /**
+     * Resume to first frame, three values per kind in the order cold (everything
+     * created), warm (activity recreated, GL state kept), session (runtime lost
+     * the session or instance), hot (pause/resume, nothing rebuilt): count, last
+     * (ns), best (ns).
+     */
+    public native long[] getResumeStatsNative();
+
+    /**
+     * Panel mesh levels of detail: level count, level switches so far, then the
+     * number of objects drawn at each of the four possible levels last frame.
+     * Switches and per-level counts are only kept when culling on the CPU.
+     */
+    public native long[] getLodStatsNative();
+
+    /**
+     * How many pixels of geometric error a coarser mesh level may show before
+     * the finer one is used (default 1). Larger values trade detail for triangles.
      */
-    public native void onDestroyNative();
+    public native void setLodPixelErrorNative(float pixels);
 }
\ No newline at end of file